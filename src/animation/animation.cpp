@@ -1,4 +1,5 @@
 #include "animation/animation.h"
+#include "animation/animation_quantization.h"
 #include "engine/blob.h"
 #include "engine/fs/file_system.h"
 #include "engine/log.h"
@@ -6,6 +7,7 @@
 #include "engine/profiler.h"
 #include "engine/quat.h"
 #include "engine/resource_manager.h"
+#include "engine/simd.h"
 #include "engine/vec.h"
 #include "renderer/model.h"
 #include "renderer/pose.h"
@@ -15,15 +17,6 @@ namespace Lumix
 {
 
 
-enum class Version
-{
-	FIRST = 0,
-	COMPRESSION = 1,
-
-	LAST
-};
-
-
 static const ResourceType ANIMATION_TYPE("animation");
 
 
@@ -45,130 +38,264 @@ Animation::Animation(const Path& path, ResourceManagerBase& resource_manager, IA
 	, m_fps(30)
 	, m_mem(allocator)
 	, m_bones(allocator)
+	, m_bindings(allocator)
+{
+}
+
+
+Animation::~Animation()
+{
+	clearBindings();
+}
+
+
+// keys before the cursor are not searched unless the time went back
+static int findKey(const uint16* times, int count, int frame, int* cursor)
+{
+	ASSERT(count > 1);
+	if (cursor)
+	{
+		int key = *cursor;
+		if (key < 1 || key >= count || times[key - 1] > frame) key = 1;
+		while (key < count - 1 && times[key] <= frame) ++key;
+		*cursor = key;
+		return key;
+	}
+
+	int from = 1;
+	int to = count - 1;
+	while (from < to)
+	{
+		int mid = (from + to) >> 1;
+		if (times[mid] <= frame) from = mid + 1;
+		else to = mid;
+	}
+	return from;
+}
+
+
+static float getKeyT(const uint16* times, int key, float time, float rcp_fps)
+{
+	return float(time - times[key - 1] * rcp_fps) / ((times[key] - times[key - 1]) * rcp_fps);
+}
+
+
+static float4 loadQuantizedPosition(const uint16* in)
+{
+	float tmp[] = {(float)in[0], (float)in[1], (float)in[2], 0.0f};
+	return f4LoadUnaligned(tmp);
+}
+
+
+Vec3 Animation::getPosition(const Bone& bone, int key) const
+{
+	if (bone.pos) return bone.pos[key];
+	Vec3 min(bone.pos_min.x, bone.pos_min.y, bone.pos_min.z);
+	Vec3 step(bone.pos_step.x, bone.pos_step.y, bone.pos_step.z);
+	return dequantizePosition(bone.quantized_pos + key * 3, min, step);
+}
+
+
+Quat Animation::getRotation(const Bone& bone, int key) const
+{
+	if (bone.rot) return bone.rot[key];
+	return dequantizeRotation(bone.quantized_rot + key * 3);
+}
+
+
+void Animation::samplePosition(const Bone& bone, int frame, float time, int* cursor, Vec3* out) const
+{
+	if (bone.pos_count < 2)
+	{
+		*out = getPosition(bone, 0);
+		return;
+	}
+	int key = findKey(bone.pos_times, bone.pos_count, frame, cursor);
+	float t = getKeyT(bone.pos_times, key, time, 1.0f / m_fps);
+	if (bone.pos)
+	{
+		lerp(bone.pos[key - 1], bone.pos[key], out, t);
+		return;
+	}
+
+	// the range is linear, so the quantized values are interpolated and the range is applied once
+	const uint16* from = bone.quantized_pos + (key - 1) * 3;
+	float4 q0 = loadQuantizedPosition(from);
+	float4 q1 = loadQuantizedPosition(from + 3);
+	float4 q = f4Add(q0, f4Mul(f4Sub(q1, q0), f4Splat(t)));
+	float4 pos = f4Add(f4LoadUnaligned(&bone.pos_min), f4Mul(q, f4LoadUnaligned(&bone.pos_step)));
+	LUMIX_ALIGN_BEGIN(16) float tmp[4] LUMIX_ALIGN_END(16);
+	f4Store(tmp, pos);
+	out->set(tmp[0], tmp[1], tmp[2]);
+}
+
+
+void Animation::sampleRotation(const Bone& bone, int frame, float time, int* cursor, Quat* out) const
 {
+	if (bone.rot_count < 2)
+	{
+		*out = getRotation(bone, 0);
+		return;
+	}
+	int key = findKey(bone.rot_times, bone.rot_count, frame, cursor);
+	float t = getKeyT(bone.rot_times, key, time, 1.0f / m_fps);
+	nlerp(getRotation(bone, key - 1), getRotation(bone, key), out, t);
 }
 
 
-void Animation::getRelativePose(float time, Pose& pose, Model& model, float weight) const
+const Animation::Binding* Animation::getBinding(Model& model)
+{
+	ASSERT(model.isReady());
+	auto iter = m_bindings.find(&model);
+	if (iter.isValid()) return iter.value();
+
+	IAllocator& allocator = getAllocator();
+	Binding* binding = LUMIX_NEW(allocator, Binding)(allocator);
+	binding->model = &model;
+	bind(*binding);
+	m_bindings.insert(&model, binding);
+	// no reference is taken, so the binding must go away with the model's data
+	model.getObserverCb().bind<Animation, &Animation::onModelStateChanged>(this);
+	return binding;
+}
+
+
+void Animation::bind(Binding& binding) const
+{
+	binding.bone_indices.resize(m_bones.size());
+	for (int i = 0, c = m_bones.size(); i < c; ++i)
+	{
+		Model::BoneMap::iterator iter = binding.model->getBoneIndex(m_bones[i].name);
+		binding.bone_indices[i] = iter.isValid() ? iter.value() : -1;
+	}
+}
+
+
+void Animation::clearBindings()
+{
+	IAllocator& allocator = getAllocator();
+	for (Binding* binding : m_bindings)
+	{
+		binding->model->getObserverCb().unbind<Animation, &Animation::onModelStateChanged>(this);
+		LUMIX_DELETE(allocator, binding);
+	}
+	m_bindings.clear();
+}
+
+
+void Animation::onModelStateChanged(State, State new_state, Resource& resource)
+{
+	if (new_state == State::READY) return;
+
+	auto iter = m_bindings.find(static_cast<Model*>(&resource));
+	if (!iter.isValid()) return;
+
+	Binding* binding = iter.value();
+	m_bindings.erase(iter);
+	binding->model->getObserverCb().unbind<Animation, &Animation::onModelStateChanged>(this);
+	LUMIX_DELETE(getAllocator(), binding);
+}
+
+
+void Animation::getRelativePose(float time, Pose& pose, const Binding& binding, float weight) const
 {
 	PROFILE_FUNCTION();
 	ASSERT(!pose.is_absolute);
-
-	if (!model.isReady()) return;
+	ASSERT(binding.bone_indices.size() == m_bones.size());
 
 	int frame = (int)(time * m_fps);
-	float rcp_fps = 1.0f / m_fps;
 	frame = Math::clamp(frame, 0, m_frame_count - 1);
 	Vec3* pos = pose.positions;
 	Quat* rot = pose.rotations;
 
 	if (frame < m_frame_count - 1)
 	{
-		for (Bone& bone : m_bones)
+		for (int i = 0, c = m_bones.size(); i < c; ++i)
 		{
-			Model::BoneMap::iterator iter = model.getBoneIndex(bone.name);
-			if (!iter.isValid()) continue;
-
-			int idx = 1;
-			for (int c = bone.pos_count; idx < c; ++idx)
-			{
-				if (bone.pos_times[idx] > frame) break;
-			}
+			int model_bone_index = binding.bone_indices[i];
+			if (model_bone_index < 0) continue;
 
-			float t = float(time - bone.pos_times[idx - 1] * rcp_fps) /
-					  ((bone.pos_times[idx] - bone.pos_times[idx - 1]) * rcp_fps);
-
-			int model_bone_index = iter.value();
+			const Bone& bone = m_bones[i];
 			Vec3 anim_pos;
-			lerp(bone.pos[idx - 1], bone.pos[idx], &anim_pos, t);
+			samplePosition(bone, frame, time, nullptr, &anim_pos);
 			lerp(pos[model_bone_index], anim_pos, &pos[model_bone_index], weight);
 
-			idx = 1;
-			for (int c = bone.rot_count; idx < c; ++idx)
-			{
-				if (bone.rot_times[idx] > frame) break;
-			}
-
-			t = float(time - bone.rot_times[idx - 1] * rcp_fps) /
-				((bone.rot_times[idx] - bone.rot_times[idx - 1]) * rcp_fps);
-
 			Quat anim_rot;
-			nlerp(bone.rot[idx - 1], bone.rot[idx], &anim_rot, t);
+			sampleRotation(bone, frame, time, nullptr, &anim_rot);
 			nlerp(rot[model_bone_index], anim_rot, &rot[model_bone_index], weight);
 		}
 	}
 	else
 	{
-		for (Bone& bone : m_bones)
+		for (int i = 0, c = m_bones.size(); i < c; ++i)
 		{
-			Model::BoneMap::iterator iter = model.getBoneIndex(bone.name);
-			if (!iter.isValid()) continue;
+			int model_bone_index = binding.bone_indices[i];
+			if (model_bone_index < 0) continue;
 
-			int model_bone_index = iter.value();
-			lerp(pos[model_bone_index], bone.pos[bone.pos_count - 1], &pos[model_bone_index], weight);
-			nlerp(rot[model_bone_index], bone.rot[bone.rot_count - 1], &rot[model_bone_index], weight);
+			const Bone& bone = m_bones[i];
+			lerp(pos[model_bone_index], getPosition(bone, bone.pos_count - 1), &pos[model_bone_index], weight);
+			nlerp(rot[model_bone_index], getRotation(bone, bone.rot_count - 1), &rot[model_bone_index], weight);
 		}
 	}
 }
 
 
-void Animation::getRelativePose(float time, Pose& pose, Model& model) const
+void Animation::getRelativePose(float time,
+	Pose& pose,
+	const Binding& binding,
+	KeyCursor* cursors,
+	int bones_count) const
 {
 	PROFILE_FUNCTION();
 	ASSERT(!pose.is_absolute);
-
-	if (!model.isReady()) return;
+	ASSERT(binding.bone_indices.size() == m_bones.size());
+	ASSERT(bones_count <= pose.count);
 
 	int frame = (int)(time * m_fps);
-	float rcp_fps = 1.0f / m_fps;
 	frame = Math::clamp(frame, 0, m_frame_count - 1);
 	Vec3* pos = pose.positions;
 	Quat* rot = pose.rotations;
 
 	if (frame < m_frame_count - 1)
 	{
-		for (Bone& bone : m_bones)
+		for (int i = 0, c = m_bones.size(); i < c; ++i)
 		{
-			Model::BoneMap::iterator iter = model.getBoneIndex(bone.name);
-			if (!iter.isValid()) continue;
-
-			int idx = 1;
-			for (int c = bone.pos_count; idx < c; ++idx)
-			{
-				if (bone.pos_times[idx] > frame) break;
-			}
-
-			float t = float(time - bone.pos_times[idx - 1] * rcp_fps) /
-				((bone.pos_times[idx] - bone.pos_times[idx - 1]) * rcp_fps);
-			int model_bone_index = iter.value();
-			lerp(bone.pos[idx - 1], bone.pos[idx], &pos[model_bone_index], t);
-
-			idx = 1;
-			for (int c = bone.rot_count; idx < c; ++idx)
-			{
-				if (bone.rot_times[idx] > frame) break;
-			}
-
-			t = float(time - bone.rot_times[idx - 1] * rcp_fps) /
-				((bone.rot_times[idx] - bone.rot_times[idx - 1]) * rcp_fps);
-			nlerp(bone.rot[idx - 1], bone.rot[idx], &rot[model_bone_index], t);
+			int model_bone_index = binding.bone_indices[i];
+			if (model_bone_index < 0 || model_bone_index >= bones_count) continue;
+
+			const Bone& bone = m_bones[i];
+			int* pos_cursor = cursors ? &cursors[i].pos : nullptr;
+			int* rot_cursor = cursors ? &cursors[i].rot : nullptr;
+			samplePosition(bone, frame, time, pos_cursor, &pos[model_bone_index]);
+			sampleRotation(bone, frame, time, rot_cursor, &rot[model_bone_index]);
 		}
 	}
 	else
 	{
-		for (Bone& bone : m_bones)
+		for (int i = 0, c = m_bones.size(); i < c; ++i)
 		{
-			Model::BoneMap::iterator iter = model.getBoneIndex(bone.name);
-			if (!iter.isValid()) continue;
+			int model_bone_index = binding.bone_indices[i];
+			if (model_bone_index < 0 || model_bone_index >= bones_count) continue;
 
-			int model_bone_index = iter.value();
-			pos[model_bone_index] = bone.pos[bone.pos_count - 1];
-			rot[model_bone_index] = bone.rot[bone.rot_count - 1];
+			const Bone& bone = m_bones[i];
+			pos[model_bone_index] = getPosition(bone, bone.pos_count - 1);
+			rot[model_bone_index] = getRotation(bone, bone.rot_count - 1);
 		}
 	}
 }
 
 
+float Animation::wrapTime(float time) const
+{
+	float length = getLength();
+	while (time > length)
+	{
+		time -= length;
+	}
+	return time;
+}
+
+
 bool Animation::load(FS::IFile& file)
 {
 	IAllocator& allocator = getAllocator();
@@ -181,12 +308,13 @@ bool Animation::load(FS::IFile& file)
 		g_log_error.log("Animation") << getPath() << " is not an animation file";
 		return false;
 	}
-	if (header.version != (int)Version::LAST)
+	if (header.version <= (uint32)Version::COMPRESSION || header.version > (uint32)Version::LAST)
 	{
 		g_log_error.log("Animation") << "Unsupported animation version " << (int)header.version << " ("
 									 << getPath() << ")";
 		return false;
 	}
+	bool is_quantized = header.version > (uint32)Version::QUANTIZATION;
 	m_fps = header.fps;
 	file.read(&m_frame_count, sizeof(m_frame_count));
 	int bone_count;
@@ -199,15 +327,38 @@ bool Animation::load(FS::IFile& file)
 	InputBlob blob(&m_mem[0], size);
 	for (int i = 0; i < m_bones.size(); ++i)
 	{
-		m_bones[i].name = blob.read<uint32>();
-
-		m_bones[i].pos_count = blob.read<int>();
-		m_bones[i].pos_times = (const uint16*)blob.skip(m_bones[i].pos_count * sizeof(uint16));
-		m_bones[i].pos = (const Vec3*)blob.skip(m_bones[i].pos_count * sizeof(Vec3));;
-		
-		m_bones[i].rot_count = blob.read<int>();
-		m_bones[i].rot_times = (const uint16*)blob.skip(m_bones[i].rot_count * sizeof(uint16));;
-		m_bones[i].rot = (const Quat*)blob.skip(m_bones[i].rot_count * sizeof(Quat));;
+		Bone& bone = m_bones[i];
+		bone.name = blob.read<uint32>();
+
+		bone.pos_count = blob.read<int>();
+		bone.pos_times = (const uint16*)blob.skip(bone.pos_count * sizeof(uint16));
+		if (is_quantized)
+		{
+			Vec3 min = blob.read<Vec3>();
+			Vec3 step = blob.read<Vec3>();
+			bone.pos_min.set(min, 0);
+			bone.pos_step.set(step, 0);
+			bone.pos = nullptr;
+			bone.quantized_pos = (const uint16*)blob.skip(bone.pos_count * sizeof(uint16) * 3);
+		}
+		else
+		{
+			bone.pos = (const Vec3*)blob.skip(bone.pos_count * sizeof(Vec3));
+			bone.quantized_pos = nullptr;
+		}
+
+		bone.rot_count = blob.read<int>();
+		bone.rot_times = (const uint16*)blob.skip(bone.rot_count * sizeof(uint16));
+		if (is_quantized)
+		{
+			bone.rot = nullptr;
+			bone.quantized_rot = (const uint16*)blob.skip(bone.rot_count * sizeof(uint16) * 3);
+		}
+		else
+		{
+			bone.rot = (const Quat*)blob.skip(bone.rot_count * sizeof(Quat));
+			bone.quantized_rot = nullptr;
+		}
 	}
 
 	m_size = file.size();
@@ -223,6 +374,7 @@ IAllocator& Animation::getAllocator()
 
 void Animation::unload(void)
 {
+	clearBindings();
 	m_bones.clear();
 	m_mem.clear();
 	m_frame_count = 0;
@@ -1,7 +1,9 @@
 #pragma once
 
+#include "engine/hash_map.h"
 #include "engine/resource.h"
 #include "engine/resource_manager_base.h"
+#include "engine/vec.h"
 
 namespace Lumix
 {
@@ -15,7 +17,6 @@ namespace FS
 class Model;
 struct Pose;
 struct Quat;
-struct Vec3;
 
 
 class AnimationManager LUMIX_FINAL : public ResourceManagerBase
@@ -43,6 +44,15 @@ class Animation LUMIX_FINAL : public Resource
 		static const uint32 HEADER_MAGIC = 0x5f4c4146; // '_LAF'
 
 	public:
+		enum class Version : uint32
+		{
+			FIRST,
+			COMPRESSION,
+			QUANTIZATION,
+
+			LAST // keep this last
+		};
+
 		struct Header
 		{
 			uint32 magic;
@@ -50,20 +60,55 @@ class Animation LUMIX_FINAL : public Resource
 			uint32 fps;
 		};
 
+		// model bone index of each animation bone, -1 if the model does not have the bone
+		struct Binding
+		{
+			explicit Binding(IAllocator& allocator)
+				: bone_indices(allocator)
+			{
+			}
+
+			Model* model;
+			Array<int> bone_indices;
+		};
+
+		// keys sampled last time, so the next sample does not have to search from the first key
+		struct KeyCursor
+		{
+			int pos;
+			int rot;
+		};
+
 	public:
 		Animation(const Path& path, ResourceManagerBase& resource_manager, IAllocator& allocator);
-
-		void getRelativePose(float time, Pose& pose, Model& model) const;
-		void getRelativePose(float time, Pose& pose, Model& model, float weight) const;
+		~Animation();
+
+		// not thread safe, the binding is valid until the animation or the model is unloaded,
+		// the model is not referenced, so it has to be ready
+		const Binding* getBinding(Model& model);
+		// only bones with model index lower than bones_count are sampled
+		void getRelativePose(float time, Pose& pose, const Binding& binding, KeyCursor* cursors, int bones_count) const;
+		void getRelativePose(float time, Pose& pose, const Binding& binding, float weight) const;
 		int getFrameCount() const { return m_frame_count; }
 		float getLength() const { return m_frame_count / (float)m_fps; }
+		// time of a looping animation wrapped to its length
+		float wrapTime(float time) const;
 		int getFPS() const { return m_fps; }
+		int getBoneCount() const { return m_bones.size(); }
 
 	private:
 		IAllocator& getAllocator();
 
 		void unload() override;
 		bool load(FS::IFile& file) override;
+		void bind(Binding& binding) const;
+		struct Bone;
+		Vec3 getPosition(const Bone& bone, int key) const;
+		Quat getRotation(const Bone& bone, int key) const;
+		void samplePosition(const Bone& bone, int frame, float time, int* cursor, Vec3* out) const;
+		void sampleRotation(const Bone& bone, int frame, float time, int* cursor, Quat* out) const;
+		void clearBindings();
+		void onModelStateChanged(State old_state, State new_state, Resource& resource);
 
 	private:
 		int	m_frame_count;
@@ -76,9 +121,16 @@ class Animation LUMIX_FINAL : public Resource
 			int rot_count;
 			const uint16* rot_times;
 			const Quat* rot;
+			// quantized animations have these instead of pos and rot, see animation_quantization.h
+			Vec4 pos_min;
+			Vec4 pos_step;
+			const uint16* quantized_pos;
+			const uint16* quantized_rot;
 		};
 		Array<Bone> m_bones;
 		Array<uint8> m_mem;
+		// keyed by the model
+		HashMap<void*, Binding*> m_bindings;
 		int m_fps;
 };
 
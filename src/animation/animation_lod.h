@@ -0,0 +1,75 @@
+#pragma once
+
+
+#include "engine/lumix.h"
+
+
+namespace Lumix
+{
+
+
+// used by the animation scene and by the unit tests, so everything is inline
+
+
+// animables are assigned to the first LOD whose distance from the main camera is bigger than theirs
+struct AnimationLOD
+{
+	float distance;
+	// the pose is sampled once in this many frames and interpolated in between
+	int update_interval;
+	// only model bones with lower index are sampled, the rest stays in bind pose, 0 samples all bones
+	int bones_count;
+};
+
+
+enum class AnimationUpdateType : uint8
+{
+	SKIP,
+	SAMPLE,
+	// samples the pose update interval frames ahead, so it can be interpolated until the next sample
+	SAMPLE_AHEAD,
+	// SAMPLE_AHEAD without a previous sample, so the current pose is sampled too
+	SAMPLE_AHEAD_FIRST,
+	INTERPOLATE
+};
+
+
+// LOD of an animable at distance from the camera, -1 without LODs
+inline int getAnimationLOD(const AnimationLOD* lods, int count, float distance)
+{
+	if (count == 0) return -1;
+	int lod = 0;
+	while (lod < count - 1 && distance >= lods[lod].distance) ++lod;
+	return lod;
+}
+
+
+// interval is the update interval of the animable's LOD; lod_interval and lod_frame are kept by the animable,
+// lod_interval is reset to 0 whenever its interpolated poses become invalid
+inline AnimationUpdateType selectAnimationUpdateType(bool is_visible, int interval, int& lod_interval, int& lod_frame)
+{
+	if (!is_visible)
+	{
+		lod_interval = 0;
+		return AnimationUpdateType::SKIP;
+	}
+
+	if (interval <= 1)
+	{
+		lod_interval = 0;
+		return AnimationUpdateType::SAMPLE;
+	}
+
+	++lod_frame;
+	if (lod_interval == 0 || lod_frame >= lod_interval)
+	{
+		bool is_first = lod_interval == 0;
+		lod_interval = interval;
+		lod_frame = 0;
+		return is_first ? AnimationUpdateType::SAMPLE_AHEAD_FIRST : AnimationUpdateType::SAMPLE_AHEAD;
+	}
+	return AnimationUpdateType::INTERPOLATE;
+}
+
+
+} // namespace Lumix
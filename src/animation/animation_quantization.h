@@ -0,0 +1,105 @@
+#pragma once
+
+
+#include "engine/lumix.h"
+#include "engine/math_utils.h"
+#include "engine/quat.h"
+#include "engine/vec.h"
+#include <cmath>
+
+
+namespace Lumix
+{
+
+
+// used by both the importer and the runtime, so everything is inline
+
+
+static const float QUANTIZED_POSITION_MAX = 65535.0f;
+static const float QUANTIZED_ROTATION_MAX = 32767.0f;
+
+
+// positions of a track are stored in 16 bits per component, relative to the track's bounding box
+inline void getQuantizationRange(const Vec3* positions, int count, Vec3* min, Vec3* step)
+{
+	Vec3 max = positions[0];
+	*min = positions[0];
+	for (int i = 1; i < count; ++i)
+	{
+		min->x = Math::minimum(min->x, positions[i].x);
+		min->y = Math::minimum(min->y, positions[i].y);
+		min->z = Math::minimum(min->z, positions[i].z);
+		max.x = Math::maximum(max.x, positions[i].x);
+		max.y = Math::maximum(max.y, positions[i].y);
+		max.z = Math::maximum(max.z, positions[i].z);
+	}
+	*step = (max - *min) * (1 / QUANTIZED_POSITION_MAX);
+}
+
+
+inline uint16 quantizePositionComponent(float value, float min, float step)
+{
+	if (step <= 0) return 0;
+	float q = (value - min) / step + 0.5f;
+	return (uint16)Math::clamp(q, 0.0f, QUANTIZED_POSITION_MAX);
+}
+
+
+inline void quantizePosition(const Vec3& pos, const Vec3& min, const Vec3& step, uint16* out)
+{
+	out[0] = quantizePositionComponent(pos.x, min.x, step.x);
+	out[1] = quantizePositionComponent(pos.y, min.y, step.y);
+	out[2] = quantizePositionComponent(pos.z, min.z, step.z);
+}
+
+
+inline Vec3 dequantizePosition(const uint16* in, const Vec3& min, const Vec3& step)
+{
+	return Vec3(min.x + in[0] * step.x, min.y + in[1] * step.y, min.z + in[2] * step.z);
+}
+
+
+// smallest three - the largest component is left out and computed from the other three,
+// those are in [-1/sqrt(2), 1/sqrt(2)] and take 15 bits each, the top bits of the first two
+// are the index of the left out component
+inline void quantizeRotation(const Quat& rot, uint16* out)
+{
+	float components[] = {rot.x, rot.y, rot.z, rot.w};
+	int largest = 0;
+	for (int i = 1; i < 4; ++i)
+	{
+		if (fabsf(components[i]) > fabsf(components[largest])) largest = i;
+	}
+	// q and -q are the same rotation, so the left out component can always be positive
+	float sign = components[largest] < 0 ? -1.0f : 1.0f;
+	for (int i = 0, j = 0; i < 4; ++i)
+	{
+		if (i == largest) continue;
+		float normalized = (components[i] * sign * Math::SQRT2 + 1) * 0.5f;
+		out[j] = (uint16)Math::clamp(normalized * QUANTIZED_ROTATION_MAX + 0.5f, 0.0f, QUANTIZED_ROTATION_MAX);
+		++j;
+	}
+	out[0] |= (largest & 1) << 15;
+	out[1] |= (largest >> 1) << 15;
+}
+
+
+inline Quat dequantizeRotation(const uint16* in)
+{
+	int largest = (in[0] >> 15) | ((in[1] >> 15) << 1);
+	float components[4];
+	float sum = 0;
+	for (int i = 0, j = 0; i < 4; ++i)
+	{
+		if (i == largest) continue;
+		float normalized = (in[j] & 0x7fff) * (1 / QUANTIZED_ROTATION_MAX);
+		components[i] = (normalized * 2 - 1) * (1 / Math::SQRT2);
+		sum += components[i] * components[i];
+		++j;
+	}
+	components[largest] = sqrtf(Math::maximum(1 - sum, 0.0f));
+	return Quat(components[0], components[1], components[2], components[3]);
+}
+
+
+} // namespace Lumix
@@ -1,16 +1,20 @@
 #include "animation_system.h"
 #include "animation/animation.h"
+#include "animation/animation_update.h"
 #include "engine/base_proxy_allocator.h"
 #include "engine/blob.h"
 #include "engine/crc32.h"
 #include "engine/engine.h"
+#include "engine/geometry.h"
 #include "engine/json_serializer.h"
 #include "engine/lua_wrapper.h"
+#include "engine/mtjd/parallel_for.h"
 #include "engine/profiler.h"
 #include "engine/property_descriptor.h"
 #include "engine/property_register.h"
 #include "engine/resource_manager.h"
 #include "engine/universe/universe.h"
+#include "engine/vec.h"
 #include "renderer/model.h"
 #include "renderer/pose.h"
 #include "renderer/render_scene.h"
@@ -54,6 +58,18 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 		float start_time;
 		Animation* animation;
 		Entity entity;
+		// resolved on the main thread each frame, before the jobs run
+		const Animation::Binding* binding;
+		Animation::KeyCursor* key_cursors;
+		int key_cursors_count;
+		AnimationUpdateType update_type;
+		bool is_visible;
+		int lod;
+		// relative poses of the last two samples in LODs with update interval
+		Pose* lod_poses[2];
+		// 0 if lod_poses are not sampled yet
+		int lod_interval;
+		int lod_frame;
 	};
 
 
@@ -62,6 +78,7 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 		struct Input
 		{
 			Animation* animation = nullptr;
+			const Animation::Binding* binding = nullptr;
 			float time = 0.0f;
 			float weight = 0.0f;
 		};
@@ -74,9 +91,14 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 		: m_universe(universe)
 		, m_engine(engine)
 		, m_anim_system(anim_system)
+		, m_allocator(allocator)
 		, m_animables(allocator)
 		, m_mixers(allocator)
+		, m_visible_entities(allocator)
+		, m_lods_count(0)
+		, m_skip_invisible(false)
 	{
+		setMemory(&m_stats, 0, sizeof(m_stats));
 		m_universe.entityDestroyed().bind<AnimationSceneImpl, &AnimationSceneImpl::onEntityDestroyed>(this);
 		m_is_game_running = false;
 		m_render_scene = static_cast<RenderScene*>(universe.getScene(crc32("renderer")));
@@ -88,6 +110,11 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 	~AnimationSceneImpl()
 	{
 		m_universe.entityDestroyed().unbind<AnimationSceneImpl, &AnimationSceneImpl::onEntityDestroyed>(this);
+		for (Animable& animable : m_animables)
+		{
+			freeKeyCursors(animable);
+			freeLODPoses(animable);
+		}
 	}
 
 
@@ -111,6 +138,8 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 		for (Animable& animable : m_animables)
 		{
 			unloadAnimation(animable.animation);
+			freeKeyCursors(animable);
+			freeLODPoses(animable);
 		}
 		m_animables.clear();
 	}
@@ -191,6 +220,39 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 	}
 
 
+	void freeKeyCursors(Animable& animable)
+	{
+		m_allocator.deallocate(animable.key_cursors);
+		animable.key_cursors = nullptr;
+		animable.key_cursors_count = 0;
+	}
+
+
+	void freeLODPoses(Animable& animable)
+	{
+		for (Pose*& pose : animable.lod_poses)
+		{
+			LUMIX_DELETE(m_allocator, pose);
+			pose = nullptr;
+		}
+		animable.lod_interval = 0;
+	}
+
+
+	void initAnimable(Animable& animable)
+	{
+		animable.binding = nullptr;
+		animable.key_cursors = nullptr;
+		animable.key_cursors_count = 0;
+		animable.update_type = AnimationUpdateType::SAMPLE;
+		animable.is_visible = true;
+		animable.lod = -1;
+		animable.lod_poses[0] = animable.lod_poses[1] = nullptr;
+		animable.lod_interval = 0;
+		animable.lod_frame = 0;
+	}
+
+
 	void destroyComponent(ComponentHandle component, ComponentType type) override
 	{
 		if (type == ANIMABLE_TYPE)
@@ -198,6 +260,8 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 			Entity entity = {component.index};
 			auto& animable = m_animables[entity];
 			unloadAnimation(animable.animation);
+			freeKeyCursors(animable);
+			freeLODPoses(animable);
 			m_animables.erase(entity);
 			m_universe.destroyComponent(entity, type, this, component);
 		}
@@ -228,6 +292,7 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 		for (int i = 0; i < count; ++i)
 		{
 			Animable animable;
+			initAnimable(animable);
 			serializer.read(animable.entity);
 			bool free = false;
 			if (version <= (int)AnimationSceneVersion::FIRST)
@@ -277,6 +342,8 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 	{
 		auto& animable = m_animables[{cmp.index}];
 		unloadAnimation(animable.animation);
+		freeKeyCursors(animable);
+		freeLODPoses(animable);
 		animable.animation = loadAnimation(path);
 		animable.time = 0;
 	}
@@ -284,6 +351,13 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 
 	void updateMixer(Mixer& mixer, float time_delta)
 	{
+		// the animable overwrites the pose anyway and it runs in another job, so it must not be touched here
+		if (m_animables.find(mixer.entity) >= 0)
+		{
+			for (auto& input : mixer.inputs) input.animation = nullptr;
+			return;
+		}
+
 		ComponentHandle model_instance = m_render_scene->getModelInstanceComponent(mixer.entity);
 		if (model_instance == INVALID_COMPONENT) return;
 
@@ -299,69 +373,245 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 		for (int i = 0; i < lengthOf(mixer.inputs); ++i)
 		{
 			Mixer::Input& input = mixer.inputs[i];
-			if (!input.animation || !input.animation->isReady()) break;
+			if (!input.binding || input.binding->model != model) break;
 			if (i == 0)
 			{
-				input.animation->getRelativePose(input.time, *pose, *model);
+				input.animation->getRelativePose(input.time, *pose, *input.binding, nullptr, pose->count);
 			}
 			else
 			{
-				input.animation->getRelativePose(input.time, *pose, *model, input.weight);
+				input.animation->getRelativePose(input.time, *pose, *input.binding, input.weight);
 			}
 			input.animation = nullptr;
+			input.binding = nullptr;
 		}
 		pose->computeAbsolute(*model);
 	}
 
 
-	void updateAnimable(Animable& animable, float time_delta)
+	Model* getReadyModel(Entity entity)
+	{
+		ComponentHandle model_instance = m_render_scene->getModelInstanceComponent(entity);
+		if (model_instance == INVALID_COMPONENT) return nullptr;
+		if (!m_render_scene->getPose(model_instance)) return nullptr;
+
+		Model* model = m_render_scene->getModelInstanceModel(model_instance);
+		return model->isReady() ? model : nullptr;
+	}
+
+
+	void bindMixer(Mixer& mixer)
 	{
+		Model* model = getReadyModel(mixer.entity);
+		for (auto& input : mixer.inputs)
+		{
+			bool is_ready = model && input.animation && input.animation->isReady();
+			input.binding = is_ready ? input.animation->getBinding(*model) : nullptr;
+		}
+	}
+
+
+	void bindAnimable(Animable& animable)
+	{
+		animable.binding = nullptr;
 		if (!animable.animation || !animable.animation->isReady()) return;
-		ComponentHandle model_instance = m_render_scene->getModelInstanceComponent(animable.entity);
-		if (model_instance == INVALID_COMPONENT) return;
+		Model* model = getReadyModel(animable.entity);
+		if (!model) return;
 
-		auto* pose = m_render_scene->getPose(model_instance);
-		auto* model = m_render_scene->getModelInstanceModel(model_instance);
+		animable.binding = animable.animation->getBinding(*model);
+		int bones_count = animable.animation->getBoneCount();
+		if (animable.key_cursors_count != bones_count)
+		{
+			freeKeyCursors(animable);
+			if (bones_count == 0) return;
+			size_t size = sizeof(Animation::KeyCursor) * bones_count;
+			animable.key_cursors = (Animation::KeyCursor*)m_allocator.allocate(size);
+			animable.key_cursors_count = bones_count;
+			setMemory(animable.key_cursors, 0, size);
+		}
+	}
 
-		if (!pose) return;
-		if (!model->isReady()) return;
 
-		model->getPose(*pose);
-		pose->computeRelative(*model);
-		animable.animation->getRelativePose(animable.time, *pose, *model);
-		pose->computeAbsolute(*model);
+	// bind pose and hierarchy of the model for updateAnimablePose
+	struct ModelSkeleton
+	{
+		void getRelativeBindPose(Pose& pose) const
+		{
+			model->getPose(pose);
+			pose.computeRelative(*model);
+		}
+
+		void computeAbsolute(Pose& pose) const { pose.computeAbsolute(*model); }
+
+		// null if the pose is not updated
+		Model* model;
+	};
+
+
+	void updateAnimable(Animable& animable, float time_delta)
+	{
+		if (!animable.binding) return;
 
-		float t = animable.time + time_delta * animable.time_scale;
-		float l = animable.animation->getLength();
-		while (t > l)
+		Pose* pose = nullptr;
+		int bones_count = 0;
+		Model* model = nullptr;
+		if (animable.update_type != AnimationUpdateType::SKIP)
 		{
-			t -= l;
+			ComponentHandle model_instance = m_render_scene->getModelInstanceComponent(animable.entity);
+			if (model_instance == INVALID_COMPONENT) return;
+
+			pose = m_render_scene->getPose(model_instance);
+			model = m_render_scene->getModelInstanceModel(model_instance);
+
+			if (!pose || model != animable.binding->model || !model->isReady())
+			{
+				// lod poses are not sampled
+				animable.lod_interval = 0;
+				return;
+			}
+
+			const AnimationLOD* lod = animable.lod >= 0 ? &m_lods[animable.lod] : nullptr;
+			bones_count = lod && lod->bones_count > 0 ? Math::minimum(lod->bones_count, pose->count) : pose->count;
 		}
-		animable.time = t;
+
+		ModelSkeleton skeleton = {model};
+		updateAnimablePose(animable, pose, bones_count, time_delta, skeleton);
 	}
 
 
 	void updateAnimable(ComponentHandle cmp, float time_delta) override
 	{
 		Animable& animable = m_animables[{cmp.index}];
+		bindAnimable(animable);
+		animable.update_type = AnimationUpdateType::SAMPLE;
 		updateAnimable(animable, time_delta);
 	}
 
 
-	void update(float time_delta, bool paused) override
+	void setLODs(const AnimationLOD* lods, int count) override
+	{
+		ASSERT(count <= MAX_LODS_COUNT);
+		m_lods_count = Math::minimum(count, (int)MAX_LODS_COUNT);
+		for (int i = 0; i < m_lods_count; ++i) m_lods[i] = lods[i];
+	}
+
+
+	void setSkipInvisible(bool skip) override { m_skip_invisible = skip; }
+	const AnimationStats& getStats() const override { return m_stats; }
+
+
+	// visibility and distance from the main camera, everything is visible and has no LOD without the camera
+	void updateLODs()
 	{
 		PROFILE_FUNCTION();
-		if (!m_is_game_running) return;
+		ComponentHandle camera = m_render_scene->getCameraInSlot("main");
+		for (Animable& animable : m_animables)
+		{
+			animable.is_visible = camera == INVALID_COMPONENT || !m_skip_invisible;
+			animable.lod = -1;
+		}
+		if (camera == INVALID_COMPONENT) return;
 
-		for (Mixer& mixer : m_mixers)
+		if (m_skip_invisible)
+		{
+			m_visible_entities.clear();
+			m_render_scene->getModelInstanceEntities(m_render_scene->getCameraFrustum(camera), m_visible_entities);
+			for (Entity entity : m_visible_entities)
+			{
+				int idx = m_animables.find(entity);
+				if (idx >= 0) m_animables.at(idx).is_visible = true;
+			}
+		}
+
+		if (m_lods_count == 0) return;
+		Vec3 camera_pos = m_universe.getPosition(m_render_scene->getCameraEntity(camera));
+		for (Animable& animable : m_animables)
 		{
-			AnimationSceneImpl::updateMixer(mixer, time_delta);
+			float distance = (m_universe.getPosition(animable.entity) - camera_pos).length();
+			animable.lod = getAnimationLOD(m_lods, m_lods_count, distance);
 		}
+	}
+
+
+	// interpolated animables need both LOD poses in the size of the render pose
+	bool prepareLODPoses(Animable& animable)
+	{
+		ComponentHandle model_instance = m_render_scene->getModelInstanceComponent(animable.entity);
+		Pose* render_pose = model_instance == INVALID_COMPONENT ? nullptr : m_render_scene->getPose(model_instance);
+		if (!render_pose) return false;
+
+		int bones_count = render_pose->count;
+		for (Pose*& pose : animable.lod_poses)
+		{
+			if (pose && pose->count == bones_count) continue;
+			if (!pose) pose = LUMIX_NEW(m_allocator, Pose)(m_allocator);
+			pose->resize(bones_count);
+			animable.lod_interval = 0;
+		}
+		return true;
+	}
+
+
+	void selectUpdateType(Animable& animable)
+	{
+		if (!animable.binding) return;
+
+		int interval = animable.lod >= 0 ? m_lods[animable.lod].update_interval : 1;
+		if (animable.is_visible && interval > 1 && !prepareLODPoses(animable)) interval = 1;
+		animable.update_type =
+			selectAnimationUpdateType(animable.is_visible, interval, animable.lod_interval, animable.lod_frame);
+		switch (animable.update_type)
+		{
+			case AnimationUpdateType::SKIP: ++m_stats.skipped_count; break;
+			case AnimationUpdateType::INTERPOLATE: ++m_stats.interpolated_count; break;
+			default: ++m_stats.sampled_count; break;
+		}
+	}
+
 
+	void update(float time_delta, bool paused) override
+	{
+		PROFILE_FUNCTION();
+		if (!m_is_game_running) return;
+
+		updateLODs();
+		setMemory(&m_stats, 0, sizeof(m_stats));
+		// bindings are cached in animations, which is not thread safe
+		for (Mixer& mixer : m_mixers) bindMixer(mixer);
 		for (Animable& animable : m_animables)
 		{
-			AnimationSceneImpl::updateAnimable(animable, time_delta);
+			bindAnimable(animable);
+			selectUpdateType(animable);
 		}
+		PROFILE_INT("sampled animables", m_stats.sampled_count);
+		PROFILE_INT("interpolated animables", m_stats.interpolated_count);
+		PROFILE_INT("skipped animables", m_stats.skipped_count);
+
+		// an entity with both a mixer and an animable shares one pose, only the animable writes it,
+		// so jobs write disjoint poses and they can be updated in any order
+		int mixers_count = m_mixers.size();
+		auto update = [this, time_delta, mixers_count](int from, int to)
+		{
+			PROFILE_BLOCK("Animation Job");
+			for (int i = from; i < to; ++i)
+			{
+				if (i < mixers_count)
+				{
+					updateMixer(m_mixers.at(i), time_delta);
+				}
+				else
+				{
+					updateAnimable(m_animables.at(i - mixers_count), time_delta);
+				}
+			}
+		};
+		MTJD::JoinHandle handle = MTJD::parallelFor(m_engine.getMTJDManager(),
+			m_engine.getLIFOAllocator(),
+			0,
+			mixers_count + m_animables.size(),
+			UPDATE_GRAIN,
+			update);
+		handle.join();
 	}
 
 
@@ -380,6 +630,7 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 		animable.entity = entity;
 		animable.time_scale = 1;
 		animable.start_time = 0;
+		initAnimable(animable);
 
 		ComponentHandle cmp = {entity.index};
 		m_universe.addComponent(entity, ANIMABLE_TYPE, this, cmp);
@@ -393,8 +644,14 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 	Universe& m_universe;
 	IPlugin& m_anim_system;
 	Engine& m_engine;
+	IAllocator& m_allocator;
 	AssociativeArray<Entity, Animable> m_animables;
 	AssociativeArray<Entity, Mixer> m_mixers;
+	Array<Entity> m_visible_entities;
+	AnimationLOD m_lods[MAX_LODS_COUNT];
+	int m_lods_count;
+	bool m_skip_invisible;
+	AnimationStats m_stats;
 	RenderScene* m_render_scene;
 	bool m_is_game_running;
 };
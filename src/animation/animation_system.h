@@ -3,19 +3,39 @@
 
 #include "engine/lumix.h"
 #include "engine/iplugin.h"
+#include "animation/animation_lod.h"
 
 
 namespace Lumix
 {
 
 
+struct AnimationStats
+{
+	int sampled_count;
+	int interpolated_count;
+	// not visible from the main camera
+	int skipped_count;
+};
+
+
 class AnimationScene : public IScene
 {
+	public:
+		static const int MAX_LODS_COUNT = 4;
+		// mixers and animables updated by one job
+		static const int UPDATE_GRAIN = 16;
+
 	public:
 		virtual class Animation* getAnimableAnimation(ComponentHandle cmp) = 0;
 		virtual float getAnimableTime(ComponentHandle cmp) = 0;
 		virtual void setAnimableTime(ComponentHandle cmp, float time) = 0;
 		virtual void updateAnimable(ComponentHandle cmp, float time_delta) = 0;
+		// animables further than the last LOD use the last LOD, there are no LODs by default
+		virtual void setLODs(const AnimationLOD* lods, int count) = 0;
+		// animables outside of the main camera frustum only advance their time, off by default
+		virtual void setSkipInvisible(bool skip) = 0;
+		virtual const AnimationStats& getStats() const = 0;
 };
 
 
@@ -0,0 +1,103 @@
+#pragma once
+
+
+#include "engine/lumix.h"
+#include "engine/quat.h"
+#include "engine/string.h"
+#include "engine/vec.h"
+#include "animation/animation.h"
+#include "animation/animation_lod.h"
+#include "renderer/pose.h"
+
+
+namespace Lumix
+{
+
+
+// used by the animation scene and by the unit tests, so everything is inline;
+// Animable is anything with the members of AnimationSceneImpl::Animable used here, Skeleton hides the model:
+// skeleton.getRelativeBindPose(pose) resets pose to the relative bind pose and
+// skeleton.computeAbsolute(pose) makes the pose absolute
+
+
+inline void copyAnimationPose(const Pose& src, Pose& dst)
+{
+	ASSERT(src.count == dst.count);
+	copyMemory(dst.positions, src.positions, sizeof(src.positions[0]) * src.count);
+	copyMemory(dst.rotations, src.rotations, sizeof(src.rotations[0]) * src.count);
+	dst.is_absolute = src.is_absolute;
+}
+
+
+// pose is in relative bind pose, bones which are not sampled keep it
+template <typename Animable>
+inline void sampleAnimationAhead(Animable& animable, Pose& pose, int bones_count, float time_delta, bool is_first)
+{
+	Pose*& prev = animable.lod_poses[0];
+	Pose*& next = animable.lod_poses[1];
+	Animation& animation = *animable.animation;
+	if (is_first)
+	{
+		copyAnimationPose(pose, *prev);
+		animation.getRelativePose(animable.time, *prev, *animable.binding, animable.key_cursors, bones_count);
+	}
+	else
+	{
+		Pose* tmp = prev;
+		prev = next;
+		next = tmp;
+	}
+	float ahead_time = animable.time + animable.lod_interval * time_delta * animable.time_scale;
+	copyAnimationPose(pose, *next);
+	animation.getRelativePose(
+		animation.wrapTime(ahead_time), *next, *animable.binding, animable.key_cursors, bones_count);
+	copyAnimationPose(*prev, pose);
+}
+
+
+// samples or interpolates pose according to animable.update_type and moves the animable in time,
+// pose is null if the update type is SKIP, only the first bones_count bones are sampled
+template <typename Animable, typename Skeleton>
+inline void updateAnimablePose(Animable& animable,
+	Pose* pose,
+	int bones_count,
+	float time_delta,
+	const Skeleton& skeleton)
+{
+	if (pose)
+	{
+		switch (animable.update_type)
+		{
+			case AnimationUpdateType::SAMPLE:
+				skeleton.getRelativeBindPose(*pose);
+				animable.animation->getRelativePose(
+					animable.time, *pose, *animable.binding, animable.key_cursors, bones_count);
+				break;
+			case AnimationUpdateType::SAMPLE_AHEAD:
+			case AnimationUpdateType::SAMPLE_AHEAD_FIRST:
+				skeleton.getRelativeBindPose(*pose);
+				sampleAnimationAhead(animable,
+					*pose,
+					bones_count,
+					time_delta,
+					animable.update_type == AnimationUpdateType::SAMPLE_AHEAD_FIRST);
+				break;
+			case AnimationUpdateType::INTERPOLATE:
+			{
+				float t = animable.lod_frame / (float)animable.lod_interval;
+				Pose* poses[] = {animable.lod_poses[0], animable.lod_poses[1]};
+				float weights[] = {1 - t, t};
+				pose->is_absolute = false;
+				pose->blend(poses, weights, lengthOf(poses));
+				break;
+			}
+			default: ASSERT(false); break;
+		}
+		skeleton.computeAbsolute(*pose);
+	}
+
+	animable.time = animable.animation->wrapTime(animable.time + time_delta * animable.time_scale);
+}
+
+
+} // namespace Lumix
@@ -458,10 +458,13 @@ public:
 		m_gui_interface->size.x = (float)m_pipeline->getWidth();
 		m_gui_interface->size.y = (float)m_pipeline->getHeight();
 		float frame_time = m_frame_timer->tick();
+		Lumix::int32 allocation_count = m_allocator.getAllocationCount();
 		m_engine->update(*m_universe);
 		m_pipeline->render();
 		auto* renderer = m_engine->getPluginManager().getPlugin("renderer");
 		static_cast<Lumix::Renderer*>(renderer)->frame();
+		// should stay at zero once the universe is loaded and nothing comes into view
+		PROFILE_INT("heap allocations", m_allocator.getAllocationCount() - allocation_count);
 		m_engine->getFileSystem().updateAsyncTransactions();
 		if (frame_time < 1 / 60.0f)
 		{
@@ -533,7 +533,9 @@ public:
 
 		m_editor->setMouseSensitivity(m_settings.m_mouse_sensitivity_x, m_settings.m_mouse_sensitivity_y);
 		m_editor->update();
+		Lumix::int32 allocation_count = m_allocator.getAllocationCount();
 		m_engine->update(*m_editor->getUniverse());
+		PROFILE_INT("engine heap allocations", m_allocator.getAllocationCount() - allocation_count);
 
 		for (auto* plugin : m_plugins)
 		{
@@ -109,6 +109,7 @@ Allocator::Allocator(IAllocator& source)
 	, m_mutex(false)
 	, m_stack_tree(LUMIX_NEW(m_source, Debug::StackTree))
 	, m_total_size(0)
+	, m_allocation_count(0)
 	, m_is_fill_enabled(true)
 	, m_are_guards_enabled(true)
 {
@@ -225,6 +226,7 @@ void* Allocator::getSystemFromUser(void* user_ptr)
 void* Allocator::reallocate(void* user_ptr, size_t size)
 {
 #ifndef _DEBUG
+	MT::atomicIncrement(&m_allocation_count);
 	return m_source.reallocate(user_ptr, size);
 #else
 	if (user_ptr == nullptr) return allocate(size);
@@ -245,6 +247,7 @@ void* Allocator::reallocate(void* user_ptr, size_t size)
 
 void* Allocator::allocate_aligned(size_t size, size_t align)
 {
+	MT::atomicIncrement(&m_allocation_count);
 	return m_source.allocate_aligned(size, align);
 }
 
@@ -257,12 +260,14 @@ void Allocator::deallocate_aligned(void* ptr)
 
 void* Allocator::reallocate_aligned(void* ptr, size_t size, size_t align)
 {
+	MT::atomicIncrement(&m_allocation_count);
 	return m_source.reallocate_aligned(ptr, size, align);
 }
 
 
 void* Allocator::allocate(size_t size)
 {
+	MT::atomicIncrement(&m_allocation_count);
 #ifndef _DEBUG
 	return m_source.allocate(size);
 #else
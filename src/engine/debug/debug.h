@@ -64,6 +64,9 @@ public:
 	void deallocate_aligned(void* ptr) override;
 	void* reallocate_aligned(void* ptr, size_t size, size_t align) override;
 	size_t getTotalSize() const { return m_total_size; }
+	// number of allocate and reallocate calls since creation, counted in release too,
+	// so the difference between two frames shows heap allocations per frame
+	int32 getAllocationCount() const { return m_allocation_count; }
 	void checkGuards();
 
 	IAllocator& getSourceAllocator() { return m_source; }
@@ -88,6 +91,7 @@ private:
 	AllocationInfo* m_root;
 	AllocationInfo m_sentinels[2];
 	size_t m_total_size;
+	volatile int32 m_allocation_count;
 	bool m_is_fill_enabled;
 	bool m_are_guards_enabled;
 };
@@ -248,6 +248,7 @@ Allocator::Allocator(IAllocator& source)
 	, m_root(nullptr)
 	, m_mutex(false)
 	, m_total_size(0)
+	, m_allocation_count(0)
 	, m_is_fill_enabled(true)
 	, m_are_guards_enabled(true)
 {
@@ -375,6 +376,7 @@ uint8* Allocator::getSystemFromUser(void* user_ptr)
 void* Allocator::reallocate(void* user_ptr, size_t size)
 {
 #ifndef _DEBUG
+	MT::atomicIncrement(&m_allocation_count);
 	return m_source.reallocate(user_ptr, size);
 #else
 	if (user_ptr == nullptr) return allocate(size);
@@ -395,6 +397,7 @@ void* Allocator::reallocate(void* user_ptr, size_t size)
 
 void* Allocator::allocate_aligned(size_t size, size_t align)
 {
+	MT::atomicIncrement(&m_allocation_count);
 #ifndef _DEBUG
 	return m_source.allocate_aligned(size, align);
 #else
@@ -483,6 +486,7 @@ void Allocator::deallocate_aligned(void* user_ptr)
 void* Allocator::reallocate_aligned(void* user_ptr, size_t size, size_t align)
 {
 #ifndef _DEBUG
+	MT::atomicIncrement(&m_allocation_count);
 	return m_source.reallocate_aligned(user_ptr, size, align);
 #else
 	if (user_ptr == nullptr) return allocate_aligned(size, align);
@@ -503,6 +507,7 @@ void* Allocator::reallocate_aligned(void* user_ptr, size_t size, size_t align)
 
 void* Allocator::allocate(size_t size)
 {
+	MT::atomicIncrement(&m_allocation_count);
 #ifndef _DEBUG
 	return m_source.allocate(size);
 #else
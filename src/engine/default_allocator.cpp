@@ -67,7 +67,12 @@ namespace Lumix
 		if (newptr == nullptr) {
 			return nullptr;
 		}
-		memcpy(newptr, ptr, malloc_usable_size(ptr));
+		if (ptr)
+		{
+			// usable size of the old block can be bigger than the new block
+			size_t old_size = malloc_usable_size(ptr);
+			memcpy(newptr, ptr, old_size < size ? old_size : size);
+		}
 		free(ptr);
 		return newptr;
 	}
@@ -6,6 +6,7 @@
 #include "engine/fs/file_system.h"
 #include "engine/fs/memory_file_device.h"
 #include "engine/fs/os_file.h"
+#include "engine/frame_allocator.h"
 #include "engine/input_system.h"
 #include "engine/iplugin.h"
 #include "engine/lifo_allocator.h"
@@ -411,6 +412,7 @@ public:
 		, m_paused(false)
 		, m_next_frame(false)
 		, m_lifo_allocator(m_allocator, 10 * 1024 * 1024)
+		, m_frame_allocator(m_allocator, 8 * 1024 * 1024, 3)
 	{
 		g_log_info.log("Core") << "Creating engine...";
 		Profiler::setThreadName("Main");
@@ -1211,6 +1213,7 @@ public:
 	{
 		ASSERT(!m_is_game_running);
 		m_is_game_running = true;
+		context.setDeferredTransformNotifications(true);
 		for (auto* scene : context.getScenes())
 		{
 			scene->startGame();
@@ -1226,6 +1229,7 @@ public:
 	{
 		ASSERT(m_is_game_running);
 		m_is_game_running = false;
+		context.setDeferredTransformNotifications(false);
 		for (auto* scene : context.getScenes())
 		{
 			scene->stopGame();
@@ -1258,6 +1262,11 @@ public:
 	void update(Universe& context) override
 	{
 		PROFILE_FUNCTION();
+		m_frame_allocator.nextFrame();
+		const FrameAllocator::Stats& frame_stats = m_frame_allocator.getStats();
+		PROFILE_INT("frame allocator KB", int(frame_stats.last_frame_used >> 10));
+		PROFILE_INT("frame allocator overflows", frame_stats.last_frame_overflows);
+
 		float dt;
 		++m_fps_frame;
 		if (m_fps_timer->getTimeSinceTick() > 0.5f)
@@ -1281,6 +1290,7 @@ public:
 			}
 		}
 		m_plugin_manager->update(dt, m_paused);
+		context.flushTransformNotifications();
 		m_input_system->update(dt);
 		getFileSystem().updateAsyncTransactions();
 
@@ -1565,6 +1575,12 @@ public:
 	}
 
 
+	FrameAllocator& getFrameAllocator() override
+	{
+		return m_frame_allocator;
+	}
+
+
 	void runScript(const char* src, int src_length, const char* path) override
 	{
 		if (luaL_loadbuffer(m_state, src, src_length, path) != LUA_OK)
@@ -1590,6 +1606,7 @@ public:
 private:
 	IAllocator& m_allocator;
 	LIFOAllocator m_lifo_allocator;
+	FrameAllocator m_frame_allocator;
 
 	FS::FileSystem* m_file_system;
 	FS::MemoryFileDevice* m_mem_file_device;
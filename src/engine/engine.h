@@ -21,6 +21,7 @@ class Manager;
 }
 
 struct ComponentUID;
+class FrameAllocator;
 class InputBlob;
 class IAllocator;
 class InputSystem;
@@ -67,6 +68,7 @@ public:
 	virtual ResourceManager& getResourceManager() = 0;
 	virtual IAllocator& getAllocator() = 0;
 
+	// while the game is running, entity transform notifications are deferred and flushed in update()
 	virtual void startGame(Universe& context) = 0;
 	virtual void stopGame(Universe& context) = 0;
 
@@ -85,6 +87,8 @@ public:
 	virtual ComponentUID createComponent(Universe& universe, Entity entity, ComponentType type) = 0;
 	virtual void pasteEntities(const Vec3& position, Universe& universe, InputBlob& blob, Array<Entity>& entities) = 0;
 	virtual IAllocator& getLIFOAllocator() = 0;
+	// for memory which lives for a frame, can be used by any thread
+	virtual FrameAllocator& getFrameAllocator() = 0;
 	virtual class Resource* getLuaResource(int idx) const = 0;
 	virtual int addLuaResource(const Path& path, struct ResourceType type) = 0;
 	virtual void unloadLuaResource(int resource_idx) = 0;
@@ -0,0 +1,265 @@
+#include "engine/frame_allocator.h"
+#include "engine/math_utils.h"
+#include "engine/mt/atomic.h"
+#include "engine/mt/thread.h"
+#include "engine/string.h"
+
+
+namespace Lumix
+{
+
+
+static const int MAX_THREADS = 64;
+static const size_t CHUNK_SIZE = 64 * 1024;
+// blocks bigger than this are taken from the frame directly, so chunks are not wasted
+static const size_t MAX_CHUNK_BLOCK_SIZE = CHUNK_SIZE / 4;
+static const size_t BLOCK_ALIGN = 8;
+
+
+struct BlockHeader
+{
+	uint32 size;
+	// from the start of the block to the data
+	uint32 offset;
+};
+
+
+struct FrameAllocator::ThreadData
+{
+	MT::ThreadID thread_id;
+	uint32 frame;
+	uint8* begin;
+	uint8* current;
+	uint8* end;
+};
+
+
+// each thread remembers where its data is in the allocator it used last
+struct ThreadCache
+{
+	int32 allocator_id;
+	void* data;
+};
+
+
+static volatile int32 s_last_allocator_id = 0;
+static thread_local ThreadCache s_thread_cache = {0, nullptr};
+
+
+static uint8* alignPointer(const void* ptr, size_t align)
+{
+	return (uint8*)(((uintptr)ptr + align - 1) & ~uintptr(align - 1));
+}
+
+
+static uint8* initBlock(uint8* block, size_t size, size_t align)
+{
+	uint8* data = alignPointer(block + sizeof(BlockHeader), align);
+	BlockHeader* header = (BlockHeader*)data - 1;
+	header->size = (uint32)size;
+	header->offset = uint32(data - block);
+	return data;
+}
+
+
+FrameAllocator::FrameAllocator(IAllocator& source, size_t frame_size, int frames_count)
+	: m_source(source)
+	, m_frame_size(frame_size)
+	, m_frames_count(frames_count)
+	, m_frame_state(0)
+	, m_overflows(0)
+	, m_threads_count(0)
+{
+	ASSERT(frames_count > 1);
+	ASSERT(frame_size < 0x80000000);
+	m_memory = (uint8*)source.allocate_aligned(frame_size * frames_count, 16);
+	m_threads = (ThreadData*)source.allocate(sizeof(ThreadData) * MAX_THREADS);
+	setMemory(m_threads, 0, sizeof(ThreadData) * MAX_THREADS);
+	m_id = MT::atomicIncrement(&s_last_allocator_id);
+	m_stats.frame_size = frame_size;
+	m_stats.last_frame_used = 0;
+	m_stats.peak_used = 0;
+	m_stats.last_frame_overflows = 0;
+}
+
+
+FrameAllocator::~FrameAllocator()
+{
+	m_source.deallocate(m_threads);
+	m_source.deallocate_aligned(m_memory);
+}
+
+
+FrameAllocator::ThreadData* FrameAllocator::getThreadData()
+{
+	if (s_thread_cache.allocator_id == m_id && s_thread_cache.data) return (ThreadData*)s_thread_cache.data;
+
+	// slots are only claimed, so a slot of this thread can not be taken by another one
+	MT::ThreadID thread_id = MT::getCurrentThreadID();
+	ThreadData* data = nullptr;
+	for (int i = 0, c = Math::minimum((int)m_threads_count, MAX_THREADS); i < c; ++i)
+	{
+		if (m_threads[i].thread_id == thread_id)
+		{
+			data = &m_threads[i];
+			break;
+		}
+	}
+	if (!data)
+	{
+		int idx = MT::atomicIncrement(&m_threads_count) - 1;
+		if (idx >= MAX_THREADS)
+		{
+			ASSERT(false);
+			return nullptr;
+		}
+		data = &m_threads[idx];
+		data->thread_id = thread_id;
+	}
+	s_thread_cache.allocator_id = m_id;
+	s_thread_cache.data = data;
+	return data;
+}
+
+
+bool FrameAllocator::isOwned(const void* ptr) const
+{
+	return ptr >= m_memory && ptr < m_memory + m_frame_size * m_frames_count;
+}
+
+
+uint8* FrameAllocator::allocateFromFrame(size_t size, uint32* frame)
+{
+	for (;;)
+	{
+		int64 state = m_frame_state;
+		uint32 idx = uint32(uint64(state) >> 32);
+		size_t offset = (uint32)state;
+		if (offset + size > m_frame_size) return nullptr;
+
+		int64 new_state = int64((uint64(idx) << 32) | uint64(offset + size));
+		if (MT::compareAndExchange64(&m_frame_state, new_state, state))
+		{
+			*frame = idx;
+			return m_memory + (idx % m_frames_count) * m_frame_size + offset;
+		}
+	}
+}
+
+
+void* FrameAllocator::allocate(size_t size)
+{
+	return allocate_aligned(size, BLOCK_ALIGN);
+}
+
+
+void FrameAllocator::deallocate(void* ptr)
+{
+	deallocate_aligned(ptr);
+}
+
+
+void* FrameAllocator::reallocate(void* ptr, size_t size)
+{
+	return reallocate_aligned(ptr, size, BLOCK_ALIGN);
+}
+
+
+void* FrameAllocator::allocate_aligned(size_t size, size_t align)
+{
+	align = Math::maximum(align, BLOCK_ALIGN);
+	size_t block_size = sizeof(BlockHeader) + align - BLOCK_ALIGN + size;
+	block_size = (block_size + BLOCK_ALIGN - 1) & ~(BLOCK_ALIGN - 1);
+
+	ThreadData* data = getThreadData();
+	if (data && block_size > MAX_CHUNK_BLOCK_SIZE)
+	{
+		uint32 frame;
+		uint8* block = allocateFromFrame(block_size, &frame);
+		if (block) return initBlock(block, size, align);
+	}
+	else if (data)
+	{
+		uint32 frame = uint32(uint64(m_frame_state) >> 32);
+		if (data->frame != frame || !data->begin || data->current + block_size > data->end)
+		{
+			data->begin = allocateFromFrame(CHUNK_SIZE, &data->frame);
+			data->current = data->begin;
+			data->end = data->begin ? data->begin + CHUNK_SIZE : nullptr;
+		}
+		if (data->begin)
+		{
+			uint8* ptr = initBlock(data->current, size, align);
+			data->current = alignPointer(ptr + size, BLOCK_ALIGN);
+			return ptr;
+		}
+	}
+
+	MT::atomicIncrement(&m_overflows);
+	return m_source.allocate_aligned(size, align);
+}
+
+
+void FrameAllocator::deallocate_aligned(void* ptr)
+{
+	if (!ptr) return;
+	if (!isOwned(ptr))
+	{
+		m_source.deallocate_aligned(ptr);
+		return;
+	}
+
+	// only the last allocation of this thread is freed, like in LIFOAllocator
+	ThreadData* data = getThreadData();
+	const BlockHeader* header = (const BlockHeader*)ptr - 1;
+	uint8* block = (uint8*)ptr - header->offset;
+	if (data && block >= data->begin && alignPointer((uint8*)ptr + header->size, BLOCK_ALIGN) == data->current)
+	{
+		data->current = block;
+	}
+}
+
+
+void* FrameAllocator::reallocate_aligned(void* ptr, size_t size, size_t align)
+{
+	if (!ptr) return allocate_aligned(size, align);
+	if (!isOwned(ptr)) return m_source.reallocate_aligned(ptr, size, align);
+
+	// the last allocation of this thread grows in place
+	ThreadData* data = getThreadData();
+	BlockHeader* header = (BlockHeader*)ptr - 1;
+	uint8* block = (uint8*)ptr - header->offset;
+	if (data && block >= data->begin && alignPointer((uint8*)ptr + header->size, BLOCK_ALIGN) == data->current &&
+		(uintptr)ptr % align == 0 && (uint8*)ptr + size <= data->end)
+	{
+		header->size = (uint32)size;
+		data->current = alignPointer((uint8*)ptr + size, BLOCK_ALIGN);
+		return ptr;
+	}
+
+	void* new_ptr = allocate_aligned(size, align);
+	copyMemory(new_ptr, ptr, Math::minimum(size, (size_t)header->size));
+	deallocate_aligned(ptr);
+	return new_ptr;
+}
+
+
+void FrameAllocator::nextFrame()
+{
+	int64 state;
+	for (;;)
+	{
+		state = m_frame_state;
+		uint32 idx = uint32(uint64(state) >> 32);
+		if (MT::compareAndExchange64(&m_frame_state, int64(uint64(idx + 1) << 32), state)) break;
+	}
+
+	size_t used = (uint32)state;
+	m_stats.last_frame_used = used;
+	m_stats.peak_used = Math::maximum(m_stats.peak_used, used);
+	m_stats.last_frame_overflows = m_overflows;
+	MT::atomicSubtract(&m_overflows, m_stats.last_frame_overflows);
+}
+
+
+} // namespace Lumix
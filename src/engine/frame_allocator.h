@@ -0,0 +1,69 @@
+#pragma once
+
+
+#include "engine/lumix.h"
+#include "engine/iallocator.h"
+
+
+namespace Lumix
+{
+
+
+// LIFOAllocator for memory which lives for a frame and is used by several threads.
+// Each thread bumps a pointer in its own chunk of the current frame, so allocations do not lock,
+// and frees are LIFO like in LIFOAllocator - the last allocation of a thread is popped, anything
+// else is freed when its frame is reused. Frames are in a ring, memory is valid at least until nextFrame
+// is called frames_count - 1 times, so jobs may finish a frame later.
+// If a frame runs out of memory, the source allocator is used and it is counted in the stats.
+class LUMIX_ENGINE_API FrameAllocator LUMIX_FINAL : public IAllocator
+{
+public:
+	struct Stats
+	{
+		size_t frame_size;
+		// bytes taken from the last finished frame, chunks of threads are counted whole
+		size_t last_frame_used;
+		size_t peak_used;
+		// allocations of the last finished frame served by the source allocator
+		int32 last_frame_overflows;
+	};
+
+public:
+	FrameAllocator(IAllocator& source, size_t frame_size, int frames_count);
+	~FrameAllocator();
+
+	void* allocate(size_t size) override;
+	void deallocate(void* ptr) override;
+	void* reallocate(void* ptr, size_t size) override;
+	void* allocate_aligned(size_t size, size_t align) override;
+	void deallocate_aligned(void* ptr) override;
+	void* reallocate_aligned(void* ptr, size_t size, size_t align) override;
+
+	// called once per frame by the engine, other threads can allocate meanwhile
+	void nextFrame();
+	// nextFrame writes the stats without synchronization, read them only from the thread calling nextFrame
+	const Stats& getStats() const { return m_stats; }
+
+private:
+	struct ThreadData;
+
+	ThreadData* getThreadData();
+	bool isOwned(const void* ptr) const;
+	uint8* allocateFromFrame(size_t size, uint32* frame);
+
+private:
+	IAllocator& m_source;
+	uint8* m_memory;
+	size_t m_frame_size;
+	int m_frames_count;
+	// frame index in the high 32 bits, bytes taken from the frame in the low 32 bits
+	volatile int64 m_frame_state;
+	volatile int32 m_overflows;
+	ThreadData* m_threads;
+	volatile int32 m_threads_count;
+	int32 m_id;
+	Stats m_stats;
+};
+
+
+} // namespace Lumix
@@ -104,6 +104,13 @@ struct Sphere
 };
 
 
+struct Ray
+{
+	Vec3 origin;
+	Vec3 dir;
+};
+
+
 LUMIX_ALIGN_BEGIN(16) struct LUMIX_ENGINE_API Frustum
 {
 	Frustum();
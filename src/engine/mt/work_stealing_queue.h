@@ -0,0 +1,77 @@
+#pragma once
+
+#include "engine/mt/atomic.h"
+
+
+namespace Lumix
+{
+	namespace MT
+	{
+		// Chase-Lev deque. Only the owner thread may push and pop (LIFO at the bottom),
+		// any other thread may steal (FIFO at the top).
+		template <class T, int32 size>
+		class WorkStealingQueue
+		{
+		public:
+			WorkStealingQueue()
+				: m_top(0)
+				, m_bottom(0)
+			{
+				static_assert((size & (size - 1)) == 0, "Size must be power of two");
+			}
+
+			bool push(const T& value)
+			{
+				int64 bottom = m_bottom;
+				int64 top = m_top;
+				if (bottom - top >= size) return false;
+
+				m_items[bottom & (size - 1)] = value;
+				memoryBarrier();
+				m_bottom = bottom + 1;
+				return true;
+			}
+
+			bool pop(T* value)
+			{
+				int64 bottom = m_bottom - 1;
+				m_bottom = bottom;
+				memoryBarrier();
+				int64 top = m_top;
+
+				if (top > bottom)
+				{
+					m_bottom = bottom + 1;
+					return false;
+				}
+
+				*value = m_items[bottom & (size - 1)];
+				if (top != bottom) return true;
+
+				// last item, race with thieves
+				bool success = compareAndExchange64(&m_top, top + 1, top);
+				m_bottom = bottom + 1;
+				return success;
+			}
+
+			bool steal(T* value)
+			{
+				int64 top = m_top;
+				memoryBarrier();
+				int64 bottom = m_bottom;
+				if (top >= bottom) return false;
+
+				*value = m_items[top & (size - 1)];
+				return compareAndExchange64(&m_top, top + 1, top);
+			}
+
+			bool isEmpty() const { return m_bottom <= m_top; }
+
+		private:
+			volatile int64 m_top;
+			uint8 m_padding[64 - sizeof(int64)];
+			volatile int64 m_bottom;
+			T m_items[size];
+		};
+	} // namespace MT
+} // namespace Lumix
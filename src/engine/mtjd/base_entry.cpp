@@ -2,14 +2,16 @@
 #include "engine/mtjd/base_entry.h"
 
 #include "engine/mtjd/manager.h"
+#include "engine/mt/sync.h"
 
 namespace Lumix
 {
 	namespace MTJD
 	{
-		BaseEntry::BaseEntry(int32 depend_count, bool sync_event, IAllocator& allocator)
+		BaseEntry::BaseEntry(int32 depend_count, bool sync_event, Manager* manager, IAllocator& allocator)
 			: m_dependency_count(depend_count)
 			, m_allocator(allocator)
+			, m_manager(manager)
 			, m_dependency_table(m_allocator)
 		{
 #if !LUMIX_SINGLE_THREAD()
@@ -48,6 +50,19 @@ namespace Lumix
 #if !LUMIX_SINGLE_THREAD()
 
 			ASSERT(nullptr != m_sync_event);
+			if (m_manager)
+			{
+				// help with the work instead of just blocking, block only when there is nothing to run
+				while (!m_sync_event->poll())
+				{
+					if (!m_manager->runReadyJob())
+					{
+						m_sync_event->wait();
+						break;
+					}
+				}
+				return;
+			}
 			m_sync_event->wait();
 
 #endif
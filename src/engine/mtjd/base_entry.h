@@ -22,12 +22,15 @@ namespace MTJD
 {
 
 
+class Manager;
+
+
 class LUMIX_ENGINE_API BaseEntry
 {
 public:
 	typedef Array<BaseEntry*> DependencyTable;
 
-	BaseEntry(int32 depend_count, bool sync_event, IAllocator& allocator);
+	BaseEntry(int32 depend_count, bool sync_event, Manager* manager, IAllocator& allocator);
 	virtual ~BaseEntry();
 
 	void addDependency(BaseEntry* entry);
@@ -43,6 +46,7 @@ protected:
 	void dependencyReady();
 
 	IAllocator& m_allocator;
+	Manager* m_manager;
 	MT::Event* m_sync_event;
 	volatile int32 m_dependency_count;
 	DependencyTable m_dependency_table;
@@ -0,0 +1,25 @@
+#pragma once
+
+
+#include "engine/lumix.h"
+
+
+namespace Lumix
+{
+namespace MTJD
+{
+
+
+// number of unfinished jobs, see Job::setCounter and Manager::wait
+struct Counter
+{
+	Counter() : value(0) {}
+
+	bool isDone() const { return value == 0; }
+
+	volatile int32 value;
+};
+
+
+} // namepsace MTJD
+} // namepsace Lumix
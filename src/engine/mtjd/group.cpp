@@ -7,8 +7,8 @@ namespace Lumix
 {
 	namespace MTJD
 	{
-		Group::Group(bool sync_event, IAllocator& allocator)
-			: BaseEntry(0, sync_event, allocator)
+		Group::Group(bool sync_event, IAllocator& allocator, Manager* manager)
+			: BaseEntry(0, sync_event, manager, allocator)
 			, m_static_dependency_table(allocator)
 		{
 		}
@@ -9,7 +9,7 @@ namespace Lumix
 		class LUMIX_ENGINE_API Group : public BaseEntry
 		{
 		public:
-			Group(bool sync_event, IAllocator& allocator);
+			Group(bool sync_event, IAllocator& allocator, Manager* manager = nullptr);
 			~Group();
 
 			void addStaticDependency(BaseEntry* entry);
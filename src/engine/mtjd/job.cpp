@@ -2,6 +2,7 @@
 #include "engine/mtjd/job.h"
 
 #include "engine/mtjd/manager.h"
+#include "engine/mt/atomic.h"
 
 namespace Lumix
 {
@@ -12,8 +13,8 @@ Job::Job(int flags,
 	Manager& manager,
 	IAllocator& allocator,
 	IAllocator& job_allocator)
-	: BaseEntry(1, (flags & SYNC_EVENT) != 0, allocator)
-	, m_manager(manager)
+	: BaseEntry(1, (flags & SYNC_EVENT) != 0, &manager, allocator)
+	, m_counter(nullptr)
 	, m_priority(priority)
 	, m_auto_destroy((flags & AUTO_DESTROY) != 0)
 	, m_scheduled(false)
@@ -44,16 +45,26 @@ void Job::decrementDependency()
 	uint32 count = MT::atomicDecrement(&m_dependency_count);
 	if (1 == count)
 	{
-		m_manager.schedule(this);
+		m_manager->schedule(this);
 	}
 
 #endif
 }
 
+void Job::setCounter(Counter* counter)
+{
+	ASSERT(!m_scheduled);
+	ASSERT(!m_counter);
+
+	m_counter = counter;
+	MT::atomicIncrement(&counter->value);
+}
+
 void Job::onExecuted()
 {
 	m_executed = true;
 	bool auto_destroy = m_auto_destroy;
+	Counter* counter = m_counter;
 
 	BaseEntry::dependencyReady();
 
@@ -61,6 +72,12 @@ void Job::onExecuted()
 	{
 		LUMIX_DELETE(m_job_allocator, this);
 	}
+
+	// must be the last thing, the waiting thread can free everything once the counter hits zero
+	if (counter)
+	{
+		MT::atomicDecrement(&counter->value);
+	}
 }
 } // namepsace MTJD
 } // namepsace Lumix
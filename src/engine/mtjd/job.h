@@ -1,5 +1,6 @@
 #pragma once
 
+#include "engine/mtjd/counter.h"
 #include "engine/mtjd/enums.h"
 #include "engine/mtjd/group.h"
 
@@ -34,6 +35,8 @@ public:
 	void decrementDependency() override;
 
 	Priority getPriority() const { return m_priority; }
+	// counter is incremented now and decremented after the job is executed
+	void setCounter(Counter* counter);
 
 protected:
 	virtual void execute() = 0;
@@ -41,7 +44,7 @@ protected:
 
 	IAllocator& m_job_allocator;
 
-	Manager& m_manager;
+	Counter* m_counter;
 	Priority m_priority;
 	bool m_auto_destroy;
 	bool m_scheduled;
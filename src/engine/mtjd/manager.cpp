@@ -1,10 +1,14 @@
 #include "engine/lumix.h"
 #include "engine/mtjd/manager.h"
 
+#include "engine/array.h"
 #include "engine/mtjd/job.h"
-#include "engine/mtjd/scheduler.h"
 #include "engine/mtjd/worker_thread.h"
+#include "engine/profiler.h"
 
+#include "engine/mt/atomic.h"
+#include "engine/mt/lock_free_fixed_queue.h"
+#include "engine/mt/sync.h"
 #include "engine/mt/thread.h"
 
 namespace Lumix
@@ -13,31 +17,38 @@ namespace MTJD
 {
 
 
+static const int SPIN_COUNT_BEFORE_SLEEP = 64;
+
+
 struct ManagerImpl LUMIX_FINAL : public Manager
 {
-	typedef MT::LockFreeFixedQueue<Job*, 512>	JobsTable;
-	typedef Array<JobTrans*>					TransTable;
+	typedef MT::LockFreeFixedQueue<Job*, 512> JobsTable;
 
 
 	ManagerImpl(IAllocator& allocator)
-		: m_scheduling_counter(0)
+		: m_allocator(allocator)
+		, m_worker_tasks(allocator)
+		, m_overflow(allocator)
+		, m_overflow_mutex(false)
+		, m_overflow_count(0)
+		, m_sleeping_workers(0)
+		, m_is_exiting(false)
 		#if !LUMIX_SINGLE_THREAD()
-			, m_scheduler(*this, allocator)
+			, m_work_signal(0, 0x7fffFFFF)
 		#endif
-		, m_worker_tasks(allocator)
-		, m_allocator(allocator)
-		, m_pending_trans(allocator)
 	{
 #if !LUMIX_SINGLE_THREAD()
 		uint32 threads_num = getCpuThreadsCount();
 
-		m_scheduler.create("MTJD::Scheduler");
-
 		m_worker_tasks.reserve(threads_num);
 		for (uint32 i = 0; i < threads_num; ++i)
 		{
-			auto& task = m_worker_tasks.emplace(m_allocator);
-			task.create("MTJD::WorkerTask", this, &m_trans_queue);
+			m_worker_tasks.emplace(m_allocator);
+		}
+		for (uint32 i = 0; i < threads_num; ++i)
+		{
+			auto& task = m_worker_tasks[i];
+			task.create("MTJD::WorkerTask", this, i);
 			task.setAffinityMask(getAffinityMask(i));
 		}
 
@@ -48,10 +59,15 @@ struct ManagerImpl LUMIX_FINAL : public Manager
 	{
 #if !LUMIX_SINGLE_THREAD()
 
-		uint32 threads_num = getCpuThreadsCount();
-		for (uint32 i = 0; i < threads_num; ++i)
+		m_is_exiting = true;
+		for (auto& task : m_worker_tasks)
+		{
+			task.forceExit(false);
+		}
+		MT::memoryBarrier();
+		for (int i = 0; i < m_worker_tasks.size(); ++i)
 		{
-			m_trans_queue.abort();
+			m_work_signal.signal();
 		}
 
 		for (auto& task : m_worker_tasks)
@@ -59,10 +75,6 @@ struct ManagerImpl LUMIX_FINAL : public Manager
 			task.destroy();
 		}
 
-		m_scheduler.forceExit(false);
-		m_scheduler.dataSignal();
-		m_scheduler.destroy();
-
 #endif
 	}
 
@@ -93,8 +105,6 @@ struct ManagerImpl LUMIX_FINAL : public Manager
 			job->m_scheduled = true;
 
 			pushReadyJob(job);
-
-			m_scheduler.dataSignal();
 		}
 
 #else
@@ -105,98 +115,167 @@ struct ManagerImpl LUMIX_FINAL : public Manager
 #endif
 	}
 
-	void scheduleCpu(Job* job)
+
+	bool runReadyJob() override
 	{
-		JobTrans* tr = m_trans_queue.alloc(false);
-		if (tr)
+#if !LUMIX_SINGLE_THREAD()
+
+		Job* job = getNextReadyJob();
+		if (!job) return false;
+
+		executeJob(job);
+		return true;
+
+#else
+
+		return false;
+
+#endif
+	}
+
+
+	void wait(Counter& counter) override
+	{
+#if !LUMIX_SINGLE_THREAD()
+
+		while (!counter.isDone())
 		{
-			tr->data = job;
-			if (!m_trans_queue.push(tr, false))
-			{
-				m_trans_queue.dealoc(tr);
-				pushReadyJob(job);
-			}
-			else
-			{
-				m_pending_trans.push(tr);
-			}
+			if (!runReadyJob()) MT::yield();
 		}
+
+#endif
+		ASSERT(counter.isDone());
 	}
 
-	void doScheduling() override
+
+	void waitForJobs() override
 	{
 #if !LUMIX_SINGLE_THREAD()
 
-		uint32 count = MT::atomicIncrement(&m_scheduling_counter);
-		if (1 == count)
+		for (int i = 0; i < SPIN_COUNT_BEFORE_SLEEP; ++i)
 		{
-			do
-			{
-				for (int i = 0; i < m_pending_trans.size();)
-				{
-					JobTrans* tr = m_pending_trans[i];
-					if (tr->isCompleted())
-					{
-						tr->data->onExecuted();
-						m_trans_queue.dealoc(tr);
-						m_pending_trans.eraseFast(i);
-					}
-					else
-					{
-						++i;
-					}
-				}
-
-				Job* job = getNextReadyJob();
-				if (job)
-				{
-					scheduleCpu(job);
-				}
+			if (hasReadyJob() || m_is_exiting) return;
+			MT::yield();
+		}
 
-				count = MT::atomicDecrement(&m_scheduling_counter);
-			} while (0 < count);
+		MT::atomicIncrement(&m_sleeping_workers);
+		if (!hasReadyJob() && !m_is_exiting)
+		{
+			PROFILE_BLOCK("Sleep");
+			m_work_signal.wait();
 		}
+		MT::atomicDecrement(&m_sleeping_workers);
 
 #endif
 	}
 
+
+#if !LUMIX_SINGLE_THREAD()
+
+	void executeJob(Job* job)
+	{
+		Profiler::beginBlock(job->getJobName());
+		job->execute();
+		Profiler::endBlock();
+		job->onExecuted();
+	}
+
+
+	WorkerTask* getCurrentWorker()
+	{
+		WorkerTask* worker = WorkerTask::getCurrent();
+		return worker && worker->getManager() == this ? worker : nullptr;
+	}
+
+
+	bool hasReadyJob()
+	{
+		for (const auto& ready : m_ready_to_execute)
+		{
+			if (!ready.isEmpty()) return true;
+		}
+		for (auto& task : m_worker_tasks)
+		{
+			if (!task.getQueue().isEmpty()) return true;
+		}
+		return m_overflow_count > 0;
+	}
+
+
 	Job* getNextReadyJob()
 	{
-#if !LUMIX_SINGLE_THREAD()
+		Job* job = nullptr;
+		WorkerTask* worker = getCurrentWorker();
+		if (worker && worker->getQueue().pop(&job)) return job;
 
 		for (int32 i = 0; i < (int32)Priority::Count; ++i)
 		{
 			if (!m_ready_to_execute[i].isEmpty())
 			{
-				Job** entry = m_ready_to_execute[i].pop(true);
-				Job* ret = *entry;
-				m_ready_to_execute[i].dealoc(entry);
-
-				return ret;
+				Job** entry = m_ready_to_execute[i].pop(false);
+				if (entry)
+				{
+					job = *entry;
+					m_ready_to_execute[i].dealoc(entry);
+					return job;
+				}
 			}
 		}
 
-#endif
+		int count = m_worker_tasks.size();
+		int first = worker ? worker->getIndex() + 1 : 0;
+		for (int i = 0; i < count; ++i)
+		{
+			WorkerTask& victim = m_worker_tasks[(first + i) % count];
+			if (&victim != worker && victim.getQueue().steal(&job)) return job;
+		}
+
+		if (m_overflow_count > 0)
+		{
+			MT::SpinLock lock(m_overflow_mutex);
+			if (!m_overflow.empty())
+			{
+				job = m_overflow.back();
+				m_overflow.pop();
+				MT::atomicDecrement(&m_overflow_count);
+				return job;
+			}
+		}
 
 		return nullptr;
 	}
 
+
 	void pushReadyJob(Job* job)
 	{
 		ASSERT(job);
 
-#if !LUMIX_SINGLE_THREAD()
-
-		Job** jobEntry = m_ready_to_execute[(int32)job->getPriority()].alloc(true);
-		if (jobEntry)
+		WorkerTask* worker = getCurrentWorker();
+		if (!worker || !worker->getQueue().push(job))
 		{
-			*jobEntry = job;
-			m_ready_to_execute[(int32)job->getPriority()].push(jobEntry, true);
+			JobsTable& ready = m_ready_to_execute[(int32)job->getPriority()];
+			Job** entry = ready.alloc(false);
+			if (entry)
+			{
+				*entry = job;
+				ready.push(entry, true);
+			}
+			else
+			{
+				// the fixed queues are full, the job waits in the overflow list, it is never run here
+				MT::SpinLock lock(m_overflow_mutex);
+				m_overflow.push(job);
+				MT::atomicIncrement(&m_overflow_count);
+			}
 		}
 
-#endif
+		MT::memoryBarrier();
+		if (m_sleeping_workers > 0) m_work_signal.signal();
 	}
 
+#endif
+
+
 	uint32 getAffinityMask(uint32) const
 	{
 		return MT::getThreadAffinityMask();
@@ -204,15 +283,17 @@ struct ManagerImpl LUMIX_FINAL : public Manager
 
 	IAllocator&			m_allocator;
 	JobsTable			m_ready_to_execute[(size_t)Priority::Count];
-	JobTransQueue		m_trans_queue;
-	TransTable			m_pending_trans;
 	Array<WorkerTask>	m_worker_tasks;
+	// jobs scheduled when the fixed queues are full, taken after them
+	Array<Job*>			m_overflow;
+	MT::SpinMutex		m_overflow_mutex;
+	volatile int32		m_overflow_count;
+	volatile int32		m_sleeping_workers;
+	volatile bool		m_is_exiting;
 	#if !LUMIX_SINGLE_THREAD()
-		Scheduler			m_scheduler;
+		MT::Semaphore		m_work_signal;
 	#endif
 
-	volatile int32 m_scheduling_counter;
-
 
 }; // struct ManagerImpl
 
@@ -1,37 +1,45 @@
 #pragma once
 
 
-#include "engine/mt/lock_free_fixed_queue.h"
-#include "engine/mt/transaction.h"
+#include "engine/lumix.h"
 
 
 namespace Lumix
 {
+
+
+class IAllocator;
+
+
 namespace MTJD
 {
 
 
 class Job;
 class WorkerTask;
+struct Counter;
 
 
 class LUMIX_ENGINE_API Manager
 {
-	friend class Scheduler;
 	friend class WorkerTask;
 
 public:
-	typedef MT::Transaction<Job*> JobTrans;
-	typedef MT::LockFreeFixedQueue<JobTrans, 32> JobTransQueue;
-
 	virtual ~Manager() {}
 
 	virtual uint32 getCpuThreadsCount() const = 0;
 	virtual void schedule(Job* job) = 0;
-	virtual void doScheduling() = 0;
+	// executes one ready job on the calling thread, returns false if there is nothing to run
+	virtual bool runReadyJob() = 0;
+	// runs other ready jobs on the calling thread until the counter drops to zero,
+	// so waiting inside a job does not take a worker away from the pool
+	virtual void wait(Counter& counter) = 0;
 
 	static Manager* create(IAllocator& allocator);
 	static void destroy(Manager& manager);
+
+private:
+	virtual void waitForJobs() = 0;
 };
 
 
@@ -0,0 +1,149 @@
+#include "engine/lumix.h"
+#include "engine/mtjd/parallel_for.h"
+
+#include "engine/iallocator.h"
+#include "engine/math_utils.h"
+#include "engine/mtjd/counter.h"
+#include "engine/mtjd/job.h"
+#include "engine/mtjd/manager.h"
+
+
+namespace Lumix
+{
+namespace MTJD
+{
+
+
+static const int CHUNKS_PER_THREAD = 4;
+
+
+class RangeJob LUMIX_FINAL : public Job
+{
+public:
+	RangeJob(RangeFunction function, void* data, int from, int to, Manager& manager, IAllocator& allocator)
+		: Job(0, Priority::Default, manager, allocator, allocator)
+		, m_function(function)
+		, m_data(data)
+		, m_from(from)
+		, m_to(to)
+	{
+		setJobName("ParallelFor");
+	}
+
+	void execute() override { m_function(m_data, m_from, m_to); }
+
+private:
+	RangeFunction m_function;
+	void* m_data;
+	int m_from;
+	int m_to;
+};
+
+
+struct RangeJobs
+{
+	RangeJobs(Manager& _manager, IAllocator& _allocator, int _count)
+		: manager(_manager)
+		, allocator(_allocator)
+		, count(_count)
+	{
+	}
+
+	RangeJob* getJobs()
+	{
+		uintptr jobs = ((uintptr)(this + 1) + ALIGN_OF(RangeJob) - 1) & ~uintptr(ALIGN_OF(RangeJob) - 1);
+		return (RangeJob*)jobs;
+	}
+
+	static size_t getMemorySize(int count)
+	{
+		return sizeof(RangeJobs) + ALIGN_OF(RangeJob) + sizeof(RangeJob) * count;
+	}
+
+	Manager& manager;
+	IAllocator& allocator;
+	Counter counter;
+	int count;
+};
+
+
+static int getMaxChunkCount(Manager& manager)
+{
+	// +1 for the thread which calls join
+	return ((int)manager.getCpuThreadsCount() + 1) * CHUNKS_PER_THREAD;
+}
+
+
+int getChunkSize(Manager& manager, int count, int grain)
+{
+	int max_chunks = getMaxChunkCount(manager);
+	return Math::maximum(Math::maximum(grain, 1), (count + max_chunks - 1) / max_chunks);
+}
+
+
+size_t getParallelForMemorySize(Manager& manager)
+{
+	return RangeJobs::getMemorySize(getMaxChunkCount(manager)) + ALIGN_OF(RangeJobs) + sizeof(size_t);
+}
+
+
+JoinHandle parallelFor(Manager& manager,
+	IAllocator& allocator,
+	int begin,
+	int end,
+	int grain,
+	RangeFunction function,
+	void* data)
+{
+	int count = end - begin;
+	if (count <= 0) return JoinHandle();
+
+	int chunk_size = getChunkSize(manager, count, grain);
+	int chunk_count = (count + chunk_size - 1) / chunk_size;
+	if (chunk_count == 1)
+	{
+		function(data, begin, end);
+		return JoinHandle();
+	}
+
+	void* mem = allocator.allocate_aligned(RangeJobs::getMemorySize(chunk_count), ALIGN_OF(RangeJobs));
+	RangeJobs* jobs = new (NewPlaceholder(), mem) RangeJobs(manager, allocator, chunk_count);
+	RangeJob* range_jobs = jobs->getJobs();
+	for (int i = 0; i < chunk_count; ++i)
+	{
+		int from = begin + i * chunk_size;
+		int to = Math::minimum(from + chunk_size, end);
+		RangeJob* job = new (NewPlaceholder(), &range_jobs[i]) RangeJob(function, data, from, to, manager, allocator);
+		job->setCounter(&jobs->counter);
+	}
+	for (int i = 0; i < chunk_count; ++i)
+	{
+		manager.schedule(&range_jobs[i]);
+	}
+
+	return JoinHandle(jobs);
+}
+
+
+void JoinHandle::join()
+{
+	if (!m_jobs) return;
+
+	RangeJobs* jobs = m_jobs;
+	m_jobs = nullptr;
+
+	jobs->manager.wait(jobs->counter);
+
+	RangeJob* range_jobs = jobs->getJobs();
+	for (int i = 0; i < jobs->count; ++i)
+	{
+		range_jobs[i].~RangeJob();
+	}
+	IAllocator& allocator = jobs->allocator;
+	jobs->~RangeJobs();
+	allocator.deallocate_aligned(jobs);
+}
+
+
+} // namespace MTJD
+} // namespace Lumix
@@ -0,0 +1,89 @@
+#pragma once
+
+
+#include "engine/lumix.h"
+
+
+namespace Lumix
+{
+
+
+class IAllocator;
+
+
+namespace MTJD
+{
+
+
+class Manager;
+struct RangeJobs;
+
+
+typedef void (*RangeFunction)(void* data, int from, int to);
+
+
+// Returned by parallelFor. join() must be called before data used by the function goes away;
+// it waits for all chunks (running other ready jobs meanwhile) and frees the job objects.
+// A handle which is not joined joins when it is destroyed or assigned to. It can only be moved,
+// a copy would join the same jobs twice.
+class LUMIX_ENGINE_API JoinHandle
+{
+public:
+	JoinHandle() : m_jobs(nullptr) {}
+	explicit JoinHandle(RangeJobs* jobs) : m_jobs(jobs) {}
+	JoinHandle(JoinHandle&& rhs)
+		: m_jobs(rhs.m_jobs)
+	{
+		rhs.m_jobs = nullptr;
+	}
+	~JoinHandle() { join(); }
+
+	void operator=(JoinHandle&& rhs)
+	{
+		if (&rhs == this) return;
+		join();
+		m_jobs = rhs.m_jobs;
+		rhs.m_jobs = nullptr;
+	}
+
+	void join();
+	bool isJoined() const { return m_jobs == nullptr; }
+
+private:
+	JoinHandle(const JoinHandle&);
+	void operator=(const JoinHandle&);
+
+private:
+	RangeJobs* m_jobs;
+};
+
+
+// number of items processed by one job, at least grain, chosen so every thread gets a few chunks
+LUMIX_ENGINE_API int getChunkSize(Manager& manager, int count, int grain);
+// upper bound of memory a single parallelFor takes from its allocator
+LUMIX_ENGINE_API size_t getParallelForMemorySize(Manager& manager);
+// Splits [begin, end) into chunks and calls function(data, from, to) for each of them in a job.
+// Job objects are allocated in one block from allocator (usually a frame allocator) and freed
+// in JoinHandle::join. If there is only one chunk, it is executed immediately.
+LUMIX_ENGINE_API JoinHandle parallelFor(Manager& manager,
+	IAllocator& allocator,
+	int begin,
+	int end,
+	int grain,
+	RangeFunction function,
+	void* data);
+
+
+template <typename T>
+JoinHandle parallelFor(Manager& manager, IAllocator& allocator, int begin, int end, int grain, T& function)
+{
+	struct Caller
+	{
+		static void call(void* data, int from, int to) { (*static_cast<T*>(data))(from, to); }
+	};
+	return parallelFor(manager, allocator, begin, end, grain, &Caller::call, &function);
+}
+
+
+} // namespace MTJD
+} // namespace Lumix
@@ -1,8 +1,6 @@
 #include "engine/lumix.h"
 #include "engine/mtjd/worker_thread.h"
 #include "engine/mtjd/manager.h"
-#include "engine/mtjd/job.h"
-#include "engine/profiler.h"
 
 namespace Lumix
 {
@@ -10,8 +8,13 @@ namespace Lumix
 	{
 #if !LUMIX_SINGLE_THREAD()
 
+		static thread_local WorkerTask* s_current_worker = nullptr;
+
+
 		WorkerTask::WorkerTask(IAllocator& allocator)
 			: Task(allocator)
+			, m_manager(nullptr)
+			, m_index(-1)
 		{
 		}
 
@@ -19,36 +22,34 @@ namespace Lumix
 		{
 		}
 
-		bool WorkerTask::create(const char* name, Manager* manager, Manager::JobTransQueue* trans_queue)
+		bool WorkerTask::create(const char* name, Manager* manager, int index)
 		{
 			ASSERT(manager);
-			ASSERT(trans_queue);
 
 			m_manager = manager;
-			m_trans_queue = trans_queue;
+			m_index = index;
 
 			return Task::create(name);
 		}
 
+		WorkerTask* WorkerTask::getCurrent()
+		{
+			return s_current_worker;
+		}
+
 		int WorkerTask::task()
 		{
-			ASSERT(m_trans_queue);
+			ASSERT(m_manager);
 
-			while (!m_trans_queue->isAborted())
+			s_current_worker = this;
+			while (!isForceExit())
 			{
-				Manager::JobTrans* tr = m_trans_queue->pop(true);
-				if (!tr)
-					break;
-
-				Profiler::beginBlock("WorkerTask");
-				Profiler::beginBlock(tr->data->getJobName());
-				tr->data->execute();
-				tr->setCompleted();
-				Profiler::endBlock();
-				Profiler::endBlock();
-
-				m_manager->doScheduling();
+				if (!m_manager->runReadyJob())
+				{
+					m_manager->waitForJobs();
+				}
 			}
+			s_current_worker = nullptr;
 
 			return 0;
 		}
@@ -2,9 +2,7 @@
 
 
 #include "engine/mt/task.h"
-#include "engine/mt/lock_free_fixed_queue.h"
-
-#include "engine/mtjd/manager.h"
+#include "engine/mt/work_stealing_queue.h"
 
 
 #if !LUMIX_SINGLE_THREAD()
@@ -20,19 +18,32 @@ namespace MTJD
 {
 
 
+class Job;
+class Manager;
+
+
 class WorkerTask LUMIX_FINAL : public MT::Task
 {
 public:
+	typedef MT::WorkStealingQueue<Job*, 4096> JobQueue;
+
 	WorkerTask(IAllocator& allocator);
 	~WorkerTask();
 
-	bool create(const char* name, Manager* manager, Manager::JobTransQueue* trans_queue);
+	bool create(const char* name, Manager* manager, int index);
+
+	int task() override;
+
+	Manager* getManager() const { return m_manager; }
+	JobQueue& getQueue() { return m_queue; }
+	int getIndex() const { return m_index; }
 
-	virtual int task();
+	static WorkerTask* getCurrent();
 
 private:
-	Manager::JobTransQueue* m_trans_queue;
 	Manager* m_manager;
+	int m_index;
+	JobQueue m_queue;
 };
 
 
@@ -40,4 +51,4 @@ private:
 } // namepsace Lumix
 
 
-#endif
\ No newline at end of file
+#endif
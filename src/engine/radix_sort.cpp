@@ -0,0 +1,78 @@
+#include "engine/radix_sort.h"
+#include "engine/iallocator.h"
+#include "engine/string.h"
+
+
+namespace Lumix
+{
+
+
+static const int RADIX_BITS = 8;
+static const int RADIX_SIZE = 1 << RADIX_BITS;
+static const int PASSES_COUNT = sizeof(uint64) * 8 / RADIX_BITS;
+
+
+void radixSort(uint64* keys, int* values, int size, IAllocator& allocator)
+{
+	if (size < 2) return;
+
+	// histograms of all digits are built in one pass over the keys
+	int histograms[PASSES_COUNT][RADIX_SIZE];
+	setMemory(histograms, 0, sizeof(histograms));
+	for (int i = 0; i < size; ++i)
+	{
+		uint64 key = keys[i];
+		for (int pass = 0; pass < PASSES_COUNT; ++pass)
+		{
+			++histograms[pass][(key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1)];
+		}
+	}
+
+	uint64* tmp_keys = (uint64*)allocator.allocate(sizeof(uint64) * size);
+	int* tmp_values = (int*)allocator.allocate(sizeof(int) * size);
+	uint64* src_keys = keys;
+	int* src_values = values;
+	uint64* dst_keys = tmp_keys;
+	int* dst_values = tmp_values;
+	for (int pass = 0; pass < PASSES_COUNT; ++pass)
+	{
+		int* histogram = histograms[pass];
+		int shift = pass * RADIX_BITS;
+		// all keys have the same digit, the pass would not change the order
+		if (histogram[(src_keys[0] >> shift) & (RADIX_SIZE - 1)] == size) continue;
+
+		int offset = 0;
+		for (int i = 0; i < RADIX_SIZE; ++i)
+		{
+			int count = histogram[i];
+			histogram[i] = offset;
+			offset += count;
+		}
+
+		for (int i = 0; i < size; ++i)
+		{
+			uint64 key = src_keys[i];
+			int dst = histogram[(key >> shift) & (RADIX_SIZE - 1)]++;
+			dst_keys[dst] = key;
+			dst_values[dst] = src_values[i];
+		}
+
+		uint64* tmp_k = src_keys;
+		src_keys = dst_keys;
+		dst_keys = tmp_k;
+		int* tmp_v = src_values;
+		src_values = dst_values;
+		dst_values = tmp_v;
+	}
+
+	if (src_keys != keys)
+	{
+		copyMemory(keys, src_keys, sizeof(uint64) * size);
+		copyMemory(values, src_values, sizeof(int) * size);
+	}
+	allocator.deallocate(tmp_values);
+	allocator.deallocate(tmp_keys);
+}
+
+
+} // namespace Lumix
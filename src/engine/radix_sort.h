@@ -0,0 +1,19 @@
+#pragma once
+
+
+#include "engine/lumix.h"
+
+
+namespace Lumix
+{
+
+
+class IAllocator;
+
+
+// stable, sorts keys in ascending order and moves values with them,
+// temporary buffers for size keys and values are taken from allocator
+LUMIX_ENGINE_API void radixSort(uint64* keys, int* values, int size, IAllocator& allocator);
+
+
+} // namespace Lumix
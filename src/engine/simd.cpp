@@ -0,0 +1,66 @@
+#include "engine/simd.h"
+
+#if LUMIX_SIMD_SSE()
+	#ifdef _WIN32
+		#include <intrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+#endif
+
+
+namespace Lumix
+{
+
+
+#if LUMIX_SIMD_SSE()
+
+static bool detectAVX2()
+{
+	static const uint32 OSXSAVE_BIT = 1 << 27;
+	static const uint32 AVX_BIT = 1 << 28;
+	static const uint32 AVX2_BIT = 1 << 5;
+	static const uint32 YMM_STATE_MASK = 6; // SSE and AVX registers are saved by the OS
+
+#ifdef _WIN32
+	int regs[4];
+	__cpuid(regs, 0);
+	if (regs[0] < 7) return false;
+
+	__cpuid(regs, 1);
+	uint32 features = regs[2];
+	if ((features & OSXSAVE_BIT) == 0 || (features & AVX_BIT) == 0) return false;
+	if ((_xgetbv(0) & YMM_STATE_MASK) != YMM_STATE_MASK) return false;
+
+	__cpuidex(regs, 7, 0);
+	return (regs[1] & AVX2_BIT) != 0;
+#else
+	unsigned int eax, ebx, ecx, edx;
+	if (__get_cpuid_max(0, nullptr) < 7) return false;
+
+	__get_cpuid(1, &eax, &ebx, &ecx, &edx);
+	if ((ecx & OSXSAVE_BIT) == 0 || (ecx & AVX_BIT) == 0) return false;
+	uint32 xcr0_low, xcr0_high;
+	asm volatile("xgetbv" : "=a"(xcr0_low), "=d"(xcr0_high) : "c"(0));
+	if ((xcr0_low & YMM_STATE_MASK) != YMM_STATE_MASK) return false;
+
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	return (ebx & AVX2_BIT) != 0;
+#endif
+}
+
+#endif
+
+
+bool isAVX2Supported()
+{
+#if LUMIX_SIMD_SSE()
+	static const bool is_supported = detectAVX2();
+	return is_supported;
+#else
+	return false;
+#endif
+}
+
+
+} // namespace Lumix
@@ -4,8 +4,22 @@
 #include "engine/lumix.h"
 
 
-#ifdef _WIN32
+#if defined(_WIN32) || defined(__SSE2__)
+	#define LUMIX_SIMD_SSE() 1
+#else
+	#define LUMIX_SIMD_SSE() 0
+#endif
+
+
+#if LUMIX_SIMD_SSE()
 	#include <xmmintrin.h>
+	#include <immintrin.h>
+	#ifdef _WIN32
+		#define LUMIX_AVX2_TARGET
+	#else
+		// lets AVX2 code live in a binary built for SSE2, it must only run if isAVX2Supported() is true
+		#define LUMIX_AVX2_TARGET __attribute__((target("avx2")))
+	#endif
 #else
 	#include <cmath>
 #endif
@@ -14,7 +28,11 @@ namespace Lumix
 {
 
 
-#ifdef _WIN32
+// checked once at runtime, float8 functions must not be called if this returns false
+LUMIX_ENGINE_API bool isAVX2Supported();
+
+
+#if LUMIX_SIMD_SSE()
 	typedef __m128 float4;
 
 
@@ -42,6 +60,19 @@ namespace Lumix
 	}
 
 
+	LUMIX_FORCE_INLINE void f4StoreUnaligned(void* dest, float4 src)
+	{
+		_mm_storeu_ps((float*)dest, src);
+	}
+
+
+	// rows become columns
+	LUMIX_FORCE_INLINE void f4Transpose(float4& a, float4& b, float4& c, float4& d)
+	{
+		_MM_TRANSPOSE4_PS(a, b, c, d);
+	}
+
+
 	LUMIX_FORCE_INLINE int f4MoveMask(float4 a)
 	{
 		return _mm_movemask_ps(a);
@@ -101,6 +132,69 @@ namespace Lumix
 		return _mm_max_ps(a, b);
 	}
 
+
+	typedef __m256 float8;
+
+
+	LUMIX_AVX2_TARGET LUMIX_FORCE_INLINE float8 f8LoadUnaligned(const void* src)
+	{
+		return _mm256_loadu_ps((const float*)(src));
+	}
+
+
+	LUMIX_AVX2_TARGET LUMIX_FORCE_INLINE float8 f8Load(const void* src)
+	{
+		return _mm256_load_ps((const float*)(src));
+	}
+
+
+	LUMIX_AVX2_TARGET LUMIX_FORCE_INLINE float8 f8Splat(float value)
+	{
+		return _mm256_set1_ps(value);
+	}
+
+
+	LUMIX_AVX2_TARGET LUMIX_FORCE_INLINE void f8Store(void* dest, float8 src)
+	{
+		_mm256_store_ps((float*)dest, src);
+	}
+
+
+	LUMIX_AVX2_TARGET LUMIX_FORCE_INLINE int f8MoveMask(float8 a)
+	{
+		return _mm256_movemask_ps(a);
+	}
+
+
+	LUMIX_AVX2_TARGET LUMIX_FORCE_INLINE float8 f8Add(float8 a, float8 b)
+	{
+		return _mm256_add_ps(a, b);
+	}
+
+
+	LUMIX_AVX2_TARGET LUMIX_FORCE_INLINE float8 f8Sub(float8 a, float8 b)
+	{
+		return _mm256_sub_ps(a, b);
+	}
+
+
+	LUMIX_AVX2_TARGET LUMIX_FORCE_INLINE float8 f8Mul(float8 a, float8 b)
+	{
+		return _mm256_mul_ps(a, b);
+	}
+
+
+	LUMIX_AVX2_TARGET LUMIX_FORCE_INLINE float8 f8Min(float8 a, float8 b)
+	{
+		return _mm256_min_ps(a, b);
+	}
+
+
+	LUMIX_AVX2_TARGET LUMIX_FORCE_INLINE float8 f8Max(float8 a, float8 b)
+	{
+		return _mm256_max_ps(a, b);
+	}
+
 #else 
 	struct float4
 	{
@@ -132,6 +226,25 @@ namespace Lumix
 	}
 
 
+	LUMIX_FORCE_INLINE void f4StoreUnaligned(void* dest, float4 src)
+	{
+		(*(float4*)dest) = src;
+	}
+
+
+	LUMIX_FORCE_INLINE void f4Transpose(float4& a, float4& b, float4& c, float4& d)
+	{
+		float4 ta = {a.x, b.x, c.x, d.x};
+		float4 tb = {a.y, b.y, c.y, d.y};
+		float4 tc = {a.z, b.z, c.z, d.z};
+		float4 td = {a.w, b.w, c.w, d.w};
+		a = ta;
+		b = tb;
+		c = tc;
+		d = td;
+	}
+
+
 	LUMIX_FORCE_INLINE int f4MoveMask(float4 a)
 	{
 		return (a.w < 0 ? (1 << 3) : 0) | 
@@ -431,7 +431,7 @@ private:
 	{
 		if (!m_cstr)
 		{
-			return rhs > 0;
+			return rhs != nullptr;
 		}
 		const T* left = m_cstr;
 		const T* right = rhs;
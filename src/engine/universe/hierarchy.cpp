@@ -30,7 +30,7 @@ public:
 		universe.registerComponentTypeScene(HIERARCHY_TYPE_HANDLE, this);
 		m_is_processing = false;
 		universe.entityDestroyed().bind<HierarchyImpl, &HierarchyImpl::onEntityDestroyed>(this);
-		universe.entityTransformed().bind<HierarchyImpl, &HierarchyImpl::onEntityMoved>(this);
+		universe.entityTransformedImmediate().bind<HierarchyImpl, &HierarchyImpl::onEntityMoved>(this);
 	}
 
 
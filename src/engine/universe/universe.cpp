@@ -3,8 +3,12 @@
 #include "engine/crc32.h"
 #include "engine/iplugin.h"
 #include "engine/json_serializer.h"
+#include "engine/log.h"
 #include "engine/matrix.h"
+#include "engine/profiler.h"
 #include "engine/property_register.h"
+#include "engine/radix_sort.h"
+#include "engine/universe/hierarchy.h"
 #include <cstdint>
 
 
@@ -24,18 +28,32 @@ Universe::Universe(IAllocator& allocator)
 	: m_allocator(allocator)
 	, m_name_to_id_map(m_allocator)
 	, m_id_to_name_map(m_allocator)
-	, m_transformations(m_allocator)
+	, m_entities(m_allocator)
+	, m_positions(m_allocator)
+	, m_rotations(m_allocator)
+	, m_scales(m_allocator)
 	, m_components(m_allocator)
 	, m_component_added(m_allocator)
 	, m_component_destroyed(m_allocator)
 	, m_entity_created(m_allocator)
 	, m_entity_destroyed(m_allocator)
 	, m_entity_moved(m_allocator)
+	, m_entities_moved(m_allocator)
+	, m_entity_moved_immediate(m_allocator)
+	, m_dirty_entities(m_allocator)
+	, m_dirty_mask(m_allocator)
+	, m_flushed_entities(m_allocator)
+	, m_flush_depths(m_allocator)
+	, m_flush_order(m_allocator)
+	, m_are_notifications_deferred(false)
 	, m_entity_map(m_allocator)
 	, m_first_free_slot(-1)
 	, m_scenes(m_allocator)
 {
-	m_transformations.reserve(RESERVED_ENTITIES_COUNT);
+	m_entities.reserve(RESERVED_ENTITIES_COUNT);
+	m_positions.reserve(RESERVED_ENTITIES_COUNT);
+	m_rotations.reserve(RESERVED_ENTITIES_COUNT);
+	m_scales.reserve(RESERVED_ENTITIES_COUNT);
 	m_components.reserve(RESERVED_ENTITIES_COUNT);
 	m_entity_map.reserve(RESERVED_ENTITIES_COUNT);
 	for (int i = 0; i < lengthOf(m_component_type_scene_map); ++i)
@@ -78,27 +96,27 @@ void Universe::addScene(IScene* scene)
 
 const Vec3& Universe::getPosition(Entity entity) const
 {
-	return m_transformations[m_entity_map[entity.index]].position;
+	return m_positions[m_entity_map[entity.index]];
 }
 
 
 const Quat& Universe::getRotation(Entity entity) const
 {
-	return m_transformations[m_entity_map[entity.index]].rotation;
+	return m_rotations[m_entity_map[entity.index]];
 }
 
 
 void Universe::setRotation(Entity entity, const Quat& rot)
 {
-	m_transformations[m_entity_map[entity.index]].rotation = rot;
-	entityTransformed().invoke(entity);
+	m_rotations[m_entity_map[entity.index]] = rot;
+	notifyTransformed(entity);
 }
 
 
 void Universe::setRotation(Entity entity, float x, float y, float z, float w)
 {
-	m_transformations[m_entity_map[entity.index]].rotation.set(x, y, z, w);
-	entityTransformed().invoke(entity);
+	m_rotations[m_entity_map[entity.index]].set(x, y, z, w);
+	notifyTransformed(entity);
 }
 
 
@@ -110,60 +128,180 @@ bool Universe::hasEntity(Entity entity) const
 
 void Universe::setMatrix(Entity entity, const Matrix& mtx)
 {
-	Transformation& out = m_transformations[m_entity_map[entity.index]];
-	mtx.decompose(out.position, out.rotation, out.scale);
-	entityTransformed().invoke(entity);
+	int idx = m_entity_map[entity.index];
+	mtx.decompose(m_positions[idx], m_rotations[idx], m_scales[idx]);
+	notifyTransformed(entity);
 }
 
 
 Matrix Universe::getPositionAndRotation(Entity entity) const
 {
-	auto& transform = m_transformations[m_entity_map[entity.index]];
-	Matrix mtx = transform.rotation.toMatrix();
-	mtx.setTranslation(transform.position);
+	int idx = m_entity_map[entity.index];
+	Matrix mtx = m_rotations[idx].toMatrix();
+	mtx.setTranslation(m_positions[idx]);
 	return mtx;
 }
 
 
 void Universe::setTransform(Entity entity, const Transform& transform)
 {
-	auto& tmp = m_transformations[m_entity_map[entity.index]];
-	tmp.position = transform.pos;
-	tmp.rotation = transform.rot;
-	entityTransformed().invoke(entity);
+	int idx = m_entity_map[entity.index];
+	m_positions[idx] = transform.pos;
+	m_rotations[idx] = transform.rot;
+	notifyTransformed(entity);
+}
+
+
+void Universe::setTransforms(const Entity* entities, const Transform* transforms, int count)
+{
+	if (count == 0) return;
+
+	for (int i = 0; i < count; ++i)
+	{
+		int idx = m_entity_map[entities[i].index];
+		m_positions[idx] = transforms[i].pos;
+		m_rotations[idx] = transforms[i].rot;
+		m_entity_moved_immediate.invoke(entities[i]);
+	}
+
+	if (m_are_notifications_deferred)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			markDirty(entities[i]);
+		}
+		return;
+	}
+	m_entities_moved.invoke(entities, count);
+}
+
+
+void Universe::notifyTransformed(Entity entity)
+{
+	m_entity_moved_immediate.invoke(entity);
+	if (m_are_notifications_deferred)
+	{
+		markDirty(entity);
+		return;
+	}
+	m_entity_moved.invoke(entity);
+}
+
+
+void Universe::markDirty(Entity entity)
+{
+	int word = entity.index >> 5;
+	uint32 bit = 1 << (entity.index & 31);
+	if (word >= m_dirty_mask.size())
+	{
+		int old_size = m_dirty_mask.size();
+		m_dirty_mask.resize(word + 1);
+		setMemory(&m_dirty_mask[old_size], 0, sizeof(m_dirty_mask[0]) * (word + 1 - old_size));
+	}
+	if (m_dirty_mask[word] & bit) return;
+
+	m_dirty_mask[word] |= bit;
+	m_dirty_entities.push(entity);
+}
+
+
+void Universe::setDeferredTransformNotifications(bool deferred)
+{
+	if (!deferred) flushTransformNotifications();
+	m_are_notifications_deferred = deferred;
+}
+
+
+static int getHierarchyDepth(Hierarchy* hierarchy, Entity entity)
+{
+	static const int MAX_DEPTH = 255;
+	if (!hierarchy) return 0;
+
+	int depth = 0;
+	for (Entity parent = hierarchy->getParent({entity.index}); isValid(parent) && depth < MAX_DEPTH;
+		 parent = hierarchy->getParent({parent.index}))
+	{
+		++depth;
+	}
+	return depth;
+}
+
+
+void Universe::flushTransformNotifications()
+{
+	if (m_dirty_entities.empty()) return;
+
+	PROFILE_FUNCTION();
+	// listeners can move other entities, e.g. attachments, so batches are reported until nothing is dirty;
+	// the limit keeps listeners which move each other forever from hanging the flush
+	static const int MAX_BATCHES = 16;
+	static const uint32 HIERARCHY_HASH = crc32("hierarchy");
+	Hierarchy* hierarchy = static_cast<Hierarchy*>(getScene(HIERARCHY_HASH));
+	int moved_count = 0;
+	for (int batch = 0; batch < MAX_BATCHES && !m_dirty_entities.empty(); ++batch)
+	{
+		m_flush_depths.clear();
+		m_flush_order.clear();
+		bool any_child = false;
+		for (int i = 0, c = m_dirty_entities.size(); i < c; ++i)
+		{
+			Entity entity = m_dirty_entities[i];
+			uint32& word = m_dirty_mask[entity.index >> 5];
+			uint32 bit = 1 << (entity.index & 31);
+			if ((word & bit) == 0) continue;
+
+			word &= ~bit;
+			int depth = getHierarchyDepth(hierarchy, entity);
+			any_child = any_child || depth > 0;
+			m_flush_depths.push(depth);
+			m_flush_order.push(i);
+		}
+		if (any_child) radixSort(&m_flush_depths[0], &m_flush_order[0], m_flush_order.size(), m_allocator);
+
+		m_flushed_entities.clear();
+		for (int idx : m_flush_order) m_flushed_entities.push(m_dirty_entities[idx]);
+		m_dirty_entities.clear();
+
+		if (m_flushed_entities.empty()) continue;
+		moved_count += m_flushed_entities.size();
+		m_entities_moved.invoke(&m_flushed_entities[0], m_flushed_entities.size());
+	}
+	PROFILE_INT("moved entities", moved_count);
+	if (!m_dirty_entities.empty())
+	{
+		g_log_warning.log("Engine") << "Transform listeners keep moving entities, the rest is reported next flush";
+	}
 }
 
 
 Transform Universe::getTransform(Entity entity) const
 {
-	auto& transform = m_transformations[m_entity_map[entity.index]];
-	return Transform(transform.position, transform.rotation);
+	int idx = m_entity_map[entity.index];
+	return Transform(m_positions[idx], m_rotations[idx]);
 }
 
 
 Matrix Universe::getMatrix(Entity entity) const
 {
-	auto& transform = m_transformations[m_entity_map[entity.index]];
-	Matrix mtx = transform.rotation.toMatrix();
-	mtx.setTranslation(transform.position);
-	mtx.multiply3x3(transform.scale);
+	int idx = m_entity_map[entity.index];
+	Matrix mtx = m_rotations[idx].toMatrix();
+	mtx.setTranslation(m_positions[idx]);
+	mtx.multiply3x3(m_scales[idx]);
 	return mtx;
 }
 
 
 void Universe::setPosition(Entity entity, float x, float y, float z)
 {
-	auto& transform = m_transformations[m_entity_map[entity.index]];
-	transform.position.set(x, y, z);
-	entityTransformed().invoke(entity);
+	m_positions[m_entity_map[entity.index]].set(x, y, z);
+	notifyTransformed(entity);
 }
 
 
 void Universe::setPosition(Entity entity, const Vec3& pos)
 {
-	auto& transform = m_transformations[m_entity_map[entity.index]];
-	transform.position = pos;
-	entityTransformed().invoke(entity);
+	m_positions[m_entity_map[entity.index]] = pos;
+	notifyTransformed(entity);
 }
 
 
@@ -212,13 +350,12 @@ void Universe::createEntity(Entity entity)
 	{
 		m_entity_map[prev_id] = m_entity_map[entity.index];
 	}
-	m_entity_map[entity.index] = m_transformations.size();
+	m_entity_map[entity.index] = m_entities.size();
 
-	Transformation& trans = m_transformations.emplace();
-	trans.position.set(0, 0, 0);
-	trans.rotation.set(0, 0, 0, 1);
-	trans.scale = 1;
-	trans.entity = entity;
+	m_entities.push(entity);
+	m_positions.emplace(0, 0, 0);
+	m_rotations.emplace(0, 0, 0, 1);
+	m_scales.push(1);
 	m_components.emplace(0);
 
 	m_entity_created.invoke(entity);
@@ -232,19 +369,18 @@ Entity Universe::createEntity(const Vec3& position, const Quat& rotation)
 	{
 		global_id = m_first_free_slot;
 		m_first_free_slot = -m_entity_map[m_first_free_slot];
-		m_entity_map[global_id] = m_transformations.size();
+		m_entity_map[global_id] = m_entities.size();
 	}
 	else
 	{
 		global_id = m_entity_map.size();
-		m_entity_map.push(m_transformations.size());
+		m_entity_map.push(m_entities.size());
 	}
 
-	Transformation& trans = m_transformations.emplace();
-	trans.position = position;
-	trans.rotation = rotation;
-	trans.scale = 1;
-	trans.entity.index = global_id;
+	m_entities.push({global_id});
+	m_positions.push(position);
+	m_rotations.push(rotation);
+	m_scales.push(1);
 	m_components.emplace(0);
 	m_entity_created.invoke({global_id});
 
@@ -270,10 +406,18 @@ void Universe::destroyEntity(Entity entity)
 		}
 	}
 
-	Entity last_item_id = m_transformations.back().entity;
-	m_entity_map[last_item_id.index] = m_entity_map[entity.index];
-	m_transformations.eraseFast(m_entity_map[entity.index]);
-	m_components.eraseFast(m_entity_map[entity.index]);
+	Entity last_item_id = m_entities.back();
+	int idx = m_entity_map[entity.index];
+	m_entity_map[last_item_id.index] = idx;
+	m_entities.eraseFast(idx);
+	m_positions.eraseFast(idx);
+	m_rotations.eraseFast(idx);
+	m_scales.eraseFast(idx);
+	m_components.eraseFast(idx);
+	if ((entity.index >> 5) < m_dirty_mask.size())
+	{
+		m_dirty_mask[entity.index >> 5] &= ~(1 << (entity.index & 31));
+	}
 	m_entity_map[entity.index] = m_first_free_slot >= 0 ? -m_first_free_slot : INT32_MIN;
 
 	int name_index = m_id_to_name_map.find(entity.index);
@@ -297,7 +441,7 @@ int Universe::getDenseIdx(Entity entity)
 
 Entity Universe::getEntityFromDenseIdx(int idx)
 {
-	return m_transformations[idx].entity;
+	return m_entities[idx];
 }
 
 
@@ -329,8 +473,15 @@ Entity Universe::getNextEntity(Entity entity)
 
 void Universe::serialize(OutputBlob& serializer)
 {
-	serializer.write((int32)m_transformations.size());
-	serializer.write(&m_transformations[0], sizeof(m_transformations[0]) * m_transformations.size());
+	// same layout as when transformations were stored in an array of structures
+	serializer.write((int32)m_entities.size());
+	for (int i = 0, c = m_entities.size(); i < c; ++i)
+	{
+		serializer.write(m_entities[i]);
+		serializer.write(m_positions[i]);
+		serializer.write(m_rotations[i]);
+		serializer.write(m_scales[i]);
+	}
 	serializer.write((int32)m_id_to_name_map.size());
 	for (int i = 0, c = m_id_to_name_map.size(); i < c; ++i)
 	{
@@ -351,11 +502,22 @@ void Universe::deserialize(InputBlob& serializer)
 {
 	int32 count;
 	serializer.read(count);
-	m_transformations.resize(count);
+	m_entities.resize(count);
+	m_positions.resize(count);
+	m_rotations.resize(count);
+	m_scales.resize(count);
 	for (int i = 0, c = m_components.size(); i < c; ++i) m_components[i] = 0;
 	m_components.resize(count);
+	m_dirty_entities.clear();
+	m_dirty_mask.clear();
 
-	serializer.read(&m_transformations[0], sizeof(m_transformations[0]) * m_transformations.size());
+	for (int i = 0; i < count; ++i)
+	{
+		serializer.read(m_entities[i]);
+		serializer.read(m_positions[i]);
+		serializer.read(m_rotations[i]);
+		serializer.read(m_scales[i]);
+	}
 
 	serializer.read(count);
 	m_id_to_name_map.clear();
@@ -382,16 +544,14 @@ void Universe::deserialize(InputBlob& serializer)
 
 void Universe::setScale(Entity entity, float scale)
 {
-	auto& transform = m_transformations[m_entity_map[entity.index]];
-	transform.scale = scale;
-	entityTransformed().invoke(entity);
+	m_scales[m_entity_map[entity.index]] = scale;
+	notifyTransformed(entity);
 }
 
 
 float Universe::getScale(Entity entity)
 {
-	auto& transform = m_transformations[m_entity_map[entity.index]];
-	return transform.scale;
+	return m_scales[m_entity_map[entity.index]];
 }
 
 
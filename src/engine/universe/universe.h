@@ -46,7 +46,7 @@ public:
 	ComponentUID getFirstComponent(Entity entity) const;
 	ComponentUID getNextComponent(const ComponentUID& cmp) const;
 	void registerComponentTypeScene(ComponentType type, IScene* scene);
-	int getEntityCount() const { return m_transformations.size(); }
+	int getEntityCount() const { return m_entities.size(); }
 
 	int getDenseIdx(Entity entity);
 	Entity getEntityFromDenseIdx(int idx);
@@ -61,6 +61,15 @@ public:
 	Matrix getPositionAndRotation(Entity entity) const;
 	Matrix getMatrix(Entity entity) const;
 	void setTransform(Entity entity, const Transform& transform);
+	// sets transforms of all entities and notifies entitiesTransformed() listeners only once
+	void setTransforms(const Entity* entities, const Transform* transforms, int count);
+	// while deferred, entityTransformed() and entitiesTransformed() listeners are not notified
+	// immediately, moved entities are collected and reported once by flushTransformNotifications()
+	void setDeferredTransformNotifications(bool deferred);
+	bool areTransformNotificationsDeferred() const { return m_are_notifications_deferred; }
+	// each entity is reported once per batch, parents before their children and otherwise in the order
+	// in which they were first moved; entities moved by listeners are reported in further batches
+	void flushTransformNotifications();
 	Transform getTransform(Entity entity) const;
 	void setRotation(Entity entity, float x, float y, float z, float w);
 	void setRotation(Entity entity, const Quat& rot);
@@ -70,10 +79,18 @@ public:
 	float getScale(Entity entity);
 	const Vec3& getPosition(Entity entity) const;
 	const Quat& getRotation(Entity entity) const;
+	// dense arrays indexed by getDenseIdx(), invalidated by creating or destroying an entity
+	const Vec3* getPositions() const { return m_positions.empty() ? nullptr : &m_positions[0]; }
+	const Quat* getRotations() const { return m_rotations.empty() ? nullptr : &m_rotations[0]; }
+	const float* getScales() const { return m_scales.empty() ? nullptr : &m_scales[0]; }
 	Lumix::Path getPath() const { return m_path; }
 	void setPath(const Lumix::Path& path) { m_path = path; }
 
 	DelegateList<void(Entity)>& entityTransformed() { return m_entity_moved; }
+	// invoked by setTransforms instead of entityTransformed
+	DelegateList<void(const Entity*, int)>& entitiesTransformed() { return m_entities_moved; }
+	// always invoked synchronously, for listeners which must keep other transforms in sync
+	DelegateList<void(Entity)>& entityTransformedImmediate() { return m_entity_moved_immediate; }
 	DelegateList<void(Entity)>& entityCreated() { return m_entity_created; }
 	DelegateList<void(Entity)>& entityDestroyed() { return m_entity_destroyed; }
 	DelegateList<void(const ComponentUID&)>& componentDestroyed() { return m_component_destroyed; }
@@ -88,24 +105,30 @@ public:
 	void addScene(IScene* scene);
 
 private:
-	struct Transformation
-	{
-		Entity entity;
-		Vec3 position;
-		Quat rotation;
-		float scale;
-	};
+	void notifyTransformed(Entity entity);
+	void markDirty(Entity entity);
 
 private:
 	IAllocator& m_allocator;
 	Array<IScene*> m_scenes;
 	IScene* m_component_type_scene_map[MAX_COMPONENTS_TYPES_COUNT];
-	Array<Transformation> m_transformations;
+	Array<Entity> m_entities;
+	Array<Vec3> m_positions;
+	Array<Quat> m_rotations;
+	Array<float> m_scales;
 	Array<uint64> m_components;
 	Array<int> m_entity_map;
 	AssociativeArray<uint32, uint32> m_name_to_id_map;
 	AssociativeArray<uint32, string> m_id_to_name_map;
 	DelegateList<void(Entity)> m_entity_moved;
+	DelegateList<void(const Entity*, int)> m_entities_moved;
+	DelegateList<void(Entity)> m_entity_moved_immediate;
+	Array<Entity> m_dirty_entities;
+	Array<uint32> m_dirty_mask;
+	Array<Entity> m_flushed_entities;
+	Array<uint64> m_flush_depths;
+	Array<int> m_flush_order;
+	bool m_are_notifications_deferred;
 	DelegateList<void(Entity)> m_entity_created;
 	DelegateList<void(Entity)> m_entity_destroyed;
 	DelegateList<void(const ComponentUID&)> m_component_destroyed;
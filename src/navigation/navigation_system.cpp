@@ -142,6 +142,7 @@ struct NavigationSceneImpl LUMIX_FINAL : public NavigationScene
 	{
 		setGeneratorParams(0.3f, 0.1f, 0.3f, 2.0f, 60.0f, 1.5f);
 		m_universe.entityTransformed().bind<NavigationSceneImpl, &NavigationSceneImpl::onEntityMoved>(this);
+		m_universe.entitiesTransformed().bind<NavigationSceneImpl, &NavigationSceneImpl::onEntitiesMoved>(this);
 		universe.registerComponentTypeScene(NAVMESH_AGENT_TYPE, this);
 	}
 
@@ -149,6 +150,7 @@ struct NavigationSceneImpl LUMIX_FINAL : public NavigationScene
 	~NavigationSceneImpl()
 	{
 		m_universe.entityTransformed().unbind<NavigationSceneImpl, &NavigationSceneImpl::onEntityMoved>(this);
+		m_universe.entitiesTransformed().unbind<NavigationSceneImpl, &NavigationSceneImpl::onEntitiesMoved>(this);
 		clearNavmesh();
 	}
 
@@ -159,6 +161,15 @@ struct NavigationSceneImpl LUMIX_FINAL : public NavigationScene
 	}
 
 
+	void onEntitiesMoved(const Entity* entities, int count)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			onEntityMoved(entities[i]);
+		}
+	}
+
+
 	void onEntityMoved(Entity entity)
 	{
 		auto iter = m_agents.find(entity);
@@ -282,6 +282,8 @@ struct PhysicsSceneImpl LUMIX_FINAL : public PhysicsScene
 		, m_ragdolls(m_allocator)
 		, m_terrains(m_allocator)
 		, m_dynamic_actors(m_allocator)
+		, m_moved_entities(m_allocator)
+		, m_moved_transforms(m_allocator)
 		, m_universe(context)
 		, m_is_game_running(false)
 		, m_contact_callback(*this)
@@ -1548,11 +1550,17 @@ struct PhysicsSceneImpl LUMIX_FINAL : public PhysicsScene
 	void updateDynamicActors()
 	{
 		PROFILE_FUNCTION();
+		m_moved_entities.clear();
+		m_moved_transforms.clear();
 		for (auto* actor : m_dynamic_actors)
 		{
 			physx::PxTransform trans = actor->physx_actor->getGlobalPose();
-			m_universe.setPosition(actor->entity, trans.p.x, trans.p.y, trans.p.z);
-			m_universe.setRotation(actor->entity, trans.q.x, trans.q.y, trans.q.z, trans.q.w);
+			m_moved_entities.push(actor->entity);
+			m_moved_transforms.push(fromPhysx(trans));
+		}
+		if (!m_moved_entities.empty())
+		{
+			m_universe.setTransforms(&m_moved_entities[0], &m_moved_transforms[0], m_moved_entities.size());
 		}
 	}
 
@@ -3558,6 +3566,8 @@ struct PhysicsSceneImpl LUMIX_FINAL : public PhysicsScene
 	AssociativeArray<Entity, Heightfield> m_terrains;
 
 	Array<RigidActor*> m_dynamic_actors;
+	Array<Entity> m_moved_entities;
+	Array<Transform> m_moved_transforms;
 	bool m_is_game_running;
 	bool m_is_updating_ragdoll;
 	uint32 m_debug_visualization_flags;
@@ -3571,7 +3581,8 @@ struct PhysicsSceneImpl LUMIX_FINAL : public PhysicsScene
 PhysicsScene* PhysicsScene::create(PhysicsSystem& system, Universe& context, Engine& engine, IAllocator& allocator)
 {
 	PhysicsSceneImpl* impl = LUMIX_NEW(allocator, PhysicsSceneImpl)(context, allocator);
-	impl->m_universe.entityTransformed().bind<PhysicsSceneImpl, &PhysicsSceneImpl::onEntityMoved>(impl);
+	// physx actors must be teleported before the next simulation step
+	impl->m_universe.entityTransformedImmediate().bind<PhysicsSceneImpl, &PhysicsSceneImpl::onEntityMoved>(impl);
 	impl->m_engine = &engine;
 	physx::PxSceneDesc sceneDesc(system.getPhysics()->getTolerancesScale());
 	sceneDesc.gravity = physx::PxVec3(0.0f, -9.8f, 0.0f);
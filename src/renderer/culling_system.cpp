@@ -2,13 +2,18 @@
 #include "engine/lumix.h"
 
 #include "engine/binary_array.h"
-#include "engine/free_list.h"
 #include "engine/geometry.h"
+#include "engine/lifo_allocator.h"
+#include "engine/math_utils.h"
 #include "engine/profiler.h"
+#include "engine/string.h"
 
-#include "engine/mtjd/group.h"
 #include "engine/mtjd/manager.h"
-#include "engine/mtjd/job.h"
+#include "engine/mtjd/parallel_for.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
 
 namespace Lumix
 {
@@ -16,351 +21,1773 @@ typedef Array<uint64> LayerMasks;
 typedef Array<int> ModelInstancetoSphereMap;
 typedef Array<ComponentHandle> SphereToModelInstanceMap;
 
-static const int MIN_ENTITIES_PER_THREAD = 50;
+static const int MIN_ENTITIES_PER_JOB = 50;
+static const int TREE_LEAF_SIZE = 8;
+static const int TREE_MAX_DEPTH = 48;
+static const int TREE_MIN_CHANGES_TO_REBUILD = 64;
+// number of culls a moving sphere must stay still to be put back to the tree on the next rebuild
+static const uint32 MOVER_SETTLE_CULLS = 128;
+static const int MAX_CACHED_VIEWS = 4;
+// when more changes are logged, cached views are dropped, retesting everything would not be much faster than culling
+static const int MAX_CACHE_CHANGES = 4096;
+
+
+struct CullingPlanes
+{
+	CullingPlanes() {}
+	explicit CullingPlanes(const Frustum& frustum) { set(frustum); }
+
+	void set(const Frustum& frustum)
+	{
+		float4 zero = f4Splat(0);
+		for (int i = 0; i < 2; ++i)
+		{
+			x[i] = f4Load(&frustum.xs[i * 4]);
+			y[i] = f4Load(&frustum.ys[i * 4]);
+			z[i] = f4Load(&frustum.zs[i * 4]);
+			d[i] = f4Load(&frustum.ds[i * 4]);
+			abs_x[i] = f4Max(x[i], f4Sub(zero, x[i]));
+			abs_y[i] = f4Max(y[i], f4Sub(zero, y[i]));
+			abs_z[i] = f4Max(z[i], f4Sub(zero, z[i]));
+		}
+	}
+
+	float4 x[2];
+	float4 y[2];
+	float4 z[2];
+	float4 d[2];
+	float4 abs_x[2];
+	float4 abs_y[2];
+	float4 abs_z[2];
+};
+
+
+LUMIX_FORCE_INLINE static bool isSphereOutside(const CullingPlanes& planes,
+	float4 cx,
+	float4 cy,
+	float4 cz,
+	float4 negative_radius)
+{
+	float4 t = f4Mul(cx, planes.x[0]);
+	t = f4Add(t, f4Mul(cy, planes.y[0]));
+	t = f4Add(t, f4Mul(cz, planes.z[0]));
+	t = f4Add(t, planes.d[0]);
+	t = f4Sub(t, negative_radius);
+	if (f4MoveMask(t)) return true;
+
+	t = f4Mul(cx, planes.x[1]);
+	t = f4Add(t, f4Mul(cy, planes.y[1]));
+	t = f4Add(t, f4Mul(cz, planes.z[1]));
+	t = f4Add(t, planes.d[1]);
+	t = f4Sub(t, negative_radius);
+	return f4MoveMask(t) != 0;
+}
+
+
+LUMIX_FORCE_INLINE static bool isSphereOutside(const CullingPlanes& planes, const Sphere& sphere)
+{
+	return isSphereOutside(planes,
+		f4Splat(sphere.position.x),
+		f4Splat(sphere.position.y),
+		f4Splat(sphere.position.z),
+		f4Splat(-sphere.radius));
+}
+
+
+// spheres are split into separate arrays, so SIMD code can test several of them at once
+struct CullingSpheres
+{
+	explicit CullingSpheres(IAllocator& allocator)
+		: x(allocator)
+		, y(allocator)
+		, z(allocator)
+		, radius(allocator)
+	{
+	}
+
+	int size() const { return x.size(); }
+	bool empty() const { return x.empty(); }
+	Sphere get(int index) const { return Sphere(x[index], y[index], z[index], radius[index]); }
+
+	void reserve(int count)
+	{
+		x.reserve(count);
+		y.reserve(count);
+		z.reserve(count);
+		radius.reserve(count);
+	}
+
+	void clear()
+	{
+		x.clear();
+		y.clear();
+		z.clear();
+		radius.clear();
+	}
+
+	void push(const Sphere& sphere)
+	{
+		x.push(sphere.position.x);
+		y.push(sphere.position.y);
+		z.push(sphere.position.z);
+		radius.push(sphere.radius);
+	}
+
+	void set(int index, const Sphere& sphere)
+	{
+		x[index] = sphere.position.x;
+		y[index] = sphere.position.y;
+		z[index] = sphere.position.z;
+		radius[index] = sphere.radius;
+	}
+
+	void eraseFast(int index)
+	{
+		x.eraseFast(index);
+		y.eraseFast(index);
+		z.eraseFast(index);
+		radius.eraseFast(index);
+	}
+
+	Array<float> x;
+	Array<float> y;
+	Array<float> z;
+	Array<float> radius;
+};
+
+
+LUMIX_FORCE_INLINE static void pushVisible(int visible_mask,
+	int first,
+	const uint64* LUMIX_RESTRICT layer_masks,
+	const ComponentHandle* LUMIX_RESTRICT sphere_to_model_instance_map,
+	uint64 layer_mask,
+	CullingSystem::Subresults& results)
+{
+	for (int i = first; visible_mask != 0; ++i, visible_mask >>= 1)
+	{
+		if ((visible_mask & 1) && (layer_masks[i] & layer_mask)) results.push(sphere_to_model_instance_map[i]);
+	}
+}
+
+
+static void cullSpheresScalar(int from,
+	int to,
+	const CullingSpheres& spheres,
+	const Frustum& frustum,
+	const uint64* LUMIX_RESTRICT layer_masks,
+	const ComponentHandle* LUMIX_RESTRICT sphere_to_model_instance_map,
+	uint64 layer_mask,
+	CullingSystem::Subresults& results)
+{
+	CullingPlanes planes(frustum);
+	for (int i = from; i < to; ++i)
+	{
+		if (isSphereOutside(planes, spheres.get(i))) continue;
+		if (layer_masks[i] & layer_mask) results.push(sphere_to_model_instance_map[i]);
+	}
+}
+
+
+static const int PLANES_COUNT = (int)Frustum::Planes::COUNT;
+
+
+// four spheres per iteration, each lane is one sphere
+static int cullSpheres4(int from,
+	int to,
+	const CullingSpheres& spheres,
+	const Frustum& frustum,
+	const uint64* LUMIX_RESTRICT layer_masks,
+	const ComponentHandle* LUMIX_RESTRICT sphere_to_model_instance_map,
+	uint64 layer_mask,
+	CullingSystem::Subresults& results)
+{
+	float4 px[PLANES_COUNT];
+	float4 py[PLANES_COUNT];
+	float4 pz[PLANES_COUNT];
+	float4 pd[PLANES_COUNT];
+	for (int i = 0; i < PLANES_COUNT; ++i)
+	{
+		px[i] = f4Splat(frustum.xs[i]);
+		py[i] = f4Splat(frustum.ys[i]);
+		pz[i] = f4Splat(frustum.zs[i]);
+		pd[i] = f4Splat(frustum.ds[i]);
+	}
+
+	const float* LUMIX_RESTRICT xs = &spheres.x[0];
+	const float* LUMIX_RESTRICT ys = &spheres.y[0];
+	const float* LUMIX_RESTRICT zs = &spheres.z[0];
+	const float* LUMIX_RESTRICT radiuses = &spheres.radius[0];
+	int i = from;
+	for (; i + 4 <= to; i += 4)
+	{
+		float4 x = f4LoadUnaligned(xs + i);
+		float4 y = f4LoadUnaligned(ys + i);
+		float4 z = f4LoadUnaligned(zs + i);
+		float4 r = f4LoadUnaligned(radiuses + i);
+
+		float4 min_distance = f4Add(f4Mul(x, px[0]), f4Mul(y, py[0]));
+		min_distance = f4Add(min_distance, f4Mul(z, pz[0]));
+		min_distance = f4Add(min_distance, f4Add(pd[0], r));
+		for (int j = 1; j < PLANES_COUNT; ++j)
+		{
+			float4 t = f4Add(f4Mul(x, px[j]), f4Mul(y, py[j]));
+			t = f4Add(t, f4Mul(z, pz[j]));
+			t = f4Add(t, f4Add(pd[j], r));
+			min_distance = f4Min(min_distance, t);
+		}
+		int visible_mask = ~f4MoveMask(min_distance) & 0xf;
+		pushVisible(visible_mask, i, layer_masks, sphere_to_model_instance_map, layer_mask, results);
+	}
+	return i;
+}
+
+
+#if LUMIX_SIMD_SSE()
+
+// same as cullSpheres4, but eight spheres per iteration
+LUMIX_AVX2_TARGET static int cullSpheres8(int from,
+	int to,
+	const CullingSpheres& spheres,
+	const Frustum& frustum,
+	const uint64* LUMIX_RESTRICT layer_masks,
+	const ComponentHandle* LUMIX_RESTRICT sphere_to_model_instance_map,
+	uint64 layer_mask,
+	CullingSystem::Subresults& results)
+{
+	float8 px[PLANES_COUNT];
+	float8 py[PLANES_COUNT];
+	float8 pz[PLANES_COUNT];
+	float8 pd[PLANES_COUNT];
+	for (int i = 0; i < PLANES_COUNT; ++i)
+	{
+		px[i] = f8Splat(frustum.xs[i]);
+		py[i] = f8Splat(frustum.ys[i]);
+		pz[i] = f8Splat(frustum.zs[i]);
+		pd[i] = f8Splat(frustum.ds[i]);
+	}
+
+	const float* LUMIX_RESTRICT xs = &spheres.x[0];
+	const float* LUMIX_RESTRICT ys = &spheres.y[0];
+	const float* LUMIX_RESTRICT zs = &spheres.z[0];
+	const float* LUMIX_RESTRICT radiuses = &spheres.radius[0];
+	int i = from;
+	for (; i + 8 <= to; i += 8)
+	{
+		float8 x = f8LoadUnaligned(xs + i);
+		float8 y = f8LoadUnaligned(ys + i);
+		float8 z = f8LoadUnaligned(zs + i);
+		float8 r = f8LoadUnaligned(radiuses + i);
+
+		float8 min_distance = f8Add(f8Mul(x, px[0]), f8Mul(y, py[0]));
+		min_distance = f8Add(min_distance, f8Mul(z, pz[0]));
+		min_distance = f8Add(min_distance, f8Add(pd[0], r));
+		for (int j = 1; j < PLANES_COUNT; ++j)
+		{
+			float8 t = f8Add(f8Mul(x, px[j]), f8Mul(y, py[j]));
+			t = f8Add(t, f8Mul(z, pz[j]));
+			t = f8Add(t, f8Add(pd[j], r));
+			min_distance = f8Min(min_distance, t);
+		}
+		int visible_mask = ~f8MoveMask(min_distance) & 0xff;
+		pushVisible(visible_mask, i, layer_masks, sphere_to_model_instance_map, layer_mask, results);
+	}
+	return i;
+}
+
+#endif
+
+
+static void doCulling(int from,
+	int to,
+	const CullingSpheres& spheres,
+	const Frustum& frustum,
+	const uint64* LUMIX_RESTRICT layer_masks,
+	const ComponentHandle* LUMIX_RESTRICT sphere_to_model_instance_map,
+	uint64 layer_mask,
+	CullingSystem::Subresults& results)
+{
+	PROFILE_FUNCTION();
+	ASSERT(results.empty());
+	PROFILE_INT("objects", to - from);
+
+	int done;
+#if LUMIX_SIMD_SSE()
+	if (isAVX2Supported())
+	{
+		done = cullSpheres8(from, to, spheres, frustum, layer_masks, sphere_to_model_instance_map, layer_mask, results);
+	}
+	else
+#endif
+	{
+		done = cullSpheres4(from, to, spheres, frustum, layer_masks, sphere_to_model_instance_map, layer_mask, results);
+	}
+	cullSpheresScalar(done, to, spheres, frustum, layer_masks, sphere_to_model_instance_map, layer_mask, results);
+}
+
+
+struct CullingTreeNode
+{
+	Vec3 center;
+	Vec3 extents;
+	int first_item;
+	int item_count;
+	int left_child; // -1 for leaves, right child is always left_child + 1
+};
+
+
+struct CullingTreeItem
+{
+	Sphere sphere;
+	uint64 layer_mask; // 0 for items removed since the last rebuild
+	ComponentHandle model_instance;
+	int leaf;
+};
+
+
+enum class NodeVisibility
+{
+	OUTSIDE,
+	PARTIAL,
+	INSIDE
+};
+
+
+static NodeVisibility testNode(const CullingPlanes& planes, const CullingTreeNode& node)
+{
+	float4 cx = f4Splat(node.center.x);
+	float4 cy = f4Splat(node.center.y);
+	float4 cz = f4Splat(node.center.z);
+	float4 ex = f4Splat(node.extents.x);
+	float4 ey = f4Splat(node.extents.y);
+	float4 ez = f4Splat(node.extents.z);
+
+	int partial_mask = 0;
+	for (int i = 0; i < 2; ++i)
+	{
+		float4 distance = f4Mul(cx, planes.x[i]);
+		distance = f4Add(distance, f4Mul(cy, planes.y[i]));
+		distance = f4Add(distance, f4Mul(cz, planes.z[i]));
+		distance = f4Add(distance, planes.d[i]);
+
+		float4 radius = f4Mul(ex, planes.abs_x[i]);
+		radius = f4Add(radius, f4Mul(ey, planes.abs_y[i]));
+		radius = f4Add(radius, f4Mul(ez, planes.abs_z[i]));
+
+		if (f4MoveMask(f4Add(distance, radius))) return NodeVisibility::OUTSIDE;
+		partial_mask |= f4MoveMask(f4Sub(distance, radius));
+	}
+	return partial_mask ? NodeVisibility::PARTIAL : NodeVisibility::INSIDE;
+}
+
+
+// big number instead of infinity for zero, so there are no floating point exceptions in box tests
+static float getInverse(float value)
+{
+	static const float MIN_VALUE = 1e-20f;
+	if (fabsf(value) < MIN_VALUE) return value < 0 ? -1 / MIN_VALUE : 1 / MIN_VALUE;
+	return 1 / value;
+}
+
+
+static bool isHitByRay(const CullingTreeNode& node, const Vec3& origin, const Vec3& inv_dir)
+{
+	float t_min = 0;
+	float t_max = FLT_MAX;
+	for (int i = 0; i < 3; ++i)
+	{
+		float center = (&node.center.x)[i] - (&origin.x)[i];
+		float extent = (&node.extents.x)[i];
+		float t0 = (center - extent) * (&inv_dir.x)[i];
+		float t1 = (center + extent) * (&inv_dir.x)[i];
+		t_min = Math::maximum(t_min, Math::minimum(t0, t1));
+		t_max = Math::minimum(t_max, Math::maximum(t0, t1));
+	}
+	return t_min <= t_max;
+}
+
+
+// dir_sq_length is dotProduct(dir, dir), it's the same for all spheres
+static bool getRaySphereT(const Vec3& origin,
+	const Vec3& dir,
+	float dir_sq_length,
+	const Vec3& center,
+	float radius,
+	float* t)
+{
+	Vec3 rel_origin = origin - center;
+	float c = dotProduct(rel_origin, rel_origin) - radius * radius;
+	if (c <= 0)
+	{
+		*t = 0;
+		return true;
+	}
+	float b = dotProduct(rel_origin, dir);
+	if (b >= 0) return false;
+	float discriminant = b * b - dir_sq_length * c;
+	if (discriminant < 0) return false;
+	*t = (-b - sqrtf(discriminant)) / dir_sq_length;
+	return true;
+}
+
+
+static int compareRayHits(const void* a, const void* b)
+{
+	float t0 = static_cast<const CullingSystem::RayHit*>(a)->t;
+	float t1 = static_cast<const CullingSystem::RayHit*>(b)->t;
+	return t0 < t1 ? -1 : (t0 > t1 ? 1 : 0);
+}
+
+
+static bool isInside(const CullingTreeNode& node, const Sphere& sphere)
+{
+	Vec3 d = sphere.position - node.center;
+	return Math::abs(d.x) + sphere.radius <= node.extents.x && Math::abs(d.y) + sphere.radius <= node.extents.y &&
+		   Math::abs(d.z) + sphere.radius <= node.extents.z;
+}
+
+
+static uint32 getFrustumsMask(int count)
+{
+	return count == CullingSystem::MAX_FRUSTUMS ? 0xffffFFFF : (1U << count) - 1;
+}
+
+
+static uint32 getLayerVisibility(uint64 layer_mask, const uint64* frustum_layer_masks, uint32 frustums)
+{
+	uint32 visibility = 0;
+	for (int i = 0; i < CullingSystem::MAX_FRUSTUMS && (frustums >> i) != 0; ++i)
+	{
+		if ((frustums & (1U << i)) && (layer_mask & frustum_layer_masks[i])) visibility |= 1U << i;
+	}
+	return visibility;
+}
+
+
+static uint32 testSphere(const CullingPlanes* planes,
+	const uint64* frustum_layer_masks,
+	uint32 frustums,
+	const Sphere& sphere,
+	uint64 layer_mask)
+{
+	float4 cx = f4Splat(sphere.position.x);
+	float4 cy = f4Splat(sphere.position.y);
+	float4 cz = f4Splat(sphere.position.z);
+	float4 r = f4Splat(-sphere.radius);
+
+	uint32 visibility = 0;
+	for (int i = 0; i < CullingSystem::MAX_FRUSTUMS && (frustums >> i) != 0; ++i)
+	{
+		if ((frustums & (1U << i)) == 0 || (layer_mask & frustum_layer_masks[i]) == 0) continue;
+		if (!isSphereOutside(planes[i], cx, cy, cz, r)) visibility |= 1U << i;
+	}
+	return visibility;
+}
+
+
+// visible_masks has a bit per lane for each frustum, lanes are spheres from first
+LUMIX_FORCE_INLINE static void pushVisibleMulti(const int* visible_masks,
+	int any_visible,
+	int first,
+	int frustum_count,
+	const uint64* LUMIX_RESTRICT layer_masks,
+	const ComponentHandle* LUMIX_RESTRICT sphere_to_model_instance_map,
+	const uint64* LUMIX_RESTRICT frustum_layer_masks,
+	uint32 all_frustums,
+	CullingSystem::Subresults& results,
+	CullingSystem::VisibilityMasks& visibility_masks)
+{
+	for (int lane = 0; any_visible != 0; ++lane, any_visible >>= 1)
+	{
+		if ((any_visible & 1) == 0) continue;
+		uint32 visibility = 0;
+		for (int frustum_idx = 0; frustum_idx < frustum_count; ++frustum_idx)
+		{
+			visibility |= ((visible_masks[frustum_idx] >> lane) & 1) << frustum_idx;
+		}
+		visibility &= getLayerVisibility(layer_masks[first + lane], frustum_layer_masks, all_frustums);
+		if (!visibility) continue;
+		results.push(sphere_to_model_instance_map[first + lane]);
+		visibility_masks.push(visibility);
+	}
+}
+
+
+// distance of the sphere's farthest point in front of the plane, negative if the sphere is outside
+LUMIX_FORCE_INLINE static float4 getPlaneDistance(const float4* plane, float4 x, float4 y, float4 z, float4 r)
+{
+	float4 t = f4Add(f4Mul(x, plane[0]), f4Mul(y, plane[1]));
+	t = f4Add(t, f4Mul(z, plane[2]));
+	return f4Add(t, f4Add(plane[3], r));
+}
+
+
+// four spheres per iteration tested against all frustums, each lane is one sphere
+static int cullSpheresMulti4(int from,
+	int to,
+	const CullingSpheres& spheres,
+	const uint64* LUMIX_RESTRICT layer_masks,
+	const ComponentHandle* LUMIX_RESTRICT sphere_to_model_instance_map,
+	const Frustum* LUMIX_RESTRICT frustums,
+	const uint64* LUMIX_RESTRICT frustum_layer_masks,
+	int frustum_count,
+	CullingSystem::Subresults& results,
+	CullingSystem::VisibilityMasks& visibility_masks)
+{
+	uint32 all_frustums = getFrustumsMask(frustum_count);
+
+	// x, y, z and d of each plane splatted to all lanes
+	float4 splatted_planes[CullingSystem::MAX_FRUSTUMS * PLANES_COUNT * 4];
+	for (int frustum_idx = 0; frustum_idx < frustum_count; ++frustum_idx)
+	{
+		const Frustum& frustum = frustums[frustum_idx];
+		float4* LUMIX_RESTRICT dst = &splatted_planes[frustum_idx * PLANES_COUNT * 4];
+		for (int j = 0; j < PLANES_COUNT; ++j)
+		{
+			dst[j * 4 + 0] = f4Splat(frustum.xs[j]);
+			dst[j * 4 + 1] = f4Splat(frustum.ys[j]);
+			dst[j * 4 + 2] = f4Splat(frustum.zs[j]);
+			dst[j * 4 + 3] = f4Splat(frustum.ds[j]);
+		}
+	}
+
+	const float* LUMIX_RESTRICT xs = &spheres.x[0];
+	const float* LUMIX_RESTRICT ys = &spheres.y[0];
+	const float* LUMIX_RESTRICT zs = &spheres.z[0];
+	const float* LUMIX_RESTRICT radiuses = &spheres.radius[0];
+	int i = from;
+	for (; i + 4 <= to; i += 4)
+	{
+		float4 x = f4LoadUnaligned(xs + i);
+		float4 y = f4LoadUnaligned(ys + i);
+		float4 z = f4LoadUnaligned(zs + i);
+		float4 r = f4LoadUnaligned(radiuses + i);
+
+		int visible_masks[CullingSystem::MAX_FRUSTUMS];
+		int any_visible = 0;
+		const float4* LUMIX_RESTRICT plane = splatted_planes;
+		for (int frustum_idx = 0; frustum_idx < frustum_count; ++frustum_idx)
+		{
+			float4 min_distance = getPlaneDistance(plane, x, y, z, r);
+			plane += 4;
+			for (int j = 1; j < PLANES_COUNT; ++j, plane += 4)
+			{
+				min_distance = f4Min(min_distance, getPlaneDistance(plane, x, y, z, r));
+			}
+			visible_masks[frustum_idx] = ~f4MoveMask(min_distance) & 0xf;
+			any_visible |= visible_masks[frustum_idx];
+		}
+		if (!any_visible) continue;
+
+		pushVisibleMulti(visible_masks,
+			any_visible,
+			i,
+			frustum_count,
+			layer_masks,
+			sphere_to_model_instance_map,
+			frustum_layer_masks,
+			all_frustums,
+			results,
+			visibility_masks);
+	}
+	return i;
+}
+
+
+#if LUMIX_SIMD_SSE()
+
+LUMIX_AVX2_TARGET LUMIX_FORCE_INLINE static float8 getPlaneDistance8(const float8* plane,
+	float8 x,
+	float8 y,
+	float8 z,
+	float8 r)
+{
+	float8 t = f8Add(f8Mul(x, plane[0]), f8Mul(y, plane[1]));
+	t = f8Add(t, f8Mul(z, plane[2]));
+	return f8Add(t, f8Add(plane[3], r));
+}
+
+
+// same as cullSpheresMulti4, but eight spheres per iteration
+LUMIX_AVX2_TARGET static int cullSpheresMulti8(int from,
+	int to,
+	const CullingSpheres& spheres,
+	const uint64* LUMIX_RESTRICT layer_masks,
+	const ComponentHandle* LUMIX_RESTRICT sphere_to_model_instance_map,
+	const Frustum* LUMIX_RESTRICT frustums,
+	const uint64* LUMIX_RESTRICT frustum_layer_masks,
+	int frustum_count,
+	CullingSystem::Subresults& results,
+	CullingSystem::VisibilityMasks& visibility_masks)
+{
+	uint32 all_frustums = getFrustumsMask(frustum_count);
+
+	float8 splatted_planes[CullingSystem::MAX_FRUSTUMS * PLANES_COUNT * 4];
+	for (int frustum_idx = 0; frustum_idx < frustum_count; ++frustum_idx)
+	{
+		const Frustum& frustum = frustums[frustum_idx];
+		float8* LUMIX_RESTRICT dst = &splatted_planes[frustum_idx * PLANES_COUNT * 4];
+		for (int j = 0; j < PLANES_COUNT; ++j)
+		{
+			dst[j * 4 + 0] = f8Splat(frustum.xs[j]);
+			dst[j * 4 + 1] = f8Splat(frustum.ys[j]);
+			dst[j * 4 + 2] = f8Splat(frustum.zs[j]);
+			dst[j * 4 + 3] = f8Splat(frustum.ds[j]);
+		}
+	}
+
+	const float* LUMIX_RESTRICT xs = &spheres.x[0];
+	const float* LUMIX_RESTRICT ys = &spheres.y[0];
+	const float* LUMIX_RESTRICT zs = &spheres.z[0];
+	const float* LUMIX_RESTRICT radiuses = &spheres.radius[0];
+	int i = from;
+	for (; i + 8 <= to; i += 8)
+	{
+		float8 x = f8LoadUnaligned(xs + i);
+		float8 y = f8LoadUnaligned(ys + i);
+		float8 z = f8LoadUnaligned(zs + i);
+		float8 r = f8LoadUnaligned(radiuses + i);
+
+		int visible_masks[CullingSystem::MAX_FRUSTUMS];
+		int any_visible = 0;
+		const float8* LUMIX_RESTRICT plane = splatted_planes;
+		for (int frustum_idx = 0; frustum_idx < frustum_count; ++frustum_idx)
+		{
+			float8 min_distance = getPlaneDistance8(plane, x, y, z, r);
+			plane += 4;
+			for (int j = 1; j < PLANES_COUNT; ++j, plane += 4)
+			{
+				min_distance = f8Min(min_distance, getPlaneDistance8(plane, x, y, z, r));
+			}
+			visible_masks[frustum_idx] = ~f8MoveMask(min_distance) & 0xff;
+			any_visible |= visible_masks[frustum_idx];
+		}
+		if (!any_visible) continue;
+
+		pushVisibleMulti(visible_masks,
+			any_visible,
+			i,
+			frustum_count,
+			layer_masks,
+			sphere_to_model_instance_map,
+			frustum_layer_masks,
+			all_frustums,
+			results,
+			visibility_masks);
+	}
+	return i;
+}
+
+#endif
+
+
+static void doCullingMulti(int from,
+	int to,
+	const CullingSpheres& spheres,
+	const uint64* LUMIX_RESTRICT layer_masks,
+	const ComponentHandle* LUMIX_RESTRICT sphere_to_model_instance_map,
+	const Frustum* LUMIX_RESTRICT frustums,
+	const CullingPlanes* LUMIX_RESTRICT planes,
+	const uint64* LUMIX_RESTRICT frustum_layer_masks,
+	int frustum_count,
+	CullingSystem::Subresults& results,
+	CullingSystem::VisibilityMasks& visibility_masks)
+{
+	PROFILE_FUNCTION();
+	PROFILE_INT("objects", to - from);
+
+	int done;
+#if LUMIX_SIMD_SSE()
+	if (isAVX2Supported())
+	{
+		done = cullSpheresMulti8(from,
+			to,
+			spheres,
+			layer_masks,
+			sphere_to_model_instance_map,
+			frustums,
+			frustum_layer_masks,
+			frustum_count,
+			results,
+			visibility_masks);
+	}
+	else
+#endif
+	{
+		done = cullSpheresMulti4(from,
+			to,
+			spheres,
+			layer_masks,
+			sphere_to_model_instance_map,
+			frustums,
+			frustum_layer_masks,
+			frustum_count,
+			results,
+			visibility_masks);
+	}
+
+	uint32 all_frustums = getFrustumsMask(frustum_count);
+	for (int i = done; i < to; ++i)
+	{
+		uint32 visibility = testSphere(planes, frustum_layer_masks, all_frustums, spheres.get(i), layer_masks[i]);
+		if (!visibility) continue;
+		results.push(sphere_to_model_instance_map[i]);
+		visibility_masks.push(visibility);
+	}
+}
+
+
+class CullingSystemImpl LUMIX_FINAL : public CullingSystem
+{
+public:
+	struct TreeTask
+	{
+		int node;
+		uint32 partial_frustums;
+		uint32 inside_frustums;
+	};
+
+
+	struct CachedPosition
+	{
+		int subresult; // -1 if the model instance is not in results
+		int index;
+	};
+
+
+	struct CachedView
+	{
+		explicit CachedView(IAllocator& allocator)
+			: results(allocator)
+			, visibility_masks(allocator)
+			, positions(allocator)
+			, frustum_count(0)
+			, is_multi_frustum(false)
+			, is_valid(false)
+			, changes_stamp(0)
+			, last_used(0)
+		{
+			results.emplace(allocator);
+			visibility_masks.emplace(allocator);
+		}
+
+		Frustum frustums[MAX_FRUSTUMS];
+		uint64 layer_masks[MAX_FRUSTUMS];
+		int frustum_count;
+		bool is_multi_frustum;
+		bool is_valid;
+		int changes_stamp; // m_changes before this index are already applied to results
+		uint32 last_used;
+		// split into chunks like a cull result, so consumers of a cache hit can process it in parallel
+		Results results;
+		Array<VisibilityMasks> visibility_masks;
+		Array<CachedPosition> positions; // model instance -> position in results
+	};
+
+
+	CullingSystemImpl(MTJD::Manager& mtjd_manager, IAllocator& allocator, uint32 flags)
+		: m_allocator(allocator)
+		, m_job_allocator(allocator, MTJD::getParallelForMemorySize(mtjd_manager))
+		, m_spheres(allocator)
+		, m_result(allocator)
+		, m_mtjd_manager(mtjd_manager)
+		, m_layer_masks(m_allocator)
+		, m_sphere_to_model_instance_map(m_allocator)
+		, m_model_instance_to_sphere_map(m_allocator)
+		, m_visibility_masks(m_allocator)
+		, m_is_async_result(false)
+		, m_async_frustum_count(0)
+		, m_is_multi_frustum_result(false)
+		, m_is_hierarchical((flags & (uint32)Flags::HIERARCHICAL) != 0)
+		, m_nodes(m_allocator)
+		, m_items(m_allocator)
+		, m_model_instance_to_item(m_allocator)
+		, m_removed_items_count(0)
+		, m_movers(m_allocator)
+		, m_mover_stamps(m_allocator)
+		, m_model_instance_to_mover(m_allocator)
+		, m_cull_stamp(0)
+		, m_tree_tasks(m_allocator)
+		, m_tmp_tree_tasks(m_allocator)
+		, m_is_cache_enabled((flags & (uint32)Flags::TEMPORAL_CACHE) != 0)
+		, m_cached_views(m_allocator)
+		, m_changes(m_allocator)
+		, m_pending_cached_view(nullptr)
+		, m_cache_lookups(0)
+		, m_cache_recent_hits(0)
+	{
+		m_current_result = &m_result;
+		m_current_visibility_masks = &m_visibility_masks;
+		m_result.emplace(m_allocator);
+		m_model_instance_to_sphere_map.reserve(5000);
+		m_sphere_to_model_instance_map.reserve(5000);
+		m_spheres.reserve(5000);
+	}
+
+
+	~CullingSystemImpl()
+	{
+		m_join_handle.join();
+		for (CachedView* view : m_cached_views)
+		{
+			LUMIX_DELETE(m_allocator, view);
+		}
+	}
+
+
+	void clear() override
+	{
+		invalidateCache();
+
+		m_spheres.clear();
+		m_layer_masks.clear();
+		m_model_instance_to_sphere_map.clear();
+		m_sphere_to_model_instance_map.clear();
+
+		m_nodes.clear();
+		m_items.clear();
+		m_model_instance_to_item.clear();
+		m_removed_items_count = 0;
+		m_movers.clear();
+		m_mover_stamps.clear();
+		m_model_instance_to_mover.clear();
+	}
+
+
+	IAllocator& getAllocator() { return m_allocator; }
+
+
+	const Results& getResult() override
+	{
+		if (m_is_async_result)
+		{
+			m_join_handle.join();
+		}
+		fillPendingCachedView();
+		return *m_current_result;
+	}
+
+
+	void cullToFrustum(const Frustum& frustum, uint64 layer_mask) override
+	{
+		m_join_handle.join();
+		fillPendingCachedView();
+		m_is_async_result = false;
+		if (useCachedView(&frustum, 1, &layer_mask, false)) return;
+
+		for (int i = 0; i < m_result.size(); ++i)
+		{
+			m_result[i].clear();
+		}
+
+		if (m_is_hierarchical)
+		{
+			updateTree();
+			CullingPlanes planes(frustum);
+			if (!m_nodes.empty()) cullSubtree(&planes, &layer_mask, {0, 1, 0}, m_result[0], nullptr);
+			cullMovers(&planes, &layer_mask, 1, 0, m_movers.size(), m_result[0], nullptr);
+		}
+		else if (!m_spheres.empty())
+		{
+			doCulling(0,
+				m_spheres.size(),
+				m_spheres,
+				frustum,
+				&m_layer_masks[0],
+				&m_sphere_to_model_instance_map[0],
+				layer_mask,
+				m_result[0]);
+		}
+		fillPendingCachedView();
+	}
+
+
+	static void cullRange(void* data, int from, int to)
+	{
+		auto* that = static_cast<CullingSystemImpl*>(data);
+		int chunk_index = from / that->m_chunk_size;
+		Subresults& results = that->m_result[chunk_index];
+		results.reserve(to - from);
+		if (that->m_is_multi_frustum_result)
+		{
+			CullingPlanes planes[MAX_FRUSTUMS];
+			that->initPlanes(planes);
+			doCullingMulti(from,
+				to,
+				that->m_spheres,
+				&that->m_layer_masks[0],
+				&that->m_sphere_to_model_instance_map[0],
+				that->m_async_frustums,
+				planes,
+				that->m_async_layer_masks,
+				that->m_async_frustum_count,
+				results,
+				that->m_visibility_masks[chunk_index]);
+			return;
+		}
+		doCulling(from,
+			to,
+			that->m_spheres,
+			that->m_async_frustums[0],
+			&that->m_layer_masks[0],
+			&that->m_sphere_to_model_instance_map[0],
+			that->m_async_layer_masks[0],
+			results);
+	}
+
+
+	static void cullTasks(void* data, int from, int to)
+	{
+		PROFILE_FUNCTION();
+		auto* that = static_cast<CullingSystemImpl*>(data);
+		CullingPlanes planes[MAX_FRUSTUMS];
+		that->initPlanes(planes);
+		int tree_tasks_count = that->m_tree_tasks.size();
+		for (int i = from; i < to; ++i)
+		{
+			Subresults& results = that->m_result[i];
+			VisibilityMasks* visibility_masks = that->m_is_multi_frustum_result ? &that->m_visibility_masks[i] : nullptr;
+			if (i < tree_tasks_count)
+			{
+				that->cullSubtree(planes, that->m_async_layer_masks, that->m_tree_tasks[i], results, visibility_masks);
+			}
+			else
+			{
+				int movers_from = (i - tree_tasks_count) * that->m_chunk_size;
+				int movers_to = Math::minimum(movers_from + that->m_chunk_size, that->m_movers.size());
+				that->cullMovers(planes,
+					that->m_async_layer_masks,
+					that->m_async_frustum_count,
+					movers_from,
+					movers_to,
+					results,
+					visibility_masks);
+			}
+		}
+	}
+
+
+	void cullToFrustumAsync(const Frustum& frustum, uint64 layer_mask) override
+	{
+		startAsync(&frustum, 1, &layer_mask, false);
+	}
+
+
+	void cullToFrustums(const Frustum* frustums, int count, const uint64* layer_masks) override
+	{
+		ASSERT(count > 0 && count <= MAX_FRUSTUMS);
+		startAsync(frustums, count, layer_masks, true);
+	}
+
+
+	const Array<VisibilityMasks>& getVisibilityMasks() override
+	{
+		ASSERT(m_is_multi_frustum_result);
+		getResult();
+		return *m_current_visibility_masks;
+	}
+
+
+	void setLayerMask(ComponentHandle model_instance, uint64 layer) override
+	{
+		m_layer_masks[m_model_instance_to_sphere_map[model_instance.index]] = layer;
+		logChange(model_instance);
+		if (m_is_hierarchical)
+		{
+			int item = m_model_instance_to_item[model_instance.index];
+			if (item >= 0) m_items[item].layer_mask = layer;
+		}
+	}
+
+
+	uint64 getLayerMask(ComponentHandle model_instance) override
+	{
+		return m_layer_masks[m_model_instance_to_sphere_map[model_instance.index]];
+	}
+
+
+	bool isAdded(ComponentHandle model_instance) override
+	{
+		return model_instance.index < m_model_instance_to_sphere_map.size() && m_model_instance_to_sphere_map[model_instance.index] != -1;
+	}
+
+
+	void addStatic(ComponentHandle model_instance, const Sphere& sphere, uint64 layer_mask) override
+	{
+		if (model_instance.index < m_model_instance_to_sphere_map.size() &&
+			m_model_instance_to_sphere_map[model_instance.index] != -1)
+		{
+			ASSERT(false);
+			return;
+		}
+
+		m_spheres.push(sphere);
+		m_sphere_to_model_instance_map.push(model_instance);
+		reserveMaps(model_instance);
+		m_model_instance_to_sphere_map[model_instance.index] = m_spheres.size() - 1;
+		m_layer_masks.push(layer_mask);
+		if (m_is_hierarchical) addMover(model_instance, m_cull_stamp - MOVER_SETTLE_CULLS);
+		logChange(model_instance);
+	}
+
+
+	void removeStatic(ComponentHandle model_instance) override
+	{
+		int index = m_model_instance_to_sphere_map[model_instance.index];
+		if (index < 0) return;
+		ASSERT(index < m_spheres.size());
+
+		if (m_is_hierarchical)
+		{
+			if (m_model_instance_to_item[model_instance.index] >= 0)
+			{
+				removeTreeItem(model_instance);
+			}
+			else
+			{
+				removeMover(model_instance);
+			}
+		}
+
+		m_model_instance_to_sphere_map[m_sphere_to_model_instance_map.back().index] = index;
+		m_spheres.eraseFast(index);
+		m_sphere_to_model_instance_map.eraseFast(index);
+		m_layer_masks.eraseFast(index);
+		m_model_instance_to_sphere_map[model_instance.index] = -1;
+		logChange(model_instance);
+	}
+
+
+	void updateBoundingSphere(const Sphere& sphere, ComponentHandle model_instance) override
+	{
+		int idx = m_model_instance_to_sphere_map[model_instance.index];
+		if (idx < 0) return;
+		m_spheres.set(idx, sphere);
+		logChange(model_instance);
+		if (!m_is_hierarchical) return;
+
+		int item_idx = m_model_instance_to_item[model_instance.index];
+		if (item_idx >= 0)
+		{
+			CullingTreeItem& item = m_items[item_idx];
+			if (isInside(m_nodes[item.leaf], sphere))
+			{
+				item.sphere = sphere;
+				return;
+			}
+			removeTreeItem(model_instance);
+			addMover(model_instance, m_cull_stamp);
+			return;
+		}
+		m_mover_stamps[m_model_instance_to_mover[model_instance.index]] = m_cull_stamp;
+	}
+
+
+	void insert(const InputSpheres& spheres, const Array<ComponentHandle>& model_instances) override
+	{
+		for (int i = 0; i < spheres.size(); i++)
+		{
+			m_spheres.push(spheres[i]);
+			reserveMaps(model_instances[i]);
+			m_model_instance_to_sphere_map[model_instances[i].index] = m_spheres.size() - 1;
+			m_sphere_to_model_instance_map.push(model_instances[i]);
+			m_layer_masks.push(1);
+			if (m_is_hierarchical) addMover(model_instances[i], m_cull_stamp - MOVER_SETTLE_CULLS);
+			logChange(model_instances[i]);
+		}
+	}
+
 
-static void doCulling(int start_index,
-	const Sphere* LUMIX_RESTRICT start,
-	const Sphere* LUMIX_RESTRICT end,
-	const Frustum* LUMIX_RESTRICT frustum,
-	const uint64* LUMIX_RESTRICT layer_masks,
-	const ComponentHandle* LUMIX_RESTRICT sphere_to_model_instance_map,
-	uint64 layer_mask,
-	CullingSystem::Subresults& results)
-{
-	PROFILE_FUNCTION();
-	int i = start_index;
-	ASSERT(results.empty());
-	PROFILE_INT("objects", int(end - start));
-	float4 px = f4Load(frustum->xs);
-	float4 py = f4Load(frustum->ys);
-	float4 pz = f4Load(frustum->zs);
-	float4 pd = f4Load(frustum->ds);
-	float4 px2 = f4Load(&frustum->xs[4]);
-	float4 py2 = f4Load(&frustum->ys[4]);
-	float4 pz2 = f4Load(&frustum->zs[4]);
-	float4 pd2 = f4Load(&frustum->ds[4]);
-	
-	for (const Sphere *sphere = start; sphere <= end; sphere++, ++i)
-	{
-		float4 cx = f4Splat(sphere->position.x);
-		float4 cy = f4Splat(sphere->position.y);
-		float4 cz = f4Splat(sphere->position.z);
-		float4 r = f4Splat(-sphere->radius);
-
-		float4 t = f4Mul(cx, px);
-		t = f4Add(t, f4Mul(cy, py));
-		t = f4Add(t, f4Mul(cz, pz));
-		t = f4Add(t, pd);
-		t = f4Sub(t, r);
-		if (f4MoveMask(t)) continue;
-
-		t = f4Mul(cx, px2);
-		t = f4Add(t, f4Mul(cy, py2));
-		t = f4Add(t, f4Mul(cz, pz2));
-		t = f4Add(t, pd2);
-		t = f4Sub(t, r);
-		if (f4MoveMask(t)) continue;
-
-		if(layer_masks[i] & layer_mask) results.push(sphere_to_model_instance_map[i]);
+	Sphere getSphere(ComponentHandle model_instance) override
+	{
+		return m_spheres.get(m_model_instance_to_sphere_map[model_instance.index]);
 	}
-}
 
-class CullingJob LUMIX_FINAL : public MTJD::Job
-{
-public:
-	CullingJob(const CullingSystem::InputSpheres& spheres,
-		const LayerMasks& layer_masks,
-		const SphereToModelInstanceMap& sphere_to_model_instance_map,
-		uint64 layer_mask,
-		CullingSystem::Subresults& results,
-		int start,
-		int end,
-		const Frustum& frustum,
-		MTJD::Manager& manager,
-		IAllocator& allocator,
-		IAllocator& job_allocator)
-		: Job(Job::AUTO_DESTROY, MTJD::Priority::Default, manager, allocator, job_allocator)
-		, m_spheres(spheres)
-		, m_results(results)
-		, m_start(start)
-		, m_end(end)
-		, m_frustum(frustum)
-		, m_layer_masks(layer_masks)
-		, m_layer_mask(layer_mask)
-		, m_sphere_to_model_instance_map(sphere_to_model_instance_map)
-	{
-		setJobName("CullingJob");
-		m_results.reserve(end - start);
-		ASSERT(m_results.empty());
-		m_is_executed = false;
-	}
-
-	~CullingJob() {}
-
-	void execute() override
-	{
-		ASSERT(m_results.empty() && !m_is_executed);
-		doCulling(m_start,
-			&m_spheres[m_start],
-			&m_spheres[m_end],
-			&m_frustum,
-			&m_layer_masks[0],
-			&m_sphere_to_model_instance_map[0],
-			m_layer_mask,
-			m_results);
-		m_is_executed = true;
+
+	void castRay(const Vec3& origin, const Vec3& dir, RayHits& hits) const override
+	{
+		float dir_sq_length = dotProduct(dir, dir);
+		if (dir_sq_length == 0) return;
+
+		int first_hit = hits.size();
+		float t;
+		if (!m_is_hierarchical)
+		{
+			for (int i = 0, c = m_spheres.size(); i < c; ++i)
+			{
+				Vec3 center(m_spheres.x[i], m_spheres.y[i], m_spheres.z[i]);
+				if (getRaySphereT(origin, dir, dir_sq_length, center, m_spheres.radius[i], &t))
+				{
+					hits.push({m_sphere_to_model_instance_map[i], t});
+				}
+			}
+		}
+		else
+		{
+			for (ComponentHandle mover : m_movers)
+			{
+				Sphere sphere = m_spheres.get(m_model_instance_to_sphere_map[mover.index]);
+				if (getRaySphereT(origin, dir, dir_sq_length, sphere.position, sphere.radius, &t))
+				{
+					hits.push({mover, t});
+				}
+			}
+			if (!m_nodes.empty()) castRayTree(origin, dir, dir_sq_length, hits);
+		}
+
+		int count = hits.size() - first_hit;
+		if (count > 1) qsort(&hits[first_hit], count, sizeof(hits[0]), compareRayHits);
 	}
 
-private:
-	const CullingSystem::InputSpheres& m_spheres;
-	CullingSystem::Subresults& m_results;
-	const LayerMasks& m_layer_masks;
-	const SphereToModelInstanceMap& m_sphere_to_model_instance_map;
-	uint64 m_layer_mask;
-	int m_start;
-	int m_end;
-	const Frustum& m_frustum;
-	bool m_is_executed;
-};
 
-class CullingSystemImpl LUMIX_FINAL : public CullingSystem
-{
-public:
-	CullingSystemImpl(MTJD::Manager& mtjd_manager, IAllocator& allocator)
-		: m_allocator(allocator)
-		, m_job_allocator(allocator)
-		, m_spheres(allocator)
-		, m_result(allocator)
-		, m_sync_point(true, allocator)
-		, m_mtjd_manager(mtjd_manager)
-		, m_layer_masks(m_allocator)
-		, m_sphere_to_model_instance_map(m_allocator)
-		, m_model_instance_to_sphere_map(m_allocator)
+private:
+	void reserveMaps(ComponentHandle model_instance)
 	{
-		m_result.emplace(m_allocator);
-		m_model_instance_to_sphere_map.reserve(5000);
-		m_sphere_to_model_instance_map.reserve(5000);
-		m_spheres.reserve(5000);
-		int cpu_count = (int)m_mtjd_manager.getCpuThreadsCount();
-		while (m_result.size() < cpu_count)
+		while (model_instance.index >= m_model_instance_to_sphere_map.size())
 		{
-			m_result.emplace(m_allocator);
+			m_model_instance_to_sphere_map.push(-1);
+		}
+		if (!m_is_hierarchical) return;
+		while (model_instance.index >= m_model_instance_to_item.size())
+		{
+			m_model_instance_to_item.push(-1);
+			m_model_instance_to_mover.push(-1);
 		}
 	}
 
 
-	void clear() override
+	void addMover(ComponentHandle model_instance, uint32 stamp)
 	{
-		m_spheres.clear();
-		m_layer_masks.clear();
-		m_model_instance_to_sphere_map.clear();
-		m_sphere_to_model_instance_map.clear();
+		ASSERT(m_model_instance_to_mover[model_instance.index] < 0);
+		m_model_instance_to_mover[model_instance.index] = m_movers.size();
+		m_movers.push(model_instance);
+		m_mover_stamps.push(stamp);
 	}
 
 
-	IAllocator& getAllocator() { return m_allocator; }
+	void removeMover(ComponentHandle model_instance)
+	{
+		int index = m_model_instance_to_mover[model_instance.index];
+		ASSERT(index >= 0);
+		m_model_instance_to_mover[m_movers.back().index] = index;
+		m_movers.eraseFast(index);
+		m_mover_stamps.eraseFast(index);
+		m_model_instance_to_mover[model_instance.index] = -1;
+	}
 
 
-	const Results& getResult() override
+	void removeTreeItem(ComponentHandle model_instance)
 	{
-		if (m_is_async_result)
+		int index = m_model_instance_to_item[model_instance.index];
+		ASSERT(index >= 0);
+		m_items[index].layer_mask = 0;
+		m_items[index].model_instance = INVALID_COMPONENT;
+		m_model_instance_to_item[model_instance.index] = -1;
+		++m_removed_items_count;
+	}
+
+
+	bool isSettled(int mover) const
+	{
+		return m_cull_stamp - m_mover_stamps[mover] >= MOVER_SETTLE_CULLS;
+	}
+
+
+	void updateTree()
+	{
+		++m_cull_stamp;
+
+		int settled_count = 0;
+		for (int i = 0; i < m_movers.size(); ++i)
 		{
-			m_sync_point.sync();
+			if (isSettled(i)) ++settled_count;
 		}
-		return m_result;
+		int tree_count = m_items.size() - m_removed_items_count;
+		bool too_many_movers = settled_count >= TREE_MIN_CHANGES_TO_REBUILD && settled_count * 8 >= tree_count;
+		bool too_many_removed =
+			m_removed_items_count >= TREE_MIN_CHANGES_TO_REBUILD && m_removed_items_count * 4 >= m_items.size();
+		if (too_many_movers || too_many_removed) rebuildTree();
 	}
 
 
-	void cullToFrustum(const Frustum& frustum, uint64 layer_mask) override
+	void rebuildTree()
 	{
-		for (int i = 0; i < m_result.size(); ++i)
+		PROFILE_FUNCTION();
+		Array<CullingTreeItem> items(m_allocator);
+		items.reserve(m_items.size() - m_removed_items_count + m_movers.size());
+		for (const CullingTreeItem& item : m_items)
 		{
-			m_result[i].clear();
+			if (isValid(item.model_instance)) items.push(item);
 		}
-		if (!m_spheres.empty())
+		for (int i = 0; i < m_movers.size();)
 		{
-			doCulling(0,
-				&m_spheres[0],
-				&m_spheres.back(),
-				&frustum,
-				&m_layer_masks[0],
-				&m_sphere_to_model_instance_map[0],
-				layer_mask,
-				m_result[0]);
+			if (!isSettled(i))
+			{
+				++i;
+				continue;
+			}
+			ComponentHandle model_instance = m_movers[i];
+			int sphere_idx = m_model_instance_to_sphere_map[model_instance.index];
+			items.push({m_spheres.get(sphere_idx), m_layer_masks[sphere_idx], model_instance, -1});
+			removeMover(model_instance);
+		}
+		m_items.swap(items);
+		m_removed_items_count = 0;
+
+		m_nodes.clear();
+		if (m_items.empty()) return;
+		m_nodes.emplace();
+		buildNode(0, 0, m_items.size(), 0);
+		for (int i = 0; i < m_items.size(); ++i)
+		{
+			m_model_instance_to_item[m_items[i].model_instance.index] = i;
 		}
-		m_is_async_result = false;
 	}
 
 
-	void cullToFrustumAsync(const Frustum& frustum, uint64 layer_mask) override
+	void buildNode(int node_idx, int first, int count, int depth)
 	{
-		int count = m_spheres.size();
-		for(auto& i : m_result)
+		const CullingTreeItem* items = &m_items[first];
+		AABB bounds(items[0].sphere.position, items[0].sphere.position);
+		AABB centers = bounds;
+		for (int i = 0; i < count; ++i)
 		{
-			i.clear();
+			const Sphere& sphere = items[i].sphere;
+			Vec3 r(sphere.radius, sphere.radius, sphere.radius);
+			bounds.addPoint(sphere.position - r);
+			bounds.addPoint(sphere.position + r);
+			centers.addPoint(sphere.position);
 		}
 
-		if (count == 0)
+		CullingTreeNode& node = m_nodes[node_idx];
+		node.center = (bounds.min + bounds.max) * 0.5f;
+		node.extents = (bounds.max - bounds.min) * 0.5f;
+		node.first_item = first;
+		node.item_count = count;
+		node.left_child = -1;
+
+		if (count <= TREE_LEAF_SIZE || depth >= TREE_MAX_DEPTH)
 		{
-			m_is_async_result = false;
+			for (int i = first; i < first + count; ++i)
+			{
+				m_items[i].leaf = node_idx;
+			}
 			return;
 		}
 
-		if (count < m_result.size() * MIN_ENTITIES_PER_THREAD)
+		Vec3 size = centers.max - centers.min;
+		int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+		float split = ((&centers.min.x)[axis] + (&centers.max.x)[axis]) * 0.5f;
+
+		int left_count = 0;
+		for (int i = first; i < first + count; ++i)
 		{
-			cullToFrustum(frustum, layer_mask);
-			return;
+			if ((&m_items[i].sphere.position.x)[axis] < split)
+			{
+				if (i != first + left_count)
+				{
+					CullingTreeItem tmp = m_items[i];
+					m_items[i] = m_items[first + left_count];
+					m_items[first + left_count] = tmp;
+				}
+				++left_count;
+			}
 		}
-		m_is_async_result = true;
+		// all centers are in one place
+		if (left_count == 0 || left_count == count) left_count = count / 2;
+
+		int left_child = m_nodes.size();
+		m_nodes.emplace();
+		m_nodes.emplace();
+		m_nodes[node_idx].left_child = left_child;
+		buildNode(left_child, first, left_count, depth + 1);
+		buildNode(left_child + 1, first + left_count, count - left_count, depth + 1);
+	}
+
 
-		int cpu_count = m_mtjd_manager.getCpuThreadsCount();
-		int step = count / cpu_count;
-		int i = 0;
-		CullingJob* jobs[16];
-		ASSERT(lengthOf(jobs) >= cpu_count);
-		for (; i < cpu_count - 1; i++)
+	void castRayTree(const Vec3& origin, const Vec3& dir, float dir_sq_length, RayHits& hits) const
+	{
+		Vec3 inv_dir(getInverse(dir.x), getInverse(dir.y), getInverse(dir.z));
+		int stack[TREE_MAX_DEPTH + 2];
+		int stack_size = 0;
+		stack[stack_size++] = 0;
+		while (stack_size > 0)
 		{
-			m_result[i].clear();
-			CullingJob* cj = LUMIX_NEW(m_job_allocator, CullingJob)(m_spheres,
-				m_layer_masks,
-				m_sphere_to_model_instance_map,
-				layer_mask,
-				m_result[i],
-				i * step,
-				(i + 1) * step - 1,
-				frustum,
-				m_mtjd_manager,
-				m_allocator,
-				m_job_allocator);
-			cj->addDependency(&m_sync_point);
-			jobs[i] = cj;
+			const CullingTreeNode& node = m_nodes[stack[--stack_size]];
+			if (!isHitByRay(node, origin, inv_dir)) continue;
+
+			if (node.left_child >= 0)
+			{
+				stack[stack_size++] = node.left_child + 1;
+				stack[stack_size++] = node.left_child;
+				continue;
+			}
+
+			for (const CullingTreeItem *item = &m_items[node.first_item], *end = item + node.item_count; item != end; ++item)
+			{
+				float t;
+				if (!isValid(item->model_instance)) continue;
+				if (!getRaySphereT(origin, dir, dir_sq_length, item->sphere.position, item->sphere.radius, &t)) continue;
+				hits.push({item->model_instance, t});
+			}
 		}
+	}
 
-		m_result[i].clear();
-		CullingJob* cj = LUMIX_NEW(m_job_allocator, CullingJob)(m_spheres,
-			m_layer_masks,
-			m_sphere_to_model_instance_map,
-			layer_mask,
-			m_result[i],
-			i * step,
-			count - 1,
-			frustum,
-			m_mtjd_manager,
-			m_allocator,
-			m_job_allocator);
-		cj->addDependency(&m_sync_point);
-		jobs[i] = cj;
 
-		for (i = 0; i < cpu_count; ++i)
+	void initPlanes(CullingPlanes* planes) const
+	{
+		for (int i = 0; i < m_async_frustum_count; ++i)
 		{
-			m_mtjd_manager.schedule(jobs[i]);
+			planes[i].set(m_async_frustums[i]);
 		}
 	}
 
 
-	void setLayerMask(ComponentHandle model_instance, uint64 layer) override
+	static void pushVisible(ComponentHandle model_instance,
+		uint32 visibility,
+		Subresults& results,
+		VisibilityMasks* visibility_masks)
 	{
-		m_layer_masks[m_model_instance_to_sphere_map[model_instance.index]] = layer;
+		results.push(model_instance);
+		if (visibility_masks) visibility_masks->push(visibility);
 	}
 
 
-	uint64 getLayerMask(ComponentHandle model_instance) override
+	void cullItems(const CullingPlanes* planes,
+		const uint64* layer_masks,
+		const TreeTask& task,
+		const CullingTreeNode& node,
+		Subresults& results,
+		VisibilityMasks* visibility_masks) const
 	{
-		return m_layer_masks[m_model_instance_to_sphere_map[model_instance.index]];
+		for (const CullingTreeItem *item = &m_items[node.first_item], *end = item + node.item_count; item != end; ++item)
+		{
+			uint32 visibility = getLayerVisibility(item->layer_mask, layer_masks, task.inside_frustums);
+			if (task.partial_frustums)
+			{
+				visibility |= testSphere(planes, layer_masks, task.partial_frustums, item->sphere, item->layer_mask);
+			}
+			if (visibility) pushVisible(item->model_instance, visibility, results, visibility_masks);
+		}
 	}
 
 
-	bool isAdded(ComponentHandle model_instance) override
+	// moves frustums, which fully contain the node, from partial to inside and drops frustums not seeing the node
+	bool testNode(const CullingPlanes* planes, const CullingTreeNode& node, TreeTask* task) const
 	{
-		return model_instance.index < m_model_instance_to_sphere_map.size() && m_model_instance_to_sphere_map[model_instance.index] != -1;
+		uint32 frustums = task->partial_frustums;
+		for (int i = 0; i < MAX_FRUSTUMS && (frustums >> i) != 0; ++i)
+		{
+			uint32 bit = 1U << i;
+			if ((frustums & bit) == 0) continue;
+			NodeVisibility visibility = Lumix::testNode(planes[i], node);
+			if (visibility == NodeVisibility::PARTIAL) continue;
+			task->partial_frustums &= ~bit;
+			if (visibility == NodeVisibility::INSIDE) task->inside_frustums |= bit;
+		}
+		return (task->partial_frustums | task->inside_frustums) != 0;
 	}
 
 
-	void addStatic(ComponentHandle model_instance, const Sphere& sphere, uint64 layer_mask) override
+	void cullSubtree(const CullingPlanes* planes,
+		const uint64* layer_masks,
+		const TreeTask& root,
+		Subresults& results,
+		VisibilityMasks* visibility_masks) const
 	{
-		if (model_instance.index < m_model_instance_to_sphere_map.size() &&
-			m_model_instance_to_sphere_map[model_instance.index] != -1)
+		TreeTask stack[TREE_MAX_DEPTH + 2];
+		int stack_size = 0;
+		stack[stack_size++] = root;
+		while (stack_size > 0)
 		{
-			ASSERT(false);
-			return;
+			TreeTask task = stack[--stack_size];
+			const CullingTreeNode& node = m_nodes[task.node];
+			if (!testNode(planes, node, &task)) continue;
+
+			if (task.partial_frustums == 0 || node.left_child < 0)
+			{
+				cullItems(planes, layer_masks, task, node, results, visibility_masks);
+			}
+			else
+			{
+				stack[stack_size++] = {node.left_child + 1, task.partial_frustums, task.inside_frustums};
+				stack[stack_size++] = {node.left_child, task.partial_frustums, task.inside_frustums};
+			}
 		}
+	}
 
-		m_spheres.push(sphere);
-		m_sphere_to_model_instance_map.push(model_instance);
-		while(model_instance.index >= m_model_instance_to_sphere_map.size())
+
+	void cullMovers(const CullingPlanes* planes,
+		const uint64* layer_masks,
+		int frustum_count,
+		int from,
+		int to,
+		Subresults& results,
+		VisibilityMasks* visibility_masks) const
+	{
+		uint32 frustums = getFrustumsMask(frustum_count);
+		for (int i = from; i < to; ++i)
 		{
-			m_model_instance_to_sphere_map.push(-1);
+			int sphere_idx = m_model_instance_to_sphere_map[m_movers[i].index];
+			uint32 visibility = testSphere(planes, layer_masks, frustums, m_spheres.get(sphere_idx), m_layer_masks[sphere_idx]);
+			if (visibility) pushVisible(m_movers[i], visibility, results, visibility_masks);
 		}
-		m_model_instance_to_sphere_map[model_instance.index] = m_spheres.size() - 1;
-		m_layer_masks.push(layer_mask);
 	}
 
 
-	void removeStatic(ComponentHandle model_instance) override
+	// splits the tree into independent subtrees, breadth first, so each job gets a similar amount of work
+	void collectTreeTasks(const CullingPlanes* planes, int max_tasks)
 	{
-		int index = m_model_instance_to_sphere_map[model_instance.index];
-		if (index < 0) return;
-		ASSERT(index < m_spheres.size());
+		m_tree_tasks.clear();
+		if (m_nodes.empty()) return;
 
-		m_model_instance_to_sphere_map[m_sphere_to_model_instance_map.back().index] = index;
-		m_spheres[index] = m_spheres.back();
-		m_sphere_to_model_instance_map[index] = m_sphere_to_model_instance_map.back();
-		m_layer_masks[index] = m_layer_masks.back();
+		m_tree_tasks.push({0, getFrustumsMask(m_async_frustum_count), 0});
+		bool is_expanded = true;
+		while (is_expanded && m_tree_tasks.size() < max_tasks)
+		{
+			is_expanded = false;
+			m_tmp_tree_tasks.clear();
+			for (TreeTask task : m_tree_tasks)
+			{
+				const CullingTreeNode& node = m_nodes[task.node];
+				if (task.partial_frustums == 0 || node.left_child < 0)
+				{
+					m_tmp_tree_tasks.push(task);
+					continue;
+				}
+				if (!testNode(planes, node, &task)) continue;
+				if (task.partial_frustums == 0)
+				{
+					m_tmp_tree_tasks.push(task);
+					continue;
+				}
+				m_tmp_tree_tasks.push({node.left_child, task.partial_frustums, task.inside_frustums});
+				m_tmp_tree_tasks.push({node.left_child + 1, task.partial_frustums, task.inside_frustums});
+				is_expanded = true;
+			}
+			m_tree_tasks.swap(m_tmp_tree_tasks);
+		}
+	}
 
-		m_spheres.pop();
-		m_sphere_to_model_instance_map.pop();
-		m_layer_masks.pop();
-		m_model_instance_to_sphere_map[model_instance.index] = -1;
+
+	void logChange(ComponentHandle model_instance)
+	{
+		if (!m_is_cache_enabled || m_cached_views.empty()) return;
+		if (m_changes.size() >= MAX_CACHE_CHANGES) invalidateCache();
+		m_changes.push(model_instance);
 	}
 
 
-	void updateBoundingSphere(const Sphere& sphere, ComponentHandle model_instance) override
+	void enableTemporalCache(bool enable) override
 	{
-		int idx = m_model_instance_to_sphere_map[model_instance.index];
-		if (idx >= 0) m_spheres[idx] = sphere;
+		m_join_handle.join();
+		fillPendingCachedView();
+		m_is_cache_enabled = enable;
+		if (!enable) invalidateCache();
 	}
 
 
-	void insert(const InputSpheres& spheres, const Array<ComponentHandle>& model_instances) override
+	void invalidateCache()
 	{
-		for (int i = 0; i < spheres.size(); i++)
+		for (CachedView* view : m_cached_views)
 		{
-			m_spheres.push(spheres[i]);
-			while(m_model_instance_to_sphere_map.size() <= model_instances[i].index)
+			view->is_valid = false;
+		}
+		m_pending_cached_view = nullptr;
+		m_changes.clear();
+	}
+
+
+	CachedView* findCachedView(const Frustum* frustums, int count, const uint64* layer_masks, bool is_multi_frustum)
+	{
+		for (CachedView* view : m_cached_views)
+		{
+			if (!view->is_valid || view->frustum_count != count || view->is_multi_frustum != is_multi_frustum) continue;
+
+			bool is_same = true;
+			for (int i = 0; i < count && is_same; ++i)
 			{
-				m_model_instance_to_sphere_map.push(-1);
+				is_same = view->layer_masks[i] == layer_masks[i] &&
+						  compareMemory(view->frustums[i].xs, frustums[i].xs, sizeof(float) * PLANES_COUNT * 4) == 0;
 			}
-			m_model_instance_to_sphere_map[model_instances[i].index] = m_spheres.size() - 1;
-			m_sphere_to_model_instance_map.push(model_instances[i]);
-			m_layer_masks.push(1);
+			if (is_same) return view;
+		}
+		return nullptr;
+	}
+
+
+	CachedView& getLeastRecentlyUsedView()
+	{
+		if (m_cached_views.size() < MAX_CACHED_VIEWS)
+		{
+			m_cached_views.push(LUMIX_NEW(m_allocator, CachedView)(m_allocator));
+			return *m_cached_views.back();
+		}
+
+		CachedView* lru = m_cached_views[0];
+		for (CachedView* view : m_cached_views)
+		{
+			if (view->last_used < lru->last_used) lru = view;
 		}
+		return *lru;
 	}
 
 
-	const Sphere& getSphere(ComponentHandle model_instance) override
+	int getCacheHitRate() const
 	{
-		return m_spheres[m_model_instance_to_sphere_map[model_instance.index]];
+		int hits = 0;
+		for (uint64 bits = m_cache_recent_hits; bits; bits &= bits - 1) ++hits;
+		return hits * 100 / Math::minimum(m_cache_lookups, (uint32)64);
+	}
+
+
+	// returns true if the result is taken from cache, otherwise the next cull result is stored in cache
+	bool useCachedView(const Frustum* frustums, int count, const uint64* layer_masks, bool is_multi_frustum)
+	{
+		m_current_result = &m_result;
+		m_current_visibility_masks = &m_visibility_masks;
+		if (!m_is_cache_enabled) return false;
+
+		++m_cache_lookups;
+		CachedView* view = findCachedView(frustums, count, layer_masks, is_multi_frustum);
+		m_cache_recent_hits = (m_cache_recent_hits << 1) | (view ? 1 : 0);
+		PROFILE_INT("cache hit rate %", getCacheHitRate());
+		if (view)
+		{
+			view->last_used = m_cache_lookups;
+			updateCachedView(*view);
+			m_current_result = &view->results;
+			m_current_visibility_masks = &view->visibility_masks;
+			return true;
+		}
+
+		view = &getLeastRecentlyUsedView();
+		view->is_valid = false;
+		view->last_used = m_cache_lookups;
+		view->frustum_count = count;
+		view->is_multi_frustum = is_multi_frustum;
+		for (int i = 0; i < count; ++i)
+		{
+			view->frustums[i] = frustums[i];
+			view->layer_masks[i] = layer_masks[i];
+		}
+		view->changes_stamp = m_changes.size();
+		m_pending_cached_view = view;
+		return false;
+	}
+
+
+	void updateCachedView(CachedView& view)
+	{
+		PROFILE_INT("retested spheres", m_changes.size() - view.changes_stamp);
+		if (view.changes_stamp == m_changes.size()) return;
+
+		CullingPlanes planes[MAX_FRUSTUMS];
+		for (int i = 0; i < view.frustum_count; ++i)
+		{
+			planes[i].set(view.frustums[i]);
+		}
+		uint32 all_frustums = getFrustumsMask(view.frustum_count);
+		for (int i = view.changes_stamp; i < m_changes.size(); ++i)
+		{
+			ComponentHandle model_instance = m_changes[i];
+			uint32 visibility = 0;
+			if (isAdded(model_instance))
+			{
+				int idx = m_model_instance_to_sphere_map[model_instance.index];
+				visibility = testSphere(planes, view.layer_masks, all_frustums, m_spheres.get(idx), m_layer_masks[idx]);
+			}
+
+			while (view.positions.size() <= model_instance.index) view.positions.push({-1, -1});
+			CachedPosition pos = view.positions[model_instance.index];
+			if (pos.subresult >= 0)
+			{
+				VisibilityMasks& visibility_masks = view.visibility_masks[pos.subresult];
+				if (visibility)
+				{
+					visibility_masks[pos.index] = visibility;
+					continue;
+				}
+				Subresults& visible = view.results[pos.subresult];
+				view.positions[visible.back().index] = pos;
+				visible.eraseFast(pos.index);
+				visibility_masks.eraseFast(pos.index);
+				view.positions[model_instance.index] = {-1, -1};
+			}
+			else if (visibility)
+			{
+				// new instances go to the smallest chunk, so the chunks stay balanced
+				int subresult = 0;
+				for (int j = 1; j < view.results.size(); ++j)
+				{
+					if (view.results[j].size() < view.results[subresult].size()) subresult = j;
+				}
+				view.positions[model_instance.index] = {subresult, view.results[subresult].size()};
+				view.results[subresult].push(model_instance);
+				view.visibility_masks[subresult].push(visibility);
+			}
+		}
+		view.changes_stamp = m_changes.size();
+	}
+
+
+	void fillPendingCachedView()
+	{
+		if (!m_pending_cached_view) return;
+
+		CachedView& view = *m_pending_cached_view;
+		m_pending_cached_view = nullptr;
+		int count = 0;
+		for (const Subresults& subresults : m_result) count += subresults.size();
+		int chunk_size = MTJD::getChunkSize(m_mtjd_manager, count, MIN_ENTITIES_PER_JOB);
+		int chunk_count = Math::maximum(1, (count + chunk_size - 1) / chunk_size);
+		for (Subresults& visible : view.results)
+		{
+			for (ComponentHandle model_instance : visible)
+			{
+				view.positions[model_instance.index] = {-1, -1};
+			}
+			visible.clear();
+		}
+		for (VisibilityMasks& visibility_masks : view.visibility_masks) visibility_masks.clear();
+		while (view.results.size() > chunk_count) view.results.pop();
+		while (view.visibility_masks.size() > chunk_count) view.visibility_masks.pop();
+		while (view.results.size() < chunk_count) view.results.emplace(m_allocator);
+		while (view.visibility_masks.size() < chunk_count) view.visibility_masks.emplace(m_allocator);
+
+		int subresult = 0;
+		for (int i = 0; i < m_result.size(); ++i)
+		{
+			const Subresults& subresults = m_result[i];
+			for (int j = 0; j < subresults.size(); ++j)
+			{
+				if (view.results[subresult].size() == chunk_size) ++subresult;
+				ComponentHandle model_instance = subresults[j];
+				while (view.positions.size() <= model_instance.index) view.positions.push({-1, -1});
+				view.positions[model_instance.index] = {subresult, view.results[subresult].size()};
+				view.results[subresult].push(model_instance);
+				view.visibility_masks[subresult].push(view.is_multi_frustum ? m_visibility_masks[i][j] : 1);
+			}
+		}
+		view.is_valid = true;
+	}
+
+
+	void startAsync(const Frustum* frustums, int frustum_count, const uint64* layer_masks, bool is_multi_frustum)
+	{
+		m_join_handle.join();
+		fillPendingCachedView();
+		m_is_multi_frustum_result = is_multi_frustum;
+		if (useCachedView(frustums, frustum_count, layer_masks, is_multi_frustum))
+		{
+			m_is_async_result = false;
+			return;
+		}
+
+		for (int i = 0; i < frustum_count; ++i)
+		{
+			m_async_frustums[i] = frustums[i];
+			m_async_layer_masks[i] = layer_masks[i];
+		}
+		m_async_frustum_count = frustum_count;
+		for (auto& i : m_result)
+		{
+			i.clear();
+		}
+		for (auto& i : m_visibility_masks)
+		{
+			i.clear();
+		}
+
+		int count;
+		int grain;
+		MTJD::RangeFunction function;
+		if (m_is_hierarchical)
+		{
+			updateTree();
+
+			CullingPlanes planes[MAX_FRUSTUMS];
+			initPlanes(planes);
+			collectTreeTasks(planes, (m_mtjd_manager.getCpuThreadsCount() + 1) * 4);
+			PROFILE_INT("tree tasks", m_tree_tasks.size());
+
+			m_chunk_size = MTJD::getChunkSize(m_mtjd_manager, m_movers.size(), MIN_ENTITIES_PER_JOB);
+			count = m_tree_tasks.size() + (m_movers.size() + m_chunk_size - 1) / m_chunk_size;
+			grain = 1;
+			function = &cullTasks;
+		}
+		else
+		{
+			count = m_spheres.size();
+			m_chunk_size = MTJD::getChunkSize(m_mtjd_manager, count, MIN_ENTITIES_PER_JOB);
+			grain = MIN_ENTITIES_PER_JOB;
+			function = &cullRange;
+		}
+
+		if (count == 0)
+		{
+			m_is_async_result = false;
+			return;
+		}
+
+		int result_count = m_is_hierarchical ? count : (count + m_chunk_size - 1) / m_chunk_size;
+		while (m_result.size() < result_count)
+		{
+			m_result.emplace(m_allocator);
+		}
+		while (m_visibility_masks.size() < m_result.size())
+		{
+			m_visibility_masks.emplace(m_allocator);
+		}
+
+		m_is_async_result = true;
+		m_join_handle = MTJD::parallelFor(m_mtjd_manager, m_job_allocator, 0, count, grain, function, this);
 	}
 
 
-private:
 	IAllocator& m_allocator;
-	FreeList<CullingJob, 16> m_job_allocator;
-	InputSpheres m_spheres;
+	LIFOAllocator m_job_allocator;
+	CullingSpheres m_spheres;
 	Results m_result;
+	Array<VisibilityMasks> m_visibility_masks;
 	LayerMasks m_layer_masks;
 	ModelInstancetoSphereMap m_model_instance_to_sphere_map;
 	SphereToModelInstanceMap m_sphere_to_model_instance_map;
 
 	MTJD::Manager& m_mtjd_manager;
-	MTJD::Group m_sync_point;
+	MTJD::JoinHandle m_join_handle;
+	Frustum m_async_frustums[MAX_FRUSTUMS];
+	uint64 m_async_layer_masks[MAX_FRUSTUMS];
+	int m_async_frustum_count;
+	int m_chunk_size;
 	bool m_is_async_result;
+	bool m_is_multi_frustum_result;
+
+	bool m_is_hierarchical;
+	Array<CullingTreeNode> m_nodes;
+	Array<CullingTreeItem> m_items;
+	Array<int> m_model_instance_to_item;
+	int m_removed_items_count;
+	Array<ComponentHandle> m_movers;
+	Array<uint32> m_mover_stamps;
+	Array<int> m_model_instance_to_mover;
+	uint32 m_cull_stamp;
+	Array<TreeTask> m_tree_tasks;
+	Array<TreeTask> m_tmp_tree_tasks;
+
+	bool m_is_cache_enabled;
+	Array<CachedView*> m_cached_views;
+	Array<ComponentHandle> m_changes;
+	CachedView* m_pending_cached_view;
+	const Results* m_current_result;
+	const Array<VisibilityMasks>* m_current_visibility_masks;
+	uint32 m_cache_lookups;
+	uint64 m_cache_recent_hits;
 };
 
 
-CullingSystem* CullingSystem::create(MTJD::Manager& mtjd_manager, IAllocator& allocator)
+CullingSystem* CullingSystem::create(MTJD::Manager& mtjd_manager, IAllocator& allocator, uint32 flags)
 {
-	return LUMIX_NEW(allocator, CullingSystemImpl)(mtjd_manager, allocator);
+	return LUMIX_NEW(allocator, CullingSystemImpl)(mtjd_manager, allocator, flags);
 }
 
 
@@ -368,4 +1795,4 @@ void CullingSystem::destroy(CullingSystem& culling_system)
 {
 	LUMIX_DELETE(static_cast<CullingSystemImpl&>(culling_system).getAllocator(), &culling_system);
 }
-}
\ No newline at end of file
+}
@@ -24,11 +24,30 @@ namespace Lumix
 		typedef Array<Sphere> InputSpheres;
 		typedef Array<ComponentHandle> Subresults;
 		typedef Array<Subresults> Results;
+		typedef Array<uint32> VisibilityMasks; // bit i is set if the instance is visible in i-th frustum
+
+		struct RayHit
+		{
+			ComponentHandle model_instance;
+			float t; // where the ray enters the sphere in units of dir, 0 if the origin is inside
+		};
+		typedef Array<RayHit> RayHits;
+
+		static const int MAX_FRUSTUMS = 32;
+
+		enum class Flags : uint32
+		{
+			// static spheres are kept in a bounding volume hierarchy, moving ones in a flat list
+			HIERARCHICAL = 1 << 0,
+			// results of the last few frustums are kept, culling with the same frustum again
+			// only retests spheres which were added, removed or changed since then
+			TEMPORAL_CACHE = 1 << 1
+		};
 
 		CullingSystem() { }
 		virtual ~CullingSystem() { }
 
-		static CullingSystem* create(MTJD::Manager& mtjd_manager, IAllocator& allocator);
+		static CullingSystem* create(MTJD::Manager& mtjd_manager, IAllocator& allocator, uint32 flags = 0);
 		static void destroy(CullingSystem& culling_system);
 
 		virtual void clear() = 0;
@@ -36,6 +55,12 @@ namespace Lumix
 
 		virtual void cullToFrustum(const Frustum& frustum, uint64 layer_mask) = 0;
 		virtual void cullToFrustumAsync(const Frustum& frustum, uint64 layer_mask) = 0;
+		// culls against all frustums in one pass, getResult() contains instances visible in at least one of them,
+		// getVisibilityMasks() has the same layout and tells in which frustums each instance is visible
+		virtual void cullToFrustums(const Frustum* frustums, int count, const uint64* layer_masks) = 0;
+		virtual const Array<VisibilityMasks>& getVisibilityMasks() = 0;
+		// same as creating the system with Flags::TEMPORAL_CACHE
+		virtual void enableTemporalCache(bool enable) = 0;
 
 		virtual bool isAdded(ComponentHandle model_instance) = 0;
 		virtual void addStatic(ComponentHandle model_instance, const Sphere& sphere, uint64 layer_mask) = 0;
@@ -47,6 +72,10 @@ namespace Lumix
 		virtual void updateBoundingSphere(const Sphere& sphere, ComponentHandle model_instance) = 0;
 
 		virtual void insert(const InputSpheres& spheres, const Array<ComponentHandle>& model_instances) = 0;
-		virtual const Sphere& getSphere(ComponentHandle model_instance) = 0;
+		virtual Sphere getSphere(ComponentHandle model_instance) = 0;
+
+		// appends instances whose spheres the ray hits to hits, sorted by t; it does not modify anything,
+		// so it can run on several threads at once while no instance is added, removed or moved
+		virtual void castRay(const Vec3& origin, const Vec3& dir, RayHits& hits) const = 0;
 	};
 } // ~namespace Lux
\ No newline at end of file
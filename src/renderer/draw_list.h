@@ -0,0 +1,80 @@
+#pragma once
+
+
+#include "engine/lumix.h"
+#include "engine/array.h"
+#include "engine/math_utils.h"
+#include "engine/matrix.h"
+#include "renderer/render_scene.h"
+#include <bgfx/bgfx.h>
+
+
+namespace Lumix
+{
+
+
+struct DrawCommand
+{
+	// range of the sorted draw list
+	int first;
+	int count;
+	// nullptr if the instance data could not be allocated or the mesh is not rigid
+	const bgfx::InstanceDataBuffer* instances;
+	bool is_rigid;
+};
+
+
+struct DrawList
+{
+	explicit DrawList(IAllocator& allocator)
+		: meshes(allocator)
+		, order(allocator)
+		, commands(allocator)
+	{
+	}
+
+	Array<const ModelInstanceMesh*> meshes;
+	// indices to meshes, sorted
+	Array<int> order;
+	Array<DrawCommand> commands;
+};
+
+
+// finds the command containing the draw list item, commands cover the sorted draw list without gaps
+inline int findDrawCommand(const Array<DrawCommand>& commands, int item)
+{
+	int from = 0;
+	int to = commands.size() - 1;
+	while (from < to)
+	{
+		int mid = (from + to + 1) >> 1;
+		if (commands[mid].first <= item) from = mid;
+		else to = mid - 1;
+	}
+	return from;
+}
+
+
+// instances of items [from, to) of the sorted draw list, called from jobs, so any range can start
+// in the middle of a command
+inline void fillInstances(const DrawList& list, const ModelInstance* model_instances, int from, int to)
+{
+	for (int cmd_idx = findDrawCommand(list.commands, from), i = from; i < to; ++cmd_idx)
+	{
+		const DrawCommand& cmd = list.commands[cmd_idx];
+		int end = Math::minimum(cmd.first + cmd.count, to);
+		if (!cmd.instances)
+		{
+			i = end;
+			continue;
+		}
+		Matrix* dst = (Matrix*)cmd.instances->data;
+		for (; i < end; ++i)
+		{
+			dst[i - cmd.first] = model_instances[list.meshes[list.order[i]]->model_instance.index].matrix;
+		}
+	}
+}
+
+
+} // namespace Lumix
@@ -1,5 +1,6 @@
 #include "import_asset_dialog.h"
 #include "animation/animation.h"
+#include "animation/animation_quantization.h"
 #include "assimp/DefaultLogger.hpp"
 #include "assimp/ProgressHandler.hpp"
 #include "assimp/postprocess.h"
@@ -133,6 +134,11 @@ int setParams(lua_State* L)
 		dlg->m_model.remove_doubles = LuaWrapper::toType<bool>(L, -1);
 	}
 	lua_pop(L, 1);
+	if (lua_getfield(L, 2, "occluder") == LUA_TBOOLEAN)
+	{
+		dlg->m_model.is_occluder = LuaWrapper::toType<bool>(L, -1);
+	}
+	lua_pop(L, 1);
 	if (lua_getfield(L, 2, "scale") == LUA_TNUMBER)
 	{
 		dlg->m_model.mesh_scale = LuaWrapper::toType<float>(L, -1);
@@ -143,6 +149,11 @@ int setParams(lua_State* L)
 		dlg->m_model.time_scale = LuaWrapper::toType<float>(L, -1);
 	}
 	lua_pop(L, 1);
+	if (lua_getfield(L, 2, "quantize_animations") == LUA_TBOOLEAN)
+	{
+		dlg->m_model.quantize_animations = LuaWrapper::toType<bool>(L, -1);
+	}
+	lua_pop(L, 1);
 	if (lua_getfield(L, 2, "to_dds") == LUA_TBOOLEAN)
 	{
 		dlg->m_convert_to_dds = LuaWrapper::toType<bool>(L, -1);
@@ -1255,7 +1266,8 @@ struct ConvertTask LUMIX_FINAL : public MT::Task
 				? 25
 				: (animation->mTicksPerSecond == 1 ? 30 : animation->mTicksPerSecond));
 			header.magic = Animation::HEADER_MAGIC;
-			header.version = 2;
+			bool quantize = m_dialog.m_model.quantize_animations;
+			header.version = uint32(quantize ? Animation::Version::LAST : Animation::Version::QUANTIZATION);
 
 			file.write(&header, sizeof(header));
 			float anim_length = getLength(animation);
@@ -1266,6 +1278,7 @@ struct ConvertTask LUMIX_FINAL : public MT::Task
 
 			Array<aiVectorKey> positions(m_dialog.m_editor.getAllocator());
 			Array<aiQuatKey> rotations(m_dialog.m_editor.getAllocator());
+			Array<Vec3> out_positions(m_dialog.m_editor.getAllocator());
 			for (unsigned int channel_idx = 0; channel_idx < animation->mNumChannels; ++channel_idx)
 			{
 				const aiNodeAnim* channel = animation->mChannels[channel_idx];
@@ -1285,6 +1298,7 @@ struct ConvertTask LUMIX_FINAL : public MT::Task
 					uint16 frame = uint16(pos.mTime * m_dialog.m_model.time_scale);
 					file.write(&frame, sizeof(frame));
 				}
+				out_positions.clear();
 				for (const auto& pos : positions)
 				{
 					Vec3 out_pos(pos.mValue.x, pos.mValue.y, pos.mValue.z);
@@ -1292,10 +1306,28 @@ struct ConvertTask LUMIX_FINAL : public MT::Task
 					out_pos.x *= scale.x;
 					out_pos.y *= scale.y;
 					out_pos.z *= scale.z;
-					out_pos = fixOrientation(out_pos);
-					file.write(&out_pos, sizeof(out_pos));
+					out_positions.push(fixOrientation(out_pos));
+				}
+				if (quantize)
+				{
+					Vec3 min(0, 0, 0);
+					Vec3 step(0, 0, 0);
+					if (count > 0) getQuantizationRange(&out_positions[0], count, &min, &step);
+					file.write(&min, sizeof(min));
+					file.write(&step, sizeof(step));
+					for (const Vec3& pos : out_positions)
+					{
+						uint16 quantized[3];
+						quantizePosition(pos, min, step, quantized);
+						file.write(quantized, sizeof(quantized));
+					}
+				}
+				else if (count > 0)
+				{
+					file.write(&out_positions[0], sizeof(out_positions[0]) * count);
 				}
-				
+
+
 				compressRotations(rotations, channel, anim_length, m_dialog.m_model.rotation_error / 100000.0f);
 				count = rotations.size();
 				file.write(&count, sizeof(count));
@@ -1308,7 +1340,16 @@ struct ConvertTask LUMIX_FINAL : public MT::Task
 				{
 					Quat out_rot(rot.mValue.x, rot.mValue.y, rot.mValue.z, rot.mValue.w);
 					out_rot = fixOrientation(out_rot);
-					file.write(&out_rot, sizeof(out_rot));
+					if (quantize)
+					{
+						uint16 quantized[3];
+						quantizeRotation(out_rot, quantized);
+						file.write(quantized, sizeof(quantized));
+					}
+					else
+					{
+						file.write(&out_rot, sizeof(out_rot));
+					}
 				}
 			}
 
@@ -2242,6 +2283,7 @@ struct ConvertTask LUMIX_FINAL : public MT::Task
 		header.version = (uint32)Model::FileVersion::LATEST;
 		file.write((const char*)&header, sizeof(header));
 		uint32 flags = areIndices16Bit() ? (uint32)Model::Flags::INDICES_16BIT : 0;
+		if (m_dialog.m_model.is_occluder) flags |= (uint32)Model::Flags::OCCLUDER;
 		file.write((const char*)&flags, sizeof(flags));
 
 		const aiMesh* mesh = nullptr;
@@ -2348,6 +2390,7 @@ ImportAssetDialog::ImportAssetDialog(StudioApp& app)
 	, m_animations(app.getWorldEditor()->getAllocator())
 {
 	m_model.make_convex = false;
+	m_model.is_occluder = false;
 	m_model.all_nodes = false;
 	m_model.mesh_scale = 1;
 	m_model.remove_doubles = false;
@@ -2360,6 +2403,7 @@ ImportAssetDialog::ImportAssetDialog(StudioApp& app)
 	m_model.position_error = 100.0f;
 	m_model.rotation_error = 10.0f;
 	m_model.time_scale = 1.0f;
+	m_model.quantize_animations = true;
 	m_is_opened = false;
 	m_message[0] = '\0';
 	m_import_message[0] = '\0';
@@ -2716,6 +2760,7 @@ void ImportAssetDialog::onAnimationsGUI()
 	ImGui::DragFloat("Time scale", &m_model.time_scale, 1.0f, 0, FLT_MAX, "%.5f");
 	ImGui::DragFloat("Max position error", &m_model.position_error, 0, FLT_MAX);
 	ImGui::DragFloat("Max rotation error", &m_model.rotation_error, 0, FLT_MAX);
+	ImGui::Checkbox("Quantize", &m_model.quantize_animations);
 
 	ImGui::Indent();
 	ImGui::Columns(2);
@@ -3225,6 +3270,8 @@ void ImportAssetDialog::onWindowGUI()
 				ImGui::DragFloat("Scale", &m_model.mesh_scale, 0.01f, 0.001f, 0);
 				ImGui::Combo("Orientation", &(int&)m_model.orientation, "Y up\0Z up\0-Z up\0-X up\0");
 				ImGui::Checkbox("Make physics convex", &m_model.make_convex);
+				ImGui::Checkbox("Occluder", &m_model.is_occluder);
+				if (ImGui::IsItemHovered()) ImGui::SetTooltip("%s", "LOD 0 hides objects behind it in software occlusion culling");
 			}
 
 			onMeshesGUI();
@@ -157,10 +157,12 @@ class ImportAssetDialog LUMIX_FINAL : public StudioApp::IPlugin
 			bool remove_doubles;
 			Orientation orientation;
 			bool make_convex;
+			bool is_occluder;
 			bool all_nodes;
 			float position_error;
 			float rotation_error;
 			float time_scale;
+			bool quantize_animations;
 		} m_model;
 
 		float m_progress_fraction;
@@ -378,6 +378,7 @@ struct ModelPlugin LUMIX_FINAL : public AssetBrowser::IPlugin
 
 		auto mesh_entity = m_universe->createEntity({ 0, 0, 0 }, { 0, 0, 0, 1 });
 		auto* render_scene = static_cast<RenderScene*>(m_universe->getScene(RENDERER_HASH));
+		render_scene->enableTemporalCulling(true);
 		m_mesh = render_scene->createComponent(MODEL_INSTANCE_TYPE, mesh_entity);
 		
 		auto light_entity = m_universe->createEntity({ 0, 0, 0 }, { 0, 0, 0, 1 });
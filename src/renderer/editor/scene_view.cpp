@@ -202,8 +202,9 @@ void SceneView::shutdown()
 
 void SceneView::onUniverseCreated()
 {
-	auto* scene = m_editor->getUniverse()->getScene(Lumix::crc32("renderer"));
-	m_pipeline->setScene(static_cast<Lumix::RenderScene*>(scene));
+	auto* scene = static_cast<Lumix::RenderScene*>(m_editor->getUniverse()->getScene(Lumix::crc32("renderer")));
+	if (scene) scene->enableTemporalCulling(true);
+	m_pipeline->setScene(scene);
 }
 
 
@@ -504,6 +505,7 @@ void SceneView::onGUI()
 		{
 			const auto& stats = m_pipeline->getStats();
 			ImGui::LabelText("Draw calls", "%d", stats.draw_call_count);
+			ImGui::LabelText("Saved draw calls", "%d", stats.saved_draw_call_count);
 			ImGui::LabelText("Instances", "%d", stats.instance_count);
 			char buf[30];
 			Lumix::toCStringPretty(stats.triangle_count, buf, Lumix::lengthOf(buf));
@@ -560,6 +560,8 @@ private:
 	{
 		auto texture = getDestinationTexture();
 		int bpp = texture->bytes_per_pixel;
+		// grass jobs read the heightmap and the splatmap, they must finish before the data change
+		static_cast<Lumix::RenderScene*>(m_terrain.scene)->forceGrassUpdate(m_terrain.handle);
 
 		for (int j = m_y; j < m_y + m_height; ++j)
 		{
@@ -573,7 +575,6 @@ private:
 			}
 		}
 		texture->onDataUpdated(m_x, m_y, m_width, m_height);
-		static_cast<Lumix::RenderScene*>(m_terrain.scene)->forceGrassUpdate(m_terrain.handle);
 
 		if (m_action_type != TerrainEditor::LAYER && m_action_type != TerrainEditor::COLOR &&
 			m_action_type != TerrainEditor::ADD_GRASS && m_action_type != TerrainEditor::REMOVE_GRASS)
@@ -0,0 +1,105 @@
+#pragma once
+
+
+#include "engine/lumix.h"
+#include "engine/math_utils.h"
+#include "engine/matrix.h"
+#include "engine/vec.h"
+#include "renderer/render_scene.h"
+#include <cmath>
+
+
+namespace Lumix
+{
+
+
+// used by both terrain jobs and the pipeline, so everything is inline
+
+
+static const float GRASS_MAX_SCALE = 2.0f;
+static const float GRASS_QUANTIZED_POSITION_MAX = 65535.0f;
+static const float GRASS_QUANTIZED_NORMAL_MAX = 127.0f;
+
+
+// a blade of grass as terrains keep it, 10 bytes instead of a matrix and a normal,
+// it is expanded to GrassInfo::InstanceData when it is drawn
+struct GrassInstance
+{
+	uint16 pos[3]; // in the range of its patch, pos_min + pos * pos_step
+	uint8 yaw; // 2 * PI / 256 steps
+	uint8 scale; // GRASS_MAX_SCALE / 255 steps
+	int8 normal[2]; // x and z, y of terrain normals is always positive
+};
+
+
+inline uint16 quantizeGrassPosition(float value, float min, float step)
+{
+	if (step <= 0) return 0;
+	float q = (value - min) / step + 0.5f;
+	return (uint16)Math::clamp(q, 0.0f, GRASS_QUANTIZED_POSITION_MAX);
+}
+
+
+inline void packGrassInstance(const Vec3& pos,
+	float yaw,
+	float scale,
+	const Vec3& normal,
+	const Vec3& pos_min,
+	const Vec3& pos_step,
+	GrassInstance* out)
+{
+	out->pos[0] = quantizeGrassPosition(pos.x, pos_min.x, pos_step.x);
+	out->pos[1] = quantizeGrassPosition(pos.y, pos_min.y, pos_step.y);
+	out->pos[2] = quantizeGrassPosition(pos.z, pos_min.z, pos_step.z);
+	out->yaw = uint8(int(yaw * (256 / (Math::PI * 2)) + 0.5f) & 0xff);
+	out->scale = (uint8)Math::clamp(scale * (255 / GRASS_MAX_SCALE) + 0.5f, 0.0f, 255.0f);
+	float nx = Math::clamp(normal.x * GRASS_QUANTIZED_NORMAL_MAX, -GRASS_QUANTIZED_NORMAL_MAX, GRASS_QUANTIZED_NORMAL_MAX);
+	float nz = Math::clamp(normal.z * GRASS_QUANTIZED_NORMAL_MAX, -GRASS_QUANTIZED_NORMAL_MAX, GRASS_QUANTIZED_NORMAL_MAX);
+	out->normal[0] = (int8)(nx < 0 ? nx - 0.5f : nx + 0.5f);
+	out->normal[1] = (int8)(nz < 0 ? nz - 0.5f : nz + 0.5f);
+}
+
+
+// the same as matrix * translation(pos) * rotationY(yaw) * scale and the normal
+inline void expandGrassInstances(const GrassInstance* instances,
+	int count,
+	const Matrix& matrix,
+	const Vec3& pos_min,
+	const Vec3& pos_step,
+	GrassInfo::InstanceData* out)
+{
+	Vec3 x_axis = matrix.getXVector();
+	Vec3 y_axis = matrix.getYVector();
+	Vec3 z_axis = matrix.getZVector();
+	Vec3 origin = matrix.transform(pos_min);
+	Vec3 x_step = x_axis * pos_step.x;
+	Vec3 y_step = y_axis * pos_step.y;
+	Vec3 z_step = z_axis * pos_step.z;
+	const float yaw_step = Math::PI * 2 / 256;
+	const float scale_step = GRASS_MAX_SCALE / 255;
+	const float normal_step = 1 / GRASS_QUANTIZED_NORMAL_MAX;
+
+	for (int i = 0; i < count; ++i)
+	{
+		const GrassInstance& instance = instances[i];
+		float scale = instance.scale * scale_step;
+		float yaw = instance.yaw * yaw_step;
+		float c = cosf(yaw) * scale;
+		float s = sinf(yaw) * scale;
+
+		Matrix& mtx = out[i].matrix;
+		mtx.setXVector(x_axis * c - z_axis * s);
+		mtx.setYVector(y_axis * scale);
+		mtx.setZVector(x_axis * s + z_axis * c);
+		mtx.setTranslation(origin + x_step * instance.pos[0] + y_step * instance.pos[1] + z_step * instance.pos[2]);
+		mtx.m14 = mtx.m24 = mtx.m34 = 0;
+		mtx.m44 = 1;
+
+		float nx = instance.normal[0] * normal_step;
+		float nz = instance.normal[1] * normal_step;
+		out[i].normal.set(nx, sqrtf(Math::maximum(1 - nx * nx - nz * nz, 0.0f)), nz, 0);
+	}
+}
+
+
+} // namespace Lumix
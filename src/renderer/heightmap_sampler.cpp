@@ -0,0 +1,174 @@
+#include "heightmap_sampler.h"
+#include "engine/math_utils.h"
+#include "engine/simd.h"
+
+
+namespace Lumix
+{
+
+
+HeightmapSampler::HeightmapSampler(const uint16* data, int width, int height, const Vec3& scale)
+	: data(data)
+	, width(width)
+	, height(height)
+	, scale(scale)
+{
+}
+
+
+float HeightmapSampler::getSample(int x, int z) const
+{
+	return data[Math::clamp(x, 0, width - 1) + Math::clamp(z, 0, height - 1) * width];
+}
+
+
+float HeightmapSampler::getHeight(int x, int z) const
+{
+	const float DIV64K = 1.0f / 65535.0f;
+	return scale.y * DIV64K * getSample(x, z);
+}
+
+
+float HeightmapSampler::getHeight(float x, float z) const
+{
+	float inv_scale = 1.0f / scale.x;
+	int int_x = (int)(x * inv_scale);
+	int int_z = (int)(z * inv_scale);
+	float dec_x = (x - (int_x * scale.x)) * inv_scale;
+	float dec_z = (z - (int_z * scale.x)) * inv_scale;
+	if (dec_z == 0 && dec_x == 0)
+	{
+		return getHeight(int_x, int_z);
+	}
+	else if (dec_x > dec_z)
+	{
+		float h0 = getHeight(int_x, int_z);
+		float h1 = getHeight(int_x + 1, int_z);
+		float h2 = getHeight(int_x + 1, int_z + 1);
+		return h0 + (h1 - h0) * dec_x + (h2 - h1) * dec_z;
+	}
+	else
+	{
+		float h0 = getHeight(int_x, int_z);
+		float h1 = getHeight(int_x + 1, int_z + 1);
+		float h2 = getHeight(int_x, int_z + 1);
+		return h0 + (h2 - h0) * dec_z + (h1 - h2) * dec_x;
+	}
+}
+
+
+Vec3 HeightmapSampler::getNormal(float x, float z) const
+{
+	int int_x = (int)(x / scale.x);
+	int int_z = (int)(z / scale.x);
+	float dec_x = (x - (int_x * scale.x)) / scale.x;
+	float dec_z = (z - (int_z * scale.x)) / scale.x;
+	if (dec_x > dec_z)
+	{
+		float h0 = getHeight(int_x, int_z);
+		float h1 = getHeight(int_x + 1, int_z);
+		float h2 = getHeight(int_x + 1, int_z + 1);
+		return crossProduct(Vec3(scale.x, h2 - h0, scale.x), Vec3(scale.x, h1 - h0, 0)).normalized();
+	}
+	else
+	{
+		float h0 = getHeight(int_x, int_z);
+		float h1 = getHeight(int_x + 1, int_z + 1);
+		float h2 = getHeight(int_x, int_z + 1);
+		return crossProduct(Vec3(0, h2 - h0, scale.x), Vec3(scale.x, h1 - h0, scale.x)).normalized();
+	}
+}
+
+
+void HeightmapSampler::getHeights(const Vec2* positions, int count, float* heights) const
+{
+	float inv_scale = 1.0f / scale.x;
+	float height_scale = scale.y / 65535.0f;
+	for (int i = 0; i < count; ++i)
+	{
+		int int_x = (int)(positions[i].x * inv_scale);
+		int int_z = (int)(positions[i].y * inv_scale);
+		float dec_x = positions[i].x * inv_scale - int_x;
+		float dec_z = positions[i].y * inv_scale - int_z;
+		float h0 = getSample(int_x, int_z);
+		if (dec_x > dec_z)
+		{
+			float h1 = getSample(int_x + 1, int_z);
+			float h2 = getSample(int_x + 1, int_z + 1);
+			heights[i] = (h0 + (h1 - h0) * dec_x + (h2 - h1) * dec_z) * height_scale;
+		}
+		else
+		{
+			float h1 = getSample(int_x + 1, int_z + 1);
+			float h2 = getSample(int_x, int_z + 1);
+			heights[i] = (h0 + (h2 - h0) * dec_z + (h1 - h2) * dec_x) * height_scale;
+		}
+	}
+}
+
+
+void HeightmapSampler::getHeightsAndNormals(const Vec2* positions, int count, float* heights, Vec3* normals) const
+{
+	float inv_scale = 1.0f / scale.x;
+	float4 height_scale = f4Splat(scale.y / 65535.0f);
+	float4 xz_scale = f4Splat(scale.x);
+	float4 zero = f4Splat(0);
+	for (int i = 0; i < count; i += 4)
+	{
+		// the triangle is picked and its slopes are fetched per position,
+		// heights and normals are computed for all four at once
+		float LUMIX_ALIGN_BEGIN(16) h0[4] LUMIX_ALIGN_END(16);
+		float LUMIX_ALIGN_BEGIN(16) slope_x[4] LUMIX_ALIGN_END(16);
+		float LUMIX_ALIGN_BEGIN(16) slope_z[4] LUMIX_ALIGN_END(16);
+		float LUMIX_ALIGN_BEGIN(16) dec_x[4] LUMIX_ALIGN_END(16);
+		float LUMIX_ALIGN_BEGIN(16) dec_z[4] LUMIX_ALIGN_END(16);
+		int lanes = Math::minimum(4, count - i);
+		for (int j = 0; j < 4; ++j)
+		{
+			const Vec2& pos = positions[i + Math::minimum(j, lanes - 1)];
+			int int_x = (int)(pos.x * inv_scale);
+			int int_z = (int)(pos.y * inv_scale);
+			dec_x[j] = pos.x * inv_scale - int_x;
+			dec_z[j] = pos.y * inv_scale - int_z;
+			h0[j] = getSample(int_x, int_z);
+			if (dec_x[j] > dec_z[j])
+			{
+				float h1 = getSample(int_x + 1, int_z);
+				float h2 = getSample(int_x + 1, int_z + 1);
+				slope_x[j] = h1 - h0[j];
+				slope_z[j] = h2 - h1;
+			}
+			else
+			{
+				float h1 = getSample(int_x, int_z + 1);
+				float h2 = getSample(int_x + 1, int_z + 1);
+				slope_x[j] = h2 - h1;
+				slope_z[j] = h1 - h0[j];
+			}
+		}
+
+		float4 sx = f4Mul(f4Load(slope_x), height_scale);
+		float4 sz = f4Mul(f4Load(slope_z), height_scale);
+		float4 height = f4Add(f4Mul(f4Load(h0), height_scale),
+			f4Add(f4Mul(sx, f4Load(dec_x)), f4Mul(sz, f4Load(dec_z))));
+		// normal of the triangle is (-slope_x, xz_scale, -slope_z) normalized
+		float4 length = f4Sqrt(f4Add(f4Add(f4Mul(sx, sx), f4Mul(sz, sz)), f4Mul(xz_scale, xz_scale)));
+		float4 nx = f4Div(f4Sub(zero, sx), length);
+		float4 ny = f4Div(xz_scale, length);
+		float4 nz = f4Div(f4Sub(zero, sz), length);
+
+		float LUMIX_ALIGN_BEGIN(16) out[4][4] LUMIX_ALIGN_END(16);
+		f4Store(out[0], height);
+		f4Store(out[1], nx);
+		f4Store(out[2], ny);
+		f4Store(out[3], nz);
+		for (int j = 0; j < lanes; ++j)
+		{
+			heights[i + j] = out[0][j];
+			normals[i + j].set(out[1][j], out[2][j], out[3][j]);
+		}
+	}
+}
+
+
+} // namespace Lumix
@@ -0,0 +1,36 @@
+#pragma once
+
+
+#include "engine/lumix.h"
+#include "engine/vec.h"
+
+
+namespace Lumix
+{
+
+
+// Heights and normals of a 16-bit heightmap in terrain space. Quad (x, z) is split into two triangles along its
+// diagonal, heights are interpolated on the triangle the position is in. Samples out of the heightmap are clamped
+// to its edges. Only wraps the data, so it is cheap to create for each query.
+struct LUMIX_RENDERER_API HeightmapSampler
+{
+	HeightmapSampler(const uint16* data, int width, int height, const Vec3& scale);
+
+	// raw height
+	float getSample(int x, int z) const;
+	float getHeight(int x, int z) const;
+	float getHeight(float x, float z) const;
+	Vec3 getNormal(float x, float z) const;
+	// the same as getHeight(float, float) for each of count positions (x, z in terrain space)
+	void getHeights(const Vec2* positions, int count, float* heights) const;
+	// the same as getHeight(float, float) and getNormal, four positions at once
+	void getHeightsAndNormals(const Vec2* positions, int count, float* heights, Vec3* normals) const;
+
+	const uint16* data;
+	int width;
+	int height;
+	Vec3 scale;
+};
+
+
+} // namespace Lumix
@@ -0,0 +1,357 @@
+#include "light_influence_grid.h"
+#include "engine/math_utils.h"
+#include <cmath>
+
+
+namespace Lumix
+{
+
+
+// objects overlapping more cells along any axis are kept in the large lists
+static const int MAX_CELL_SPAN = 4;
+
+
+static uint64 getCellKey(int x, int y, int z)
+{
+	return ((uint64)(x & 0x1fFFff) << 42) | ((uint64)(y & 0x1fFFff) << 21) | (uint64)(z & 0x1fFFff);
+}
+
+
+LightInfluenceGrid::LightInfluenceGrid(IAllocator& allocator, float cell_size)
+	: m_allocator(allocator)
+	, m_cell_size(cell_size)
+	, m_cell_map(allocator)
+	, m_cells(allocator)
+	, m_lights(allocator)
+	, m_light_map(allocator)
+	, m_instances(allocator)
+	, m_large_lights(allocator)
+	, m_large_instances(allocator)
+	, m_empty(allocator)
+	, m_stamp(0)
+	, m_pair_tests_count(0)
+{
+}
+
+
+void LightInfluenceGrid::clear()
+{
+	m_cell_map.clear();
+	m_cells.clear();
+	m_lights.clear();
+	m_light_map.clear();
+	m_instances.clear();
+	m_large_lights.clear();
+	m_large_instances.clear();
+}
+
+
+LightInfluenceGrid::CellRange LightInfluenceGrid::getCellRange(const Vec3& center, float radius) const
+{
+	CellRange range;
+	const float* c = &center.x;
+	range.is_large = false;
+	for (int i = 0; i < 3; ++i)
+	{
+		range.min[i] = (int)floorf((c[i] - radius) / m_cell_size);
+		range.max[i] = (int)floorf((c[i] + radius) / m_cell_size);
+		if (range.max[i] - range.min[i] >= MAX_CELL_SPAN) range.is_large = true;
+	}
+	return range;
+}
+
+
+LightInfluenceGrid::Cell& LightInfluenceGrid::getCell(int x, int y, int z)
+{
+	uint64 key = getCellKey(x, y, z);
+	auto iter = m_cell_map.find(key);
+	if (iter.isValid()) return m_cells[iter.value()];
+
+	m_cell_map.insert(key, m_cells.size());
+	return m_cells.emplace(m_allocator);
+}
+
+
+LightInfluenceGrid::Cell* LightInfluenceGrid::findCell(int x, int y, int z)
+{
+	auto iter = m_cell_map.find(getCellKey(x, y, z));
+	return iter.isValid() ? &m_cells[iter.value()] : nullptr;
+}
+
+
+void LightInfluenceGrid::addToCells(const CellRange& range, ComponentHandle cmp, bool is_light)
+{
+	if (range.is_large)
+	{
+		(is_light ? m_large_lights : m_large_instances).push(cmp);
+		return;
+	}
+
+	for (int z = range.min[2]; z <= range.max[2]; ++z)
+	{
+		for (int y = range.min[1]; y <= range.max[1]; ++y)
+		{
+			for (int x = range.min[0]; x <= range.max[0]; ++x)
+			{
+				Cell& cell = getCell(x, y, z);
+				(is_light ? cell.lights : cell.instances).push(cmp);
+			}
+		}
+	}
+}
+
+
+void LightInfluenceGrid::removeFromCells(const CellRange& range, ComponentHandle cmp, bool is_light)
+{
+	if (range.is_large)
+	{
+		(is_light ? m_large_lights : m_large_instances).eraseItemFast(cmp);
+		return;
+	}
+
+	for (int z = range.min[2]; z <= range.max[2]; ++z)
+	{
+		for (int y = range.min[1]; y <= range.max[1]; ++y)
+		{
+			for (int x = range.min[0]; x <= range.max[0]; ++x)
+			{
+				Cell* cell = findCell(x, y, z);
+				if (cell) (is_light ? cell->lights : cell->instances).eraseItemFast(cmp);
+			}
+		}
+	}
+}
+
+
+bool LightInfluenceGrid::overlaps(const Light& light, const Instance& instance)
+{
+	++m_pair_tests_count;
+	float dist = light.range + instance.sphere.radius;
+	return (light.position - instance.sphere.position).squaredLength() < dist * dist;
+}
+
+
+void LightInfluenceGrid::link(Light& light, ComponentHandle instance)
+{
+	Link& link = m_instances[instance.index].lights.emplace();
+	link.light = light.cmp;
+	link.index = light.instances.size();
+	light.instances.push(instance);
+}
+
+
+void LightInfluenceGrid::unlink(Light& light, int index)
+{
+	int last = light.instances.size() - 1;
+	if (index != last)
+	{
+		// the last instance takes the removed one's place, fix its link
+		for (Link& link : m_instances[light.instances[last].index].lights)
+		{
+			if (link.light == light.cmp)
+			{
+				link.index = index;
+				break;
+			}
+		}
+	}
+	light.instances.eraseFast(index);
+}
+
+
+void LightInfluenceGrid::unlinkInstance(ComponentHandle instance)
+{
+	Array<Link>& links = m_instances[instance.index].lights;
+	for (const Link& link : links)
+	{
+		unlink(m_lights[m_light_map[link.light]], link.index);
+	}
+	links.clear();
+}
+
+
+void LightInfluenceGrid::unlinkLight(Light& light)
+{
+	for (ComponentHandle instance : light.instances)
+	{
+		Array<Link>& links = m_instances[instance.index].lights;
+		for (int i = 0, c = links.size(); i < c; ++i)
+		{
+			if (links[i].light == light.cmp)
+			{
+				links.eraseFast(i);
+				break;
+			}
+		}
+	}
+	light.instances.clear();
+}
+
+
+void LightInfluenceGrid::setLight(ComponentHandle cmp, const Vec3& position, float range)
+{
+	auto iter = m_light_map.find(cmp);
+	Light* light;
+	CellRange cells = getCellRange(position, range);
+	if (iter.isValid())
+	{
+		light = &m_lights[iter.value()];
+		unlinkLight(*light);
+		removeFromCells(light->cells, cmp, true);
+	}
+	else
+	{
+		m_light_map.insert(cmp, m_lights.size());
+		light = &m_lights.emplace(m_allocator);
+		light->cmp = cmp;
+		light->stamp = 0;
+	}
+	light->position = position;
+	light->range = range;
+	light->cells = cells;
+	addToCells(cells, cmp, true);
+
+	++m_stamp;
+	for (ComponentHandle instance : m_large_instances)
+	{
+		if (overlaps(*light, m_instances[instance.index])) link(*light, instance);
+		m_instances[instance.index].stamp = m_stamp;
+	}
+	if (cells.is_large)
+	{
+		for (int i = 0, c = m_instances.size(); i < c; ++i)
+		{
+			Instance& instance = m_instances[i];
+			if (!instance.is_valid || instance.stamp == m_stamp) continue;
+			if (overlaps(*light, instance)) link(*light, {i});
+		}
+		return;
+	}
+
+	for (int z = cells.min[2]; z <= cells.max[2]; ++z)
+	{
+		for (int y = cells.min[1]; y <= cells.max[1]; ++y)
+		{
+			for (int x = cells.min[0]; x <= cells.max[0]; ++x)
+			{
+				Cell* cell = findCell(x, y, z);
+				if (!cell) continue;
+				for (ComponentHandle instance_cmp : cell->instances)
+				{
+					Instance& instance = m_instances[instance_cmp.index];
+					if (instance.stamp == m_stamp) continue;
+					instance.stamp = m_stamp;
+					if (overlaps(*light, instance)) link(*light, instance_cmp);
+				}
+			}
+		}
+	}
+}
+
+
+void LightInfluenceGrid::removeLight(ComponentHandle cmp)
+{
+	auto iter = m_light_map.find(cmp);
+	if (!iter.isValid()) return;
+
+	int index = iter.value();
+	Light& light = m_lights[index];
+	unlinkLight(light);
+	removeFromCells(light.cells, cmp, true);
+	m_light_map.erase(cmp);
+	m_lights.eraseFast(index);
+	if (index < m_lights.size()) m_light_map[m_lights[index].cmp] = index;
+}
+
+
+void LightInfluenceGrid::setInstance(ComponentHandle cmp, const Sphere& sphere)
+{
+	while (cmp.index >= m_instances.size()) m_instances.emplace(m_allocator);
+
+	Instance& instance = m_instances[cmp.index];
+	CellRange cells = getCellRange(sphere.position, sphere.radius);
+	if (instance.is_valid)
+	{
+		unlinkInstance(cmp);
+		removeFromCells(instance.cells, cmp, false);
+	}
+	else
+	{
+		instance.is_valid = true;
+		instance.stamp = 0;
+	}
+	instance.sphere = sphere;
+	instance.cells = cells;
+	addToCells(cells, cmp, false);
+
+	++m_stamp;
+	for (ComponentHandle light_cmp : m_large_lights)
+	{
+		Light& light = m_lights[m_light_map[light_cmp]];
+		light.stamp = m_stamp;
+		if (overlaps(light, instance)) link(light, cmp);
+	}
+	if (cells.is_large)
+	{
+		for (Light& light : m_lights)
+		{
+			if (light.stamp == m_stamp) continue;
+			if (overlaps(light, instance)) link(light, cmp);
+		}
+		return;
+	}
+
+	for (int z = cells.min[2]; z <= cells.max[2]; ++z)
+	{
+		for (int y = cells.min[1]; y <= cells.max[1]; ++y)
+		{
+			for (int x = cells.min[0]; x <= cells.max[0]; ++x)
+			{
+				Cell* cell = findCell(x, y, z);
+				if (!cell) continue;
+				for (ComponentHandle light_cmp : cell->lights)
+				{
+					Light& light = m_lights[m_light_map[light_cmp]];
+					if (light.stamp == m_stamp) continue;
+					light.stamp = m_stamp;
+					if (overlaps(light, instance)) link(light, cmp);
+				}
+			}
+		}
+	}
+}
+
+
+void LightInfluenceGrid::removeInstance(ComponentHandle cmp)
+{
+	if (cmp.index >= m_instances.size()) return;
+	Instance& instance = m_instances[cmp.index];
+	if (!instance.is_valid) return;
+
+	unlinkInstance(cmp);
+	removeFromCells(instance.cells, cmp, false);
+	instance.is_valid = false;
+}
+
+
+const Array<ComponentHandle>& LightInfluenceGrid::getInfluencedInstances(ComponentHandle light) const
+{
+	auto iter = m_light_map.find(light);
+	return iter.isValid() ? m_lights[iter.value()].instances : m_empty;
+}
+
+
+int LightInfluenceGrid::getInstanceLightsCount(ComponentHandle instance) const
+{
+	if (instance.index >= m_instances.size()) return 0;
+	return m_instances[instance.index].lights.size();
+}
+
+
+ComponentHandle LightInfluenceGrid::getInstanceLight(ComponentHandle instance, int index) const
+{
+	return m_instances[instance.index].lights[index].light;
+}
+
+
+} // namespace Lumix
@@ -0,0 +1,126 @@
+#pragma once
+
+
+#include "engine/array.h"
+#include "engine/geometry.h"
+#include "engine/hash_map.h"
+#include "engine/lumix.h"
+
+
+namespace Lumix
+{
+
+
+class IAllocator;
+
+
+// Keeps track of which model instances are in range of which point lights. Lights and instances
+// are bucketed in a uniform grid, so moving an instance tests only lights in the cells it overlaps.
+// Each instance knows the lights it's linked to, so unlinking does not search all lights.
+class LUMIX_RENDERER_API LightInfluenceGrid
+{
+public:
+	static const int DEFAULT_CELL_SIZE = 32;
+
+public:
+	LightInfluenceGrid(IAllocator& allocator, float cell_size = DEFAULT_CELL_SIZE);
+
+	void clear();
+	// adds the light or updates its position and range
+	void setLight(ComponentHandle light, const Vec3& position, float range);
+	void removeLight(ComponentHandle light);
+	// adds the instance or updates its bounding sphere
+	void setInstance(ComponentHandle instance, const Sphere& sphere);
+	void removeInstance(ComponentHandle instance);
+
+	const Array<ComponentHandle>& getInfluencedInstances(ComponentHandle light) const;
+	int getInstanceLightsCount(ComponentHandle instance) const;
+	ComponentHandle getInstanceLight(ComponentHandle instance, int index) const;
+	int getPairTestsCount() const { return m_pair_tests_count; }
+
+private:
+	struct CellRange
+	{
+		int min[3];
+		int max[3];
+		bool is_large;
+	};
+
+	struct Cell
+	{
+		Cell(IAllocator& allocator)
+			: lights(allocator)
+			, instances(allocator)
+		{
+		}
+
+		Array<ComponentHandle> lights;
+		Array<ComponentHandle> instances;
+	};
+
+	struct Light
+	{
+		Light(IAllocator& allocator)
+			: instances(allocator)
+		{
+		}
+
+		ComponentHandle cmp;
+		Vec3 position;
+		float range;
+		CellRange cells;
+		uint32 stamp;
+		Array<ComponentHandle> instances;
+	};
+
+	// light and position of the instance in that light's list
+	struct Link
+	{
+		ComponentHandle light;
+		int index;
+	};
+
+	struct Instance
+	{
+		Instance(IAllocator& allocator)
+			: lights(allocator)
+			, is_valid(false)
+		{
+		}
+
+		Sphere sphere;
+		CellRange cells;
+		uint32 stamp;
+		bool is_valid;
+		Array<Link> lights;
+	};
+
+	CellRange getCellRange(const Vec3& center, float radius) const;
+	Cell& getCell(int x, int y, int z);
+	Cell* findCell(int x, int y, int z);
+	void addToCells(const CellRange& range, ComponentHandle cmp, bool is_light);
+	void removeFromCells(const CellRange& range, ComponentHandle cmp, bool is_light);
+	void link(Light& light, ComponentHandle instance);
+	void unlink(Light& light, int index);
+	void unlinkInstance(ComponentHandle instance);
+	void unlinkLight(Light& light);
+	bool overlaps(const Light& light, const Instance& instance);
+
+private:
+	IAllocator& m_allocator;
+	float m_cell_size;
+	HashMap<uint64, int> m_cell_map;
+	Array<Cell> m_cells;
+	Array<Light> m_lights;
+	HashMap<ComponentHandle, int> m_light_map;
+	Array<Instance> m_instances;
+	// lights and instances spanning too many cells, tested against everything
+	Array<ComponentHandle> m_large_lights;
+	Array<ComponentHandle> m_large_instances;
+	Array<ComponentHandle> m_empty;
+	uint32 m_stamp;
+	int m_pair_tests_count;
+};
+
+
+} // namespace Lumix
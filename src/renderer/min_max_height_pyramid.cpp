@@ -0,0 +1,233 @@
+#include "min_max_height_pyramid.h"
+#include "engine/math_utils.h"
+#include "engine/profiler.h"
+#include <cfloat>
+#include <cmath>
+
+
+namespace Lumix
+{
+
+
+// each visited cell pushes at most 4 children, so 3 per level are enough
+static const int MAX_STACK_SIZE = 3 * 32 + 1;
+
+
+// big number instead of infinity for zero, so there are no floating point exceptions in box tests
+static float getInverse(float value)
+{
+	static const float MIN_VALUE = 1e-20f;
+	if (fabsf(value) < MIN_VALUE) return value < 0 ? -1 / MIN_VALUE : 1 / MIN_VALUE;
+	return 1 / value;
+}
+
+
+static bool intersectBox(const Vec3& min,
+	const Vec3& max,
+	const Vec3& origin,
+	const Vec3& inv_dir,
+	float max_t)
+{
+	float tx1 = (min.x - origin.x) * inv_dir.x;
+	float tx2 = (max.x - origin.x) * inv_dir.x;
+	float tmin = Math::minimum(tx1, tx2);
+	float tmax = Math::maximum(tx1, tx2);
+
+	float ty1 = (min.y - origin.y) * inv_dir.y;
+	float ty2 = (max.y - origin.y) * inv_dir.y;
+	tmin = Math::maximum(tmin, Math::minimum(ty1, ty2));
+	tmax = Math::minimum(tmax, Math::maximum(ty1, ty2));
+
+	float tz1 = (min.z - origin.z) * inv_dir.z;
+	float tz2 = (max.z - origin.z) * inv_dir.z;
+	tmin = Math::maximum(tmin, Math::minimum(tz1, tz2));
+	tmax = Math::minimum(tmax, Math::maximum(tz1, tz2));
+
+	tmin = Math::maximum(tmin, 0.0f);
+	return tmin <= tmax && tmin <= max_t;
+}
+
+
+MinMaxHeightPyramid::MinMaxHeightPyramid(IAllocator& allocator)
+	: m_allocator(allocator)
+	, m_levels(allocator)
+	, m_width(0)
+	, m_height(0)
+{
+}
+
+
+void MinMaxHeightPyramid::clear()
+{
+	m_levels.clear();
+	m_width = 0;
+	m_height = 0;
+}
+
+
+void MinMaxHeightPyramid::build(const uint16* heights, int width, int height)
+{
+	PROFILE_FUNCTION();
+	clear();
+	if (width < 2 || height < 2) return;
+
+	m_width = width;
+	m_height = height;
+	int level_width = width - 1;
+	int level_height = height - 1;
+	for (;;)
+	{
+		Level& level = m_levels.emplace(m_allocator);
+		level.width = level_width;
+		level.height = level_height;
+		level.cells.resize(level_width * level_height);
+		if (level_width == 1 && level_height == 1) break;
+		level_width = (level_width + 1) >> 1;
+		level_height = (level_height + 1) >> 1;
+	}
+	updateCells(heights, 0, 0, width - 2, height - 2);
+}
+
+
+void MinMaxHeightPyramid::update(const uint16* heights, int x, int z, int w, int h)
+{
+	if (m_levels.empty()) return;
+
+	// cell i uses samples i and i + 1
+	const Level& level0 = m_levels[0];
+	int from_x = Math::maximum(x - 1, 0);
+	int from_z = Math::maximum(z - 1, 0);
+	int to_x = Math::minimum(x + w - 1, level0.width - 1);
+	int to_z = Math::minimum(z + h - 1, level0.height - 1);
+	if (from_x > to_x || from_z > to_z) return;
+	updateCells(heights, from_x, from_z, to_x, to_z);
+}
+
+
+void MinMaxHeightPyramid::updateCells(const uint16* heights, int from_x, int from_z, int to_x, int to_z)
+{
+	Level& level0 = m_levels[0];
+	for (int z = from_z; z <= to_z; ++z)
+	{
+		const uint16* row = heights + z * m_width;
+		const uint16* next_row = row + m_width;
+		for (int x = from_x; x <= to_x; ++x)
+		{
+			MinMax& cell = level0.cells[x + z * level0.width];
+			cell.min = Math::minimum(Math::minimum(row[x], row[x + 1]), Math::minimum(next_row[x], next_row[x + 1]));
+			cell.max = Math::maximum(Math::maximum(row[x], row[x + 1]), Math::maximum(next_row[x], next_row[x + 1]));
+		}
+	}
+
+	for (int i = 1; i < m_levels.size(); ++i)
+	{
+		const Level& children = m_levels[i - 1];
+		Level& level = m_levels[i];
+		from_x >>= 1;
+		from_z >>= 1;
+		to_x >>= 1;
+		to_z >>= 1;
+		for (int z = from_z; z <= to_z; ++z)
+		{
+			for (int x = from_x; x <= to_x; ++x)
+			{
+				MinMax& cell = level.cells[x + z * level.width];
+				cell = children.cells[x * 2 + z * 2 * children.width];
+				for (int j = 1; j < 4; ++j)
+				{
+					int child_x = x * 2 + (j & 1);
+					int child_z = z * 2 + (j >> 1);
+					if (child_x >= children.width || child_z >= children.height) continue;
+					const MinMax& child = children.cells[child_x + child_z * children.width];
+					cell.min = Math::minimum(cell.min, child.min);
+					cell.max = Math::maximum(cell.max, child.max);
+				}
+			}
+		}
+	}
+}
+
+
+bool MinMaxHeightPyramid::intersectQuad(const uint16* heights,
+	int x,
+	int z,
+	const Vec3& origin,
+	const Vec3& dir,
+	float* t) const
+{
+	const uint16* row = heights + z * m_width;
+	const uint16* next_row = row + m_width;
+	float fx = (float)x;
+	float fz = (float)z;
+	Vec3 p0(fx, row[x], fz);
+	Vec3 p1(fx + 1, row[x + 1], fz);
+	Vec3 p2(fx + 1, next_row[x + 1], fz + 1);
+	Vec3 p3(fx, next_row[x], fz + 1);
+
+	float t0, t1;
+	bool is_hit0 = Math::getRayTriangleIntersection(origin, dir, p0, p1, p2, &t0);
+	bool is_hit1 = Math::getRayTriangleIntersection(origin, dir, p0, p2, p3, &t1);
+	if (!is_hit0 && !is_hit1) return false;
+	*t = is_hit0 && is_hit1 ? Math::minimum(t0, t1) : (is_hit0 ? t0 : t1);
+	return true;
+}
+
+
+bool MinMaxHeightPyramid::castRay(const uint16* heights, const Vec3& origin, const Vec3& dir, float* t) const
+{
+	if (m_levels.empty()) return false;
+
+	Vec3 inv_dir(getInverse(dir.x), getInverse(dir.y), getInverse(dir.z));
+	// children are visited in the order the ray crosses them
+	int near_child = (dir.x < 0 ? 1 : 0) | (dir.z < 0 ? 2 : 0);
+	struct StackItem
+	{
+		int level;
+		int x;
+		int z;
+	};
+	StackItem stack[MAX_STACK_SIZE];
+	int stack_size = 1;
+	stack[0] = {m_levels.size() - 1, 0, 0};
+	float nearest_t = FLT_MAX;
+	while (stack_size > 0)
+	{
+		StackItem item = stack[--stack_size];
+		const Level& level = m_levels[item.level];
+		const MinMax& cell = level.cells[item.x + item.z * level.width];
+		int cell_size = 1 << item.level;
+		Vec3 min((float)(item.x * cell_size), cell.min, (float)(item.z * cell_size));
+		Vec3 max((float)Math::minimum((item.x + 1) * cell_size, m_width - 1),
+			cell.max,
+			(float)Math::minimum((item.z + 1) * cell_size, m_height - 1));
+		if (!intersectBox(min, max, origin, inv_dir, nearest_t)) continue;
+
+		if (item.level == 0)
+		{
+			float quad_t;
+			if (intersectQuad(heights, item.x, item.z, origin, dir, &quad_t) && quad_t < nearest_t)
+			{
+				nearest_t = quad_t;
+			}
+			continue;
+		}
+
+		const Level& children = m_levels[item.level - 1];
+		for (int i = 3; i >= 0; --i)
+		{
+			int child = i ^ near_child;
+			int child_x = item.x * 2 + (child & 1);
+			int child_z = item.z * 2 + (child >> 1);
+			if (child_x >= children.width || child_z >= children.height) continue;
+			ASSERT(stack_size < MAX_STACK_SIZE);
+			stack[stack_size++] = {item.level - 1, child_x, child_z};
+		}
+	}
+
+	if (nearest_t == FLT_MAX) return false;
+	*t = nearest_t;
+	return true;
+}
+
+
+} // namespace Lumix
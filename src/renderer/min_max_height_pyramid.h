@@ -0,0 +1,64 @@
+#pragma once
+
+
+#include "engine/array.h"
+#include "engine/lumix.h"
+#include "engine/vec.h"
+
+
+namespace Lumix
+{
+
+
+class IAllocator;
+
+
+// Min/max mip pyramid over a 16-bit heightmap. Cell (x, z) of level 0 is the quad between samples x..x+1 and
+// z..z+1, each next level merges 2x2 cells of the previous one. Rays skip whole cells which they pass above
+// or below, only the quads they might hit are tested.
+class LUMIX_RENDERER_API MinMaxHeightPyramid
+{
+public:
+	explicit MinMaxHeightPyramid(IAllocator& allocator);
+
+	// heights are not copied, the same array must be passed to update() and castRay()
+	void build(const uint16* heights, int width, int height);
+	// recomputes cells which use samples in the rectangle
+	void update(const uint16* heights, int x, int z, int w, int h);
+	void clear();
+	bool empty() const { return m_levels.empty(); }
+	// x and z are in samples, y is in raw height units; returns the nearest hit, t is in units of dir
+	bool castRay(const uint16* heights, const Vec3& origin, const Vec3& dir, float* t) const;
+	int getLevelsCount() const { return m_levels.size(); }
+
+private:
+	struct MinMax
+	{
+		uint16 min;
+		uint16 max;
+	};
+
+	struct Level
+	{
+		explicit Level(IAllocator& allocator)
+			: cells(allocator)
+		{
+		}
+
+		int width;
+		int height;
+		Array<MinMax> cells;
+	};
+
+	void updateCells(const uint16* heights, int from_x, int from_z, int to_x, int to_z);
+	bool intersectQuad(const uint16* heights, int x, int z, const Vec3& origin, const Vec3& dir, float* t) const;
+
+private:
+	IAllocator& m_allocator;
+	Array<Level> m_levels;
+	int m_width;
+	int m_height;
+};
+
+
+} // namespace Lumix
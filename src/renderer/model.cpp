@@ -67,6 +67,7 @@ Model::Model(const Path& path, ResourceManagerBase& resource_manager, IAllocator
 	, m_indices_handle(BGFX_INVALID_HANDLE)
 	, m_first_nonroot_bone_index(0)
 	, m_flags(0)
+	, m_bvh(m_allocator)
 {
 	m_lods[0] = { 0, -1, FLT_MAX };
 	m_lods[1] = { 0, -1, FLT_MAX };
@@ -81,6 +82,30 @@ Model::~Model()
 }
 
 
+void Model::buildBVH()
+{
+	PROFILE_FUNCTION();
+	if (m_vertices.empty()) return;
+
+	Array<uint32> indices(m_allocator);
+	const uint16* indices16 = (const uint16*)&m_indices[0];
+	const uint32* indices32 = (const uint32*)&m_indices[0];
+	bool is16 = areIndices16();
+	int vertex_offset = 0;
+	for (int mesh_index = m_lods[0].from_mesh; mesh_index <= m_lods[0].to_mesh; ++mesh_index)
+	{
+		const Mesh& mesh = m_meshes[mesh_index];
+		indices.reserve(indices.size() + mesh.indices_count);
+		for (int i = mesh.indices_offset, end = mesh.indices_offset + mesh.indices_count; i < end; ++i)
+		{
+			indices.push(vertex_offset + (is16 ? indices16[i] : indices32[i]));
+		}
+		vertex_offset += mesh.attribute_array_size / m_vertex_decl.getStride();
+	}
+	m_bvh.build(&m_vertices[0], indices.empty() ? nullptr : &indices[0], indices.size() / 3);
+}
+
+
 RayCastModelHit Model::castRay(const Vec3& origin,
 							   const Vec3& dir,
 							   const Matrix& model_transform)
@@ -94,59 +119,20 @@ RayCastModelHit Model::castRay(const Vec3& origin,
 	Vec3 local_origin = inv.transform(origin);
 	Vec3 local_dir = static_cast<Vec3>(inv * Vec4(dir.x, dir.y, dir.z, 0));
 
-	const Array<Vec3>& vertices = m_vertices;
-	uint16* indices16 = (uint16*)&m_indices[0];
-	uint32* indices32 = (uint32*)&m_indices[0];
-	int vertex_offset = 0;
-	bool is16 = m_flags & (uint32)Model::Flags::INDICES_16BIT;
-	for (int mesh_index = m_lods[0].from_mesh; mesh_index <= m_lods[0].to_mesh; ++mesh_index)
+	TriangleBVH::Hit bvh_hit;
+	if (m_bvh.castRay(local_origin, local_dir, &bvh_hit))
 	{
-		int indices_end = m_meshes[mesh_index].indices_offset + m_meshes[mesh_index].indices_count;
-		for(int i = m_meshes[mesh_index].indices_offset; i < indices_end; i += 3)
+		// triangles are in the order of LOD 0 meshes
+		int mesh_index = m_lods[0].from_mesh;
+		int triangle = bvh_hit.triangle;
+		while (triangle >= m_meshes[mesh_index].indices_count / 3)
 		{
-			Vec3 p0, p1, p2;
-			if(is16)
-			{
-				p0 = vertices[vertex_offset + indices16[i]];
-				p1 = vertices[vertex_offset + indices16[i + 1]];
-				p2 = vertices[vertex_offset + indices16[i + 2]];
-			}
-			else
-			{
-				p0 = vertices[vertex_offset + indices32[i]];
-				p1 = vertices[vertex_offset + indices32[i + 1]];
-				p2 = vertices[vertex_offset + indices32[i + 2]];
-			}
-			Vec3 normal = crossProduct(p1 - p0, p2 - p0);
-			float q = dotProduct(normal, local_dir);
-			if (q == 0)	continue;
-
-			float d = -dotProduct(normal, p0);
-			float t = -(dotProduct(normal, local_origin) + d) / q;
-			if (t < 0) continue;
-
-			Vec3 hit_point = local_origin + local_dir * t;
-
-			Vec3 edge0 = p1 - p0;
-			Vec3 VP0 = hit_point - p0;
-			if (dotProduct(normal, crossProduct(edge0, VP0)) < 0) continue;
-
-			Vec3 edge1 = p2 - p1;
-			Vec3 VP1 = hit_point - p1;
-			if (dotProduct(normal, crossProduct(edge1, VP1)) < 0) continue;
-
-			Vec3 edge2 = p0 - p2;
-			Vec3 VP2 = hit_point - p2;
-			if (dotProduct(normal, crossProduct(edge2, VP2)) < 0) continue;
-
-			if (!hit.m_is_hit || hit.m_t > t)
-			{
-				hit.m_is_hit = true;
-				hit.m_t = t;
-				hit.m_mesh = &m_meshes[mesh_index];
-			}
+			triangle -= m_meshes[mesh_index].indices_count / 3;
+			++mesh_index;
 		}
-		vertex_offset += m_meshes[mesh_index].attribute_array_size / m_vertex_decl.getStride();
+		hit.m_is_hit = true;
+		hit.m_t = bvh_hit.t;
+		hit.m_mesh = &m_meshes[mesh_index];
 	}
 	hit.m_origin = origin;
 	hit.m_dir = dir;
@@ -588,6 +574,7 @@ bool Model::load(FS::IFile& file)
 
 	if (parseMeshes(file, (FileVersion)header.version) && parseGeometry(file) && parseBones(file) && parseLODs(file))
 	{
+		buildBVH();
 		m_size = file.size();
 		return true;
 	}
@@ -647,6 +634,7 @@ void Model::unload(void)
 	m_bones.clear();
 	m_uvs.clear();
 	m_vertices.clear();
+	m_bvh.clear();
 
 	if(bgfx::isValid(m_vertices_handle)) bgfx::destroyVertexBuffer(m_vertices_handle);
 	if(bgfx::isValid(m_indices_handle)) bgfx::destroyIndexBuffer(m_indices_handle);
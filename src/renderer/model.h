@@ -9,6 +9,7 @@
 #include "engine/string.h"
 #include "engine/vec.h"
 #include "engine/resource.h"
+#include "renderer/triangle_bvh.h"
 #include <bgfx/bgfx.h>
 
 
@@ -99,7 +100,9 @@ public:
 
 	enum class Flags : uint32
 	{
-		INDICES_16BIT = 1 << 0
+		INDICES_16BIT = 1 << 0,
+		// LOD 0 is rasterized to the occlusion buffer and hides instances behind it
+		OCCLUDER = 1 << 1
 	};
 
 	struct LOD
@@ -156,12 +159,15 @@ public:
 	BoneMap::iterator getBoneIndex(uint32 hash) { return m_bone_map.find(hash); }
 	void getPose(Pose& pose);
 	float getBoundingRadius() const { return m_bounding_radius; }
+	// LOD 0 triangles are put in a BVH when the model is loaded, so rays can be cast from any thread
 	RayCastModelHit castRay(const Vec3& origin, const Vec3& dir, const Matrix& model_transform);
 	const AABB& getAABB() const { return m_aabb; }
 	LOD* getLODs() { return m_lods; }
+	const LOD* getLODs() const { return m_lods; }
 	const uint16* getIndices16() const { return areIndices16() ? (uint16*)&m_indices[0] : nullptr; }
 	const uint32* getIndices32() const { return areIndices16() ? nullptr : (uint32*)&m_indices[0]; }
 	bool areIndices16() const { return (m_flags & (uint32)Flags::INDICES_16BIT) != 0; }
+	bool isOccluder() const { return (m_flags & (uint32)Flags::OCCLUDER) != 0; }
 	int getIndicesCount() const { return m_indices.size() / (areIndices16() ? 2 : 4); }
 	const Array<Vec3>& getVertices() const { return m_vertices; }
 	const Array<Vec2>& getUVs() const { return m_uvs; }
@@ -185,6 +191,7 @@ private:
 	bool parseLODs(FS::IFile& file);
 	int getBoneIdx(const char* name);
 	void computeRuntimeData(const uint8* vertices);
+	void buildBVH();
 
 	void unload(void) override;
 	bool load(FS::IFile& file) override;
@@ -205,6 +212,7 @@ private:
 	AABB m_aabb;
 	uint32 m_flags;
 	int m_first_nonroot_bone_index;
+	TriangleBVH m_bvh;
 };
 
 
@@ -0,0 +1,367 @@
+#include "occlusion_buffer.h"
+#include "engine/geometry.h"
+#include "engine/iallocator.h"
+#include "engine/math_utils.h"
+#include "engine/matrix.h"
+#include "engine/mtjd/parallel_for.h"
+#include "engine/profiler.h"
+#include "engine/simd.h"
+#include "renderer/model.h"
+#include <cfloat>
+#include <cmath>
+
+
+namespace Lumix
+{
+
+
+static const int ROWS_PER_JOB = 8;
+// triangles with smaller area in pixels cover no pixel centers or only a few of them
+static const float MIN_TRIANGLE_AREA = 0.01f;
+
+
+LUMIX_ALIGN_BEGIN(16) struct VertexLanes
+{
+	float x[4];
+	float y[4];
+	float z[4];
+} LUMIX_ALIGN_END(16);
+
+
+OcclusionBuffer::OcclusionBuffer(MTJD::Manager& mtjd_manager, IAllocator& allocator)
+	: m_allocator(allocator)
+	, m_mtjd_manager(mtjd_manager)
+	, m_depths(nullptr)
+	, m_depths_capacity(0)
+	, m_triangles(allocator)
+	, m_screen_vertices(allocator)
+	, m_near(0)
+	, m_width(0)
+	, m_height(0)
+{
+	for (int mask = 0; mask < 16; ++mask)
+	{
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			m_uncovered_lanes[mask][lane] = (mask & (1 << lane)) ? 0 : FLT_MAX;
+		}
+	}
+}
+
+
+OcclusionBuffer::~OcclusionBuffer()
+{
+	m_allocator.deallocate_aligned(m_depths);
+}
+
+
+void OcclusionBuffer::clear(const Frustum& frustum, int width, int height)
+{
+	ASSERT(frustum.fov > 0);
+	ASSERT(width > 0 && height > 0 && width % 4 == 0);
+
+	m_width = width;
+	m_height = height;
+	if (m_depths_capacity < width * height)
+	{
+		m_allocator.deallocate_aligned(m_depths);
+		m_depths = (float*)m_allocator.allocate_aligned(width * height * sizeof(float), 16);
+		m_depths_capacity = width * height;
+	}
+	for (int i = 0, c = width * height; i < c; ++i)
+	{
+		m_depths[i] = FLT_MAX;
+	}
+	m_triangles.clear();
+
+	// same basis as Frustum::computePerspective
+	Vec3 z = frustum.direction;
+	z.normalize();
+	Vec3 x = crossProduct(z, frustum.up);
+	x.normalize();
+	Vec3 y = crossProduct(x, z);
+
+	float tang = tanf(frustum.fov * 0.5f);
+	float half_width = width * 0.5f;
+	float half_height = height * 0.5f;
+	m_position = frustum.position;
+	m_depth_axis = z;
+	m_screen_x_axis = x * (half_width / (tang * frustum.ratio)) + z * half_width;
+	m_screen_y_axis = z * half_height - y * (half_height / tang);
+	m_near = frustum.near_distance;
+}
+
+
+void OcclusionBuffer::getScreenTransform(const Matrix& mtx, ScreenTransform* transform) const
+{
+	Vec3 mtx_x = mtx.getXVector();
+	Vec3 mtx_y = mtx.getYVector();
+	Vec3 mtx_z = mtx.getZVector();
+	Vec3 translation = mtx.getTranslation() - m_position;
+	const Vec3* axes[] = {&m_screen_x_axis, &m_screen_y_axis, &m_depth_axis};
+	float* rows[] = {transform->x, transform->y, transform->depth};
+	for (int i = 0; i < 3; ++i)
+	{
+		rows[i][0] = dotProduct(*axes[i], mtx_x);
+		rows[i][1] = dotProduct(*axes[i], mtx_y);
+		rows[i][2] = dotProduct(*axes[i], mtx_z);
+		rows[i][3] = dotProduct(*axes[i], translation);
+	}
+}
+
+
+void OcclusionBuffer::transformVertices(const Matrix& mtx, const Vec3* vertices, int count)
+{
+	ScreenTransform transform;
+	getScreenTransform(mtx, &transform);
+	const float* rows[] = {transform.x, transform.y, transform.depth};
+	float4 coefs[3][4];
+	for (int i = 0; i < 3; ++i)
+	{
+		for (int j = 0; j < 4; ++j)
+		{
+			coefs[i][j] = f4Splat(rows[i][j]);
+		}
+	}
+
+	m_screen_vertices.resize(count);
+	ScreenVertex* LUMIX_RESTRICT out = &m_screen_vertices[0];
+	for (int i = 0; i < count; i += 4)
+	{
+		VertexLanes lanes;
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			const Vec3& v = vertices[Math::minimum(i + lane, count - 1)];
+			lanes.x[lane] = v.x;
+			lanes.y[lane] = v.y;
+			lanes.z[lane] = v.z;
+		}
+		float4 vx = f4Load(lanes.x);
+		float4 vy = f4Load(lanes.y);
+		float4 vz = f4Load(lanes.z);
+
+		float4 res[3];
+		for (int row = 0; row < 3; ++row)
+		{
+			res[row] = f4Add(f4Add(f4Mul(coefs[row][0], vx), f4Mul(coefs[row][1], vy)),
+				f4Add(f4Mul(coefs[row][2], vz), coefs[row][3]));
+		}
+		// vertices behind the near plane are never used, their screen position does not matter
+		float4 inv_depth = f4Div(f4Splat(1), res[2]);
+		float4 screen_x = f4Mul(res[0], inv_depth);
+		float4 screen_y = f4Mul(res[1], inv_depth);
+		f4Store(lanes.x, screen_x);
+		f4Store(lanes.y, screen_y);
+		f4Store(lanes.z, res[2]);
+		for (int lane = 0; lane < 4 && i + lane < count; ++lane)
+		{
+			out[i + lane] = {lanes.x[lane], lanes.y[lane], lanes.z[lane]};
+		}
+	}
+}
+
+
+void OcclusionBuffer::addTriangle(const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2)
+{
+	// clipping is not needed, triangles crossing the near plane just do not occlude anything
+	if (v0.depth < m_near || v1.depth < m_near || v2.depth < m_near) return;
+
+	float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+	if (Math::abs(area) < MIN_TRIANGLE_AREA) return;
+
+	float min_x = Math::minimum(v0.x, v1.x, v2.x);
+	float max_x = Math::maximum(v0.x, v1.x, v2.x);
+	float min_y = Math::minimum(v0.y, v1.y, v2.y);
+	float max_y = Math::maximum(v0.y, v1.y, v2.y);
+	if (max_x < 0 || max_y < 0 || min_x >= m_width || min_y >= m_height) return;
+
+	Triangle& tri = m_triangles.emplace();
+	tri.min_x = (int)Math::clamp(min_x, 0.0f, float(m_width - 1));
+	tri.max_x = (int)Math::clamp(max_x, 0.0f, float(m_width - 1));
+	tri.min_y = (int)Math::clamp(min_y, 0.0f, float(m_height - 1));
+	tri.max_y = (int)Math::clamp(max_y, 0.0f, float(m_height - 1));
+	tri.depth = Math::maximum(v0.depth, v1.depth, v2.depth);
+
+	// edge function of edge i is positive inside the triangle
+	const ScreenVertex* v[] = {&v0, &v1, &v2};
+	float sign = area > 0 ? 1.0f : -1.0f;
+	for (int i = 0; i < 3; ++i)
+	{
+		const ScreenVertex& a = *v[i];
+		const ScreenVertex& b = *v[(i + 1) % 3];
+		tri.edge_a[i] = (a.y - b.y) * sign;
+		tri.edge_b[i] = (b.x - a.x) * sign;
+		tri.edge_c[i] = (a.x * b.y - b.x * a.y) * sign;
+	}
+}
+
+
+template <typename T>
+void OcclusionBuffer::addIndexedTriangles(const Matrix& mtx, const Vec3* vertices, const T* indices, int count)
+{
+	if (count < 3) return;
+
+	T max_index = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		max_index = Math::maximum(max_index, indices[i]);
+	}
+	transformVertices(mtx, vertices, (int)max_index + 1);
+
+	const ScreenVertex* screen_vertices = &m_screen_vertices[0];
+	for (int i = 0; i + 2 < count; i += 3)
+	{
+		addTriangle(screen_vertices[indices[i]], screen_vertices[indices[i + 1]], screen_vertices[indices[i + 2]]);
+	}
+}
+
+
+void OcclusionBuffer::addTriangles(const Matrix& mtx, const Vec3* vertices, const uint16* indices, int indices_count)
+{
+	addIndexedTriangles(mtx, vertices, indices, indices_count);
+}
+
+
+void OcclusionBuffer::addTriangles(const Matrix& mtx, const Vec3* vertices, const uint32* indices, int indices_count)
+{
+	addIndexedTriangles(mtx, vertices, indices, indices_count);
+}
+
+
+void OcclusionBuffer::addOccluder(const Model& model, const Matrix& mtx)
+{
+	if (!model.isReady() || model.getMeshCount() == 0) return;
+
+	int stride = model.getVertexDecl().getStride();
+	const Model::LOD& lod = model.getLODs()[0];
+	for (int i = lod.from_mesh; i <= lod.to_mesh; ++i)
+	{
+		const Mesh& mesh = model.getMesh(i);
+		const Vec3* vertices = &model.getVertices()[mesh.attribute_array_offset / stride];
+		if (model.areIndices16())
+		{
+			addTriangles(mtx, vertices, model.getIndices16() + mesh.indices_offset, mesh.indices_count);
+		}
+		else
+		{
+			addTriangles(mtx, vertices, model.getIndices32() + mesh.indices_offset, mesh.indices_count);
+		}
+	}
+}
+
+
+void OcclusionBuffer::rasterizeRows(int from, int to)
+{
+	PROFILE_FUNCTION();
+	static const float LANE_OFFSETS[] = {0.5f, 1.5f, 2.5f, 3.5f};
+	float4 lane_offsets = f4LoadUnaligned(LANE_OFFSETS);
+	float4 four = f4Splat(4);
+
+	for (const Triangle& tri : m_triangles)
+	{
+		int min_y = Math::maximum(tri.min_y, from);
+		int max_y = Math::minimum(tri.max_y, to - 1);
+		if (min_y > max_y) continue;
+
+		int min_x = tri.min_x & ~3;
+		float4 depth = f4Splat(tri.depth);
+		float4 a[3], step[3], start[3];
+		for (int i = 0; i < 3; ++i)
+		{
+			a[i] = f4Splat(tri.edge_a[i]);
+			step[i] = f4Mul(a[i], four);
+			start[i] = f4Mul(a[i], f4Add(f4Splat((float)min_x), lane_offsets));
+		}
+
+		for (int y = min_y; y <= max_y; ++y)
+		{
+			float py = y + 0.5f;
+			float4 e[3];
+			for (int i = 0; i < 3; ++i)
+			{
+				e[i] = f4Add(start[i], f4Splat(tri.edge_b[i] * py + tri.edge_c[i]));
+			}
+
+			float* LUMIX_RESTRICT row = m_depths + y * m_width;
+			for (int x = min_x; x <= tri.max_x; x += 4)
+			{
+				int mask = ~f4MoveMask(f4Min(e[0], f4Min(e[1], e[2]))) & 0xf;
+				if (mask)
+				{
+					float4 masked_depth = f4Max(depth, f4LoadUnaligned(m_uncovered_lanes[mask]));
+					f4Store(row + x, f4Min(f4Load(row + x), masked_depth));
+				}
+				for (int i = 0; i < 3; ++i)
+				{
+					e[i] = f4Add(e[i], step[i]);
+				}
+			}
+		}
+	}
+}
+
+
+void OcclusionBuffer::rasterizeRowsCallback(void* data, int from, int to)
+{
+	static_cast<OcclusionBuffer*>(data)->rasterizeRows(from, to);
+}
+
+
+void OcclusionBuffer::rasterize(IAllocator& job_allocator)
+{
+	PROFILE_FUNCTION();
+	PROFILE_INT("occluder triangles", m_triangles.size());
+	if (m_triangles.empty()) return;
+
+	MTJD::JoinHandle handle =
+		MTJD::parallelFor(m_mtjd_manager, job_allocator, 0, m_height, ROWS_PER_JOB, &rasterizeRowsCallback, this);
+	handle.join();
+}
+
+
+bool OcclusionBuffer::isVisible(const Matrix& mtx, const AABB& aabb) const
+{
+	if (m_triangles.empty()) return true;
+
+	ScreenTransform transform;
+	getScreenTransform(mtx, &transform);
+
+	float min_depth = FLT_MAX;
+	float min_x = FLT_MAX, min_y = FLT_MAX;
+	float max_x = -FLT_MAX, max_y = -FLT_MAX;
+	for (int i = 0; i < 8; ++i)
+	{
+		float x = i & 1 ? aabb.max.x : aabb.min.x;
+		float y = i & 2 ? aabb.max.y : aabb.min.y;
+		float z = i & 4 ? aabb.max.z : aabb.min.z;
+		float depth = transform.depth[0] * x + transform.depth[1] * y + transform.depth[2] * z + transform.depth[3];
+		if (depth < m_near) return true;
+
+		float screen_x = (transform.x[0] * x + transform.x[1] * y + transform.x[2] * z + transform.x[3]) / depth;
+		float screen_y = (transform.y[0] * x + transform.y[1] * y + transform.y[2] * z + transform.y[3]) / depth;
+		min_depth = Math::minimum(min_depth, depth);
+		min_x = Math::minimum(min_x, screen_x);
+		max_x = Math::maximum(max_x, screen_x);
+		min_y = Math::minimum(min_y, screen_y);
+		max_y = Math::maximum(max_y, screen_y);
+	}
+	// outside of the screen, frustum culling decides
+	if (max_x < 0 || max_y < 0 || min_x >= m_width || min_y >= m_height) return true;
+
+	int from_x = (int)Math::clamp(min_x, 0.0f, float(m_width - 1));
+	int to_x = (int)Math::clamp(max_x, 0.0f, float(m_width - 1));
+	int from_y = (int)Math::clamp(min_y, 0.0f, float(m_height - 1));
+	int to_y = (int)Math::clamp(max_y, 0.0f, float(m_height - 1));
+	for (int y = from_y; y <= to_y; ++y)
+	{
+		const float* row = m_depths + y * m_width;
+		for (int x = from_x; x <= to_x; ++x)
+		{
+			if (row[x] >= min_depth) return true;
+		}
+	}
+	return false;
+}
+
+
+} // namespace Lumix
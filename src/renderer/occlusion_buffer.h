@@ -0,0 +1,108 @@
+#pragma once
+
+
+#include "engine/array.h"
+#include "engine/lumix.h"
+#include "engine/vec.h"
+
+
+namespace Lumix
+{
+
+
+struct AABB;
+struct Frustum;
+class IAllocator;
+struct Matrix;
+class Model;
+
+
+namespace MTJD
+{
+class Manager;
+}
+
+
+// Low resolution depth buffer rasterized on CPU from occluder triangles. It's used to skip
+// instances which passed frustum culling but are hidden behind occluders.
+// Depth is the distance along the view direction and each triangle is written with depth of its
+// farthest vertex, so the result of isVisible is conservative.
+class LUMIX_RENDERER_API OcclusionBuffer
+{
+public:
+	static const int DEFAULT_WIDTH = 256;
+	static const int DEFAULT_HEIGHT = 128;
+
+	struct Triangle
+	{
+		float edge_a[3];
+		float edge_b[3];
+		float edge_c[3];
+		float depth;
+		int min_x, min_y, max_x, max_y;
+	};
+
+public:
+	OcclusionBuffer(MTJD::Manager& mtjd_manager, IAllocator& allocator);
+	~OcclusionBuffer();
+
+	// starts a new frame, frustum must be perspective, width must be multiple of 4
+	void clear(const Frustum& frustum, int width, int height);
+	// occluders are set up immediately, but the depth buffer is updated only in rasterize()
+	void addOccluder(const Model& model, const Matrix& mtx);
+	void addTriangles(const Matrix& mtx, const Vec3* vertices, const uint16* indices, int indices_count);
+	void addTriangles(const Matrix& mtx, const Vec3* vertices, const uint32* indices, int indices_count);
+	// rows of the depth buffer are split between MTJD jobs
+	void rasterize(IAllocator& job_allocator);
+	bool isVisible(const Matrix& mtx, const AABB& aabb) const;
+
+	bool hasOccluders() const { return !m_triangles.empty(); }
+	int getTrianglesCount() const { return m_triangles.size(); }
+	int getWidth() const { return m_width; }
+	int getHeight() const { return m_height; }
+	const float* getDepths() const { return m_depths; }
+
+private:
+	struct ScreenVertex
+	{
+		float x, y, depth;
+	};
+
+	// rows of a matrix transforming local space to screen space multiplied by depth
+	struct ScreenTransform
+	{
+		float x[4];
+		float y[4];
+		float depth[4];
+	};
+
+	OcclusionBuffer(const OcclusionBuffer&);
+	void operator=(const OcclusionBuffer&);
+
+	void getScreenTransform(const Matrix& mtx, ScreenTransform* transform) const;
+	void transformVertices(const Matrix& mtx, const Vec3* vertices, int count);
+	void addTriangle(const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2);
+	template <typename T> void addIndexedTriangles(const Matrix& mtx, const Vec3* vertices, const T* indices, int count);
+	void rasterizeRows(int from, int to);
+	static void rasterizeRowsCallback(void* data, int from, int to);
+
+private:
+	IAllocator& m_allocator;
+	MTJD::Manager& m_mtjd_manager;
+	float* m_depths;
+	int m_depths_capacity;
+	Array<Triangle> m_triangles;
+	Array<ScreenVertex> m_screen_vertices;
+	Vec3 m_position;
+	// world space axes, dot(axis, p - m_position) is screen x * depth, screen y * depth and depth of p
+	Vec3 m_screen_x_axis;
+	Vec3 m_screen_y_axis;
+	Vec3 m_depth_axis;
+	float m_near;
+	int m_width;
+	int m_height;
+	float m_uncovered_lanes[16][4];
+};
+
+
+} // namespace Lumix
@@ -3,14 +3,17 @@
 #include "engine/crc32.h"
 #include "engine/fs/disk_file_device.h"
 #include "engine/fs/file_system.h"
+#include "engine/frame_allocator.h"
 #include "engine/geometry.h"
-#include "engine/lifo_allocator.h"
 #include "engine/log.h"
 #include "engine/lua_wrapper.h"
+#include "engine/mtjd/parallel_for.h"
 #include "engine/profiler.h"
+#include "engine/radix_sort.h"
 #include "engine/engine.h"
 #include "imgui/imgui.h"
 #include "lua_script/lua_script_system.h"
+#include "renderer/draw_list.h"
 #include "renderer/frame_buffer.h"
 #include "renderer/material.h"
 #include "renderer/material_manager.h"
@@ -33,6 +36,10 @@ namespace Lumix
 
 static const float SHADOW_CAM_NEAR = 50.0f;
 static const float SHADOW_CAM_FAR = 5000.0f;
+// meshes per job when computing sort keys of a draw list
+static const int DRAW_KEYS_GRAIN = 256;
+// draw list items per job when copying instance data
+static const int INSTANCE_DATA_GRAIN = 1024;
 static bool is_opengl = false;
 
 
@@ -239,6 +246,11 @@ void CommandBufferGenerator::end()
 
 struct PipelineImpl LUMIX_FINAL : public Pipeline
 {
+	// views culled together by cullViews, shadowmap splits go first
+	static const int CAMERA_CULLED_VIEW = 4;
+	static const int CULLED_VIEWS_COUNT = 5;
+
+
 	struct TerrainInstance
 	{
 		int m_count;
@@ -283,6 +295,8 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 		, m_scene(nullptr)
 		, m_width(-1)
 		, m_height(-1)
+		, m_culled_views_count(0)
+		, m_culled_shadowmap_width(0)
 	{
 		for (auto& handle : m_debug_vertex_buffers)
 		{
@@ -737,6 +751,7 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 		m_scene->setCameraScreenSize(cmp, m_width, m_height);
 		m_applied_camera = cmp;
 		m_camera_frustum = m_scene->getCameraFrustum(cmp);
+		m_culled_views_count = 0;
 
 		Matrix projection_matrix = m_scene->getCameraProjection(cmp);
 
@@ -988,7 +1003,7 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 		Material* material = static_cast<Material*>(res);
 		if (!material->isReady()) return;
 
-		IAllocator& frame_allocator = m_renderer.getEngine().getLIFOAllocator();
+		IAllocator& frame_allocator = m_renderer.getEngine().getFrameAllocator();
 		Array<ComponentHandle> local_lights(frame_allocator);
 		m_scene->getPointLights(m_camera_frustum, local_lights);
 
@@ -1081,7 +1096,7 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 		PROFILE_FUNCTION();
 		if (m_applied_camera == INVALID_COMPONENT) return;
 
-		IAllocator& frame_allocator = m_renderer.getEngine().getLIFOAllocator();
+		IAllocator& frame_allocator = m_renderer.getEngine().getFrameAllocator();
 		Array<DecalInfo> decals(frame_allocator);
 		m_scene->getDecals(m_camera_frustum, decals);
 
@@ -1175,7 +1190,7 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 		shadowmap_info.light = light;
 		//setPointLightUniforms(light);
 
-		IAllocator& frame_allocator = m_renderer.getEngine().getLIFOAllocator();
+		IAllocator& frame_allocator = m_renderer.getEngine().getFrameAllocator();
 		for (int i = 0; i < 4; ++i)
 		{
 			newView("omnilight", 0xff);
@@ -1311,33 +1326,23 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 	}
 
 
-	void renderShadowmap(int split_index)
+	bool computeShadowmapSplit(int split_index,
+		float shadowmap_width,
+		Frustum* shadow_camera_frustum,
+		Matrix* view_matrix,
+		Matrix* projection_matrix)
 	{
 		Universe& universe = m_scene->getUniverse();
 		ComponentHandle light_cmp = m_scene->getActiveGlobalLight();
-		if (!isValid(light_cmp) || !isValid(m_applied_camera)) return;
+		if (!isValid(light_cmp) || !isValid(m_applied_camera)) return false;
 		float camera_height = m_scene->getCameraScreenHeight(m_applied_camera);
-		if (!camera_height) return;
+		if (!camera_height) return false;
 
 		Matrix light_mtx = universe.getMatrix(m_scene->getGlobalLightEntity(light_cmp));
-		m_global_light_shadowmap = m_current_framebuffer;
-		float shadowmap_height = (float)m_current_framebuffer->getHeight();
-		float shadowmap_width = (float)m_current_framebuffer->getWidth();
-		float viewports[] = { 0, 0, 0.5f, 0, 0, 0.5f, 0.5f, 0.5f };
-		float viewports_gl[] = { 0, 0.5f, 0.5f, 0.5f, 0, 0, 0.5f, 0};
 		float camera_fov = m_scene->getCameraFOV(m_applied_camera);
 		float camera_ratio = m_scene->getCameraScreenWidth(m_applied_camera) / camera_height;
 		Vec4 cascades = m_scene->getShadowmapCascades(light_cmp);
 		float split_distances[] = {0.01f, cascades.x, cascades.y, cascades.z, cascades.w};
-		m_is_rendering_in_shadowmap = true;
-		bgfx::setViewClear(m_current_view->bgfx_id, BGFX_CLEAR_DEPTH | BGFX_CLEAR_COLOR, 0xffffffff, 1.0f, 0);
-		bgfx::touch(m_current_view->bgfx_id);
-		float* viewport = (is_opengl ? viewports_gl : viewports) + split_index * 2;
-		bgfx::setViewRect(m_current_view->bgfx_id,
-			(uint16)(1 + shadowmap_width * viewport[0]),
-			(uint16)(1 + shadowmap_height * viewport[1]),
-			(uint16)(0.5f * shadowmap_width - 2),
-			(uint16)(0.5f * shadowmap_height - 2));
 
 		Frustum camera_frustum;
 		Matrix camera_matrix = universe.getMatrix(m_scene->getCameraEntity(m_applied_camera));
@@ -1353,24 +1358,76 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 		float bb_size = camera_frustum.radius;
 		shadow_cam_pos = shadowmapTexelAlign(shadow_cam_pos, 0.5f * shadowmap_width - 2, bb_size, light_mtx);
 
-		Matrix projection_matrix;
-		projection_matrix.setOrtho(-bb_size, bb_size, -bb_size, bb_size, SHADOW_CAM_NEAR, SHADOW_CAM_FAR, is_opengl);
+		projection_matrix->setOrtho(-bb_size, bb_size, -bb_size, bb_size, SHADOW_CAM_NEAR, SHADOW_CAM_FAR, is_opengl);
 		Vec3 light_forward = light_mtx.getZVector();
 		shadow_cam_pos -= light_forward * SHADOW_CAM_FAR * 0.5f;
-		Matrix view_matrix;
-		view_matrix.lookAt(shadow_cam_pos, shadow_cam_pos + light_forward, light_mtx.getYVector());
-		bgfx::setViewTransform(m_current_view->bgfx_id, &view_matrix.m11, &projection_matrix.m11);
-		float ymul = is_opengl ? 0.5f : -0.5f;
-		static const Matrix biasMatrix(0.5, 0.0, 0.0, 0.0, 0.0, ymul, 0.0, 0.0, 0.0, 0.0, 0.5, 0.0, 0.5, 0.5, 0.5, 1.0);
-		m_shadow_viewprojection[split_index] = biasMatrix * (projection_matrix * view_matrix);
+		view_matrix->lookAt(shadow_cam_pos, shadow_cam_pos + light_forward, light_mtx.getYVector());
 
-		Frustum shadow_camera_frustum;
-		shadow_camera_frustum.computeOrtho(
+		shadow_camera_frustum->computeOrtho(
 			shadow_cam_pos, -light_forward, light_mtx.getYVector(), bb_size, bb_size, SHADOW_CAM_NEAR, SHADOW_CAM_FAR);
 
-		findExtraShadowcasterPlanes(light_forward, camera_frustum, &shadow_camera_frustum);
+		findExtraShadowcasterPlanes(light_forward, camera_frustum, shadow_camera_frustum);
+		return true;
+	}
+
+
+	// culls all shadowmap splits and the camera in one pass over the scene,
+	// renderAll then picks the results up instead of culling each view separately
+	void cullViews(float shadowmap_width, uint64 shadowmap_layer_mask)
+	{
+		PROFILE_FUNCTION();
+		Frustum frustums[CULLED_VIEWS_COUNT];
+		m_culled_views_count = 0;
+		for (int i = 0; i < lengthOf(m_shadowmap_splits); ++i)
+		{
+			ShadowmapSplit& split = m_shadowmap_splits[i];
+			if (!computeShadowmapSplit(i, shadowmap_width, &split.frustum, &split.view, &split.projection)) return;
+			frustums[i] = split.frustum;
+			m_culled_views_layer_masks[i] = shadowmap_layer_mask;
+		}
+		frustums[CAMERA_CULLED_VIEW] = m_camera_frustum;
+		m_culled_views_layer_masks[CAMERA_CULLED_VIEW] = m_layer_mask;
+		m_culled_views_count = CULLED_VIEWS_COUNT;
+		m_culled_shadowmap_width = shadowmap_width;
+		m_scene->cullViews(frustums, CULLED_VIEWS_COUNT, m_culled_views_layer_masks);
+	}
+
+
+	void renderShadowmap(int split_index)
+	{
+		float shadowmap_height = (float)m_current_framebuffer->getHeight();
+		float shadowmap_width = (float)m_current_framebuffer->getWidth();
+		uint64 layer_mask = m_current_view->layer_mask;
+		if (m_culled_views_count == 0 || m_culled_shadowmap_width != shadowmap_width ||
+			m_culled_views_layer_masks[split_index] != layer_mask)
+		{
+			cullViews(shadowmap_width, layer_mask);
+		}
+		// the split is computed only by cullViews, it fails when there is no global light or camera
+		if (m_culled_views_count == 0) return;
+		const ShadowmapSplit& split = m_shadowmap_splits[split_index];
+
+		m_global_light_shadowmap = m_current_framebuffer;
+		float viewports[] = { 0, 0, 0.5f, 0, 0, 0.5f, 0.5f, 0.5f };
+		float viewports_gl[] = { 0, 0.5f, 0.5f, 0.5f, 0, 0, 0.5f, 0};
+		m_is_rendering_in_shadowmap = true;
+		bgfx::setViewClear(m_current_view->bgfx_id, BGFX_CLEAR_DEPTH | BGFX_CLEAR_COLOR, 0xffffffff, 1.0f, 0);
+		bgfx::touch(m_current_view->bgfx_id);
+		float* viewport = (is_opengl ? viewports_gl : viewports) + split_index * 2;
+		bgfx::setViewRect(m_current_view->bgfx_id,
+			(uint16)(1 + shadowmap_width * viewport[0]),
+			(uint16)(1 + shadowmap_height * viewport[1]),
+			(uint16)(0.5f * shadowmap_width - 2),
+			(uint16)(0.5f * shadowmap_height - 2));
+
+		bgfx::setViewTransform(m_current_view->bgfx_id, &split.view.m11, &split.projection.m11);
+		float ymul = is_opengl ? 0.5f : -0.5f;
+		static const Matrix biasMatrix(0.5, 0.0, 0.0, 0.0, 0.0, ymul, 0.0, 0.0, 0.0, 0.0, 0.5, 0.0, 0.5, 0.5, 0.5, 1.0);
+		m_shadow_viewprojection[split_index] = biasMatrix * (split.projection * split.view);
 
-		renderAll(shadow_camera_frustum, false, camera_matrix.getTranslation(), m_current_view->layer_mask);
+		Universe& universe = m_scene->getUniverse();
+		Vec3 camera_pos = universe.getPosition(m_scene->getCameraEntity(m_applied_camera));
+		renderAll(split.frustum, false, camera_pos, layer_mask, split_index);
 
 		m_is_rendering_in_shadowmap = false;
 	}
@@ -1710,7 +1767,7 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 	{
 		PROFILE_FUNCTION();
 
-		Array<ModelInstanceMesh> tmp_meshes(m_renderer.getEngine().getLIFOAllocator());
+		Array<ModelInstanceMesh> tmp_meshes(m_renderer.getEngine().getFrameAllocator());
 		m_scene->getPointLightInfluencedGeometry(light, tmp_meshes);
 		renderMeshes(tmp_meshes);
 	}
@@ -1722,7 +1779,7 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 
 		Array<ComponentHandle> lights(m_allocator);
 		m_scene->getPointLights(frustum, lights);
-		IAllocator& frame_allocator = m_renderer.getEngine().getLIFOAllocator();
+		IAllocator& frame_allocator = m_renderer.getEngine().getFrameAllocator();
 		m_is_current_light_global = false;
 		for (int i = 0; i < lights.size(); ++i)
 		{
@@ -1907,16 +1964,28 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 	}
 
 
-	void renderAll(const Frustum& frustum, bool render_grass, const Vec3& lod_ref_point, uint64 layer_mask)
+	void renderAll(const Frustum& frustum,
+		bool render_grass,
+		const Vec3& lod_ref_point,
+		uint64 layer_mask,
+		int culled_view = -1)
 	{
 		PROFILE_FUNCTION();
 
 		if (!isValid(m_applied_camera)) return;
 
-		IAllocator& frame_allocator = m_renderer.getEngine().getLIFOAllocator();
+		IAllocator& frame_allocator = m_renderer.getEngine().getFrameAllocator();
 		m_is_current_light_global = true;
 
-		auto& meshes = m_scene->getModelInstanceInfos(frustum, lod_ref_point, layer_mask);
+		bool is_culled = culled_view >= 0 && culled_view < m_culled_views_count &&
+						 m_culled_views_layer_masks[culled_view] == layer_mask && m_scene->areCulledViewsValid();
+		if (culled_view >= 0 && !is_culled)
+		{
+			++m_stats.culled_view_fallback_count;
+			PROFILE_INT("culled view fallbacks", m_stats.culled_view_fallback_count);
+		}
+		auto& meshes = is_culled ? m_scene->getCulledModelInstanceInfos(culled_view, lod_ref_point)
+								 : m_scene->getModelInstanceInfos(frustum, lod_ref_point, layer_mask);
 		renderMeshes(meshes);
 
 		if (render_grass)
@@ -1997,21 +2066,8 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 		Material* material = mesh.material;
 		auto& shader_instance = mesh.material->getShaderInstance();
 
-		Matrix bone_mtx[128];
-
 		const Pose& pose = *model_instance.pose;
 		const Model& model = *model_instance.model;
-		Vec3* poss = pose.positions;
-		Quat* rots = pose.rotations;
-
-		ASSERT(pose.count <= lengthOf(bone_mtx));
-		for (int bone_index = 0, bone_count = pose.count; bone_index < bone_count; ++bone_index)
-		{
-			auto& bone = model.getBone(bone_index);
-			Transform tmp = {poss[bone_index], rots[bone_index]};
-			bone_mtx[bone_index] = (tmp * bone.inv_bind_transform).toMatrix();
-		}
-
 		int stride = model.getVertexDecl().getStride();
 		
 		int view_idx = m_layer_to_view_map[material->getRenderLayer()];
@@ -2020,7 +2076,7 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 
 		if (!bgfx::isValid(shader_instance.getProgramHandle(view.pass_idx))) return;
 
-		bgfx::setUniform(m_bone_matrices_uniform, bone_mtx, pose.count);
+		bgfx::setUniform(m_bone_matrices_uniform, m_scene->getSkinningPalette(info.model_instance), pose.count);
 		executeCommandBuffer(material->getCommandBuffer(), material);
 		executeCommandBuffer(view.command_buffer.buffer, material);
 
@@ -2043,19 +2099,9 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 		const Mesh& mesh = *info.mesh;
 		Material* material = mesh.material;
 
-		Matrix bone_mtx[128];
 		const Pose& pose = *model_instance.pose;
 		const Model& model = *model_instance.model;
-		Vec3* poss = pose.positions;
-		Quat* rots = pose.rotations;
-
-		ASSERT(pose.count <= lengthOf(bone_mtx));
-		for (int bone_index = 0, bone_count = pose.count; bone_index < bone_count; ++bone_index)
-		{
-			auto& bone = model.getBone(bone_index);
-			Transform tmp = { poss[bone_index], rots[bone_index] };
-			bone_mtx[bone_index] = (tmp * bone.inv_bind_transform).toMatrix();
-		}
+		const Matrix* bone_mtx = m_scene->getSkinningPalette(info.model_instance);
 
 		int stride = model.getVertexDecl().getStride();
 		int layers_count = material->getLayersCount();
@@ -2174,42 +2220,6 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 	}
 
 
-	void renderRigidMesh(const ModelInstance& model_instance, const ModelInstanceMesh& info)
-	{
-		int instance_idx = info.mesh->instance_idx;
-		if (instance_idx == -1)
-		{
-			instance_idx = m_instance_data_idx;
-			m_instance_data_idx = (m_instance_data_idx + 1) % lengthOf(m_instances_data);
-			if (m_instances_data[instance_idx].buffer)
-			{
-				finishInstances(instance_idx);
-			}
-			InstanceData& data = m_instances_data[instance_idx];
-			if (!bgfx::checkAvailInstanceDataBuffer(InstanceData::MAX_INSTANCE_COUNT, sizeof(Matrix)))
-			{
-				g_log_warning.log("Renderer") << "Could not allocate instance data buffer";
-				return;
-			}
-			data.buffer =
-				bgfx::allocInstanceDataBuffer(InstanceData::MAX_INSTANCE_COUNT, sizeof(Matrix));
-			data.instance_count = 0;
-			data.mesh = info.mesh;
-			data.model = model_instance.model;
-			info.mesh->instance_idx = instance_idx;
-		}
-		InstanceData& data = m_instances_data[instance_idx];
-		float* mtcs = (float*)data.buffer->data;
-		copyMemory(&mtcs[data.instance_count * 16], &model_instance.matrix, sizeof(model_instance.matrix));
-		++data.instance_count;
-
-		if (data.instance_count == InstanceData::MAX_INSTANCE_COUNT)
-		{
-			finishInstances(instance_idx);
-		}
-	}
-
-
 	void executeCommandBuffer(const uint8* data, Material* material) const
 	{
 		const uint8* ip = data;
@@ -2365,11 +2375,6 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 
 	void renderGrass(const GrassInfo& grass)
 	{
-		if (!bgfx::checkAvailInstanceDataBuffer(grass.instance_count, sizeof(Matrix))) return;
-
-		const bgfx::InstanceDataBuffer* idb =
-			bgfx::allocInstanceDataBuffer(grass.instance_count, sizeof(GrassInfo::InstanceData));
-		copyMemory(idb->data, grass.instance_data, sizeof(GrassInfo::InstanceData) * grass.instance_count);
 		const Mesh& mesh = grass.model->getMesh(0);
 		Material* material = mesh.material;
 		int stride = grass.model->getVertexDecl().getStride();
@@ -2388,7 +2393,7 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 		bgfx::setIndexBuffer(grass.model->getIndicesHandle(), mesh.indices_offset, mesh.indices_count);
 		bgfx::setStencil(view.stencil, BGFX_STENCIL_NONE);
 		bgfx::setState(view.render_state | material->getRenderStates());
-		bgfx::setInstanceDataBuffer(idb, grass.instance_count);
+		bgfx::setInstanceDataBuffer(grass.instance_buffer, 0, grass.instance_count);
 		++m_stats.draw_call_count;
 		m_stats.instance_count += grass.instance_count;
 		m_stats.triangle_count += grass.instance_count * mesh.indices_count;
@@ -2421,29 +2426,205 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 	}
 
 
-	void renderMeshes(const Array<ModelInstanceMesh>& meshes)
+	static uint16 hashPointer(const void* ptr)
+	{
+		uint32 value = uint32((uintptr)ptr >> 4) * 2654435761U;
+		return uint16(value >> 16);
+	}
+
+
+	// view | program | material | mesh | depth, so instances of a mesh are next to each other
+	// and state changes only between materials; hash collisions only split batches
+	uint64 getSortKey(const ModelInstance& model_instance, const Mesh& mesh, const Vec3& camera_pos) const
+	{
+		Material* material = mesh.material;
+		int view_idx = m_layer_to_view_map[material->getRenderLayer()];
+		const View& view = m_views[view_idx >= 0 ? view_idx : 0];
+		// getProgramHandle creates the program, which can not be done from jobs
+		const ShaderInstance& shader_instance = material->getShaderInstance();
+		uint16 program = view.pass_idx >= 0 ? shader_instance.program_handles[view.pass_idx].idx : 0;
+
+		float squared_distance = (model_instance.matrix.getTranslation() - camera_pos).squaredLength();
+		uint32 depth;
+		copyMemory(&depth, &squared_distance, sizeof(depth));
+
+		return (uint64(view_idx & 0x1f) << 59) | (uint64(program & 0x7ff) << 48) |
+			   (uint64(hashPointer(material)) << 32) | (uint64(hashPointer(&mesh)) << 16) | (depth >> 16);
+	}
+
+
+	// the most instances, at most count, which fit in the transient instance data buffer
+	static int getAvailInstanceCount(int count)
+	{
+		if (bgfx::checkAvailInstanceDataBuffer(count, sizeof(Matrix))) return count;
+		int from = 0;
+		int to = count - 1;
+		while (from < to)
+		{
+			int mid = (from + to + 1) >> 1;
+			if (bgfx::checkAvailInstanceDataBuffer(mid, sizeof(Matrix))) from = mid;
+			else to = mid - 1;
+		}
+		return from;
+	}
+
+
+	// one command per rigid mesh run and per skinned or multilayer mesh, instance data is allocated here
+	// and filled later by jobs; runs which do not fit in the instance data buffer are split, the part
+	// which does not fit at all is not drawn
+	void createDrawCommands(DrawList& list)
 	{
 		PROFILE_FUNCTION();
-		if(meshes.empty()) return;
+		ModelInstance* model_instances = m_scene->getModelInstances();
+		int count = list.meshes.size();
+		for (int i = 0; i < count;)
+		{
+			const ModelInstanceMesh& info = *list.meshes[list.order[i]];
+			DrawCommand& cmd = list.commands.emplace();
+			cmd.first = i;
+			cmd.count = 1;
+			cmd.instances = nullptr;
+			cmd.is_rigid = model_instances[info.model_instance.index].type == ModelInstance::RIGID;
+			if (cmd.is_rigid)
+			{
+				while (i + cmd.count < count && list.meshes[list.order[i + cmd.count]]->mesh == info.mesh) ++cmd.count;
+				int avail_count = getAvailInstanceCount(cmd.count);
+				if (avail_count > 0)
+				{
+					// the rest of the run is the next command
+					cmd.count = avail_count;
+					cmd.instances = bgfx::allocInstanceDataBuffer(cmd.count, sizeof(Matrix));
+				}
+				else
+				{
+					g_log_warning.log("Renderer") << "Could not allocate instance data buffer";
+				}
+			}
+			i += cmd.count;
+		}
+	}
+
+
+	// all instances are drawn in one call; the state is set only if the previous batch did not preserve it
+	void renderRigidBatch(const ModelInstanceMesh& info, const DrawCommand& cmd, bool is_state_set, bool preserve_state)
+	{
+		const ModelInstance* model_instances = m_scene->getModelInstances();
+		Mesh& mesh = *info.mesh;
+		const Model& model = *model_instances[info.model_instance.index].model;
+		Material* material = mesh.material;
+
+		int view_idx = m_layer_to_view_map[material->getRenderLayer()];
+		ASSERT(view_idx >= 0);
+		auto& view = m_views[view_idx >= 0 ? view_idx : 0];
+		if (!is_state_set)
+		{
+			executeCommandBuffer(material->getCommandBuffer(), material);
+			executeCommandBuffer(view.command_buffer.buffer, material);
+			bgfx::setStencil(view.stencil, BGFX_STENCIL_NONE);
+			bgfx::setState(view.render_state | material->getRenderStates());
+		}
+
+		const uint16 stride = model.getVertexDecl().getStride();
+		bgfx::setVertexBuffer(
+			model.getVerticesHandle(), mesh.attribute_array_offset / stride, mesh.attribute_array_size / stride);
+		bgfx::setIndexBuffer(model.getIndicesHandle(), mesh.indices_offset, mesh.indices_count);
+		bgfx::setInstanceDataBuffer(cmd.instances, cmd.count);
+		ShaderInstance& shader_instance = material->getShaderInstance();
+		++m_stats.draw_call_count;
+		m_stats.saved_draw_call_count += cmd.count - 1;
+		m_stats.instance_count += cmd.count;
+		m_stats.triangle_count += cmd.count * mesh.indices_count / 3;
+		bgfx::submit(view.bgfx_id, shader_instance.getProgramHandle(view.pass_idx), 0, preserve_state);
+	}
+
 
+	// meshes are sorted by getSortKey, runs of rigid instances of the same mesh are drawn in one call
+	// and the state is kept between runs with the same material and view; jobs compute the keys
+	// and copy instance data, only bgfx calls are made on this thread
+	void renderDrawList(DrawList& list)
+	{
+		PROFILE_FUNCTION();
+		int count = list.meshes.size();
+		IAllocator& frame_allocator = m_renderer.getEngine().getFrameAllocator();
+		MTJD::Manager& mtjd_manager = m_renderer.getEngine().getMTJDManager();
 		ModelInstance* model_instances = m_scene->getModelInstances();
-		PROFILE_INT("mesh count", meshes.size());
-		for(auto& mesh : meshes)
+		Vec3 camera_pos(0, 0, 0);
+		if (isValid(m_applied_camera))
 		{
-			ModelInstance& model_instance = model_instances[mesh.model_instance.index];
-			switch (model_instance.type)
+			camera_pos = m_scene->getUniverse().getPosition(m_scene->getCameraEntity(m_applied_camera));
+		}
+
+		// the frame allocator grows only its last allocation in place, so the list is sized before the keys
+		list.order.resize(count);
+		list.commands.reserve(count);
+		Array<uint64> keys(frame_allocator);
+		keys.resize(count);
+		auto computeKeys = [&](int from, int to) {
+			PROFILE_BLOCK("Draw keys");
+			for (int i = from; i < to; ++i)
 			{
-				case ModelInstance::RIGID:
-					renderRigidMesh(model_instance, mesh);
-					break;
-				case ModelInstance::SKINNED:
-					renderSkinnedMesh(model_instance, mesh);
-					break;
-				case ModelInstance::MULTILAYER:
-					renderMultilayerMesh(model_instance, mesh);
-					break;
+				const ModelInstanceMesh& mesh = *list.meshes[i];
+				keys[i] = getSortKey(model_instances[mesh.model_instance.index], *mesh.mesh, camera_pos);
+				list.order[i] = i;
 			}
+		};
+		MTJD::parallelFor(mtjd_manager, frame_allocator, 0, count, DRAW_KEYS_GRAIN, computeKeys).join();
+		{
+			PROFILE_BLOCK("Sort draw list");
+			radixSort(&keys[0], &list.order[0], count, frame_allocator);
 		}
+
+		createDrawCommands(list);
+		auto fill = [&list, model_instances](int from, int to) {
+			PROFILE_BLOCK("Instance data");
+			fillInstances(list, model_instances, from, to);
+		};
+		MTJD::parallelFor(mtjd_manager, frame_allocator, 0, count, INSTANCE_DATA_GRAIN, fill).join();
+
+		bool is_state_set = false;
+		for (int i = 0, c = list.commands.size(); i < c; ++i)
+		{
+			const DrawCommand& cmd = list.commands[i];
+			const ModelInstanceMesh& info = *list.meshes[list.order[cmd.first]];
+			if (!cmd.is_rigid)
+			{
+				ModelInstance& model_instance = model_instances[info.model_instance.index];
+				if (model_instance.type == ModelInstance::SKINNED)
+				{
+					renderSkinnedMesh(model_instance, info);
+				}
+				else
+				{
+					renderMultilayerMesh(model_instance, info);
+				}
+				continue;
+			}
+			if (!cmd.instances) continue;
+
+			bool preserve_state = false;
+			if (i + 1 < c)
+			{
+				const DrawCommand& next = list.commands[i + 1];
+				preserve_state = next.is_rigid && next.instances &&
+								 list.meshes[list.order[next.first]]->mesh->material == info.mesh->material;
+			}
+			renderRigidBatch(info, cmd, is_state_set, preserve_state);
+			is_state_set = preserve_state;
+		}
+		PROFILE_INT("saved draw calls", m_stats.saved_draw_call_count);
+	}
+
+
+	void renderMeshes(const Array<ModelInstanceMesh>& meshes)
+	{
+		PROFILE_FUNCTION();
+		if(meshes.empty()) return;
+
+		PROFILE_INT("mesh count", meshes.size());
+		DrawList draw_list(m_renderer.getEngine().getFrameAllocator());
+		draw_list.meshes.resize(meshes.size());
+		for (int i = 0; i < meshes.size(); ++i) draw_list.meshes[i] = &meshes[i];
+		renderDrawList(draw_list);
 		finishInstances();
 	}
 
@@ -2452,30 +2633,19 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 	{
 		PROFILE_FUNCTION();
 		int mesh_count = 0;
+		for (auto& submeshes : meshes) mesh_count += submeshes.size();
+		PROFILE_INT("mesh count", mesh_count);
+		if (mesh_count == 0) return;
+
+		DrawList draw_list(m_renderer.getEngine().getFrameAllocator());
+		draw_list.meshes.resize(mesh_count);
+		int idx = 0;
 		for (auto& submeshes : meshes)
 		{
-			if(submeshes.empty()) continue;
-			ModelInstance* model_instances = m_scene->getModelInstances();
-			mesh_count += submeshes.size();
-			for (auto& mesh : submeshes)
-			{
-				ModelInstance& model_instance = model_instances[mesh.model_instance.index];
-				switch (model_instance.type)
-				{
-					case ModelInstance::RIGID:
-						renderRigidMesh(model_instance, mesh);
-						break;
-					case ModelInstance::SKINNED:
-						renderSkinnedMesh(model_instance, mesh);
-						break;
-					case ModelInstance::MULTILAYER:
-						renderMultilayerMesh(model_instance, mesh);
-						break;
-				}
-			}
+			for (auto& mesh : submeshes) draw_list.meshes[idx++] = &mesh;
 		}
+		renderDrawList(draw_list);
 		finishInstances();
-		PROFILE_INT("mesh count", mesh_count);
 	}
 
 
@@ -2524,6 +2694,7 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 		m_current_view = nullptr;
 		m_view_idx = -1;
 		m_layer_mask = 0;
+		m_culled_views_count = 0;
 		m_pass_idx = -1;
 		m_current_framebuffer = m_default_framebuffer;
 		m_instance_data_idx = 0;
@@ -2696,6 +2867,16 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 	Frustum m_camera_frustum;
 
 	Matrix m_shadow_viewprojection[4];
+	// computed once per cullViews and used when the split is rendered
+	struct ShadowmapSplit
+	{
+		Frustum frustum;
+		Matrix view;
+		Matrix projection;
+	} m_shadowmap_splits[4];
+	uint64 m_culled_views_layer_masks[CULLED_VIEWS_COUNT];
+	int m_culled_views_count;
+	float m_culled_shadowmap_width;
 	int m_view_x;
 	int m_view_y;
 	int m_width;
@@ -2829,7 +3010,11 @@ int renderModels(lua_State* L)
 {
 	auto* pipeline = LuaWrapper::checkArg<PipelineImpl*>(L, 1);
 
-	pipeline->renderAll(pipeline->m_camera_frustum, true, pipeline->m_camera_frustum.position, pipeline->m_layer_mask);
+	pipeline->renderAll(pipeline->m_camera_frustum,
+		true,
+		pipeline->m_camera_frustum.position,
+		pipeline->m_layer_mask,
+		PipelineImpl::CAMERA_CULLED_VIEW);
 	pipeline->m_layer_mask = 0;
 	return 0;
 }
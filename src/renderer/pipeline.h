@@ -62,8 +62,12 @@ class LUMIX_RENDERER_API Pipeline
 		struct Stats
 		{
 			int draw_call_count;
+			// draw calls not needed thanks to instancing
+			int saved_draw_call_count;
 			int instance_count;
 			int triangle_count;
+			// views culled on their own because the results of cullViews could not be used
+			int culled_view_fallback_count;
 		};
 
 		struct CustomCommandHandler
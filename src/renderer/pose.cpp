@@ -2,6 +2,7 @@
 #include "engine/matrix.h"
 #include "engine/quat.h"
 #include "engine/profiler.h"
+#include "engine/simd.h"
 #include "engine/vec.h"
 #include "renderer/model.h"
 
@@ -10,6 +11,84 @@ namespace Lumix
 {
 
 
+namespace
+{
+
+
+// 4 bones, each component in its own register
+struct Quat4
+{
+	float4 x, y, z, w;
+};
+
+
+} // anonymous namespace
+
+
+// indexed by f4MoveMask of dot products, flips quaternions to the same hemisphere like nlerp does
+static const float SIGNS[16][4] = {
+	{1, 1, 1, 1}, {-1, 1, 1, 1}, {1, -1, 1, 1}, {-1, -1, 1, 1},
+	{1, 1, -1, 1}, {-1, 1, -1, 1}, {1, -1, -1, 1}, {-1, -1, -1, 1},
+	{1, 1, 1, -1}, {-1, 1, 1, -1}, {1, -1, 1, -1}, {-1, -1, 1, -1},
+	{1, 1, -1, -1}, {-1, 1, -1, -1}, {1, -1, -1, -1}, {-1, -1, -1, -1}};
+
+
+static Quat4 loadQuats(const Quat& a, const Quat& b, const Quat& c, const Quat& d)
+{
+	Quat4 q;
+	q.x = f4LoadUnaligned(&a);
+	q.y = f4LoadUnaligned(&b);
+	q.z = f4LoadUnaligned(&c);
+	q.w = f4LoadUnaligned(&d);
+	f4Transpose(q.x, q.y, q.z, q.w);
+	return q;
+}
+
+
+static Quat4 loadQuats(const Quat* q)
+{
+	return loadQuats(q[0], q[1], q[2], q[3]);
+}
+
+
+static void storeQuats(Quat* out, Quat4 q)
+{
+	f4Transpose(q.x, q.y, q.z, q.w);
+	f4StoreUnaligned(&out[0], q.x);
+	f4StoreUnaligned(&out[1], q.y);
+	f4StoreUnaligned(&out[2], q.z);
+	f4StoreUnaligned(&out[3], q.w);
+}
+
+
+static float4 dot(const Quat4& a, const Quat4& b)
+{
+	return f4Add(f4Add(f4Add(f4Mul(a.x, b.x), f4Mul(a.y, b.y)), f4Mul(a.z, b.z)), f4Mul(a.w, b.w));
+}
+
+
+static float4 getHemisphereSigns(const Quat4& a, const Quat4& b)
+{
+	return f4LoadUnaligned(SIGNS[f4MoveMask(dot(a, b))]);
+}
+
+
+static Quat4 normalize(const Quat4& q)
+{
+	float4 inv_length = f4Div(f4Splat(1), f4Sqrt(dot(q, q)));
+	return {f4Mul(q.x, inv_length), f4Mul(q.y, inv_length), f4Mul(q.z, inv_length), f4Mul(q.w, inv_length)};
+}
+
+
+static Quat4 madd(const Quat4& sum, const Quat4& q, float4 weight)
+{
+	return {f4Add(sum.x, f4Mul(q.x, weight)),
+		f4Add(sum.y, f4Mul(q.y, weight)),
+		f4Add(sum.z, f4Mul(q.z, weight)),
+		f4Add(sum.w, f4Mul(q.w, weight))};
+}
+
+
 Pose::Pose(IAllocator& allocator)
 	: allocator(allocator)
 {
@@ -33,14 +112,98 @@ void Pose::blend(Pose& rhs, float weight)
 	if (weight <= 0.001f) return;
 	weight = Math::clamp(weight, 0.0f, 1.0f);
 	float inv = 1.0f - weight;
-	for (int i = 0, c = count; i < c; ++i)
+	float4 weight4 = f4Splat(weight);
+	float4 inv4 = f4Splat(inv);
+
+	// positions are blended as an array of floats
+	float* pos = (float*)positions;
+	const float* rhs_pos = (const float*)rhs.positions;
+	int floats_count = count * 3;
+	int i = 0;
+	for (; i + 4 <= floats_count; i += 4)
+	{
+		float4 a = f4LoadUnaligned(pos + i);
+		float4 b = f4LoadUnaligned(rhs_pos + i);
+		f4StoreUnaligned(pos + i, f4Add(f4Mul(a, inv4), f4Mul(b, weight4)));
+	}
+	for (; i < floats_count; ++i)
+	{
+		pos[i] = pos[i] * inv + rhs_pos[i] * weight;
+	}
+
+	i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		Quat4 a = loadQuats(&rotations[i]);
+		Quat4 b = loadQuats(&rhs.rotations[i]);
+		Quat4 zero = {f4Splat(0), f4Splat(0), f4Splat(0), f4Splat(0)};
+		Quat4 lerped = madd(madd(zero, a, inv4), b, f4Mul(weight4, getHemisphereSigns(a, b)));
+		storeQuats(&rotations[i], normalize(lerped));
+	}
+	for (; i < count; ++i)
 	{
-		positions[i] = positions[i] * inv + rhs.positions[i] * weight;
 		nlerp(rotations[i], rhs.rotations[i], &rotations[i], weight);
 	}
 }
 
 
+void Pose::blend(Pose* const* poses, const float* weights, int poses_count)
+{
+	PROFILE_FUNCTION();
+	ASSERT(poses_count > 0);
+	for (int j = 0; j < poses_count; ++j) ASSERT(poses[j]->count == count);
+
+	float* pos = (float*)positions;
+	int floats_count = count * 3;
+	int i = 0;
+	for (; i + 4 <= floats_count; i += 4)
+	{
+		float4 sum = f4Splat(0);
+		for (int j = 0; j < poses_count; ++j)
+		{
+			float4 value = f4LoadUnaligned((const float*)poses[j]->positions + i);
+			sum = f4Add(sum, f4Mul(value, f4Splat(weights[j])));
+		}
+		f4StoreUnaligned(pos + i, sum);
+	}
+	for (; i < floats_count; ++i)
+	{
+		float sum = 0;
+		for (int j = 0; j < poses_count; ++j) sum += ((const float*)poses[j]->positions)[i] * weights[j];
+		pos[i] = sum;
+	}
+
+	// rotations are summed in the hemisphere of the first pose and normalized
+	i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		Quat4 first = loadQuats(&poses[0]->rotations[i]);
+		Quat4 zero = {f4Splat(0), f4Splat(0), f4Splat(0), f4Splat(0)};
+		Quat4 sum = madd(zero, first, f4Splat(weights[0]));
+		for (int j = 1; j < poses_count; ++j)
+		{
+			Quat4 q = loadQuats(&poses[j]->rotations[i]);
+			sum = madd(sum, q, f4Mul(f4Splat(weights[j]), getHemisphereSigns(first, q)));
+		}
+		storeQuats(&rotations[i], normalize(sum));
+	}
+	for (; i < count; ++i)
+	{
+		const Quat& first = poses[0]->rotations[i];
+		Quat sum(first.x * weights[0], first.y * weights[0], first.z * weights[0], first.w * weights[0]);
+		for (int j = 1; j < poses_count; ++j)
+		{
+			const Quat& q = poses[j]->rotations[i];
+			float dot = first.x * q.x + first.y * q.y + first.z * q.z + first.w * q.w;
+			float weight = dot < 0 ? -weights[j] : weights[j];
+			sum.set(sum.x + q.x * weight, sum.y + q.y * weight, sum.z + q.z * weight, sum.w + q.w * weight);
+		}
+		sum.normalize();
+		rotations[i] = sum;
+	}
+}
+
+
 void Pose::resize(int count)
 {
 	is_absolute = false;
@@ -60,16 +223,110 @@ void Pose::resize(int count)
 }
 
 
+// the same as Quat::rotate
+static void rotate(const Quat4& q, float4 v[3])
+{
+	float4 uv[3] = {f4Sub(f4Mul(q.y, v[2]), f4Mul(q.z, v[1])),
+		f4Sub(f4Mul(q.z, v[0]), f4Mul(q.x, v[2])),
+		f4Sub(f4Mul(q.x, v[1]), f4Mul(q.y, v[0]))};
+	float4 uuv[3] = {f4Sub(f4Mul(q.y, uv[2]), f4Mul(q.z, uv[1])),
+		f4Sub(f4Mul(q.z, uv[0]), f4Mul(q.x, uv[2])),
+		f4Sub(f4Mul(q.x, uv[1]), f4Mul(q.y, uv[0]))};
+	float4 two = f4Splat(2.0f);
+	float4 two_w = f4Mul(two, q.w);
+	for (int i = 0; i < 3; ++i)
+	{
+		v[i] = f4Add(f4Add(v[i], f4Mul(uv[i], two_w)), f4Mul(uuv[i], two));
+	}
+}
+
+
+// the same as Quat::operator*
+static Quat4 multiply(const Quat4& a, const Quat4& b)
+{
+	Quat4 res;
+	res.x = f4Sub(f4Add(f4Add(f4Mul(a.w, b.x), f4Mul(b.w, a.x)), f4Mul(a.y, b.z)), f4Mul(b.y, a.z));
+	res.y = f4Sub(f4Add(f4Add(f4Mul(a.w, b.y), f4Mul(b.w, a.y)), f4Mul(a.z, b.x)), f4Mul(b.z, a.x));
+	res.z = f4Sub(f4Add(f4Add(f4Mul(a.w, b.z), f4Mul(b.w, a.z)), f4Mul(a.x, b.y)), f4Mul(b.x, a.y));
+	res.w = f4Sub(f4Sub(f4Sub(f4Mul(a.w, b.w), f4Mul(a.x, b.x)), f4Mul(a.y, b.y)), f4Mul(a.z, b.z));
+	return res;
+}
+
+
+// 4 bones whose parents are all before them are transformed at once, the rest one by one
+template <typename GetParent>
+static void computeAbsolute(Vec3* positions, Quat* rotations, int first_nonroot_bone, int count, GetParent getParent)
+{
+	int i = first_nonroot_bone < 0 ? count : first_nonroot_bone;
+	while (i < count)
+	{
+		int parents[4];
+		bool is_independent = i + 4 <= count;
+		for (int j = 0; j < 4 && is_independent; ++j)
+		{
+			parents[j] = getParent(i + j);
+			is_independent = parents[j] >= 0 && parents[j] < i;
+		}
+
+		if (!is_independent)
+		{
+			int parent = getParent(i);
+			if (parent >= 0)
+			{
+				positions[i] = rotations[parent].rotate(positions[i]) + positions[parent];
+				rotations[i] = rotations[parent] * rotations[i];
+			}
+			++i;
+			continue;
+		}
+
+		Quat4 parent_rot = loadQuats(
+			rotations[parents[0]], rotations[parents[1]], rotations[parents[2]], rotations[parents[3]]);
+		float LUMIX_ALIGN_BEGIN(16) tmp[3][4] LUMIX_ALIGN_END(16);
+		float LUMIX_ALIGN_BEGIN(16) parent_tmp[3][4] LUMIX_ALIGN_END(16);
+		for (int j = 0; j < 4; ++j)
+		{
+			const Vec3& pos = positions[i + j];
+			const Vec3& parent_pos = positions[parents[j]];
+			tmp[0][j] = pos.x;
+			tmp[1][j] = pos.y;
+			tmp[2][j] = pos.z;
+			parent_tmp[0][j] = parent_pos.x;
+			parent_tmp[1][j] = parent_pos.y;
+			parent_tmp[2][j] = parent_pos.z;
+		}
+		float4 pos[3] = {f4Load(tmp[0]), f4Load(tmp[1]), f4Load(tmp[2])};
+		rotate(parent_rot, pos);
+		for (int k = 0; k < 3; ++k)
+		{
+			f4Store(tmp[k], f4Add(pos[k], f4Load(parent_tmp[k])));
+		}
+		for (int j = 0; j < 4; ++j)
+		{
+			positions[i + j].set(tmp[0][j], tmp[1][j], tmp[2][j]);
+		}
+		storeQuats(&rotations[i], multiply(parent_rot, loadQuats(&rotations[i])));
+		i += 4;
+	}
+}
+
+
 void Pose::computeAbsolute(Model& model)
 {
 	PROFILE_FUNCTION();
 	if (is_absolute) return;
-	for (int i = model.getFirstNonrootBoneIndex(); i < count; ++i)
-	{
-		int parent = model.getBone(i).parent_idx;
-		positions[i] = rotations[parent].rotate(positions[i]) + positions[parent];
-		rotations[i] = rotations[parent] * rotations[i];
-	}
+	auto getParent = [&model](int bone) { return model.getBone(bone).parent_idx; };
+	Lumix::computeAbsolute(positions, rotations, model.getFirstNonrootBoneIndex(), count, getParent);
+	is_absolute = true;
+}
+
+
+void Pose::computeAbsolute(const int* parents, int first_nonroot_bone)
+{
+	PROFILE_FUNCTION();
+	if (is_absolute) return;
+	auto getParent = [parents](int bone) { return parents[bone]; };
+	Lumix::computeAbsolute(positions, rotations, first_nonroot_bone, count, getParent);
 	is_absolute = true;
 }
 
@@ -22,8 +22,12 @@ struct LUMIX_RENDERER_API Pose
 
 	void resize(int count);
 	void computeAbsolute(Model& model);
+	// parents[i] is the index of the parent of bone i, parents are before their children
+	void computeAbsolute(const int* parents, int first_nonroot_bone);
 	void computeRelative(Model& model);
 	void blend(Pose& rhs, float weight);
+	// weighted average of the poses, the weights must sum to 1, one of the poses can be this pose
+	void blend(Pose* const* poses, const float* weights, int poses_count);
 
 	IAllocator& allocator;
 	bool is_absolute;
@@ -0,0 +1,70 @@
+#pragma once
+
+
+#include "engine/lumix.h"
+#include "engine/array.h"
+#include "engine/geometry.h"
+#include "engine/mtjd/parallel_for.h"
+#include "renderer/culling_system.h"
+#include "renderer/model.h"
+
+
+namespace Lumix
+{
+
+
+static const int RAYS_PER_JOB = 16;
+
+
+// closest hit among the model instances whose bounding spheres the ray hits,
+// hit_instance(model_instance, origin, dir) returns the hit of a single instance;
+// candidates is only a scratch buffer, so a batch of rays can reuse it
+template <typename HitInstance>
+RayCastModelHit castRayOnInstances(const CullingSystem& culling_system,
+	const Vec3& origin,
+	const Vec3& dir,
+	ComponentHandle ignored_model_instance,
+	CullingSystem::RayHits& candidates,
+	const HitInstance& hit_instance)
+{
+	RayCastModelHit hit;
+	hit.m_is_hit = false;
+
+	candidates.clear();
+	culling_system.castRay(origin, dir, candidates);
+	for (const CullingSystem::RayHit& candidate : candidates)
+	{
+		// candidates are sorted by distance, so the rest can not be closer than the hit
+		if (hit.m_is_hit && candidate.t > hit.m_t) break;
+		if (candidate.model_instance == ignored_model_instance) continue;
+
+		RayCastModelHit new_hit = hit_instance(candidate.model_instance, origin, dir);
+		if (new_hit.m_is_hit && (!hit.m_is_hit || new_hit.m_t < hit.m_t)) hit = new_hit;
+	}
+	return hit;
+}
+
+
+// out[i] = cast_ray(rays[i], candidates) on all worker threads, each job reuses one candidates buffer;
+// jobs and candidates are allocated from allocator, which must be thread safe, usually the frame allocator
+template <typename CastRay>
+void castRaysInJobs(MTJD::Manager& manager,
+	IAllocator& allocator,
+	const Ray* rays,
+	int count,
+	RayCastModelHit* out,
+	const CastRay& cast_ray)
+{
+	auto cast = [&allocator, rays, out, &cast_ray](int from, int to) {
+		CullingSystem::RayHits candidates(allocator);
+		for (int i = from; i < to; ++i)
+		{
+			out[i] = cast_ray(rays[i], candidates);
+		}
+	};
+	MTJD::JoinHandle handle = MTJD::parallelFor(manager, allocator, 0, count, RAYS_PER_JOB, cast);
+	handle.join();
+}
+
+
+} // namespace Lumix
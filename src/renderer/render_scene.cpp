@@ -4,15 +4,15 @@
 #include "engine/blob.h"
 #include "engine/crc32.h"
 #include "engine/fs/file_system.h"
+#include "engine/frame_allocator.h"
 #include "engine/geometry.h"
 #include "engine/json_serializer.h"
-#include "engine/lifo_allocator.h"
 #include "engine/log.h"
 #include "engine/lua_wrapper.h"
 #include "engine/math_utils.h"
-#include "engine/mtjd/generic_job.h"
-#include "engine/mtjd/job.h"
+#include "engine/mt/atomic.h"
 #include "engine/mtjd/manager.h"
+#include "engine/mtjd/parallel_for.h"
 #include "engine/path_utils.h"
 #include "engine/plugin_manager.h"
 #include "engine/profiler.h"
@@ -27,12 +27,15 @@
 
 #include "renderer/culling_system.h"
 #include "renderer/frame_buffer.h"
+#include "renderer/light_influence_grid.h"
 #include "renderer/material.h"
 #include "renderer/material_manager.h"
 #include "renderer/model.h"
+#include "renderer/occlusion_buffer.h"
 #include "renderer/particle_system.h"
 #include "renderer/pipeline.h"
 #include "renderer/pose.h"
+#include "renderer/ray_cast.h"
 #include "renderer/renderer.h"
 #include "renderer/shader.h"
 #include "renderer/terrain.h"
@@ -141,6 +144,20 @@ struct EnvironmentProbe
 };
 
 
+// bone matrices ready to be uploaded, valid only in the frame they were computed in
+struct SkinningPalette
+{
+	explicit SkinningPalette(IAllocator& allocator)
+		: matrices(allocator)
+		, frame(0)
+	{
+	}
+
+	Array<Matrix> matrices;
+	uint32 frame;
+};
+
+
 struct BoneAttachment
 {
 	Entity entity;
@@ -182,6 +199,7 @@ public:
 	~RenderSceneImpl()
 	{
 		m_universe.entityTransformed().unbind<RenderSceneImpl, &RenderSceneImpl::onEntityMoved>(this);
+		m_universe.entitiesTransformed().unbind<RenderSceneImpl, &RenderSceneImpl::onEntitiesMoved>(this);
 		m_universe.entityDestroyed().unbind<RenderSceneImpl, &RenderSceneImpl::onEntityDestroyed>(this);
 		CullingSystem::destroy(*m_culling_system);
 	}
@@ -238,7 +256,9 @@ public:
 			}
 		}
 		m_model_instances.clear();
+		m_skinning_palettes.clear();
 		m_culling_system->clear();
+		m_light_influence_grid.clear();
 
 		for (auto& probe : m_environment_probes)
 		{
@@ -587,6 +607,13 @@ public:
 	void update(float dt, bool paused) override
 	{
 		PROFILE_FUNCTION();
+		PROFILE_INT("skinning palettes computed", m_skinning_stats.palettes_computed);
+		PROFILE_INT("skinning palettes reused", m_skinning_stats.palettes_reused);
+		// poses are updated after this, palettes of the previous frame are not valid anymore
+		++m_skinning_frame;
+		m_skinning_stats.palettes_computed = 0;
+		m_skinning_stats.palettes_reused = 0;
+
 		if (m_is_game_running)
 		{
 			m_is_updating_attachments = true;
@@ -1035,7 +1062,6 @@ public:
 		m_point_lights.resize(size);
 		for (int i = 0; i < size; ++i)
 		{
-			m_light_influenced_geometry.push(Array<ComponentHandle>(m_allocator));
 			PointLight& light = m_point_lights[i];
 			if (version > RenderSceneVersion::SPECULAR_INTENSITY)
 			{
@@ -1058,6 +1084,7 @@ public:
 				light.m_specular_intensity = 1;
 			}
 			m_point_lights_map.insert(light.m_component, i);
+			detectLightInfluencedGeometry(light.m_component);
 
 			m_universe.addComponent(light.m_entity, POINT_LIGHT_TYPE, this, light.m_component);
 		}
@@ -1162,18 +1189,7 @@ public:
 	void destroyModelInstance(ComponentHandle component)
 	{
 		m_model_instance_destroyed.invoke(component);
-		for (int i = 0; i < m_light_influenced_geometry.size(); ++i)
-		{
-			Array<ComponentHandle>& influenced_geometry = m_light_influenced_geometry[i];
-			for (int j = 0; j < influenced_geometry.size(); ++j)
-			{
-				if (influenced_geometry[j] == component)
-				{
-					influenced_geometry.erase(j);
-					break;
-				}
-			}
-		}
+		m_light_influence_grid.removeInstance(component);
 
 		setModel(component, nullptr);
 		auto& model_instance = m_model_instances[component.index];
@@ -1213,7 +1229,7 @@ public:
 		Entity entity = m_point_lights[index].m_entity;
 		m_point_lights.eraseFast(index);
 		m_point_lights_map.erase(component);
-		m_light_influenced_geometry.eraseFast(index);
+		m_light_influence_grid.removeLight(component);
 		if (index < m_point_lights.size())
 		{
 			m_point_lights_map[m_point_lights[index].m_component] = index;
@@ -1859,22 +1875,6 @@ public:
 	}
 
 
-	Frustum getPointLightFrustum(ComponentHandle cmp) const
-	{
-		const PointLight& light = m_point_lights[m_point_lights_map[cmp]];
-		Frustum frustum;
-		frustum.computeOrtho(m_universe.getPosition(light.m_entity),
-			Vec3(1, 0, 0),
-			Vec3(0, 1, 0),
-			light.m_range,
-			light.m_range,
-			-light.m_range,
-			light.m_range);
-
-		return frustum;
-	}
-
-
 	void onEntityDestroyed(Entity entity)
 	{
 		for (auto& i : m_bone_attachments)
@@ -1888,6 +1888,16 @@ public:
 	}
 
 
+	void onEntitiesMoved(const Entity* entities, int count)
+	{
+		PROFILE_FUNCTION();
+		for (int i = 0; i < count; ++i)
+		{
+			onEntityMoved(entities[i]);
+		}
+	}
+
+
 	void onEntityMoved(Entity entity)
 	{
 		int index = entity.index;
@@ -1903,26 +1913,7 @@ public:
 				float radius = m_universe.getScale(entity) * r.model->getBoundingRadius();
 				Vec3 position = m_universe.getPosition(entity);
 				m_culling_system->updateBoundingSphere({position, radius}, cmp);
-			}
-
-			float bounding_radius = r.model ? r.model->getBoundingRadius() : 1;
-			for (int light_idx = 0, c = m_point_lights.size(); light_idx < c; ++light_idx)
-			{
-				for (int j = 0, c2 = m_light_influenced_geometry[light_idx].size(); j < c2; ++j)
-				{
-					if(m_light_influenced_geometry[light_idx][j] == cmp)
-					{
-						m_light_influenced_geometry[light_idx].eraseFast(j);
-						break;
-					}
-				}
-
-				Vec3 pos = m_universe.getPosition(r.entity);
-				Frustum frustum = getPointLightFrustum({light_idx});
-				if(frustum.isSphereInside(pos, bounding_radius))
-				{
-					m_light_influenced_geometry[light_idx].push(cmp);
-				}
+				m_light_influence_grid.setInstance(cmp, {position, radius});
 			}
 		}
 
@@ -1932,12 +1923,15 @@ public:
 			updateDecalInfo(m_decals.at(decal_idx));
 		}
 
-		for (int i = 0, c = m_point_lights.size(); i < c; ++i)
+		if (m_universe.hasComponent(entity, POINT_LIGHT_TYPE))
 		{
-			if (m_point_lights[i].m_entity == entity)
+			for (int i = 0, c = m_point_lights.size(); i < c; ++i)
 			{
-				detectLightInfluencedGeometry(m_point_lights[i].m_component);
-				break;
+				if (m_point_lights[i].m_entity == entity)
+				{
+					detectLightInfluencedGeometry(m_point_lights[i].m_component);
+					break;
+				}
 			}
 		}
 
@@ -2017,6 +2011,12 @@ public:
 	}
 
 
+	void getTerrainHeightsAt(ComponentHandle cmp, const Vec2* positions, int count, float* heights) override
+	{
+		m_terrains[{cmp.index}]->getHeights(positions, count, heights);
+	}
+
+
 	AABB getTerrainAABB(ComponentHandle cmp) override
 	{
 		return m_terrains[{cmp.index}]->getAABB();
@@ -2130,6 +2130,44 @@ public:
 	Pose* getPose(ComponentHandle cmp) override { return m_model_instances[cmp.index].pose; }
 
 
+	const Matrix* getSkinningPalette(ComponentHandle cmp) override
+	{
+		if (!m_model_instances[cmp.index].pose) return nullptr;
+
+		SkinningPalette& palette = m_skinning_palettes[cmp.index];
+		if (palette.frame == m_skinning_frame)
+		{
+			++m_skinning_stats.palettes_reused;
+		}
+		else
+		{
+			computeSkinningPalette(cmp);
+			++m_skinning_stats.palettes_computed;
+		}
+		return &palette.matrices[0];
+	}
+
+
+	const SkinningStats& getSkinningStats() const override { return m_skinning_stats; }
+
+
+	// called from jobs too, each palette must be computed by only one of them
+	void computeSkinningPalette(ComponentHandle cmp)
+	{
+		const ModelInstance& model_instance = m_model_instances[cmp.index];
+		const Pose& pose = *model_instance.pose;
+		const Model& model = *model_instance.model;
+		SkinningPalette& palette = m_skinning_palettes[cmp.index];
+		ASSERT(pose.count <= palette.matrices.size());
+		for (int bone_index = 0, bone_count = pose.count; bone_index < bone_count; ++bone_index)
+		{
+			Transform tmp = {pose.positions[bone_index], pose.rotations[bone_index]};
+			palette.matrices[bone_index] = (tmp * model.getBone(bone_index).inv_bind_transform).toMatrix();
+		}
+		palette.frame = m_skinning_frame;
+	}
+
+
 	Entity getModelInstanceEntity(ComponentHandle cmp) override { return m_model_instances[cmp.index].entity; }
 
 
@@ -2216,10 +2254,13 @@ public:
 
 		if (!m_is_grass_enabled) return;
 
+		int grass_memory = 0;
 		for (auto* terrain : m_terrains)
 		{
 			terrain->getGrassInfos(frustum, infos, camera);
+			grass_memory += terrain->getGrassMemory();
 		}
+		PROFILE_INT("grass memory KB", grass_memory >> 10);
 	}
 
 
@@ -2511,31 +2552,53 @@ public:
 		PROFILE_FUNCTION();
 		if (m_model_instances.empty()) return nullptr;
 
+		// results of cullViews are overwritten
+		m_are_culled_views_valid = false;
 		m_culling_system->cullToFrustumAsync(frustum, layer_mask);
 		return &m_culling_system->getResult();
 	}
 
 	
-	void runJobs(Array<MTJD::Job*>& jobs, MTJD::Group& sync_point)
+	// returns false if there are no visible occluders
+	bool rasterizeOccluders(const CullingSystem::Results& results,
+		const Array<CullingSystem::VisibilityMasks>* visibility_masks,
+		uint32 view_mask,
+		const Frustum& frustum)
 	{
 		PROFILE_FUNCTION();
-		for (int i = 0; i < jobs.size(); ++i)
-		{
-			m_engine.getMTJDManager().schedule(jobs[i]);
-		}
-		if (!jobs.empty())
+		bool is_cleared = false;
+		for (int i = 0; i < results.size(); ++i)
 		{
-			sync_point.sync();
+			const CullingSystem::Subresults& subresults = results[i];
+			for (int j = 0; j < subresults.size(); ++j)
+			{
+				if (visibility_masks && ((*visibility_masks)[i][j] & view_mask) == 0) continue;
+				const ModelInstance& model_instance = m_model_instances[subresults[j].index];
+				if (!model_instance.model->isOccluder()) continue;
+
+				if (!is_cleared)
+				{
+					m_occlusion_buffer.clear(frustum, OcclusionBuffer::DEFAULT_WIDTH, OcclusionBuffer::DEFAULT_HEIGHT);
+					is_cleared = true;
+				}
+				m_occlusion_buffer.addOccluder(*model_instance.model, model_instance.matrix);
+			}
 		}
+		if (!is_cleared) return false;
+
+		m_occlusion_buffer.rasterize(m_engine.getFrameAllocator());
+		return m_occlusion_buffer.hasOccluders();
 	}
 
 
+	// visibility_masks and view_mask select instances of one view from the results of multi-frustum culling
 	void fillTemporaryInfos(const CullingSystem::Results& results,
+		const Array<CullingSystem::VisibilityMasks>* visibility_masks,
+		uint32 view_mask,
 		const Frustum& frustum,
 		const Vec3& lod_ref_point)
 	{
 		PROFILE_FUNCTION();
-		m_jobs.clear();
 
 		while (m_temporary_infos.size() < results.size())
 		{
@@ -2546,47 +2609,67 @@ public:
 			m_temporary_infos.pop();
 		}
 
-		for (int subresult_index = 0; subresult_index < results.size(); ++subresult_index)
+		float lod_multiplier = m_lod_multiplier;
+		if (frustum.fov > 0)
 		{
-			Array<ModelInstanceMesh>& subinfos = m_temporary_infos[subresult_index];
-			subinfos.clear();
-			if (results[subresult_index].empty()) continue;
+			float t = frustum.fov / Math::degreesToRadians(60.0f);
+			lod_multiplier *= t * t;
+		}
+		// occlusion buffer supports only perspective projection
+		bool is_occlusion_culled = frustum.fov > 0 && rasterizeOccluders(results, visibility_masks, view_mask, frustum);
 
-			MTJD::Job* job = MTJD::makeJob(m_engine.getMTJDManager(),
-				[&subinfos, this, &results, subresult_index, &frustum, lod_ref_point]()
+		auto fill = [this, &results, visibility_masks, view_mask, lod_ref_point, lod_multiplier, is_occlusion_culled](
+			int from, int to)
+		{
+			PROFILE_BLOCK("Temporary Info Job");
+			for (int subresult_index = from; subresult_index < to; ++subresult_index)
+			{
+				Array<ModelInstanceMesh>& subinfos = m_temporary_infos[subresult_index];
+				subinfos.clear();
+				if (results[subresult_index].empty()) continue;
+
+				PROFILE_INT("ModelInstance count", results[subresult_index].size());
+				const ComponentHandle* LUMIX_RESTRICT raw_subresults = &results[subresult_index][0];
+				const uint32* LUMIX_RESTRICT masks = visibility_masks ? &(*visibility_masks)[subresult_index][0] : nullptr;
+				ModelInstance* LUMIX_RESTRICT model_instances = &m_model_instances[0];
+				int occluded_count = 0;
+				int palettes_count = 0;
+				for (int i = 0, c = results[subresult_index].size(); i < c; ++i)
 				{
-					PROFILE_BLOCK("Temporary Info Job");
-					PROFILE_INT("ModelInstance count", results[subresult_index].size());
-					Vec3 ref_point = lod_ref_point;
-					float lod_multiplier = m_lod_multiplier;
-					if (frustum.fov > 0)
+					if (masks && (masks[i] & view_mask) == 0) continue;
+					ModelInstance* LUMIX_RESTRICT model_instance = &model_instances[raw_subresults[i].index];
+					Model* LUMIX_RESTRICT model = model_instance->model;
+					if (is_occlusion_culled && !m_occlusion_buffer.isVisible(model_instance->matrix, model->getAABB()))
 					{
-						float t = frustum.fov / Math::degreesToRadians(60.0f);
-						lod_multiplier *= t * t;
+						++occluded_count;
+						continue;
 					}
-					const ComponentHandle* LUMIX_RESTRICT raw_subresults = &results[subresult_index][0];
-					ModelInstance* LUMIX_RESTRICT model_instances = &m_model_instances[0];
-					for (int i = 0, c = results[subresult_index].size(); i < c; ++i)
+
+					float squared_distance = (model_instance->matrix.getTranslation() - lod_ref_point).squaredLength();
+					squared_distance *= lod_multiplier;
+
+					LODMeshIndices lod = model->getLODMeshIndices(squared_distance);
+					for (int j = lod.from, c = lod.to; j <= c; ++j)
 					{
-						ModelInstance* LUMIX_RESTRICT model_instance = &model_instances[raw_subresults[i].index];
-						float squared_distance = (model_instance->matrix.getTranslation() - ref_point).squaredLength();
-						squared_distance *= lod_multiplier;
+						auto& info = subinfos.emplace();
+						info.model_instance = raw_subresults[i];
+						info.mesh = &model_instance->meshes[j];
+					}
 
-						Model* LUMIX_RESTRICT model = model_instance->model;
-						LODMeshIndices lod = model->getLODMeshIndices(squared_distance);
-						for (int j = lod.from, c = lod.to; j <= c; ++j)
-						{
-							auto& info = subinfos.emplace();
-							info.model_instance = raw_subresults[i];
-							info.mesh = &model_instance->meshes[j];
-						}
+					// an instance is only in one subresult, so no other job computes its palette
+					if (model_instance->pose && m_skinning_palettes[raw_subresults[i].index].frame != m_skinning_frame)
+					{
+						computeSkinningPalette(raw_subresults[i]);
+						++palettes_count;
 					}
-				},
-				m_allocator);
-			job->addDependency(&m_sync_point);
-			m_jobs.push(job);
-		}
-		runJobs(m_jobs, m_sync_point);
+				}
+				if (is_occlusion_culled) PROFILE_INT("occluded", occluded_count);
+				if (palettes_count > 0) MT::atomicAdd(&m_skinning_stats.palettes_computed, palettes_count);
+			}
+		};
+		MTJD::JoinHandle handle =
+			MTJD::parallelFor(m_engine.getMTJDManager(), m_engine.getFrameAllocator(), 0, results.size(), 1, fill);
+		handle.join();
 	}
 
 
@@ -2690,12 +2773,12 @@ public:
 	{
 		PROFILE_FUNCTION();
 
-		int light_index = m_point_lights_map[light_cmp];
-		for (int j = 0, cj = m_light_influenced_geometry[light_index].size(); j < cj; ++j)
+		const Array<ComponentHandle>& geoms = m_light_influence_grid.getInfluencedInstances(light_cmp);
+		for (int j = 0, cj = geoms.size(); j < cj; ++j)
 		{
-			ComponentHandle model_instance_cmp = m_light_influenced_geometry[light_index][j];
+			ComponentHandle model_instance_cmp = geoms[j];
 			ModelInstance& model_instance = m_model_instances[model_instance_cmp.index];
-			const Sphere& sphere = m_culling_system->getSphere(model_instance_cmp);
+			Sphere sphere = m_culling_system->getSphere(model_instance_cmp);
 			if (frustum.isSphereInside(sphere.position, sphere.radius))
 			{
 				for (int k = 0, kc = model_instance.model->getMeshCount(); k < kc; ++k)
@@ -2713,8 +2796,7 @@ public:
 	{
 		PROFILE_FUNCTION();
 
-		int light_index = m_point_lights_map[light_cmp];
-		auto& geoms = m_light_influenced_geometry[light_index];
+		auto& geoms = m_light_influence_grid.getInfluencedInstances(light_cmp);
 		for (int j = 0, cj = geoms.size(); j < cj; ++j)
 		{
 			const ModelInstance& model_instance = m_model_instances[geoms[j].index];
@@ -2755,11 +2837,50 @@ public:
 		const CullingSystem::Results* results = cull(frustum, layer_mask);
 		if (!results) return m_temporary_infos;
 
-		fillTemporaryInfos(*results, frustum, lod_ref_point);
+		fillTemporaryInfos(*results, nullptr, 0, frustum, lod_ref_point);
+		return m_temporary_infos;
+	}
+
+
+	void cullViews(const Frustum* frustums, int count, const uint64* layer_masks) override
+	{
+		PROFILE_FUNCTION();
+		ASSERT(count <= lengthOf(m_culled_views));
+		for (int i = 0; i < count; ++i)
+		{
+			m_culled_views[i] = frustums[i];
+			m_culled_views_layer_masks[i] = layer_masks[i];
+		}
+		m_culled_views_count = count;
+		m_are_culled_views_valid = !m_model_instances.empty();
+		if (m_are_culled_views_valid) m_culling_system->cullToFrustums(frustums, count, layer_masks);
+	}
+
+
+	Array<Array<ModelInstanceMesh>>& getCulledModelInstanceInfos(int view, const Vec3& lod_ref_point) override
+	{
+		PROFILE_FUNCTION();
+
+		ASSERT(view < m_culled_views_count);
+		if (!m_are_culled_views_valid)
+		{
+			return getModelInstanceInfos(m_culled_views[view], lod_ref_point, m_culled_views_layer_masks[view]);
+		}
+
+		for (auto& i : m_temporary_infos) i.clear();
+		const CullingSystem::Results& results = m_culling_system->getResult();
+		const Array<CullingSystem::VisibilityMasks>& visibility_masks = m_culling_system->getVisibilityMasks();
+		fillTemporaryInfos(results, &visibility_masks, 1U << view, m_culled_views[view], lod_ref_point);
 		return m_temporary_infos;
 	}
 
 
+	bool areCulledViewsValid() const override { return m_are_culled_views_valid; }
+
+
+	void enableTemporalCulling(bool enabled) override { m_culling_system->enableTemporalCache(enabled); }
+
+
 	void setCameraSlot(ComponentHandle cmp, const char* slot) override
 	{
 		auto& camera = m_cameras[{cmp.index}];
@@ -3476,37 +3597,38 @@ public:
 	RayCastModelHit castRay(const Vec3& origin, const Vec3& dir, ComponentHandle ignored_model_instance) override
 	{
 		PROFILE_FUNCTION();
-		RayCastModelHit hit;
-		hit.m_is_hit = false;
-		float cur_dist = FLT_MAX;
-		Universe& universe = getUniverse();
-		for (int i = 0; i < m_model_instances.size(); ++i)
-		{
-			auto& r = m_model_instances[i];
-			if (ignored_model_instance.index == i || !r.model) continue;
-
-			const Vec3& pos = r.matrix.getTranslation();
-			float radius = r.model->getBoundingRadius();
-			float scale = universe.getScale(r.entity);
-			float dist = (pos - origin).length();
-			if (dist - radius * scale > cur_dist) continue;
-			
-			Vec3 intersection;
-			if (dotProduct(pos - origin, pos - origin) < radius * radius ||
-				Math::getRaySphereIntersection(origin, dir, pos, radius * scale, intersection))
-			{
-				RayCastModelHit new_hit = r.model->castRay(origin, dir, r.matrix);
-				if (new_hit.m_is_hit && (!hit.m_is_hit || new_hit.m_t < hit.m_t))
-				{
-					new_hit.m_component = {i};
-					new_hit.m_entity = r.entity;
-					new_hit.m_component_type = MODEL_INSTANCE_TYPE;
-					hit = new_hit;
-					hit.m_is_hit = true;
-					cur_dist = dir.length() * hit.m_t;
-				}
-			}
-		}
+		return castRay(origin, dir, ignored_model_instance, m_ray_hits);
+	}
+
+
+	void castRays(const Ray* rays, int count, RayCastModelHit* out) override
+	{
+		PROFILE_FUNCTION();
+		PROFILE_INT("rays", count);
+		auto cast = [this](const Ray& ray, CullingSystem::RayHits& candidates) {
+			return castRay(ray.origin, ray.dir, INVALID_COMPONENT, candidates);
+		};
+		castRaysInJobs(m_engine.getMTJDManager(), m_engine.getFrameAllocator(), rays, count, out, cast);
+	}
+
+
+	// candidates is only a scratch buffer, so a batch of rays can reuse it
+	RayCastModelHit castRay(const Vec3& origin,
+		const Vec3& dir,
+		ComponentHandle ignored_model_instance,
+		CullingSystem::RayHits& candidates) const
+	{
+		// bounding spheres of all visible model instances are in the culling system
+		auto hit_instance = [this](ComponentHandle model_instance, const Vec3& origin, const Vec3& dir) {
+			const ModelInstance& r = m_model_instances[model_instance.index];
+			RayCastModelHit hit = r.model->castRay(origin, dir, r.matrix);
+			hit.m_component = model_instance;
+			hit.m_entity = r.entity;
+			hit.m_component_type = MODEL_INSTANCE_TYPE;
+			return hit;
+		};
+		RayCastModelHit hit =
+			castRayOnInstances(*m_culling_system, origin, dir, ignored_model_instance, candidates, hit_instance);
 
 		for (auto* terrain : m_terrains)
 		{
@@ -3625,6 +3747,7 @@ public:
 	void setLightRange(ComponentHandle cmp, float value) override
 	{
 		m_point_lights[m_point_lights_map[cmp]].m_range = value;
+		detectLightInfluencedGeometry(cmp);
 	}
 
 
@@ -3818,10 +3941,7 @@ public:
 		LUMIX_DELETE(m_allocator, r.pose);
 		r.pose = nullptr;
 
-		for (int i = 0; i < m_point_lights.size(); ++i)
-		{
-			m_light_influenced_geometry[i].eraseItemFast(component);
-		}
+		m_light_influence_grid.removeInstance(component);
 		m_culling_system->removeStatic(component);
 	}
 
@@ -3861,6 +3981,10 @@ public:
 			r.pose = LUMIX_NEW(m_allocator, Pose)(m_allocator);
 			r.pose->resize(model->getBoneCount());
 			model->getPose(*r.pose);
+			while (component.index >= m_skinning_palettes.size()) m_skinning_palettes.emplace(m_allocator);
+			SkinningPalette& palette = m_skinning_palettes[component.index];
+			palette.matrices.resize(model->getBoneCount());
+			palette.frame = 0;
 			int skinned_define_idx = m_renderer.getShaderDefineIdx("SKINNED");
 			for (int i = 0; i < model->getMeshCount(); ++i)
 			{
@@ -3890,17 +4014,7 @@ public:
 			r.mesh_count = r.model->getMeshCount();
 		}
 
-		for (int i = 0; i < m_point_lights.size(); ++i)
-		{
-			PointLight& light = m_point_lights[i];
-			Vec3 t = r.matrix.getTranslation();
-			float radius = r.model->getBoundingRadius();
-			if ((t - m_universe.getPosition(light.m_entity)).squaredLength() <
-				(radius + light.m_range) * (radius + light.m_range))
-			{
-				m_light_influenced_geometry[i].push(component);
-			}
-		}
+		m_light_influence_grid.setInstance(component, sphere);
 	}
 
 
@@ -4045,6 +4159,7 @@ public:
 			if (old_model->isReady())
 			{
 				m_culling_system->removeStatic(component);
+				m_light_influence_grid.removeInstance(component);
 			}
 			old_model->getResourceManager().unload(*old_model);
 		}
@@ -4070,20 +4185,8 @@ public:
 
 	void detectLightInfluencedGeometry(ComponentHandle cmp)
 	{
-		Frustum frustum = getPointLightFrustum(cmp);
-		m_culling_system->cullToFrustum(frustum, 0xffffFFFF);
-		const CullingSystem::Results& results = m_culling_system->getResult();
-		auto& influenced_geometry = m_light_influenced_geometry[cmp.index];
-		influenced_geometry.clear();
-		for (int i = 0; i < results.size(); ++i)
-		{
-			const CullingSystem::Subresults& subresult = results[i];
-			influenced_geometry.reserve(influenced_geometry.size() + subresult.size());
-			for (int j = 0, c = subresult.size(); j < c; ++j)
-			{
-				influenced_geometry.push(subresult[j]);
-			}
-		}
+		const PointLight& light = m_point_lights[m_point_lights_map[cmp]];
+		m_light_influence_grid.setLight(cmp, m_universe.getPosition(light.m_entity), light.m_range);
 	}
 
 
@@ -4272,7 +4375,6 @@ public:
 	ComponentHandle createPointLight(Entity entity)
 	{
 		PointLight& light = m_point_lights.emplace();
-		m_light_influenced_geometry.emplace(m_allocator);
 		light.m_entity = entity;
 		light.m_diffuse_color.set(1, 1, 1);
 		light.m_diffuse_intensity = 1;
@@ -4403,7 +4505,7 @@ private:
 	CullingSystem* m_culling_system;
 
 	ComponentHandle m_point_light_last_cmp;
-	Array<Array<ComponentHandle>> m_light_influenced_geometry;
+	LightInfluenceGrid m_light_influence_grid;
 	ComponentHandle m_active_global_light_cmp;
 	ComponentHandle m_global_light_last_cmp;
 	HashMap<ComponentHandle, int> m_point_lights_map;
@@ -4423,8 +4525,16 @@ private:
 	Array<DebugPoint> m_debug_points;
 
 	Array<Array<ModelInstanceMesh>> m_temporary_infos;
-	MTJD::Group m_sync_point;
-	Array<MTJD::Job*> m_jobs;
+	// scratch buffer of castRay, which is called only from the main thread
+	CullingSystem::RayHits m_ray_hits;
+	Array<SkinningPalette> m_skinning_palettes;
+	uint32 m_skinning_frame;
+	SkinningStats m_skinning_stats;
+	Frustum m_culled_views[CullingSystem::MAX_FRUSTUMS];
+	uint64 m_culled_views_layer_masks[CullingSystem::MAX_FRUSTUMS];
+	int m_culled_views_count;
+	bool m_are_culled_views_valid;
+	OcclusionBuffer m_occlusion_buffer;
 
 	float m_time;
 	float m_lod_multiplier;
@@ -4496,15 +4606,19 @@ RenderSceneImpl::RenderSceneImpl(Renderer& renderer,
 	, m_cameras(m_allocator)
 	, m_terrains(m_allocator)
 	, m_point_lights(m_allocator)
-	, m_light_influenced_geometry(m_allocator)
+	, m_light_influence_grid(m_allocator)
 	, m_global_lights(m_allocator)
 	, m_decals(m_allocator)
 	, m_debug_triangles(m_allocator)
 	, m_debug_lines(m_allocator)
 	, m_debug_points(m_allocator)
 	, m_temporary_infos(m_allocator)
-	, m_sync_point(true, m_allocator)
-	, m_jobs(m_allocator)
+	, m_ray_hits(m_allocator)
+	, m_skinning_palettes(m_allocator)
+	, m_skinning_frame(1)
+	, m_culled_views_count(0)
+	, m_are_culled_views_valid(false)
+	, m_occlusion_buffer(engine.getMTJDManager(), m_allocator)
 	, m_active_global_light_cmp(INVALID_COMPONENT)
 	, m_global_light_last_cmp(INVALID_COMPONENT)
 	, m_point_light_last_cmp(INVALID_COMPONENT)
@@ -4522,9 +4636,13 @@ RenderSceneImpl::RenderSceneImpl(Renderer& renderer,
 {
 	is_opengl = renderer.isOpenGL();
 	m_universe.entityTransformed().bind<RenderSceneImpl, &RenderSceneImpl::onEntityMoved>(this);
+	m_universe.entitiesTransformed().bind<RenderSceneImpl, &RenderSceneImpl::onEntitiesMoved>(this);
 	m_universe.entityDestroyed().bind<RenderSceneImpl, &RenderSceneImpl::onEntityDestroyed>(this);
-	m_culling_system = CullingSystem::create(m_engine.getMTJDManager(), m_allocator);
+	m_culling_system =
+		CullingSystem::create(m_engine.getMTJDManager(), m_allocator, (uint32)CullingSystem::Flags::HIERARCHICAL);
 	m_model_instances.reserve(5000);
+	m_skinning_stats.palettes_computed = 0;
+	m_skinning_stats.palettes_reused = 0;
 
 	for (auto& i : COMPONENT_INFOS)
 	{
@@ -4,6 +4,7 @@
 #include "engine/lumix.h"
 #include "engine/matrix.h"
 #include "engine/iplugin.h"
+#include <bgfx/bgfx.h>
 
 
 struct lua_State;
@@ -22,6 +23,7 @@ struct Mesh;
 class Model;
 class Path;
 struct  Pose;
+struct Ray;
 struct RayCastModelHit;
 class Renderer;
 class Shader;
@@ -104,6 +106,13 @@ struct ModelInstance
 };
 
 
+struct SkinningStats
+{
+	int32 palettes_computed; // at most once per skinned instance and frame
+	int32 palettes_reused; // requests served by a palette computed earlier in the same frame
+};
+
+
 struct ModelInstanceMesh
 {
 	ComponentHandle model_instance;
@@ -113,13 +122,15 @@ struct ModelInstanceMesh
 
 struct GrassInfo
 {
+	// what the grass shader reads, expanded from the compact instances by expandGrassInstances
 	struct InstanceData
 	{
 		Matrix matrix;
 		Vec4 normal;
 	};
 	Model* model;
-	const InstanceData* instance_data;
+	// InstanceData of the patch, expanded when the patch became visible
+	bgfx::VertexBufferHandle instance_buffer;
 	int instance_count;
 	float type_distance;
 };
@@ -163,6 +174,8 @@ public:
 	static void registerLuaAPI(lua_State* L);
 
 	virtual RayCastModelHit castRay(const Vec3& origin, const Vec3& dir, ComponentHandle ignore) = 0;
+	// casts count rays on all worker threads, out[i] is the same as castRay(rays[i], INVALID_COMPONENT) returns
+	virtual void castRays(const Ray* rays, int count, RayCastModelHit* out) = 0;
 	virtual RayCastModelHit castRayTerrain(ComponentHandle terrain, const Vec3& origin, const Vec3& dir) = 0;
 	virtual void getRay(ComponentHandle camera, float x, float y, Vec3& origin, Vec3& dir) = 0;
 
@@ -172,6 +185,10 @@ public:
 	virtual IAllocator& getAllocator() = 0;
 
 	virtual Pose* getPose(ComponentHandle cmp) = 0;
+	// bone matrices of the current pose multiplied by inverse bind matrices, computed once per frame
+	virtual const Matrix* getSkinningPalette(ComponentHandle cmp) = 0;
+	// counters of the current frame
+	virtual const SkinningStats& getSkinningStats() const = 0;
 	virtual ComponentHandle getActiveGlobalLight() = 0;
 	virtual void setActiveGlobalLight(ComponentHandle cmp) = 0;
 	virtual Vec4 getShadowmapCascades(ComponentHandle cmp) = 0;
@@ -341,6 +358,14 @@ public:
 	virtual Array<Array<ModelInstanceMesh>>& getModelInstanceInfos(const Frustum& frustum,
 		const Vec3& lod_ref_point,
 		uint64 layer_mask) = 0;
+	// culls all views in one pass, meshes of each view are then returned by getCulledModelInstanceInfos
+	virtual void cullViews(const Frustum* frustums, int count, const uint64* layer_masks) = 0;
+	virtual Array<Array<ModelInstanceMesh>>& getCulledModelInstanceInfos(int view, const Vec3& lod_ref_point) = 0;
+	// false once any other culling overwrote the results of cullViews
+	virtual bool areCulledViewsValid() const = 0;
+	// culling results are cached and reused while the view does not move, it pays off in views
+	// which are often still, such as the editor and asset previews, so it is off by default
+	virtual void enableTemporalCulling(bool enabled) = 0;
 	virtual void getModelInstanceEntities(const Frustum& frustum, Array<Entity>& entities) = 0;
 	virtual Entity getModelInstanceEntity(ComponentHandle cmp) = 0;
 	virtual ComponentHandle getFirstModelInstance() = 0;
@@ -359,6 +384,8 @@ public:
 	virtual void forceGrassUpdate(ComponentHandle cmp) = 0;
 	virtual void getTerrainInfos(Array<TerrainInfo>& infos, const Vec3& camera_pos) = 0;
 	virtual float getTerrainHeightAt(ComponentHandle cmp, float x, float z) = 0;
+	// positions are (x, z) pairs in terrain space, e.g. for placing many objects at once
+	virtual void getTerrainHeightsAt(ComponentHandle cmp, const Vec2* positions, int count, float* heights) = 0;
 	virtual Vec3 getTerrainNormalAt(ComponentHandle cmp, float x, float z) = 0;
 	virtual void setTerrainMaterialPath(ComponentHandle cmp, const Path& path) = 0;
 	virtual Path getTerrainMaterialPath(ComponentHandle cmp) = 0;
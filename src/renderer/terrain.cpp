@@ -1,16 +1,21 @@
 #include "terrain.h"
 #include "engine/blob.h"
 #include "engine/crc32.h"
+#include "engine/frame_allocator.h"
 #include "engine/geometry.h"
 #include "engine/json_serializer.h"
 #include "engine/lifo_allocator.h"
 #include "engine/log.h"
 #include "engine/math_utils.h"
+#include "engine/mtjd/generic_job.h"
+#include "engine/mtjd/parallel_for.h"
 #include "engine/profiler.h"
 #include "engine/property_register.h"
 #include "engine/resource_manager.h"
 #include "engine/resource_manager_base.h"
+#include "engine/string.h"
 #include "engine/engine.h"
+#include "renderer/heightmap_sampler.h"
 #include "renderer/material.h"
 #include "renderer/model.h"
 #include "renderer/render_scene.h"
@@ -27,6 +32,10 @@ namespace Lumix
 
 static const float  GRASS_QUAD_SIZE = 10.0f;
 static const float GRASS_QUAD_RADIUS = GRASS_QUAD_SIZE * 0.7072f;
+// quads out of range kept per camera
+static const int GRASS_CACHE_SIZE = 64;
+// grass patches per job when expanding their instances, a patch has hundreds to thousands of instances
+static const int GRASS_PATCHES_GRAIN = 1;
 static const int GRID_SIZE = 16;
 static const int COPY_COUNT = 50;
 static const ComponentType TERRAIN_HASH = PropertyRegister::getComponentType("terrain");
@@ -48,6 +57,26 @@ struct Sample
 	float u, v;
 };
 
+
+// xorshift, each quad has its own so quads can be generated in jobs and always look the same
+struct GrassRandom
+{
+	explicit GrassRandom(uint32 seed)
+		: state(seed ? seed : 1)
+	{
+	}
+
+	float randFloat(float from, float to)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return from + (to - from) * (state >> 8) * (1.0f / 16777216.0f);
+	}
+
+	uint32 state;
+};
+
 struct TerrainQuad
 {
 	enum ChildType
@@ -177,6 +206,7 @@ Terrain::Terrain(Renderer& renderer, Entity entity, RenderScene& scene, IAllocat
 	, m_root(nullptr)
 	, m_detail_texture(nullptr)
 	, m_heightmap(nullptr)
+	, m_height_pyramid(allocator)
 	, m_splatmap(nullptr)
 	, m_width(0)
 	, m_height(0)
@@ -192,9 +222,18 @@ Terrain::Terrain(Renderer& renderer, Entity entity, RenderScene& scene, IAllocat
 	, m_vertices_handle(BGFX_INVALID_HANDLE)
 	, m_indices_handle(BGFX_INVALID_HANDLE)
 	, m_grass_distance(5)
-	, m_force_grass_update(false)
+	, m_grass_update_counter(0)
 {
 	generateGeometry();
+	// only the stride matters for instance data
+	m_grass_instance_decl.begin()
+		.add(bgfx::Attrib::TexCoord0, 4, bgfx::AttribType::Float)
+		.add(bgfx::Attrib::TexCoord1, 4, bgfx::AttribType::Float)
+		.add(bgfx::Attrib::TexCoord2, 4, bgfx::AttribType::Float)
+		.add(bgfx::Attrib::TexCoord3, 4, bgfx::AttribType::Float)
+		.add(bgfx::Attrib::TexCoord4, 4, bgfx::AttribType::Float)
+		.end();
+	ASSERT(m_grass_instance_decl.getStride() == sizeof(GrassInfo::InstanceData));
 }
 
 Terrain::GrassType::~GrassType()
@@ -208,6 +247,7 @@ Terrain::GrassType::~GrassType()
 
 Terrain::~Terrain()
 {
+	waitForGrass();
 	bgfx::destroyIndexBuffer(m_indices_handle);
 	bgfx::destroyVertexBuffer(m_vertices_handle);
 
@@ -247,6 +287,7 @@ float Terrain::getRootSize() const
 
 void Terrain::addGrassType(int index)
 {
+	waitForGrass();
 	if(index < 0)
 	{
 		m_grass_types.push(LUMIX_NEW(m_allocator, GrassType)(*this, m_grass_types.size()));
@@ -347,9 +388,40 @@ void Terrain::setGrassTypePath(int index, const Path& path)
 }
 	
 
+void Terrain::waitForGrass()
+{
+	MTJD::Manager& manager = m_scene.getEngine().getMTJDManager();
+	for (int i = 0; i < m_grass_quads.size(); ++i)
+	{
+		for (GrassQuad* quad : m_grass_quads.at(i))
+		{
+			if (!quad->isReady()) manager.wait(quad->job);
+		}
+	}
+}
+
+
+void Terrain::destroyGrassQuad(GrassQuad* quad)
+{
+	if (!quad->isReady()) m_scene.getEngine().getMTJDManager().wait(quad->job);
+	LUMIX_DELETE(m_allocator, quad);
+}
+
+
+void Terrain::GrassQuad::destroyInstanceBuffers()
+{
+	for (GrassPatch& patch : m_patches)
+	{
+		if (bgfx::isValid(patch.instance_buffer)) bgfx::destroyVertexBuffer(patch.instance_buffer);
+		patch.instance_buffer = BGFX_INVALID_HANDLE;
+	}
+}
+
+
 void Terrain::forceGrassUpdate()
 {
-	m_force_grass_update = true;
+	waitForGrass();
+	m_last_camera_position.clear();
 	for (int i = 0; i < m_grass_quads.size(); ++i)
 	{
 		Array<GrassQuad*>& quads = m_grass_quads.at(i);
@@ -373,7 +445,7 @@ Array<Terrain::GrassQuad*>& Terrain::getQuads(ComponentHandle camera)
 }
 
 
-void Terrain::generateGrassTypeQuad(GrassPatch& patch, const Matrix& terrain_matrix, float quad_x, float quad_z)
+void Terrain::generateGrassTypeQuad(GrassPatch& patch, float quad_x, float quad_z)
 {
 	ASSERT(quad_x >= 0);
 	ASSERT(quad_z >= 0);
@@ -392,9 +464,11 @@ void Terrain::generateGrassTypeQuad(GrassPatch& patch, const Matrix& terrain_mat
 	float base_tx = tx_step * quad_x - tx_step * 0.5f;
 
 	struct { float x, y; void* type; } hashed_patch = { quad_x, quad_z, patch.m_type };
-	uint32 hash = crc32(&hashed_patch, sizeof(hashed_patch));
-	Math::seedRandom(hash);
+	GrassRandom random(crc32(&hashed_patch, sizeof(hashed_patch)));
 
+	// positions first, so heights and normals are sampled in bulk
+	Array<Vec2> positions(m_allocator);
+	Array<float> densities(m_allocator);
 	for (float dz = 0; dz < quad_height; dz += step)
 	{
 		int y_offset = int(splat_map->height * (quad_z + dz) / (m_height * m_scale.x)) * splat_map->width;
@@ -410,18 +484,72 @@ void Terrain::generateGrassTypeQuad(GrassPatch& patch, const Matrix& terrain_mat
 			float density = ((pixel_value >> 8) & 0xff) * DIV255;
 			if (density < 0.25f) continue;
 
-			Matrix tmp = Matrix::IDENTITY;
-			float x = quad_x + dx + step * Math::randFloat(-0.5f, 0.5f);
-			float z = quad_z + dz + step * Math::randFloat(-0.5f, 0.5f);
-			tmp.setTranslation(Vec3(x, getHeight(x, z), z));
-			Quat q(Vec3(0, 1, 0), Math::randFloat(0, Math::PI * 2));
-			tmp = terrain_matrix * tmp * q.toMatrix();
-			tmp.multiply3x3(density + Math::randFloat(-0.1f, 0.1f));
-			GrassPatch::InstanceData& instance_data = patch.instance_data.emplace();
-			instance_data.matrix = tmp;
-			instance_data.normal = Vec4(getNormal(x, z), 0);
+			float x = quad_x + dx + step * random.randFloat(-0.5f, 0.5f);
+			float z = quad_z + dz + step * random.randFloat(-0.5f, 0.5f);
+			positions.emplace(x, z);
+			densities.push(density);
 		}
 	}
+	if (positions.empty()) return;
+
+	Array<float> heights(m_allocator);
+	Array<Vec3> normals(m_allocator);
+	heights.resize(positions.size());
+	normals.resize(positions.size());
+	getHeightsAndNormals(&positions[0], positions.size(), &heights[0], &normals[0]);
+
+	Vec3 pos_max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	patch.pos_min.set(FLT_MAX, FLT_MAX, FLT_MAX);
+	for (int i = 0, c = positions.size(); i < c; ++i)
+	{
+		patch.pos_min.x = Math::minimum(patch.pos_min.x, positions[i].x);
+		patch.pos_min.y = Math::minimum(patch.pos_min.y, heights[i]);
+		patch.pos_min.z = Math::minimum(patch.pos_min.z, positions[i].y);
+		pos_max.x = Math::maximum(pos_max.x, positions[i].x);
+		pos_max.y = Math::maximum(pos_max.y, heights[i]);
+		pos_max.z = Math::maximum(pos_max.z, positions[i].y);
+	}
+	patch.pos_step = (pos_max - patch.pos_min) * (1 / GRASS_QUANTIZED_POSITION_MAX);
+
+	patch.instance_data.resize(positions.size());
+	for (int i = 0, c = positions.size(); i < c; ++i)
+	{
+		Vec3 pos(positions[i].x, heights[i], positions[i].y);
+		float yaw = random.randFloat(0, Math::PI * 2);
+		float scale = densities[i] + random.randFloat(-0.1f, 0.1f);
+		packGrassInstance(pos, yaw, scale, normals[i], patch.pos_min, patch.pos_step, &patch.instance_data[i]);
+	}
+}
+
+
+// runs in a job
+void Terrain::generateGrassQuad(GrassQuad& quad)
+{
+	PROFILE_FUNCTION();
+	float quad_x = quad.x * GRASS_QUAD_SIZE;
+	float quad_z = quad.z * GRASS_QUAD_SIZE;
+	quad.pos.x = quad_x;
+	quad.pos.z = quad_z;
+	quad.m_patches.reserve(m_grass_types.size());
+
+	float min_y = FLT_MAX;
+	float max_y = -FLT_MAX;
+	for (auto* grass_type : m_grass_types)
+	{
+		Model* model = grass_type->m_grass_model;
+		if (!model || !model->isReady()) continue;
+		GrassPatch& patch = quad.m_patches.emplace(m_allocator);
+		patch.m_type = grass_type;
+
+		generateGrassTypeQuad(patch, quad_x, quad_z);
+		if (patch.instance_data.empty()) continue;
+		min_y = Math::minimum(patch.pos_min.y, min_y);
+		max_y = Math::maximum(patch.pos_min.y + patch.pos_step.y * GRASS_QUANTIZED_POSITION_MAX, max_y);
+	}
+	if (min_y > max_y) min_y = max_y = 0;
+
+	quad.pos.y = (max_y + min_y) * 0.5f;
+	quad.radius = Math::maximum((max_y - min_y) * 0.5f, GRASS_QUAD_SIZE) * Math::SQRT2;
 }
 
 
@@ -433,89 +561,149 @@ void Terrain::updateGrass(ComponentHandle camera)
 	Universe& universe = m_scene.getUniverse();
 	Entity camera_entity = m_scene.getCameraEntity(camera);
 	Vec3 camera_pos = universe.getPosition(camera_entity);
-
-	if ((m_last_camera_position[camera] - camera_pos).length() <= FLT_MIN && !m_force_grass_update) return;
-	m_last_camera_position[camera] = camera_pos;
-
-	m_force_grass_update = false;
 	Matrix terrain_mtx = universe.getMatrix(m_entity);
 	Matrix inv_mtx = terrain_mtx;
 	inv_mtx.fastInverse();
 	Vec3 local_camera_pos = inv_mtx.transform(camera_pos);
-	float cx = (int)(local_camera_pos.x / (GRASS_QUAD_SIZE)) * GRASS_QUAD_SIZE;
-	float cz = (int)(local_camera_pos.z / (GRASS_QUAD_SIZE)) * GRASS_QUAD_SIZE;
-	float from_quad_x = cx - m_grass_distance * GRASS_QUAD_SIZE;
-	float from_quad_z = cz - m_grass_distance * GRASS_QUAD_SIZE;
-	float to_quad_x = cx + m_grass_distance * GRASS_QUAD_SIZE;
-	float to_quad_z = cz + m_grass_distance * GRASS_QUAD_SIZE;
-
-	float old_bounds[4] = {FLT_MAX, -FLT_MAX, FLT_MAX, -FLT_MAX};
-	Array<GrassQuad*>& quads = getQuads(camera);
-	for (int i = quads.size() - 1; i >= 0; --i)
-	{
-		GrassQuad* quad = quads[i];
-		old_bounds[0] = Math::minimum(old_bounds[0], quad->pos.x);
-		old_bounds[1] = Math::maximum(old_bounds[1], quad->pos.x);
-		old_bounds[2] = Math::minimum(old_bounds[2], quad->pos.z);
-		old_bounds[3] = Math::maximum(old_bounds[3], quad->pos.z);
-		if (quad->pos.x < from_quad_x || quad->pos.x > to_quad_x || quad->pos.z < from_quad_z ||
-			quad->pos.z > to_quad_z)
-		{
-			LUMIX_DELETE(m_allocator, quads[i]);
-			quads.eraseFast(i);
-		}
+	int cx = (int)(local_camera_pos.x / GRASS_QUAD_SIZE);
+	int cz = (int)(local_camera_pos.z / GRASS_QUAD_SIZE);
+
+	// quads change only when the camera moves to another quad
+	int last_idx = m_last_camera_position.find(camera);
+	if (last_idx >= 0)
+	{
+		const Vec3& last_pos = m_last_camera_position.at(last_idx);
+		if ((int)(last_pos.x / GRASS_QUAD_SIZE) == cx && (int)(last_pos.z / GRASS_QUAD_SIZE) == cz) return;
 	}
+	m_last_camera_position[camera] = local_camera_pos;
+	++m_grass_update_counter;
 
-	from_quad_x = Math::maximum(0.0f, from_quad_x);
-	from_quad_z = Math::maximum(0.0f, from_quad_z);
+	int from_x = Math::maximum(0, cx - m_grass_distance);
+	int from_z = Math::maximum(0, cz - m_grass_distance);
+	int to_x = cx + m_grass_distance;
+	int to_z = cz + m_grass_distance;
 
-	int old_quad_size = quads.size();
-	for (float quad_z = from_quad_z; quad_z <= to_quad_z; quad_z += GRASS_QUAD_SIZE)
+	Array<GrassQuad*>& quads = getQuads(camera);
+	int cached_count = 0;
+	for (GrassQuad* quad : quads)
 	{
-		for (float quad_x = from_quad_x; quad_x <= to_quad_x; quad_x += GRASS_QUAD_SIZE)
-		{
-			if (quad_x >= old_bounds[0] && quad_x <= old_bounds[1] && quad_z >= old_bounds[2] &&
-				quad_z <= old_bounds[3])
-				continue;
-
-			PROFILE_BLOCK("generate quad");
-			GrassQuad* quad = LUMIX_NEW(m_allocator, GrassQuad)(m_allocator);
-			quads.push(quad);
-			quad->pos.x = quad_x;
-			quad->pos.z = quad_z;
-			quad->m_patches.reserve(m_grass_types.size());
+		quad->is_in_range = quad->x >= from_x && quad->x <= to_x && quad->z >= from_z && quad->z <= to_z;
+		if (quad->is_in_range) quad->last_used = m_grass_update_counter;
+		else ++cached_count;
+		// only quads which are ready have instance buffers
+		if (!quad->is_in_range && quad->isReady()) quad->destroyInstanceBuffers();
+	}
 
-			float min_y = FLT_MAX;
-			float max_y = -FLT_MAX;
-			for (auto* grass_type : m_grass_types)
+	MTJD::Manager& manager = m_scene.getEngine().getMTJDManager();
+	for (int z = from_z; z <= to_z; ++z)
+	{
+		for (int x = from_x; x <= to_x; ++x)
+		{
+			bool exists = false;
+			for (GrassQuad* quad : quads)
 			{
-				Model* model = grass_type->m_grass_model;
-				if (!model || !model->isReady()) continue;
-				GrassPatch& patch = quad->m_patches.emplace(m_allocator);
-				patch.m_type = grass_type;
-
-				generateGrassTypeQuad(patch, terrain_mtx, quad_x, quad_z);
-				for (auto instance_data : patch.instance_data)
+				if (quad->x == x && quad->z == z)
 				{
-					min_y = Math::minimum(instance_data.matrix.getTranslation().y, min_y);
-					max_y = Math::maximum(instance_data.matrix.getTranslation().y, max_y);
+					exists = true;
+					break;
 				}
 			}
+			if (exists) continue;
 
-			quad->pos.y = (max_y + min_y) * 0.5f;
-			quad->radius = Math::maximum((max_y - min_y) * 0.5f, GRASS_QUAD_SIZE) * Math::SQRT2;
+			GrassQuad* quad = LUMIX_NEW(m_allocator, GrassQuad)(m_allocator);
+			quads.push(quad);
+			quad->x = x;
+			quad->z = z;
+			quad->is_in_range = true;
+			quad->last_used = m_grass_update_counter;
+
+			Terrain* terrain = this;
+			MTJD::Job* job = MTJD::makeJob(manager,
+				[terrain, quad]() { terrain->generateGrassQuad(*quad); },
+				m_allocator);
+			job->setCounter(&quad->job);
+			manager.schedule(job);
+		}
+	}
 
+	while (cached_count > GRASS_CACHE_SIZE)
+	{
+		int lru = -1;
+		for (int i = 0; i < quads.size(); ++i)
+		{
+			if (quads[i]->is_in_range) continue;
+			if (lru < 0 || quads[i]->last_used < quads[lru]->last_used) lru = i;
 		}
+		destroyGrassQuad(quads[lru]);
+		quads.eraseFast(lru);
+		--cached_count;
 	}
 }
 
 
+int Terrain::getGrassMemory() const
+{
+	int size = 0;
+	for (int i = 0; i < m_grass_quads.size(); ++i)
+	{
+		for (const GrassQuad* quad : m_grass_quads.at(i))
+		{
+			// patches of quads in jobs are being resized
+			if (!quad->isReady()) continue;
+			for (const GrassPatch& patch : quad->m_patches)
+			{
+				size += patch.instance_data.capacity() * sizeof(patch.instance_data[0]);
+			}
+		}
+	}
+	return size;
+}
+
+
 void Terrain::GrassType::grassLoaded(Resource::State, Resource::State, Resource&)
 {
 	m_terrain.forceGrassUpdate();
 }
 
 
+// instance data of all new patches is allocated first, so it can be expanded in jobs,
+// only bgfx calls are made on this thread
+void Terrain::createGrassInstanceBuffers(GrassPatch* const* patches, int count, const Matrix& mtx)
+{
+	PROFILE_FUNCTION();
+	PROFILE_INT("expanded patches", count);
+	Engine& engine = m_scene.getEngine();
+	IAllocator& frame_allocator = engine.getFrameAllocator();
+	Array<const bgfx::Memory*> memories(frame_allocator);
+	memories.resize(count);
+	for (int i = 0; i < count; ++i)
+	{
+		memories[i] = bgfx::alloc(patches[i]->instance_data.size() * sizeof(GrassInfo::InstanceData));
+	}
+
+	auto expand = [patches, &memories, &mtx](int from, int to) {
+		PROFILE_BLOCK("Grass instance data");
+		for (int i = from; i < to; ++i)
+		{
+			const GrassPatch& patch = *patches[i];
+			expandGrassInstances(&patch.instance_data[0],
+				patch.instance_data.size(),
+				mtx,
+				patch.pos_min,
+				patch.pos_step,
+				(GrassInfo::InstanceData*)memories[i]->data);
+		}
+	};
+	MTJD::parallelFor(engine.getMTJDManager(), frame_allocator, 0, count, GRASS_PATCHES_GRAIN, expand).join();
+
+	for (int i = 0; i < count; ++i)
+	{
+		patches[i]->instance_buffer = bgfx::createVertexBuffer(memories[i], m_grass_instance_decl);
+		patches[i]->instance_buffer_matrix = mtx;
+	}
+}
+
+
 void Terrain::getGrassInfos(const Frustum& frustum, Array<GrassInfo>& infos, ComponentHandle camera)
 {
 	if (!m_material || !m_material->isReady()) return;
@@ -526,8 +714,12 @@ void Terrain::getGrassInfos(const Frustum& frustum, Array<GrassInfo>& infos, Com
 	Universe& universe = m_scene.getUniverse();
 	Matrix mtx = universe.getMatrix(m_entity);
 	Vec3 frustum_position = frustum.position;
+	IAllocator& frame_allocator = m_scene.getEngine().getFrameAllocator();
+	Array<GrassPatch*> visible_patches(frame_allocator);
+	Array<GrassPatch*> new_patches(frame_allocator);
 	for (auto* quad : quads)
 	{
+		if (!quad->is_in_range || !quad->isReady()) continue;
 		Vec3 quad_center(quad->pos.x + GRASS_QUAD_SIZE * 0.5f, quad->pos.y, quad->pos.z + GRASS_QUAD_SIZE * 0.5f);
 		quad_center = mtx.transform(quad_center);
 		if (frustum.isSphereInside(quad_center, quad->radius))
@@ -535,19 +727,35 @@ void Terrain::getGrassInfos(const Frustum& frustum, Array<GrassInfo>& infos, Com
 			float dist2 = (quad_center - frustum_position).squaredLength();
 			for (int patch_idx = 0; patch_idx < quad->m_patches.size(); ++patch_idx)
 			{
-				const GrassPatch& patch = quad->m_patches[patch_idx];
+				GrassPatch& patch = quad->m_patches[patch_idx];
 				if (patch.m_type->m_distance * patch.m_type->m_distance < dist2) continue;
-				if (!patch.instance_data.empty())
-				{
-					GrassInfo& info = infos.emplace();
-					info.instance_data = (GrassInfo::InstanceData*)&patch.instance_data[0];
-					info.instance_count = patch.instance_data.size();
-					info.model = patch.m_type->m_grass_model;
-					info.type_distance = patch.m_type->m_distance;
-				}
+				if (patch.instance_data.empty()) continue;
+
+				visible_patches.push(&patch);
+				bool is_expanded = bgfx::isValid(patch.instance_buffer) &&
+								   compareMemory(&patch.instance_buffer_matrix, &mtx, sizeof(mtx)) == 0;
+				if (is_expanded) continue;
+
+				// the terrain moved since the patch was expanded
+				if (bgfx::isValid(patch.instance_buffer)) bgfx::destroyVertexBuffer(patch.instance_buffer);
+				patch.instance_buffer = BGFX_INVALID_HANDLE;
+				new_patches.push(&patch);
 			}
 		}
 	}
+
+	if (!new_patches.empty()) createGrassInstanceBuffers(&new_patches[0], new_patches.size(), mtx);
+
+	for (GrassPatch* patch : visible_patches)
+	{
+		// out of bgfx vertex buffers
+		if (!bgfx::isValid(patch->instance_buffer)) continue;
+		GrassInfo& info = infos.emplace();
+		info.instance_buffer = patch->instance_buffer;
+		info.instance_count = patch->instance_data.size();
+		info.model = patch->m_type->m_grass_model;
+		info.type_distance = patch->m_type->m_distance;
+	}
 }
 
 
@@ -555,6 +763,8 @@ void Terrain::setMaterial(Material* material)
 {
 	if (material != m_material)
 	{
+		// grass jobs read the splatmap and the heightmap
+		waitForGrass();
 		if (m_material)
 		{
 			m_material->getResourceManager().unload(*m_material);
@@ -562,6 +772,7 @@ void Terrain::setMaterial(Material* material)
 		}
 		m_material = material;
 		m_splatmap = nullptr;
+		clearHeightPyramid();
 		m_heightmap = nullptr;
 		if (m_mesh && m_material)
 		{
@@ -654,122 +865,73 @@ void Terrain::getInfos(Array<TerrainInfo>& infos, const Vec3& camera_pos)
 }
 
 
+HeightmapSampler Terrain::getHeightmapSampler() const
+{
+	ASSERT(m_heightmap->bytes_per_pixel == 2);
+	return HeightmapSampler((const uint16*)m_heightmap->getData(), m_width, m_height, m_scale);
+}
+
+
 Vec3 Terrain::getNormal(float x, float z)
 {
-	int int_x = (int)(x / m_scale.x);
-	int int_z = (int)(z / m_scale.x);
-	float dec_x = (x - (int_x * m_scale.x)) / m_scale.x;
-	float dec_z = (z - (int_z * m_scale.x)) / m_scale.x;
-	if (dec_x > dec_z)
-	{
-		float h0 = getHeight(int_x, int_z);
-		float h1 = getHeight(int_x + 1, int_z);
-		float h2 = getHeight(int_x + 1, int_z + 1);
-		return crossProduct(Vec3(m_scale.x, h2 - h0, m_scale.x), Vec3(m_scale.x, h1 - h0, 0)).normalized();
-	}
-	else
-	{
-		float h0 = getHeight(int_x, int_z);
-		float h1 = getHeight(int_x + 1, int_z + 1);
-		float h2 = getHeight(int_x, int_z + 1);
-		return crossProduct(Vec3(0, h2 - h0, m_scale.x), Vec3(m_scale.x, h1 - h0, m_scale.x)).normalized();
-	}
+	if (!m_heightmap) return Vec3(0, 1, 0);
+	return getHeightmapSampler().getNormal(x, z);
 }
 
 	
 float Terrain::getHeight(float x, float z) const
 {
-	float inv_scale = 1.0f / m_scale.x;
-	int int_x = (int)(x * inv_scale);
-	int int_z = (int)(z * inv_scale);
-	float dec_x = (x - (int_x * m_scale.x)) * inv_scale;
-	float dec_z = (z - (int_z * m_scale.x)) * inv_scale;
-	if (dec_z == 0 && dec_x == 0)
-	{
-		return getHeight(int_x, int_z);
-	}
-	else if (dec_x > dec_z)
-	{
-		float h0 = getHeight(int_x, int_z);
-		float h1 = getHeight(int_x + 1, int_z);
-		float h2 = getHeight(int_x + 1, int_z + 1);
-		return h0 + (h1 - h0) * dec_x + (h2 - h1) * dec_z;
-	}
-	else
-	{
-		float h0 = getHeight(int_x, int_z);
-		float h1 = getHeight(int_x + 1, int_z + 1);
-		float h2 = getHeight(int_x, int_z + 1);
-		return h0 + (h2 - h0) * dec_z + (h1 - h2) * dec_x;
-	}
+	if (!m_heightmap) return 0;
+	return getHeightmapSampler().getHeight(x, z);
 }
 	
 
 float Terrain::getHeight(int x, int z) const
 {
-	const float DIV64K = 1.0f / 65535.0f;
-	const float DIV255 = 1.0f / 255.0f;
 	if (!m_heightmap) return 0;
-
-	Texture* t = m_heightmap;
-	ASSERT(t->bytes_per_pixel == 2);
-	int idx = Math::clamp(x, 0, m_width) + Math::clamp(z, 0, m_height) * m_width;
-	return m_scale.y * DIV64K * ((uint16*)t->getData())[idx];
+	return getHeightmapSampler().getHeight(x, z);
 }
 
 
-void Terrain::setHeight(int x, int z, float h)
+void Terrain::getHeights(const Vec2* positions, int count, float* heights) const
 {
-	const float DIV64K = 1.0f / 65535.0f;
-	const float DIV255 = 1.0f / 255.0f;
-	if (!m_heightmap) return;
-
-	Texture* t = m_heightmap;
-	ASSERT(t->bytes_per_pixel == 2);
-	int idx = Math::clamp(x, 0, m_width) + Math::clamp(z, 0, m_height) * m_width;
-	((uint16*)t->getData())[idx] = (uint16)(h * (65535.0f / m_scale.y));
+	PROFILE_FUNCTION();
+	if (!m_heightmap)
+	{
+		for (int i = 0; i < count; ++i) heights[i] = 0;
+		return;
+	}
+	getHeightmapSampler().getHeights(positions, count, heights);
 }
 
 
-bool getRayTriangleIntersection(const Vec3& local_origin, const Vec3& local_dir, const Vec3& p0, const Vec3& p1, const Vec3& p2, float& out)
+void Terrain::getHeightsAndNormals(const Vec2* positions, int count, float* heights, Vec3* normals) const
 {
-	Vec3 normal = crossProduct(p1 - p0, p2 - p0);
-	float q = dotProduct(normal, local_dir);
-	if (q == 0)
-	{
-		return false;
-	}
-	float d = -dotProduct(normal, p0);
-	float t = -(dotProduct(normal, local_origin) + d) / q;
-	if (t < 0)
-	{
-		return false;
-	}
-	Vec3 hit_point = local_origin + local_dir * t;
-
-	Vec3 edge0 = p1 - p0;
-	Vec3 VP0 = hit_point - p0;
-	if (dotProduct(normal, crossProduct(edge0, VP0)) < 0)
+	PROFILE_FUNCTION();
+	if (!m_heightmap)
 	{
-		return false;
+		for (int i = 0; i < count; ++i)
+		{
+			heights[i] = 0;
+			normals[i].set(0, 1, 0);
+		}
+		return;
 	}
+	getHeightmapSampler().getHeightsAndNormals(positions, count, heights, normals);
+}
 
-	Vec3 edge1 = p2 - p1;
-	Vec3 VP1 = hit_point - p1;
-	if (dotProduct(normal, crossProduct(edge1, VP1)) < 0)
-	{
-		return false;
-	}
 
-	Vec3 edge2 = p0 - p2;
-	Vec3 VP2 = hit_point - p2;
-	if (dotProduct(normal, crossProduct(edge2, VP2)) < 0)
-	{
-		return false;
-	}
+void Terrain::setHeight(int x, int z, float h)
+{
+	const float DIV64K = 1.0f / 65535.0f;
+	const float DIV255 = 1.0f / 255.0f;
+	if (!m_heightmap) return;
 
-	out = t;
-	return true;
+	Texture* t = m_heightmap;
+	ASSERT(t->bytes_per_pixel == 2);
+	int idx = Math::clamp(x, 0, m_width - 1) + Math::clamp(z, 0, m_height - 1) * m_width;
+	((uint16*)t->getData())[idx] = (uint16)(h * (65535.0f / m_scale.y));
+	m_height_pyramid.update((const uint16*)t->getData(), idx % m_width, idx / m_width, 1, 1);
 }
 
 
@@ -777,68 +939,25 @@ RayCastModelHit Terrain::castRay(const Vec3& origin, const Vec3& dir)
 {
 	RayCastModelHit hit;
 	hit.m_is_hit = false;
-	if (m_root)
-	{
-		Matrix mtx = m_scene.getUniverse().getMatrix(m_entity);
-		mtx.fastInverse();
-		Vec3 rel_origin = mtx.transform(origin);
-		Vec3 rel_dir = mtx * Vec4(dir, 0);
-		Vec3 start;
-		Vec3 size(m_root->m_size * m_scale.x, m_scale.y * 65535.0f, m_root->m_size * m_scale.x);
-		if (Math::getRayAABBIntersection(rel_origin, rel_dir, m_root->m_min, size, start))
-		{
-			int hx = (int)(start.x / m_scale.x);
-			int hz = (int)(start.z / m_scale.x);
-
-			float next_x = fabs(rel_dir.x) < 0.01f ? hx : ((hx + (rel_dir.x < 0 ? 0 : 1)) * m_scale.x - rel_origin.x) / rel_dir.x;
-			float next_z = fabs(rel_dir.z) < 0.01f ? hz : ((hz + (rel_dir.z < 0 ? 0 : 1)) * m_scale.x - rel_origin.z) / rel_dir.z;
-
-			float delta_x = fabs(rel_dir.x) < 0.01f ? 0 : m_scale.x / Math::abs(rel_dir.x);
-			float delta_z = fabs(rel_dir.z) < 0.01f ? 0 : m_scale.x / Math::abs(rel_dir.z);
-			int step_x = (int)Math::signum(rel_dir.x);
-			int step_z = (int)Math::signum(rel_dir.z);
-
-			while (hx >= 0 && hz >= 0 && hx + step_x < m_width && hz + step_z < m_height)
-			{
-				float t;
-				float x = hx * m_scale.x;
-				float z = hz * m_scale.x;
-				Vec3 p0(x, getHeight(x, z), z);
-				Vec3 p1(x + m_scale.x, getHeight(x + m_scale.x, z), z);
-				Vec3 p2(x + m_scale.x, getHeight(x + m_scale.x, z + m_scale.x), z + m_scale.x);
-				Vec3 p3(x, getHeight(x, z + m_scale.x), z + m_scale.x);
-				if (getRayTriangleIntersection(rel_origin, rel_dir, p0, p1, p2, t))
-				{
-					hit.m_is_hit = true;
-					hit.m_origin = origin;
-					hit.m_dir = dir;
-					hit.m_t = t;
-					return hit;
-				}
-				if (getRayTriangleIntersection(rel_origin, rel_dir, p0, p2, p3, t))
-				{
-					hit.m_is_hit = true;
-					hit.m_origin = origin;
-					hit.m_dir = dir;
-					hit.m_t = t;
-					return hit;
-				}
-				if (next_x < next_z)
-				{
-					next_x += delta_x;
-					hx += step_x;
-				}
-				else
-				{
-					next_z += delta_z;
-					hz += step_z;
-				}
-				if (delta_x == 0 && delta_z == 0)
-				{
-					return hit;
-				}
-			}
-		}
+	if (!m_root || m_height_pyramid.empty()) return hit;
+	if (m_scale.x <= 0 || m_scale.y <= 0) return hit;
+
+	Matrix mtx = m_scene.getUniverse().getMatrix(m_entity);
+	mtx.fastInverse();
+	Vec3 rel_origin = mtx.transform(origin);
+	Vec3 rel_dir = mtx * Vec4(dir, 0);
+
+	// the pyramid works with samples and raw heights, scaling the axes does not change t
+	Vec3 to_heightmap(1 / m_scale.x, 65535.0f / m_scale.y, 1 / m_scale.x);
+	Vec3 heightmap_origin(rel_origin.x * to_heightmap.x, rel_origin.y * to_heightmap.y, rel_origin.z * to_heightmap.z);
+	Vec3 heightmap_dir(rel_dir.x * to_heightmap.x, rel_dir.y * to_heightmap.y, rel_dir.z * to_heightmap.z);
+	float t;
+	if (m_height_pyramid.castRay((const uint16*)m_heightmap->getData(), heightmap_origin, heightmap_dir, &t))
+	{
+		hit.m_is_hit = true;
+		hit.m_origin = origin;
+		hit.m_dir = dir;
+		hit.m_t = t;
 	}
 	return hit;
 }
@@ -911,9 +1030,36 @@ TerrainQuad* Terrain::generateQuadTree(float size)
 	return root;
 }
 
+void Terrain::buildHeightPyramid()
+{
+	clearHeightPyramid();
+	if (!m_heightmap || m_heightmap->bytes_per_pixel != 2) return;
+
+	m_height_pyramid.build((const uint16*)m_heightmap->getData(), m_width, m_height);
+	m_heightmap->getDataUpdatedCb().bind<Terrain, &Terrain::onHeightmapUpdated>(this);
+}
+
+
+void Terrain::clearHeightPyramid()
+{
+	if (m_height_pyramid.empty()) return;
+
+	m_heightmap->getDataUpdatedCb().unbind<Terrain, &Terrain::onHeightmapUpdated>(this);
+	m_height_pyramid.clear();
+}
+
+
+void Terrain::onHeightmapUpdated(int x, int y, int w, int h)
+{
+	m_height_pyramid.update((const uint16*)m_heightmap->getData(), x, y, w, h);
+}
+
+
 void Terrain::onMaterialLoaded(Resource::State, Resource::State new_state, Resource&)
 {
 	PROFILE_FUNCTION();
+	forceGrassUpdate();
+	clearHeightPyramid();
 	if (new_state == Resource::State::READY)
 	{
 		m_detail_texture = m_material->getTextureByUniform(TEX_COLOR_UNIFORM);
@@ -947,6 +1093,7 @@ void Terrain::onMaterialLoaded(Resource::State, Resource::State new_state, Resou
 				m_width = m_heightmap->width;
 				m_height = m_heightmap->height;
 				m_root = generateQuadTree((float)m_width);
+				buildHeightPyramid();
 			}
 		}
 	}
@@ -4,8 +4,11 @@
 #include "engine/array.h"
 #include "engine/associative_array.h"
 #include "engine/matrix.h"
+#include "engine/mtjd/counter.h"
 #include "engine/resource.h"
 #include "engine/vec.h"
+#include "renderer/grass_instance.h"
+#include "renderer/min_max_height_pyramid.h"
 #include <bgfx/bgfx.h>
 
 
@@ -15,7 +18,7 @@ namespace Lumix
 
 struct AABB;
 struct Frustum;
-struct GrassInfo;
+struct HeightmapSampler;
 class IAllocator;
 class LIFOAllocator;
 class Material;
@@ -50,28 +53,44 @@ class Terrain
 
 		struct GrassPatch
 		{
-			struct InstanceData
-			{
-				Matrix matrix;
-				Vec4 normal;
-			};
 			explicit GrassPatch(IAllocator& allocator)
 				: instance_data(allocator)
+				, instance_buffer(BGFX_INVALID_HANDLE)
 			{ }
 
-			Array<InstanceData> instance_data;
+			Array<GrassInstance> instance_data;
+			// range of the quantized positions, in terrain space
+			Vec3 pos_min;
+			Vec3 pos_step;
 			GrassType* m_type;
+			// instance_data expanded to GrassInfo::InstanceData with instance_buffer_matrix when the patch
+			// became visible, so it is not expanded again each frame; destroyed when the quad gets out of range
+			bgfx::VertexBufferHandle instance_buffer;
+			Matrix instance_buffer_matrix;
 		};
 
+		// generated in a job, nothing but x, z and the bookkeeping can be accessed until the job is done
 		struct GrassQuad
 		{
 			explicit GrassQuad(IAllocator& allocator)
 				: m_patches(allocator)
 			{}
+			~GrassQuad() { destroyInstanceBuffers(); }
+
+			void destroyInstanceBuffers();
+
+			bool isReady() const { return job.isDone(); }
 
 			Array<GrassPatch> m_patches;
 			Vec3 pos;
 			float radius;
+			// position in the grid of quads
+			int x;
+			int z;
+			// quads out of range are kept for when the camera returns, the least recently used are deleted
+			bool is_in_range;
+			uint32 last_used;
+			MTJD::Counter job;
 		};
 
 	public:
@@ -100,8 +119,14 @@ class Terrain
 		int getGrassTypeDensity(int index) const;
 		float getGrassTypeDistance(int index) const;
 		int getGrassTypeCount() const { return m_grass_types.size(); }
+		// bytes of instance data in the grass caches of all cameras
+		int getGrassMemory() const;
 
 		float getHeight(int x, int z) const;
+		// the same as getHeight(float, float) for each of count positions (x, z in terrain space)
+		void getHeights(const Vec2* positions, int count, float* heights) const;
+		// the same as getHeight(float, float) and getNormal, four positions at once
+		void getHeightsAndNormals(const Vec2* positions, int count, float* heights, Vec3* normals) const;
 		void setHeight(int x, int z, float height);
 		void setXZScale(float scale) { m_scale.x = scale; m_scale.z = scale; }
 		void setYScale(float scale) { m_scale.y = scale; }
@@ -125,12 +150,17 @@ class Terrain
 		Array<Terrain::GrassQuad*>& getQuads(ComponentHandle camera);
 		TerrainQuad* generateQuadTree(float size);
 		void updateGrass(ComponentHandle camera);
-		void generateGrassTypeQuad(GrassPatch& patch,
-								   const Matrix& terrain_matrix,
-								   float quad_x,
-								   float quad_z);
+		void generateGrassQuad(GrassQuad& quad);
+		void generateGrassTypeQuad(GrassPatch& patch, float quad_x, float quad_z);
+		void waitForGrass();
+		void destroyGrassQuad(GrassQuad* quad);
+		void createGrassInstanceBuffers(GrassPatch* const* patches, int count, const Matrix& mtx);
 		void generateGeometry();
+		HeightmapSampler getHeightmapSampler() const;
 		void onMaterialLoaded(Resource::State, Resource::State new_state, Resource&);
+		void buildHeightPyramid();
+		void clearHeightPyramid();
+		void onHeightmapUpdated(int x, int y, int w, int h);
 
 	private:
 		IAllocator& m_allocator;
@@ -146,13 +176,15 @@ class Terrain
 		Entity m_entity;
 		Material* m_material;
 		Texture* m_heightmap;
+		MinMaxHeightPyramid m_height_pyramid;
 		Texture* m_splatmap;
 		Texture* m_detail_texture;
 		RenderScene& m_scene;
 		Array<GrassType*> m_grass_types;
 		AssociativeArray<ComponentHandle, Array<GrassQuad*> > m_grass_quads;
 		AssociativeArray<ComponentHandle, Vec3> m_last_camera_position;
-		bool m_force_grass_update;
+		uint32 m_grass_update_counter;
+		bgfx::VertexDecl m_grass_instance_decl;
 		Renderer& m_renderer;
 };
 
@@ -44,6 +44,7 @@ Texture::Texture(const Path& path, ResourceManagerBase& resource_manager, IAlloc
 	, bytes_per_pixel(-1)
 	, depth(-1)
 	, layers(1)
+	, m_data_updated_cb(_allocator)
 {
 	bgfx_flags = 0;
 	is_cubemap = false;
@@ -333,6 +334,7 @@ void Texture::onDataUpdated(int x, int y, int w, int h)
 		}
 	}
 	bgfx::updateTexture2D(handle, 0, 0, (uint16_t)x, (uint16_t)y, (uint16_t)w, (uint16_t)h, mem);
+	m_data_updated_cb.invoke(x, y, w, h);
 }
 
 
@@ -1,6 +1,7 @@
 #pragma once
 
 
+#include "engine/delegate_list.h"
 #include "engine/resource.h"
 #include <bgfx/bgfx.h>
 
@@ -27,6 +28,8 @@ class LUMIX_RENDERER_API Texture LUMIX_FINAL : public Resource
 		void addDataReference();
 		void removeDataReference();
 		void onDataUpdated(int x, int y, int w, int h);
+		// called by onDataUpdated with the changed rectangle
+		DelegateList<void(int, int, int, int)>& getDataUpdatedCb() { return m_data_updated_cb; }
 		void save();
 		void setFlags(uint32 flags);
 		void setFlag(uint32 flag, bool value);
@@ -52,6 +55,9 @@ class LUMIX_RENDERER_API Texture LUMIX_FINAL : public Resource
 	private:
 		void unload(void) override;
 		bool load(FS::IFile& file) override;
+
+	private:
+		DelegateList<void(int, int, int, int)> m_data_updated_cb;
 };
 
 
@@ -0,0 +1,386 @@
+#include "triangle_bvh.h"
+#include "engine/math_utils.h"
+#include "engine/profiler.h"
+#include "engine/simd.h"
+#include "engine/string.h"
+#include <cfloat>
+#include <cmath>
+
+
+namespace Lumix
+{
+
+
+static const int BINS_COUNT = 16;
+static const int MAX_STACK_SIZE = 256;
+
+
+static float getHalfArea(const Vec3& min, const Vec3& max)
+{
+	Vec3 size = max - min;
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+
+static void addPoint(Vec3& min, Vec3& max, const Vec3& point)
+{
+	min.x = Math::minimum(min.x, point.x);
+	min.y = Math::minimum(min.y, point.y);
+	min.z = Math::minimum(min.z, point.z);
+	max.x = Math::maximum(max.x, point.x);
+	max.y = Math::maximum(max.y, point.y);
+	max.z = Math::maximum(max.z, point.z);
+}
+
+
+static bool intersectBox(const Vec3& min,
+	const Vec3& max,
+	const Vec3& origin,
+	const Vec3& inv_dir,
+	float max_t,
+	float* t_near)
+{
+	float tx1 = (min.x - origin.x) * inv_dir.x;
+	float tx2 = (max.x - origin.x) * inv_dir.x;
+	float tmin = Math::minimum(tx1, tx2);
+	float tmax = Math::maximum(tx1, tx2);
+
+	float ty1 = (min.y - origin.y) * inv_dir.y;
+	float ty2 = (max.y - origin.y) * inv_dir.y;
+	tmin = Math::maximum(tmin, Math::minimum(ty1, ty2));
+	tmax = Math::minimum(tmax, Math::maximum(ty1, ty2));
+
+	float tz1 = (min.z - origin.z) * inv_dir.z;
+	float tz2 = (max.z - origin.z) * inv_dir.z;
+	tmin = Math::maximum(tmin, Math::minimum(tz1, tz2));
+	tmax = Math::minimum(tmax, Math::maximum(tz1, tz2));
+
+	tmin = Math::maximum(tmin, 0.0f);
+	*t_near = tmin;
+	return tmin <= tmax && tmin <= max_t;
+}
+
+
+// big number instead of infinity for zero, so there are no floating point exceptions in box tests
+static float getInverse(float value)
+{
+	static const float MIN_VALUE = 1e-20f;
+	if (fabsf(value) < MIN_VALUE) return value < 0 ? -1 / MIN_VALUE : 1 / MIN_VALUE;
+	return 1 / value;
+}
+
+
+TriangleBVH::TriangleBVH(IAllocator& allocator)
+	: m_allocator(allocator)
+	, m_nodes(allocator)
+	, m_packets(allocator)
+{
+}
+
+
+void TriangleBVH::clear()
+{
+	m_nodes.clear();
+	m_packets.clear();
+}
+
+
+void TriangleBVH::build(const Vec3* vertices, const uint32* indices, int triangles_count)
+{
+	PROFILE_FUNCTION();
+	clear();
+	if (triangles_count == 0) return;
+
+	Array<BuildTriangle> triangles(m_allocator);
+	triangles.resize(triangles_count);
+	for (int i = 0; i < triangles_count; ++i)
+	{
+		BuildTriangle& triangle = triangles[i];
+		const Vec3& p0 = vertices[indices[i * 3]];
+		triangle.min = triangle.max = p0;
+		addPoint(triangle.min, triangle.max, vertices[indices[i * 3 + 1]]);
+		addPoint(triangle.min, triangle.max, vertices[indices[i * 3 + 2]]);
+		triangle.center = (triangle.min + triangle.max) * 0.5f;
+		triangle.index = i;
+	}
+
+	m_nodes.reserve(triangles_count / LEAF_SIZE * 2 + 1);
+	m_packets.reserve(triangles_count / LEAF_SIZE + 1);
+	m_nodes.emplace();
+	buildNode(0, &triangles[0], triangles_count, vertices, indices);
+}
+
+
+void TriangleBVH::buildNode(int node_idx,
+	BuildTriangle* triangles,
+	int count,
+	const Vec3* vertices,
+	const uint32* indices)
+{
+	Vec3 min = triangles[0].min;
+	Vec3 max = triangles[0].max;
+	Vec3 center_min = triangles[0].center;
+	Vec3 center_max = triangles[0].center;
+	for (int i = 1; i < count; ++i)
+	{
+		addPoint(min, max, triangles[i].min);
+		addPoint(min, max, triangles[i].max);
+		addPoint(center_min, center_max, triangles[i].center);
+	}
+	m_nodes[node_idx].min = min;
+	m_nodes[node_idx].max = max;
+
+	if (count <= LEAF_SIZE)
+	{
+		m_nodes[node_idx].is_leaf = true;
+		m_nodes[node_idx].index = m_packets.size();
+		createPacket(triangles, count, vertices, indices);
+		return;
+	}
+
+	float best_cost = FLT_MAX;
+	int best_axis = -1;
+	int best_bin = 0;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float axis_min = (&center_min.x)[axis];
+		float extent = (&center_max.x)[axis] - axis_min;
+		if (extent <= 0) continue;
+
+		int bin_counts[BINS_COUNT] = {};
+		Vec3 bin_min[BINS_COUNT];
+		Vec3 bin_max[BINS_COUNT];
+		for (int i = 0; i < BINS_COUNT; ++i)
+		{
+			bin_min[i].set(FLT_MAX, FLT_MAX, FLT_MAX);
+			bin_max[i].set(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		}
+		float scale = BINS_COUNT / extent;
+		for (int i = 0; i < count; ++i)
+		{
+			int bin = Math::minimum(int(((&triangles[i].center.x)[axis] - axis_min) * scale), BINS_COUNT - 1);
+			++bin_counts[bin];
+			addPoint(bin_min[bin], bin_max[bin], triangles[i].min);
+			addPoint(bin_min[bin], bin_max[bin], triangles[i].max);
+		}
+
+		// cost of the right side of each split, sweeping from the right
+		float right_costs[BINS_COUNT];
+		Vec3 right_min(FLT_MAX, FLT_MAX, FLT_MAX);
+		Vec3 right_max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		int right_count = 0;
+		for (int i = BINS_COUNT - 1; i > 0; --i)
+		{
+			right_count += bin_counts[i];
+			if (bin_counts[i] > 0)
+			{
+				addPoint(right_min, right_max, bin_min[i]);
+				addPoint(right_min, right_max, bin_max[i]);
+			}
+			right_costs[i] = right_count > 0 ? getHalfArea(right_min, right_max) * right_count : 0;
+		}
+
+		Vec3 left_min(FLT_MAX, FLT_MAX, FLT_MAX);
+		Vec3 left_max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		int left_count = 0;
+		for (int i = 0; i < BINS_COUNT - 1; ++i)
+		{
+			left_count += bin_counts[i];
+			if (bin_counts[i] > 0)
+			{
+				addPoint(left_min, left_max, bin_min[i]);
+				addPoint(left_min, left_max, bin_max[i]);
+			}
+			if (left_count == 0 || left_count == count) continue;
+
+			float cost = getHalfArea(left_min, left_max) * left_count + right_costs[i + 1];
+			if (cost < best_cost)
+			{
+				best_cost = cost;
+				best_axis = axis;
+				best_bin = i;
+			}
+		}
+	}
+
+	// if all centers are in the same point, any split is as good as other
+	int mid = count / 2;
+	if (best_axis >= 0)
+	{
+		float axis_min = (&center_min.x)[best_axis];
+		float scale = BINS_COUNT / ((&center_max.x)[best_axis] - axis_min);
+		int left = 0;
+		int right = count - 1;
+		while (left <= right)
+		{
+			int bin = Math::minimum(int(((&triangles[left].center.x)[best_axis] - axis_min) * scale), BINS_COUNT - 1);
+			if (bin <= best_bin)
+			{
+				++left;
+			}
+			else
+			{
+				BuildTriangle tmp = triangles[left];
+				triangles[left] = triangles[right];
+				triangles[right] = tmp;
+				--right;
+			}
+		}
+		mid = left;
+	}
+
+	int children = m_nodes.size();
+	m_nodes.emplace();
+	m_nodes.emplace();
+	m_nodes[node_idx].is_leaf = false;
+	m_nodes[node_idx].index = children;
+	buildNode(children, triangles, mid, vertices, indices);
+	buildNode(children + 1, triangles + mid, count - mid, vertices, indices);
+}
+
+
+void TriangleBVH::createPacket(const BuildTriangle* triangles,
+	int count,
+	const Vec3* vertices,
+	const uint32* indices)
+{
+	Packet& packet = m_packets.emplace();
+	setMemory(&packet, 0, sizeof(packet));
+	for (int i = 0; i < LEAF_SIZE; ++i)
+	{
+		// unused lanes have zero edges, so they can not be hit
+		if (i >= count)
+		{
+			packet.triangles[i] = -1;
+			continue;
+		}
+
+		int triangle = triangles[i].index;
+		const Vec3& p0 = vertices[indices[triangle * 3]];
+		Vec3 edge1 = vertices[indices[triangle * 3 + 1]] - p0;
+		Vec3 edge2 = vertices[indices[triangle * 3 + 2]] - p0;
+		for (int j = 0; j < 3; ++j)
+		{
+			packet.p0[j][i] = (&p0.x)[j];
+			packet.edge1[j][i] = (&edge1.x)[j];
+			packet.edge2[j][i] = (&edge2.x)[j];
+		}
+		packet.triangles[i] = triangle;
+	}
+}
+
+
+void TriangleBVH::intersectPacket(const Packet& packet, const Vec3& origin, const Vec3& dir, Hit* hit) const
+{
+	LUMIX_ALIGN_BEGIN(16) struct Lanes
+	{
+		float det[4];
+		float u[4];
+		float v[4];
+		float t[4];
+	} LUMIX_ALIGN_END(16);
+
+	// Moller-Trumbore for 4 triangles at once
+	float4 dx = f4Splat(dir.x);
+	float4 dy = f4Splat(dir.y);
+	float4 dz = f4Splat(dir.z);
+	float4 e1x = f4Load(packet.edge1[0]);
+	float4 e1y = f4Load(packet.edge1[1]);
+	float4 e1z = f4Load(packet.edge1[2]);
+	float4 e2x = f4Load(packet.edge2[0]);
+	float4 e2y = f4Load(packet.edge2[1]);
+	float4 e2z = f4Load(packet.edge2[2]);
+
+	float4 px = f4Sub(f4Mul(dy, e2z), f4Mul(dz, e2y));
+	float4 py = f4Sub(f4Mul(dz, e2x), f4Mul(dx, e2z));
+	float4 pz = f4Sub(f4Mul(dx, e2y), f4Mul(dy, e2x));
+	float4 det = f4Add(f4Add(f4Mul(e1x, px), f4Mul(e1y, py)), f4Mul(e1z, pz));
+
+	float4 tx = f4Sub(f4Splat(origin.x), f4Load(packet.p0[0]));
+	float4 ty = f4Sub(f4Splat(origin.y), f4Load(packet.p0[1]));
+	float4 tz = f4Sub(f4Splat(origin.z), f4Load(packet.p0[2]));
+	float4 u = f4Add(f4Add(f4Mul(tx, px), f4Mul(ty, py)), f4Mul(tz, pz));
+
+	float4 qx = f4Sub(f4Mul(ty, e1z), f4Mul(tz, e1y));
+	float4 qy = f4Sub(f4Mul(tz, e1x), f4Mul(tx, e1z));
+	float4 qz = f4Sub(f4Mul(tx, e1y), f4Mul(ty, e1x));
+	float4 v = f4Add(f4Add(f4Mul(dx, qx), f4Mul(dy, qy)), f4Mul(dz, qz));
+	float4 t = f4Add(f4Add(f4Mul(e2x, qx), f4Mul(e2y, qy)), f4Mul(e2z, qz));
+
+	Lanes lanes;
+	f4Store(lanes.det, det);
+	f4Store(lanes.u, u);
+	f4Store(lanes.v, v);
+	f4Store(lanes.t, t);
+	for (int i = 0; i < LEAF_SIZE; ++i)
+	{
+		if (lanes.det[i] == 0) continue;
+
+		float inv_det = 1 / lanes.det[i];
+		float lane_u = lanes.u[i] * inv_det;
+		if (lane_u < 0 || lane_u > 1) continue;
+		float lane_v = lanes.v[i] * inv_det;
+		if (lane_v < 0 || lane_u + lane_v > 1) continue;
+		float lane_t = lanes.t[i] * inv_det;
+		if (lane_t < 0 || lane_t >= hit->t) continue;
+
+		hit->t = lane_t;
+		hit->triangle = packet.triangles[i];
+	}
+}
+
+
+bool TriangleBVH::castRay(const Vec3& origin, const Vec3& dir, Hit* hit) const
+{
+	hit->t = FLT_MAX;
+	hit->triangle = -1;
+	if (m_nodes.empty()) return false;
+
+	Vec3 inv_dir(getInverse(dir.x), getInverse(dir.y), getInverse(dir.z));
+	float t_near;
+	if (!intersectBox(m_nodes[0].min, m_nodes[0].max, origin, inv_dir, FLT_MAX, &t_near)) return false;
+
+	struct StackItem
+	{
+		int node;
+		float t_near;
+	};
+	StackItem stack[MAX_STACK_SIZE];
+	int stack_size = 1;
+	stack[0] = {0, t_near};
+	while (stack_size > 0)
+	{
+		--stack_size;
+		if (stack[stack_size].t_near > hit->t) continue;
+		const Node& node = m_nodes[stack[stack_size].node];
+
+		if (node.is_leaf)
+		{
+			intersectPacket(m_packets[node.index], origin, dir, hit);
+			continue;
+		}
+
+		const Node& left = m_nodes[node.index];
+		const Node& right = m_nodes[node.index + 1];
+		float left_t, right_t;
+		bool is_left_hit = intersectBox(left.min, left.max, origin, inv_dir, hit->t, &left_t);
+		bool is_right_hit = intersectBox(right.min, right.max, origin, inv_dir, hit->t, &right_t);
+		ASSERT(stack_size + 2 <= MAX_STACK_SIZE);
+		// the nearer child is pushed last, so it's visited first
+		if (is_left_hit && is_right_hit && left_t < right_t)
+		{
+			stack[stack_size++] = {node.index + 1, right_t};
+			stack[stack_size++] = {node.index, left_t};
+		}
+		else
+		{
+			if (is_left_hit) stack[stack_size++] = {node.index, left_t};
+			if (is_right_hit) stack[stack_size++] = {node.index + 1, right_t};
+		}
+	}
+
+	return hit->triangle >= 0;
+}
+
+
+} // namespace Lumix
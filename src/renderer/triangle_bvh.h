@@ -0,0 +1,78 @@
+#pragma once
+
+
+#include "engine/array.h"
+#include "engine/lumix.h"
+#include "engine/vec.h"
+
+
+namespace Lumix
+{
+
+
+class IAllocator;
+
+
+// Bounding volume hierarchy over triangles, built with binned SAH. Each leaf holds up to 4 triangles
+// stored as one SoA packet, so the ray is tested against all of them at once with SIMD.
+class LUMIX_RENDERER_API TriangleBVH
+{
+public:
+	static const int LEAF_SIZE = 4;
+
+	struct Hit
+	{
+		float t;
+		// index of the triangle in the array passed to build()
+		int triangle;
+	};
+
+public:
+	explicit TriangleBVH(IAllocator& allocator);
+
+	// indices contain 3 vertex indices per triangle
+	void build(const Vec3* vertices, const uint32* indices, int triangles_count);
+	void clear();
+	bool empty() const { return m_nodes.empty(); }
+	// returns the nearest hit in front of the origin, t is in units of dir
+	bool castRay(const Vec3& origin, const Vec3& dir, Hit* hit) const;
+	int getNodesCount() const { return m_nodes.size(); }
+
+private:
+	struct Node
+	{
+		Vec3 min;
+		Vec3 max;
+		// inner node: index of the first of two consecutive children, leaf: index of the packet
+		int index;
+		bool is_leaf;
+	};
+
+	LUMIX_ALIGN_BEGIN(16) struct Packet
+	{
+		float p0[3][4];
+		float edge1[3][4];
+		float edge2[3][4];
+		int triangles[4];
+	} LUMIX_ALIGN_END(16);
+
+	struct BuildTriangle
+	{
+		Vec3 min;
+		Vec3 max;
+		Vec3 center;
+		int index;
+	};
+
+	void buildNode(int node, BuildTriangle* triangles, int count, const Vec3* vertices, const uint32* indices);
+	void createPacket(const BuildTriangle* triangles, int count, const Vec3* vertices, const uint32* indices);
+	void intersectPacket(const Packet& packet, const Vec3& origin, const Vec3& dir, Hit* hit) const;
+
+private:
+	IAllocator& m_allocator;
+	Array<Node> m_nodes;
+	Array<Packet> m_packets;
+};
+
+
+} // namespace Lumix
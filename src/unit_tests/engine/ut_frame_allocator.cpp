@@ -0,0 +1,122 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "engine/array.h"
+#include "engine/frame_allocator.h"
+#include "engine/mtjd/manager.h"
+#include "engine/mtjd/parallel_for.h"
+
+namespace
+{
+	static const size_t FRAME_SIZE = 1024 * 1024;
+	static const int FRAMES_COUNT = 3;
+
+
+	void UT_frame_allocator_lifo(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::FrameAllocator frame_allocator(allocator, FRAME_SIZE, FRAMES_COUNT);
+
+		void* a = frame_allocator.allocate(100);
+		void* b = frame_allocator.allocate(30);
+		LUMIX_EXPECT(a != b);
+
+		// the last allocation is freed and grows in place
+		frame_allocator.deallocate(b);
+		void* c = frame_allocator.allocate(50);
+		LUMIX_EXPECT(c == b);
+		LUMIX_EXPECT(frame_allocator.reallocate(c, 1000) == c);
+
+		// anything else is copied
+		static_cast<char*>(a)[99] = 42;
+		void* d = frame_allocator.reallocate(a, 200);
+		LUMIX_EXPECT(d != a);
+		LUMIX_EXPECT(static_cast<char*>(d)[99] == 42);
+
+		void* aligned = frame_allocator.allocate_aligned(10, 64);
+		LUMIX_EXPECT((Lumix::uintptr)aligned % 64 == 0);
+		frame_allocator.deallocate_aligned(aligned);
+		frame_allocator.deallocate(d);
+		frame_allocator.deallocate(c);
+		frame_allocator.deallocate(a);
+	}
+
+
+	void UT_frame_allocator_ring(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::FrameAllocator frame_allocator(allocator, FRAME_SIZE, FRAMES_COUNT);
+
+		void* first = frame_allocator.allocate(100);
+		frame_allocator.nextFrame();
+		LUMIX_EXPECT(frame_allocator.getStats().last_frame_used > 0);
+		LUMIX_EXPECT(frame_allocator.getStats().last_frame_overflows == 0);
+
+		// memory of a frame is not reused until the ring comes back to it
+		for (int i = 1; i < FRAMES_COUNT; ++i)
+		{
+			void* ptr = frame_allocator.allocate(100);
+			LUMIX_EXPECT(ptr != first);
+			frame_allocator.nextFrame();
+		}
+		LUMIX_EXPECT(frame_allocator.allocate(100) == first);
+
+		// a frame without memory left uses the source allocator
+		void* big = frame_allocator.allocate(FRAME_SIZE);
+		LUMIX_EXPECT(big != nullptr);
+		frame_allocator.deallocate(big);
+		frame_allocator.nextFrame();
+		const Lumix::FrameAllocator::Stats& stats = frame_allocator.getStats();
+		LUMIX_EXPECT(stats.last_frame_overflows == 1);
+		LUMIX_EXPECT(stats.peak_used >= stats.last_frame_used);
+		LUMIX_EXPECT(stats.frame_size == FRAME_SIZE);
+	}
+
+
+	void UT_frame_allocator_threads(const char* params)
+	{
+		static const int JOBS_COUNT = 64;
+		static const int ARRAYS_PER_JOB = 10;
+
+		Lumix::DefaultAllocator allocator;
+		Lumix::MTJD::Manager* manager = Lumix::MTJD::Manager::create(allocator);
+		Lumix::FrameAllocator frame_allocator(allocator, FRAME_SIZE, FRAMES_COUNT);
+
+		for (int frame = 0; frame < FRAMES_COUNT * 2; ++frame)
+		{
+			int* arrays[JOBS_COUNT][ARRAYS_PER_JOB];
+			auto fill = [&](int from, int to) {
+				for (int i = from; i < to; ++i)
+				{
+					for (int j = 0; j < ARRAYS_PER_JOB; ++j)
+					{
+						int count = 10 + j * 37;
+						int* values = (int*)frame_allocator.allocate(sizeof(int) * count);
+						for (int k = 0; k < count; ++k) values[k] = i * ARRAYS_PER_JOB + j;
+						arrays[i][j] = values;
+					}
+				}
+			};
+			Lumix::MTJD::parallelFor(*manager, frame_allocator, 0, JOBS_COUNT, 1, fill).join();
+
+			// nothing was overwritten by other threads
+			for (int i = 0; i < JOBS_COUNT; ++i)
+			{
+				for (int j = 0; j < ARRAYS_PER_JOB; ++j)
+				{
+					int count = 10 + j * 37;
+					bool is_intact = true;
+					for (int k = 0; k < count; ++k) is_intact = is_intact && arrays[i][j][k] == i * ARRAYS_PER_JOB + j;
+					LUMIX_EXPECT(is_intact);
+				}
+			}
+			frame_allocator.nextFrame();
+			LUMIX_EXPECT(frame_allocator.getStats().last_frame_overflows == 0);
+		}
+
+		Lumix::MTJD::Manager::destroy(*manager);
+	}
+}
+
+REGISTER_TEST("unit_tests/engine/frame_allocator_lifo", UT_frame_allocator_lifo, "");
+REGISTER_TEST("unit_tests/engine/frame_allocator_ring", UT_frame_allocator_ring, "");
+REGISTER_TEST("unit_tests/engine/frame_allocator_threads", UT_frame_allocator_threads, "");
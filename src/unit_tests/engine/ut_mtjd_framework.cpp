@@ -1,6 +1,12 @@
 #include "unit_tests/suite/lumix_unit_tests.h"
+#include "engine/mt/atomic.h"
+#include "engine/mt/thread.h"
+#include "engine/mtjd/counter.h"
+#include "engine/mtjd/group.h"
 #include "engine/mtjd/job.h"
 #include "engine/mtjd/manager.h"
+#include "engine/mtjd/parallel_for.h"
+#include "engine/timer.h"
 
 
 namespace
@@ -15,6 +21,16 @@ float OUT_BUFFER[TESTS_COUNT][BUFFER_SIZE];
 
 static int s_auto_delete_count = 0;
 
+// far more than the fixed queues hold, so the overflow list is used
+const int32 TINY_JOBS_COUNT = 100000;
+static volatile int32 s_tiny_jobs_executed = 0;
+static volatile int32 s_tiny_jobs_on_workers = 0;
+static Lumix::MT::ThreadID s_main_thread;
+
+const int32 NESTED_LEVELS = 8;
+const int32 NESTED_FORK_COUNT = 4;
+static volatile int32 s_nested_leaves_executed = 0;
+
 static_assert(TESTS_COUNT % 2 == 0, "");
 }
 
@@ -65,6 +81,55 @@ private:
 	int32 m_size;
 };
 
+class TinyJob : public Lumix::MTJD::Job
+{
+public:
+	TinyJob(Lumix::MTJD::Manager& manager, Lumix::IAllocator& allocator)
+		: Job(Job::AUTO_DESTROY, Lumix::MTJD::Priority::Default, manager, allocator, allocator)
+	{
+		setJobName("TinyJob");
+	}
+
+	void execute() override
+	{
+		Lumix::MT::atomicIncrement(&s_tiny_jobs_executed);
+		Lumix::MT::ThreadID thread = Lumix::MT::getCurrentThreadID();
+		if (thread != s_main_thread) Lumix::MT::atomicIncrement(&s_tiny_jobs_on_workers);
+	}
+};
+
+class NestedJob : public Lumix::MTJD::Job
+{
+public:
+	NestedJob(int32 level, Lumix::MTJD::Manager& manager, Lumix::IAllocator& allocator)
+		: Job(Job::AUTO_DESTROY, Lumix::MTJD::Priority::Default, manager, allocator, allocator)
+		, m_level(level)
+	{
+		setJobName("NestedJob");
+	}
+
+	void execute() override
+	{
+		if (m_level == NESTED_LEVELS)
+		{
+			Lumix::MT::atomicIncrement(&s_nested_leaves_executed);
+			return;
+		}
+
+		Lumix::MTJD::Counter counter;
+		for (int32 i = 0; i < NESTED_FORK_COUNT; ++i)
+		{
+			NestedJob* job = LUMIX_NEW(m_job_allocator, NestedJob)(m_level + 1, *m_manager, m_job_allocator);
+			job->setCounter(&counter);
+			m_manager->schedule(job);
+		}
+		m_manager->wait(counter);
+	}
+
+private:
+	int32 m_level;
+};
+
 void UT_MTJDFrameworkTest(const char* params)
 {
 	Lumix::DefaultAllocator allocator;
@@ -192,5 +257,118 @@ void UT_MTJDFrameworkDependencyTest(const char* params)
 	allocator.deallocate(jobs);
 }
 
+void UT_MTJDFrameworkThroughputTest(const char* params)
+{
+	Lumix::DefaultAllocator allocator;
+	Lumix::MTJD::Manager* manager = Lumix::MTJD::Manager::create(allocator);
+
+	s_tiny_jobs_executed = 0;
+	s_tiny_jobs_on_workers = 0;
+	s_main_thread = Lumix::MT::getCurrentThreadID();
+	TinyJob** jobs = (TinyJob**)allocator.allocate(sizeof(TinyJob*) * TINY_JOBS_COUNT);
+	for (int32 i = 0; i < TINY_JOBS_COUNT; ++i)
+	{
+		jobs[i] = LUMIX_NEW(allocator, TinyJob)(*manager, allocator);
+	}
+
+	Lumix::Timer* timer = Lumix::Timer::create(allocator);
+	Lumix::MTJD::Counter counter;
+	// one burst from the main thread, schedule() must not run any of the jobs itself
+	for (int32 i = 0; i < TINY_JOBS_COUNT; ++i)
+	{
+		jobs[i]->setCounter(&counter);
+		manager->schedule(jobs[i]);
+	}
+	float schedule_time = timer->tick();
+	// the main thread does not run jobs, only workers are measured
+	while (!counter.isDone()) Lumix::MT::yield();
+	float time = schedule_time + timer->tick();
+	Lumix::Timer::destroy(timer);
+
+	LUMIX_EXPECT(s_tiny_jobs_executed == TINY_JOBS_COUNT);
+	LUMIX_EXPECT(s_tiny_jobs_on_workers == TINY_JOBS_COUNT);
+	Lumix::g_log_info.log("unit") << TINY_JOBS_COUNT << " jobs on " << manager->getCpuThreadsCount() << " workers in "
+								  << time * 1000 << " ms, " << (int)(TINY_JOBS_COUNT / time) << " jobs/s, scheduled in "
+								  << schedule_time * 1000 << " ms";
+
+	allocator.deallocate(jobs);
+	Lumix::MTJD::Manager::destroy(*manager);
+}
+
+void UT_MTJDFrameworkNestedTest(const char* params)
+{
+	Lumix::DefaultAllocator allocator;
+	Lumix::MTJD::Manager* manager = Lumix::MTJD::Manager::create(allocator);
+
+	int32 expected_leaves = 1;
+	for (int32 i = 0; i < NESTED_LEVELS; ++i)
+	{
+		expected_leaves *= NESTED_FORK_COUNT;
+	}
+
+	for (int32 run = 0; run < 4; ++run)
+	{
+		s_nested_leaves_executed = 0;
+		Lumix::MTJD::Counter counter;
+		NestedJob* root = LUMIX_NEW(allocator, NestedJob)(0, *manager, allocator);
+		root->setCounter(&counter);
+		manager->schedule(root);
+		manager->wait(counter);
+
+		LUMIX_EXPECT(counter.isDone());
+		LUMIX_EXPECT(s_nested_leaves_executed == expected_leaves);
+	}
+
+	Lumix::MTJD::Manager::destroy(*manager);
+}
+
+void UT_MTJDParallelForTest(const char* params)
+{
+	Lumix::DefaultAllocator allocator;
+	Lumix::MTJD::Manager* manager = Lumix::MTJD::Manager::create(allocator);
+
+	for (int32 i = 0; i < BUFFER_SIZE; ++i)
+	{
+		IN1_BUFFER[0][i] = (float)i;
+		OUT_BUFFER[0][i] = 0;
+	}
+
+	auto fn = [](int from, int to)
+	{
+		for (int i = from; i < to; ++i)
+		{
+			OUT_BUFFER[0][i] += IN1_BUFFER[0][i] + 1;
+		}
+	};
+	Lumix::MTJD::JoinHandle handle = Lumix::MTJD::parallelFor(*manager, allocator, 0, BUFFER_SIZE, 16, fn);
+	handle.join();
+	LUMIX_EXPECT(handle.isJoined());
+
+	for (int32 i = 0; i < BUFFER_SIZE; ++i)
+	{
+		LUMIX_EXPECT(OUT_BUFFER[0][i] == (float)i + 1);
+	}
+
+	LUMIX_EXPECT(Lumix::MTJD::getChunkSize(*manager, BUFFER_SIZE, 16) >= 16);
+	LUMIX_EXPECT(Lumix::MTJD::getChunkSize(*manager, 1, 16) == 16);
+
+	// a moved handle owns the jobs, a handle which goes out of scope joins them
+	{
+		Lumix::MTJD::JoinHandle moved = Lumix::MTJD::parallelFor(*manager, allocator, 0, BUFFER_SIZE, 16, fn);
+		Lumix::MTJD::JoinHandle owner(static_cast<Lumix::MTJD::JoinHandle&&>(moved));
+		LUMIX_EXPECT(moved.isJoined());
+		LUMIX_EXPECT(!owner.isJoined());
+	}
+	for (int32 i = 0; i < BUFFER_SIZE; ++i)
+	{
+		LUMIX_EXPECT(OUT_BUFFER[0][i] == (float)i * 2 + 2);
+	}
+
+	Lumix::MTJD::Manager::destroy(*manager);
+}
+
 REGISTER_TEST("unit_tests/engine/mtjd/frameworkTest", UT_MTJDFrameworkTest, "")
 REGISTER_TEST("unit_tests/engine/mtjd/frameworkDependencyTest", UT_MTJDFrameworkDependencyTest, "")
+REGISTER_TEST("unit_tests/engine/mtjd/frameworkThroughputTest", UT_MTJDFrameworkThroughputTest, "")
+REGISTER_TEST("unit_tests/engine/mtjd/frameworkNestedTest", UT_MTJDFrameworkNestedTest, "")
+REGISTER_TEST("unit_tests/engine/mtjd/parallelForTest", UT_MTJDParallelForTest, "")
@@ -0,0 +1,48 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+#include "engine/array.h"
+#include "engine/math_utils.h"
+#include "engine/radix_sort.h"
+
+
+namespace
+{
+	void UT_radix_sort(const char* params)
+	{
+		static const int COUNT = 1000;
+
+		Lumix::DefaultAllocator allocator;
+		Lumix::Math::seedRandom(14);
+		Lumix::Array<Lumix::uint64> keys(allocator);
+		Lumix::Array<Lumix::uint64> original(allocator);
+		Lumix::Array<int> values(allocator);
+		for (int i = 0; i < COUNT; ++i)
+		{
+			// few distinct high bits, so there are equal keys and skipped passes
+			Lumix::uint64 key = (Lumix::uint64(Lumix::Math::rand() % 4) << 56) | Lumix::Math::rand() % 100;
+			keys.push(key);
+			original.push(key);
+			values.push(i);
+		}
+
+		Lumix::radixSort(&keys[0], &values[0], COUNT, allocator);
+		for (int i = 0; i < COUNT; ++i)
+		{
+			LUMIX_EXPECT(keys[i] == original[values[i]]);
+			if (i == 0) continue;
+			LUMIX_EXPECT(keys[i - 1] <= keys[i]);
+			// stable
+			if (keys[i - 1] == keys[i]) LUMIX_EXPECT(values[i - 1] < values[i]);
+		}
+
+		// already sorted and single item input
+		Lumix::radixSort(&keys[0], &values[0], COUNT, allocator);
+		for (int i = 1; i < COUNT; ++i) LUMIX_EXPECT(keys[i - 1] <= keys[i]);
+		Lumix::uint64 key = 5;
+		int value = 7;
+		Lumix::radixSort(&key, &value, 1, allocator);
+		LUMIX_EXPECT(key == 5);
+		LUMIX_EXPECT(value == 7);
+	}
+}
+
+REGISTER_TEST("unit_tests/engine/radix_sort", UT_radix_sort, "");
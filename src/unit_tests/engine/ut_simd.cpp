@@ -1,5 +1,9 @@
 #include "unit_tests/suite/lumix_unit_tests.h"
+#include "engine/array.h"
+#include "engine/log.h"
+#include "engine/math_utils.h"
 #include "engine/simd.h"
+#include "engine/timer.h"
 
 
 using namespace Lumix;
@@ -152,6 +156,211 @@ void UT_simd_min_max(const char* params)
 }
 
 
+void UT_simd_splat_move_mask(const char* params)
+{
+	float LUMIX_ALIGN_BEGIN(16) tmp[4] LUMIX_ALIGN_END(16);
+	f4Store(tmp, f4Splat(7));
+	for (int i = 0; i < 4; ++i) LUMIX_EXPECT(tmp[i] == 7);
+
+	LUMIX_EXPECT(f4MoveMask(f4Load(c0)) == 0);
+	LUMIX_EXPECT(f4MoveMask(f4Load(c1)) == 1 << 2);
+	LUMIX_EXPECT(f4MoveMask(f4Load(c3)) == 3);
+
+	float unaligned[5] = { 0, 5, 9, -15, 0 };
+	f4Store(tmp, f4LoadUnaligned(unaligned + 1));
+	LUMIX_EXPECT_FLOAT4_EQUAL(tmp, c1);
+}
+
+
+void UT_simd_transpose(const char* params)
+{
+	float4 a = f4Load(c0);
+	float4 b = f4Load(c1);
+	float4 c = f4Load(c2);
+	float4 d = f4Load(c3);
+	f4Transpose(a, b, c, d);
+
+	float unaligned[17];
+	f4StoreUnaligned(unaligned + 1, a);
+	f4StoreUnaligned(unaligned + 5, b);
+	f4StoreUnaligned(unaligned + 9, c);
+	f4StoreUnaligned(unaligned + 13, d);
+	const float* rows[] = { c0, c1, c2, c3 };
+	for (int i = 0; i < 4; ++i)
+	{
+		for (int j = 0; j < 4; ++j)
+		{
+			LUMIX_EXPECT(unaligned[1 + i * 4 + j] == rows[j][i]);
+		}
+	}
+}
+
+
+#if LUMIX_SIMD_SSE()
+
+static const float LUMIX_ALIGN_BEGIN(32) c8_0[8] LUMIX_ALIGN_END(32) = { 0, 1, 2, 3, 5, 9, -15, 0 };
+static const float LUMIX_ALIGN_BEGIN(32) c8_1[8] LUMIX_ALIGN_END(32) = { 5, 9, -15, 0, 0, 1, 2, 3 };
+
+
+LUMIX_AVX2_TARGET static void testFloat8()
+{
+	float LUMIX_ALIGN_BEGIN(32) tmp[8] LUMIX_ALIGN_END(32);
+	float8 a = f8Load(c8_0);
+	float8 b = f8LoadUnaligned(c8_1);
+
+	f8Store(tmp, a);
+	for (int i = 0; i < 8; ++i) LUMIX_EXPECT(tmp[i] == c8_0[i]);
+
+	f8Store(tmp, f8Add(a, b));
+	for (int i = 0; i < 8; ++i) LUMIX_EXPECT_CLOSE_EQ(tmp[i], c8_0[i] + c8_1[i], 0.001f);
+
+	f8Store(tmp, f8Sub(a, b));
+	for (int i = 0; i < 8; ++i) LUMIX_EXPECT_CLOSE_EQ(tmp[i], c8_0[i] - c8_1[i], 0.001f);
+
+	f8Store(tmp, f8Mul(a, b));
+	for (int i = 0; i < 8; ++i) LUMIX_EXPECT_CLOSE_EQ(tmp[i], c8_0[i] * c8_1[i], 0.001f);
+
+	f8Store(tmp, f8Min(a, b));
+	for (int i = 0; i < 8; ++i) LUMIX_EXPECT(tmp[i] == Math::minimum(c8_0[i], c8_1[i]));
+
+	f8Store(tmp, f8Max(a, b));
+	for (int i = 0; i < 8; ++i) LUMIX_EXPECT(tmp[i] == Math::maximum(c8_0[i], c8_1[i]));
+
+	f8Store(tmp, f8Splat(3));
+	for (int i = 0; i < 8; ++i) LUMIX_EXPECT(tmp[i] == 3);
+
+	LUMIX_EXPECT(f8MoveMask(a) == 1 << 6);
+	LUMIX_EXPECT(f8MoveMask(b) == 1 << 2);
+}
+
+#endif
+
+
+void UT_simd_float8(const char* params)
+{
+#if LUMIX_SIMD_SSE()
+	if (!isAVX2Supported())
+	{
+		g_log_info.log("unit") << "AVX2 not supported, float8 not tested";
+		return;
+	}
+	testFloat8();
+#endif
+}
+
+
+// sphere vs. 6 planes, the same thing the culling system does, spheres are in separate x, y, z, radius arrays
+static const int BENCH_SPHERES_COUNT = 1 << 20;
+static const int BENCH_PLANES_COUNT = 6;
+static const float BENCH_PLANES[BENCH_PLANES_COUNT][4] = {
+	{ 1, 0, 0, 50 }, { -1, 0, 0, 50 }, { 0, 1, 0, 50 }, { 0, -1, 0, 50 }, { 0, 0, 1, 50 }, { 0, 0, -1, 50 } };
+
+
+static int cullScalar(const float* xs, const float* ys, const float* zs, const float* rs)
+{
+	int visible = 0;
+	for (int i = 0; i < BENCH_SPHERES_COUNT; ++i)
+	{
+		bool is_visible = true;
+		for (const auto& p : BENCH_PLANES)
+		{
+			float distance = (xs[i] * p[0] + ys[i] * p[1]) + zs[i] * p[2] + (p[3] + rs[i]);
+			is_visible = is_visible && distance >= 0;
+		}
+		visible += is_visible ? 1 : 0;
+	}
+	return visible;
+}
+
+
+static int cullFloat4(const float* xs, const float* ys, const float* zs, const float* rs)
+{
+	int visible = 0;
+	for (int i = 0; i < BENCH_SPHERES_COUNT; i += 4)
+	{
+		float4 x = f4LoadUnaligned(xs + i);
+		float4 y = f4LoadUnaligned(ys + i);
+		float4 z = f4LoadUnaligned(zs + i);
+		float4 r = f4LoadUnaligned(rs + i);
+		int outside = 0;
+		for (const auto& p : BENCH_PLANES)
+		{
+			float4 t = f4Add(f4Mul(x, f4Splat(p[0])), f4Mul(y, f4Splat(p[1])));
+			t = f4Add(t, f4Mul(z, f4Splat(p[2])));
+			t = f4Add(t, f4Add(f4Splat(p[3]), r));
+			outside |= f4MoveMask(t);
+		}
+		for (int j = 0; j < 4; ++j) visible += (outside & (1 << j)) ? 0 : 1;
+	}
+	return visible;
+}
+
+
+#if LUMIX_SIMD_SSE()
+
+LUMIX_AVX2_TARGET static int cullFloat8(const float* xs, const float* ys, const float* zs, const float* rs)
+{
+	int visible = 0;
+	for (int i = 0; i < BENCH_SPHERES_COUNT; i += 8)
+	{
+		float8 x = f8LoadUnaligned(xs + i);
+		float8 y = f8LoadUnaligned(ys + i);
+		float8 z = f8LoadUnaligned(zs + i);
+		float8 r = f8LoadUnaligned(rs + i);
+		int outside = 0;
+		for (const auto& p : BENCH_PLANES)
+		{
+			float8 t = f8Add(f8Mul(x, f8Splat(p[0])), f8Mul(y, f8Splat(p[1])));
+			t = f8Add(t, f8Mul(z, f8Splat(p[2])));
+			t = f8Add(t, f8Add(f8Splat(p[3]), r));
+			outside |= f8MoveMask(t);
+		}
+		for (int j = 0; j < 8; ++j) visible += (outside & (1 << j)) ? 0 : 1;
+	}
+	return visible;
+}
+
+#endif
+
+
+void UT_simd_culling_benchmark(const char* params)
+{
+	DefaultAllocator allocator;
+	Array<float> xs(allocator);
+	Array<float> ys(allocator);
+	Array<float> zs(allocator);
+	Array<float> rs(allocator);
+	for (int i = 0; i < BENCH_SPHERES_COUNT; ++i)
+	{
+		xs.push(Math::randFloat(-100, 100));
+		ys.push(Math::randFloat(-100, 100));
+		zs.push(Math::randFloat(-100, 100));
+		rs.push(Math::randFloat(0.1f, 5));
+	}
+
+	Timer* timer = Timer::create(allocator);
+	int scalar_visible = cullScalar(&xs[0], &ys[0], &zs[0], &rs[0]);
+	float scalar_time = timer->tick();
+	int float4_visible = cullFloat4(&xs[0], &ys[0], &zs[0], &rs[0]);
+	float float4_time = timer->tick();
+	LUMIX_EXPECT(scalar_visible == float4_visible);
+	g_log_info.log("unit") << BENCH_SPHERES_COUNT << " spheres: scalar " << scalar_time * 1000 << " ms, float4 "
+						   << float4_time * 1000 << " ms";
+
+#if LUMIX_SIMD_SSE()
+	if (isAVX2Supported())
+	{
+		timer->tick();
+		int float8_visible = cullFloat8(&xs[0], &ys[0], &zs[0], &rs[0]);
+		float float8_time = timer->tick();
+		LUMIX_EXPECT(scalar_visible == float8_visible);
+		g_log_info.log("unit") << BENCH_SPHERES_COUNT << " spheres: float8 " << float8_time * 1000 << " ms";
+	}
+#endif
+	Timer::destroy(timer);
+}
+
+
 REGISTER_TEST("unit_tests/engine/simd/load_store", UT_simd_load_store, "")
 REGISTER_TEST("unit_tests/engine/simd/add", UT_simd_add, "")
 REGISTER_TEST("unit_tests/engine/simd/sub", UT_simd_sub, "")
@@ -161,3 +370,7 @@ REGISTER_TEST("unit_tests/engine/simd/rcp", UT_simd_rcp, "")
 REGISTER_TEST("unit_tests/engine/simd/sqrt", UT_simd_sqrt, "")
 REGISTER_TEST("unit_tests/engine/simd/rsqrt", UT_simd_rsqrt, "")
 REGISTER_TEST("unit_tests/engine/simd/min_max", UT_simd_min_max, "")
+REGISTER_TEST("unit_tests/engine/simd/splat_move_mask", UT_simd_splat_move_mask, "")
+REGISTER_TEST("unit_tests/engine/simd/transpose", UT_simd_transpose, "")
+REGISTER_TEST("unit_tests/engine/simd/float8", UT_simd_float8, "")
+REGISTER_TEST("unit_tests/engine/simd/culling_benchmark", UT_simd_culling_benchmark, "")
@@ -1,4 +1,9 @@
 #include "unit_tests/suite/lumix_unit_tests.h"
+#include "engine/blob.h"
+#include "engine/crc32.h"
+#include "engine/matrix.h"
+#include "engine/property_register.h"
+#include "engine/universe/hierarchy.h"
 #include "engine/universe/universe.h"
 
 
@@ -95,6 +100,218 @@ namespace
 			LUMIX_EXPECT(universe.getEntityCount() == 4 - i);
 		}
 	}
+
+
+	struct TransformsListener
+	{
+		void onEntitiesTransformed(const Lumix::Entity* entities, int count)
+		{
+			++calls;
+			transformed_count += count;
+			for (int i = 0; i < count && i < Lumix::lengthOf(last_batch); ++i) last_batch[i] = entities[i];
+		}
+
+		void onEntityTransformed(Lumix::Entity entity) { ++single_calls; }
+		void onEntityTransformedImmediate(Lumix::Entity entity) { ++immediate_calls; }
+
+		int calls = 0;
+		int transformed_count = 0;
+		int single_calls = 0;
+		int immediate_calls = 0;
+		Lumix::Entity last_batch[16];
+	};
+
+
+	void UT_universe_transforms(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::PathManager path_manager(allocator);
+		Lumix::Universe universe(allocator);
+
+		static const int ENTITY_COUNT = 10;
+		Lumix::Entity entities[ENTITY_COUNT];
+		Lumix::Transform transforms[ENTITY_COUNT];
+		for (int i = 0; i < ENTITY_COUNT; ++i)
+		{
+			entities[i] = universe.createEntity({0, 0, 0}, {0, 0, 0, 1});
+			transforms[i].pos.set(float(i), float(i * 2), float(i * 3));
+			transforms[i].rot = Lumix::Quat(Lumix::Vec3(0, 1, 0), i * 0.1f);
+		}
+		universe.destroyEntity(entities[3]);
+		entities[3] = entities[ENTITY_COUNT - 1];
+
+		TransformsListener listener;
+		universe.entitiesTransformed().bind<TransformsListener, &TransformsListener::onEntitiesTransformed>(
+			&listener);
+		universe.setTransforms(entities, transforms, ENTITY_COUNT - 1);
+		LUMIX_EXPECT(listener.calls == 1);
+		LUMIX_EXPECT(listener.transformed_count == ENTITY_COUNT - 1);
+
+		for (int i = 0; i < ENTITY_COUNT - 1; ++i)
+		{
+			Lumix::Vec3 pos = universe.getPosition(entities[i]);
+			Lumix::Quat rot = universe.getRotation(entities[i]);
+			LUMIX_EXPECT_CLOSE_EQ(pos.y, transforms[i].pos.y, 0.00001f);
+			LUMIX_EXPECT_CLOSE_EQ(rot.y, transforms[i].rot.y, 0.00001f);
+			LUMIX_EXPECT_CLOSE_EQ(universe.getPositions()[universe.getDenseIdx(entities[i])].z,
+				transforms[i].pos.z,
+				0.00001f);
+		}
+		universe.entitiesTransformed().unbind<TransformsListener, &TransformsListener::onEntitiesTransformed>(
+			&listener);
+
+		Lumix::OutputBlob blob(allocator);
+		universe.serialize(blob);
+		Lumix::Universe loaded(allocator);
+		Lumix::InputBlob input(blob);
+		loaded.deserialize(input);
+		LUMIX_EXPECT(loaded.getEntityCount() == universe.getEntityCount());
+		for (int i = 0; i < ENTITY_COUNT - 1; ++i)
+		{
+			LUMIX_EXPECT(loaded.hasEntity(entities[i]));
+			LUMIX_EXPECT_CLOSE_EQ(loaded.getPosition(entities[i]).x, transforms[i].pos.x, 0.00001f);
+			LUMIX_EXPECT_CLOSE_EQ(loaded.getRotation(entities[i]).w, transforms[i].rot.w, 0.00001f);
+		}
+	}
+
+
+	void UT_universe_deferred_transforms(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::PathManager path_manager(allocator);
+		Lumix::Universe universe(allocator);
+
+		Lumix::Entity entities[4];
+		for (auto& entity : entities)
+		{
+			entity = universe.createEntity({0, 0, 0}, {0, 0, 0, 1});
+		}
+
+		TransformsListener listener;
+		universe.entitiesTransformed().bind<TransformsListener, &TransformsListener::onEntitiesTransformed>(
+			&listener);
+		universe.entityTransformed().bind<TransformsListener, &TransformsListener::onEntityTransformed>(&listener);
+		universe.entityTransformedImmediate()
+			.bind<TransformsListener, &TransformsListener::onEntityTransformedImmediate>(&listener);
+
+		universe.setDeferredTransformNotifications(true);
+		universe.setPosition(entities[2], {1, 2, 3});
+		universe.setPosition(entities[0], {1, 2, 3});
+		universe.setRotation(entities[2], {0, 1, 0, 0});
+		universe.setScale(entities[3], 2);
+		Lumix::Transform transforms[] = {{{3, 2, 1}, {0, 0, 0, 1}}, {{3, 2, 1}, {0, 0, 0, 1}}};
+		universe.setTransforms(entities, transforms, Lumix::lengthOf(transforms));
+		universe.destroyEntity(entities[3]);
+
+		LUMIX_EXPECT(listener.immediate_calls == 6);
+		LUMIX_EXPECT(listener.single_calls == 0);
+		LUMIX_EXPECT(listener.calls == 0);
+		LUMIX_EXPECT_CLOSE_EQ(universe.getPosition(entities[0]).x, 3, 0.00001f);
+
+		universe.flushTransformNotifications();
+		LUMIX_EXPECT(listener.calls == 1);
+		LUMIX_EXPECT(listener.transformed_count == 3);
+		LUMIX_EXPECT(listener.last_batch[0] == entities[2]);
+		LUMIX_EXPECT(listener.last_batch[1] == entities[0]);
+		LUMIX_EXPECT(listener.last_batch[2] == entities[1]);
+
+		universe.flushTransformNotifications();
+		LUMIX_EXPECT(listener.calls == 1);
+
+		universe.setPosition(entities[1], {0, 0, 0});
+		universe.setDeferredTransformNotifications(false);
+		LUMIX_EXPECT(listener.calls == 2);
+		LUMIX_EXPECT(listener.transformed_count == 4);
+
+		universe.setPosition(entities[1], {1, 1, 1});
+		LUMIX_EXPECT(listener.single_calls == 1);
+		LUMIX_EXPECT(listener.immediate_calls == 8);
+	}
+
+
+	// moves the follower when the leader is reported, like bone attachments follow their model
+	struct FollowingListener
+	{
+		void onEntitiesTransformed(const Lumix::Entity* entities, int count)
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				if (reported_count < Lumix::lengthOf(reported)) reported[reported_count++] = entities[i];
+				if (entities[i] == leader) universe->setPosition(follower, universe->getPosition(leader));
+			}
+			++calls;
+		}
+
+		Lumix::Universe* universe;
+		Lumix::Entity leader;
+		Lumix::Entity follower;
+		Lumix::Entity reported[16];
+		int reported_count = 0;
+		int calls = 0;
+	};
+
+
+	int findReported(const FollowingListener& listener, Lumix::Entity entity)
+	{
+		for (int i = 0; i < listener.reported_count; ++i)
+		{
+			if (listener.reported[i] == entity) return i;
+		}
+		return -1;
+	}
+
+
+	void UT_universe_flush_order(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::PathManager path_manager(allocator);
+		Lumix::Universe universe(allocator);
+		Lumix::HierarchyPlugin hierarchy_plugin(allocator);
+		hierarchy_plugin.createScenes(universe);
+		auto* hierarchy = static_cast<Lumix::Hierarchy*>(universe.getScene(Lumix::crc32("hierarchy")));
+		LUMIX_EXPECT(hierarchy != nullptr);
+
+		Lumix::Entity parent = universe.createEntity({0, 0, 0}, {0, 0, 0, 1});
+		Lumix::Entity child = universe.createEntity({1, 0, 0}, {0, 0, 0, 1});
+		Lumix::Entity grandchild = universe.createEntity({2, 0, 0}, {0, 0, 0, 1});
+		Lumix::Entity leader = universe.createEntity({0, 0, 0}, {0, 0, 0, 1});
+		Lumix::Entity follower = universe.createEntity({0, 0, 0}, {0, 0, 0, 1});
+		static const Lumix::ComponentType HIERARCHY_TYPE = Lumix::PropertyRegister::getComponentType("hierarchy");
+		hierarchy->setParent(hierarchy->createComponent(HIERARCHY_TYPE, child), parent);
+		hierarchy->setParent(hierarchy->createComponent(HIERARCHY_TYPE, grandchild), child);
+
+		FollowingListener listener;
+		listener.universe = &universe;
+		listener.leader = leader;
+		listener.follower = follower;
+		universe.entitiesTransformed().bind<FollowingListener, &FollowingListener::onEntitiesTransformed>(&listener);
+
+		// children are moved by the hierarchy before their parent is marked dirty
+		universe.setDeferredTransformNotifications(true);
+		universe.setPosition(grandchild, {5, 0, 0});
+		universe.setPosition(leader, {3, 3, 3});
+		universe.setPosition(parent, {0, 1, 0});
+		universe.flushTransformNotifications();
+
+		LUMIX_EXPECT(listener.reported_count == 5);
+		LUMIX_EXPECT(findReported(listener, parent) < findReported(listener, child));
+		LUMIX_EXPECT(findReported(listener, child) < findReported(listener, grandchild));
+		LUMIX_EXPECT(findReported(listener, leader) < findReported(listener, grandchild));
+		// the follower is moved by the listener and still reported in the same flush
+		LUMIX_EXPECT(findReported(listener, follower) == 4);
+		LUMIX_EXPECT(listener.calls == 2);
+		LUMIX_EXPECT_CLOSE_EQ(universe.getPosition(follower).x, 3, 0.00001f);
+
+		universe.flushTransformNotifications();
+		LUMIX_EXPECT(listener.calls == 2);
+
+		universe.setDeferredTransformNotifications(false);
+		universe.entitiesTransformed().unbind<FollowingListener, &FollowingListener::onEntitiesTransformed>(&listener);
+		hierarchy_plugin.destroyScene(hierarchy);
+	}
 } // anonymous namespace
 
 REGISTER_TEST("unit_tests/engine/universe", UT_universe, "");
+REGISTER_TEST("unit_tests/engine/universe_transforms", UT_universe_transforms, "");
+REGISTER_TEST("unit_tests/engine/universe_deferred_transforms", UT_universe_deferred_transforms, "");
+REGISTER_TEST("unit_tests/engine/universe_flush_order", UT_universe_flush_order, "");
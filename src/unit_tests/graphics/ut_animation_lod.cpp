@@ -0,0 +1,103 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "animation/animation_lod.h"
+#include "engine/lumix.h"
+
+
+namespace
+{
+	void UT_animation_lod_selection(const char* params)
+	{
+		LUMIX_EXPECT(Lumix::getAnimationLOD(nullptr, 0, 0) == -1);
+		LUMIX_EXPECT(Lumix::getAnimationLOD(nullptr, 0, 1000) == -1);
+
+		Lumix::AnimationLOD lods[] = {{25, 1, 0}, {60, 2, 0}, {150, 4, 10}};
+		LUMIX_EXPECT(Lumix::getAnimationLOD(lods, Lumix::lengthOf(lods), 0) == 0);
+		LUMIX_EXPECT(Lumix::getAnimationLOD(lods, Lumix::lengthOf(lods), 24.9f) == 0);
+		LUMIX_EXPECT(Lumix::getAnimationLOD(lods, Lumix::lengthOf(lods), 25) == 1);
+		LUMIX_EXPECT(Lumix::getAnimationLOD(lods, Lumix::lengthOf(lods), 59) == 1);
+		LUMIX_EXPECT(Lumix::getAnimationLOD(lods, Lumix::lengthOf(lods), 60) == 2);
+		// further than the last LOD
+		LUMIX_EXPECT(Lumix::getAnimationLOD(lods, Lumix::lengthOf(lods), 1000) == 2);
+
+		LUMIX_EXPECT(Lumix::getAnimationLOD(lods, 1, 1000) == 0);
+	}
+
+
+	void UT_animation_lod_update_interval(const char* params)
+	{
+		int lod_interval = 0;
+		int lod_frame = 0;
+
+		for (int i = 0; i < 3; ++i)
+		{
+			LUMIX_EXPECT((Lumix::selectAnimationUpdateType(true, 1, lod_interval, lod_frame) ==
+						  Lumix::AnimationUpdateType::SAMPLE));
+			LUMIX_EXPECT(lod_interval == 0);
+		}
+
+		// the first sample has no previous pose to interpolate from
+		LUMIX_EXPECT((Lumix::selectAnimationUpdateType(true, 4, lod_interval, lod_frame) ==
+					  Lumix::AnimationUpdateType::SAMPLE_AHEAD_FIRST));
+		for (int cycle = 0; cycle < 3; ++cycle)
+		{
+			for (int i = 1; i < 4; ++i)
+			{
+				LUMIX_EXPECT((Lumix::selectAnimationUpdateType(true, 4, lod_interval, lod_frame) ==
+							  Lumix::AnimationUpdateType::INTERPOLATE));
+				// interpolation weight of the ahead pose
+				LUMIX_EXPECT(lod_frame == i);
+				LUMIX_EXPECT(lod_interval == 4);
+			}
+			LUMIX_EXPECT((Lumix::selectAnimationUpdateType(true, 4, lod_interval, lod_frame) ==
+						  Lumix::AnimationUpdateType::SAMPLE_AHEAD));
+			LUMIX_EXPECT(lod_frame == 0);
+		}
+
+		// the interpolated poses are lost, e.g. the model changed
+		lod_interval = 0;
+		LUMIX_EXPECT((Lumix::selectAnimationUpdateType(true, 4, lod_interval, lod_frame) ==
+					  Lumix::AnimationUpdateType::SAMPLE_AHEAD_FIRST));
+
+		// a closer LOD samples every frame and the next interval starts from scratch
+		LUMIX_EXPECT((Lumix::selectAnimationUpdateType(true, 1, lod_interval, lod_frame) ==
+					  Lumix::AnimationUpdateType::SAMPLE));
+		LUMIX_EXPECT((Lumix::selectAnimationUpdateType(true, 2, lod_interval, lod_frame) ==
+					  Lumix::AnimationUpdateType::SAMPLE_AHEAD_FIRST));
+		LUMIX_EXPECT((Lumix::selectAnimationUpdateType(true, 2, lod_interval, lod_frame) ==
+					  Lumix::AnimationUpdateType::INTERPOLATE));
+		LUMIX_EXPECT((Lumix::selectAnimationUpdateType(true, 2, lod_interval, lod_frame) ==
+					  Lumix::AnimationUpdateType::SAMPLE_AHEAD));
+	}
+
+
+	void UT_animation_lod_skip_invisible(const char* params)
+	{
+		int lod_interval = 0;
+		int lod_frame = 0;
+
+		LUMIX_EXPECT((Lumix::selectAnimationUpdateType(false, 1, lod_interval, lod_frame) ==
+					  Lumix::AnimationUpdateType::SKIP));
+		LUMIX_EXPECT((Lumix::selectAnimationUpdateType(false, 4, lod_interval, lod_frame) ==
+					  Lumix::AnimationUpdateType::SKIP));
+		LUMIX_EXPECT(lod_interval == 0);
+
+		LUMIX_EXPECT((Lumix::selectAnimationUpdateType(true, 4, lod_interval, lod_frame) ==
+					  Lumix::AnimationUpdateType::SAMPLE_AHEAD_FIRST));
+		LUMIX_EXPECT((Lumix::selectAnimationUpdateType(true, 4, lod_interval, lod_frame) ==
+					  Lumix::AnimationUpdateType::INTERPOLATE));
+
+		// skipped animables do not update their poses, so they must not interpolate from the old ones
+		LUMIX_EXPECT((Lumix::selectAnimationUpdateType(false, 4, lod_interval, lod_frame) ==
+					  Lumix::AnimationUpdateType::SKIP));
+		LUMIX_EXPECT(lod_interval == 0);
+		LUMIX_EXPECT((Lumix::selectAnimationUpdateType(true, 4, lod_interval, lod_frame) ==
+					  Lumix::AnimationUpdateType::SAMPLE_AHEAD_FIRST));
+		LUMIX_EXPECT((Lumix::selectAnimationUpdateType(true, 1, lod_interval, lod_frame) ==
+					  Lumix::AnimationUpdateType::SAMPLE));
+	}
+}
+
+REGISTER_TEST("unit_tests/graphics/animation_lod_selection", UT_animation_lod_selection, "");
+REGISTER_TEST("unit_tests/graphics/animation_lod_update_interval", UT_animation_lod_update_interval, "");
+REGISTER_TEST("unit_tests/graphics/animation_lod_skip_invisible", UT_animation_lod_skip_invisible, "");
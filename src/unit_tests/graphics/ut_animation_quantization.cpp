@@ -0,0 +1,80 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "animation/animation_quantization.h"
+#include "engine/math_utils.h"
+
+#include <cmath>
+
+namespace
+{
+	Lumix::Quat getRandomRotation()
+	{
+		Lumix::Vec3 axis(
+			Lumix::Math::randFloat(-1, 1), Lumix::Math::randFloat(-1, 1), Lumix::Math::randFloat(0.1f, 1));
+		axis.normalize();
+		return Lumix::Quat(axis, Lumix::Math::randFloat(-2 * Lumix::Math::PI, 2 * Lumix::Math::PI));
+	}
+
+
+	void expectSameRotation(const Lumix::Quat& rot)
+	{
+		Lumix::uint16 quantized[3];
+		Lumix::quantizeRotation(rot, quantized);
+		Lumix::Quat result = Lumix::dequantizeRotation(quantized);
+
+		// q and -q are the same rotation
+		float dot = rot.x * result.x + rot.y * result.y + rot.z * result.z + rot.w * result.w;
+		LUMIX_EXPECT_CLOSE_EQ(fabsf(dot), 1.0f, 0.0001f);
+		float length = sqrtf(
+			result.x * result.x + result.y * result.y + result.z * result.z + result.w * result.w);
+		LUMIX_EXPECT_CLOSE_EQ(length, 1.0f, 0.0001f);
+	}
+
+
+	void UT_animation_quantize_rotation(const char* params)
+	{
+		Lumix::Math::seedRandom(8);
+		for (int i = 0; i < 1000; ++i)
+		{
+			expectSameRotation(getRandomRotation());
+		}
+
+		// the left out component is at each index and has both signs
+		expectSameRotation({0, 0, 0, 1});
+		expectSameRotation({0, 0, 0, -1});
+		expectSameRotation({1, 0, 0, 0});
+		expectSameRotation({0, -1, 0, 0});
+		expectSameRotation({0, 0, 1, 0});
+		expectSameRotation({0.5f, -0.5f, 0.5f, -0.5f});
+	}
+
+
+	void UT_animation_quantize_position(const char* params)
+	{
+		static const int COUNT = 200;
+
+		Lumix::Math::seedRandom(9);
+		Lumix::Vec3 positions[COUNT];
+		for (int i = 0; i < COUNT; ++i)
+		{
+			positions[i].set(Lumix::Math::randFloat(-3, 5), Lumix::Math::randFloat(0, 200), 1.5f);
+		}
+
+		Lumix::Vec3 min, step;
+		Lumix::getQuantizationRange(positions, COUNT, &min, &step);
+		LUMIX_EXPECT(step.z == 0);
+		for (int i = 0; i < COUNT; ++i)
+		{
+			Lumix::uint16 quantized[3];
+			Lumix::quantizePosition(positions[i], min, step, quantized);
+			Lumix::Vec3 result = Lumix::dequantizePosition(quantized, min, step);
+			// rounded to the nearest step
+			LUMIX_EXPECT_CLOSE_EQ(result.x, positions[i].x, step.x * 0.5f + 0.00001f);
+			LUMIX_EXPECT_CLOSE_EQ(result.y, positions[i].y, step.y * 0.5f + 0.0001f);
+			LUMIX_EXPECT_CLOSE_EQ(result.z, positions[i].z, 0.00001f);
+		}
+	}
+}
+
+REGISTER_TEST("unit_tests/graphics/animation_quantize_rotation", UT_animation_quantize_rotation, "");
+REGISTER_TEST("unit_tests/graphics/animation_quantize_position", UT_animation_quantize_position, "");
@@ -0,0 +1,448 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "animation/animation.h"
+#include "animation/animation_system.h"
+#include "animation/animation_update.h"
+#include "engine/blob.h"
+#include "engine/fs/disk_file_device.h"
+#include "engine/fs/file_system.h"
+#include "engine/log.h"
+#include "engine/math_utils.h"
+#include "engine/mtjd/manager.h"
+#include "engine/mtjd/parallel_for.h"
+#include "engine/path.h"
+#include "engine/quat.h"
+#include "engine/resource_manager.h"
+#include "engine/timer.h"
+
+#include "renderer/pose.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	static const int BONES_COUNT = 60;
+	static const int FRAMES_COUNT = 30;
+	static const int FPS = 30;
+	static const int CLIPS_COUNT = 4;
+	// every few animables are in a LOD with this update interval, so their poses are interpolated
+	static const int LOD_UPDATE_INTERVAL = 3;
+	static const Lumix::ResourceType ANIMATION_TYPE("animation");
+
+
+	// times of keys in frames, the first and the last frame always have a key
+	void writeKeyTimes(Lumix::OutputBlob& blob, int keys_count)
+	{
+		blob.write(keys_count);
+		int frame = 0;
+		for (int i = 0; i < keys_count; ++i)
+		{
+			int max_frame = FRAMES_COUNT - keys_count + i;
+			if (i == 0) frame = 0;
+			else if (i == keys_count - 1) frame = FRAMES_COUNT - 1;
+			else frame = (int)Lumix::Math::rand(frame, max_frame);
+			blob.write((Lumix::uint16)frame);
+			++frame;
+		}
+	}
+
+
+	// animation file with random keys, bone i of the animation is bone i of the skeleton
+	void writeAnimation(Lumix::FS::FileSystem& fs, const Lumix::Path& path, Lumix::IAllocator& allocator)
+	{
+		Lumix::OutputBlob blob(allocator);
+		Lumix::Animation::Header header;
+		header.magic = Lumix::Animation::HEADER_MAGIC;
+		header.version = (Lumix::uint32)Lumix::Animation::Version::QUANTIZATION;
+		header.fps = FPS;
+		blob.write(header);
+		blob.write(FRAMES_COUNT);
+		blob.write(BONES_COUNT);
+		for (int bone = 0; bone < BONES_COUNT; ++bone)
+		{
+			blob.write((Lumix::uint32)bone);
+
+			int pos_count = (int)Lumix::Math::rand(2, FRAMES_COUNT);
+			writeKeyTimes(blob, pos_count);
+			for (int i = 0; i < pos_count; ++i)
+			{
+				blob.write(Lumix::Vec3(Lumix::Math::randFloat(-1, 1), Lumix::Math::randFloat(0, 1), 0.0f));
+			}
+
+			int rot_count = (int)Lumix::Math::rand(2, FRAMES_COUNT);
+			writeKeyTimes(blob, rot_count);
+			for (int i = 0; i < rot_count; ++i)
+			{
+				Lumix::Vec3 axis(Lumix::Math::randFloat(-1, 1), Lumix::Math::randFloat(-1, 1), 1.0f);
+				axis.normalize();
+				blob.write(Lumix::Quat(axis, Lumix::Math::randFloat(-1, 1)));
+			}
+		}
+
+		Lumix::FS::IFile* file = fs.open(fs.getDiskDevice(), path, Lumix::FS::Mode::CREATE_AND_WRITE);
+		LUMIX_EXPECT(file != nullptr);
+		if (!file) return;
+		file->write(blob.getData(), blob.getPos());
+		fs.close(*file);
+	}
+
+
+	void getAnimationPath(int clip, char (&path)[Lumix::MAX_PATH_LENGTH])
+	{
+		sprintf(path, "animation_update_%d.ani", clip);
+	}
+
+
+	// loads animations the same way the engine does, from files written by the test to the working directory
+	struct TestAnimations
+	{
+		explicit TestAnimations(Lumix::IAllocator& _allocator)
+			: allocator(_allocator)
+			, disk_device("disk", "", _allocator)
+			, resource_manager(_allocator)
+			, animation_manager(_allocator)
+			, binding(_allocator)
+		{
+			Lumix::Math::seedRandom(7);
+			fs = Lumix::FS::FileSystem::create(allocator);
+			fs->mount(&disk_device);
+			fs->setDefaultDevice("disk");
+			resource_manager.create(*fs);
+			animation_manager.create(ANIMATION_TYPE, resource_manager);
+
+			for (int i = 0; i < CLIPS_COUNT; ++i)
+			{
+				char path[Lumix::MAX_PATH_LENGTH];
+				getAnimationPath(i, path);
+				writeAnimation(*fs, Lumix::Path(path), allocator);
+				clips[i] = static_cast<Lumix::Animation*>(animation_manager.load(Lumix::Path(path)));
+			}
+			for (Lumix::Animation* clip : clips)
+			{
+				while (clip->isEmpty()) fs->updateAsyncTransactions();
+				LUMIX_EXPECT(clip->isReady());
+			}
+
+			// models are not loaded in unit tests, bones of the animations are the model bones
+			binding.model = nullptr;
+			for (int i = 0; i < BONES_COUNT; ++i) binding.bone_indices.push(i);
+			parents[0] = -1;
+			for (int i = 1; i < BONES_COUNT; ++i)
+			{
+				parents[i] = i < 8 ? i - 1 : i - 1 - (i % 4);
+			}
+		}
+
+		~TestAnimations()
+		{
+			for (Lumix::Animation* clip : clips) animation_manager.unload(*clip);
+			animation_manager.destroy();
+			resource_manager.destroy();
+			Lumix::FS::FileSystem::destroy(fs);
+			for (int i = 0; i < CLIPS_COUNT; ++i)
+			{
+				char path[Lumix::MAX_PATH_LENGTH];
+				getAnimationPath(i, path);
+				remove(path);
+			}
+		}
+
+		bool isReady() const
+		{
+			for (Lumix::Animation* clip : clips)
+			{
+				if (!clip->isReady()) return false;
+			}
+			return true;
+		}
+
+		Lumix::IAllocator& allocator;
+		Lumix::FS::FileSystem* fs;
+		Lumix::FS::DiskFileDevice disk_device;
+		Lumix::ResourceManager resource_manager;
+		Lumix::AnimationManager animation_manager;
+		Lumix::Animation* clips[CLIPS_COUNT];
+		Lumix::Animation::Binding binding;
+		int parents[BONES_COUNT];
+	};
+
+
+	// has the members of AnimationSceneImpl::Animable which updateAnimablePose uses
+	struct TestAnimable
+	{
+		float time;
+		float time_scale;
+		Lumix::Animation* animation;
+		const Lumix::Animation::Binding* binding;
+		Lumix::Animation::KeyCursor* key_cursors;
+		Lumix::AnimationUpdateType update_type;
+		Lumix::Pose* lod_poses[2];
+		int lod_interval;
+		int lod_frame;
+		int update_interval;
+		Lumix::Pose* pose;
+	};
+
+
+	// bind pose of the test skeleton has all bones at the origin of their parents
+	struct TestSkeleton
+	{
+		void getRelativeBindPose(Lumix::Pose& pose) const
+		{
+			for (int i = 0; i < pose.count; ++i)
+			{
+				pose.positions[i].set(0, 0, 0);
+				pose.rotations[i].set(0, 0, 0, 1);
+			}
+			pose.is_absolute = false;
+		}
+
+		void computeAbsolute(Lumix::Pose& pose) const { pose.computeAbsolute(parents, 1); }
+
+		const int* parents;
+	};
+
+
+	struct TestScene
+	{
+		explicit TestScene(const TestAnimations& _animations)
+			: animations(_animations)
+			, animables(_animations.allocator)
+		{
+		}
+
+		~TestScene()
+		{
+			Lumix::IAllocator& allocator = animations.allocator;
+			for (TestAnimable& animable : animables)
+			{
+				LUMIX_DELETE(allocator, animable.pose);
+				LUMIX_DELETE(allocator, animable.lod_poses[0]);
+				LUMIX_DELETE(allocator, animable.lod_poses[1]);
+				allocator.deallocate(animable.key_cursors);
+			}
+		}
+
+		const TestAnimations& animations;
+		Lumix::Array<TestAnimable> animables;
+	};
+
+
+	Lumix::Pose* createPose(Lumix::IAllocator& allocator)
+	{
+		Lumix::Pose* pose = LUMIX_NEW(allocator, Lumix::Pose)(allocator);
+		pose->resize(BONES_COUNT);
+		return pose;
+	}
+
+
+	void createScene(TestScene& scene, int animables_count)
+	{
+		Lumix::IAllocator& allocator = scene.animations.allocator;
+		Lumix::Math::seedRandom(8);
+		for (int i = 0; i < animables_count; ++i)
+		{
+			TestAnimable& animable = scene.animables.emplace();
+			animable.animation = scene.animations.clips[i % CLIPS_COUNT];
+			animable.binding = &scene.animations.binding;
+			animable.time = Lumix::Math::randFloat(0, animable.animation->getLength());
+			animable.time_scale = Lumix::Math::randFloat(0.5f, 1.5f);
+			size_t cursors_size = sizeof(Lumix::Animation::KeyCursor) * BONES_COUNT;
+			animable.key_cursors = (Lumix::Animation::KeyCursor*)allocator.allocate(cursors_size);
+			memset(animable.key_cursors, 0, cursors_size);
+			animable.update_type = Lumix::AnimationUpdateType::SAMPLE;
+			animable.lod_poses[0] = createPose(allocator);
+			animable.lod_poses[1] = createPose(allocator);
+			animable.lod_interval = 0;
+			animable.lod_frame = 0;
+			animable.update_interval = i % 3 == 0 ? LOD_UPDATE_INTERVAL : 1;
+			animable.pose = createPose(allocator);
+		}
+	}
+
+
+	// done on the main thread before the jobs, like in AnimationScene
+	void selectUpdateTypes(TestScene& scene)
+	{
+		for (TestAnimable& animable : scene.animables)
+		{
+			animable.update_type = Lumix::selectAnimationUpdateType(
+				true, animable.update_interval, animable.lod_interval, animable.lod_frame);
+		}
+	}
+
+
+	void updateAnimable(const TestScene& scene, TestAnimable& animable, float time_delta)
+	{
+		TestSkeleton skeleton = {scene.animations.parents};
+		Lumix::updateAnimablePose(animable, animable.pose, BONES_COUNT, time_delta, skeleton);
+	}
+
+
+	void updateSerial(TestScene& scene, float time_delta)
+	{
+		selectUpdateTypes(scene);
+		for (TestAnimable& animable : scene.animables)
+		{
+			updateAnimable(scene, animable, time_delta);
+		}
+	}
+
+
+	void updateParallel(TestScene& scene, Lumix::MTJD::Manager& manager, float time_delta)
+	{
+		selectUpdateTypes(scene);
+		auto update = [&scene, time_delta](int from, int to)
+		{
+			for (int i = from; i < to; ++i)
+			{
+				updateAnimable(scene, scene.animables[i], time_delta);
+			}
+		};
+		Lumix::MTJD::JoinHandle handle = Lumix::MTJD::parallelFor(manager,
+			scene.animations.allocator,
+			0,
+			scene.animables.size(),
+			Lumix::AnimationScene::UPDATE_GRAIN,
+			update);
+		handle.join();
+	}
+
+
+	bool isSameState(const TestScene& a, const TestScene& b)
+	{
+		if (a.animables.size() != b.animables.size()) return false;
+		for (int i = 0; i < a.animables.size(); ++i)
+		{
+			const TestAnimable& lhs = a.animables[i];
+			const TestAnimable& rhs = b.animables[i];
+			if (lhs.time != rhs.time) return false;
+			if (memcmp(lhs.pose->positions, rhs.pose->positions, sizeof(Lumix::Vec3) * BONES_COUNT) != 0) return false;
+			if (memcmp(lhs.pose->rotations, rhs.pose->rotations, sizeof(Lumix::Quat) * BONES_COUNT) != 0) return false;
+		}
+		return true;
+	}
+
+
+	void UT_animation_update_determinism(const char* params)
+	{
+		static const int ANIMABLES_COUNT = 500;
+		static const int UPDATES_COUNT = 40;
+
+		Lumix::DefaultAllocator allocator;
+		Lumix::PathManager path_manager(allocator);
+		TestAnimations animations(allocator);
+		if (!animations.isReady()) return;
+
+		Lumix::MTJD::Manager* manager = Lumix::MTJD::Manager::create(allocator);
+		TestScene serial(animations);
+		TestScene parallel(animations);
+		TestScene parallel2(animations);
+		createScene(serial, ANIMABLES_COUNT);
+		createScene(parallel, ANIMABLES_COUNT);
+		createScene(parallel2, ANIMABLES_COUNT);
+
+		// the time steps wrap the animations around, so the key cursors go back too
+		for (int update = 0; update < UPDATES_COUNT; ++update)
+		{
+			float time_delta = 1 / 30.0f + (update % 3) * 0.01f;
+			updateSerial(serial, time_delta);
+			updateParallel(parallel, *manager, time_delta);
+			updateParallel(parallel2, *manager, time_delta);
+			LUMIX_EXPECT(isSameState(serial, parallel));
+			LUMIX_EXPECT(isSameState(parallel, parallel2));
+		}
+
+		Lumix::MTJD::Manager::destroy(*manager);
+	}
+
+
+	// cursors only speed up the key search, so the pose is the same as with the binary search
+	void UT_animation_cursor_sampling(const char* params)
+	{
+		static const int SAMPLES_COUNT = 300;
+		static const int SAMPLED_BONES_COUNT = 40;
+
+		Lumix::DefaultAllocator allocator;
+		Lumix::PathManager path_manager(allocator);
+		TestAnimations animations(allocator);
+		if (!animations.isReady()) return;
+
+		Lumix::Pose cursor_pose(allocator);
+		Lumix::Pose search_pose(allocator);
+		cursor_pose.resize(BONES_COUNT);
+		search_pose.resize(BONES_COUNT);
+		for (Lumix::Animation* clip : animations.clips)
+		{
+			Lumix::Animation::KeyCursor cursors[BONES_COUNT];
+			memset(cursors, 0, sizeof(cursors));
+			float time = 0;
+			for (int i = 0; i < SAMPLES_COUNT; ++i)
+			{
+				// mostly forward like a playing animation, sometimes back or far ahead
+				float step = i % 17 == 0 ? Lumix::Math::randFloat(-0.5f, 0.5f) : Lumix::Math::randFloat(0, 0.05f);
+				time = clip->wrapTime(Lumix::Math::maximum(time + step, 0.0f));
+				int bones_count = i % 5 == 0 ? SAMPLED_BONES_COUNT : BONES_COUNT;
+
+				memset(cursor_pose.positions, 0, sizeof(Lumix::Vec3) * BONES_COUNT);
+				memset(cursor_pose.rotations, 0, sizeof(Lumix::Quat) * BONES_COUNT);
+				memset(search_pose.positions, 0, sizeof(Lumix::Vec3) * BONES_COUNT);
+				memset(search_pose.rotations, 0, sizeof(Lumix::Quat) * BONES_COUNT);
+				cursor_pose.is_absolute = false;
+				search_pose.is_absolute = false;
+				clip->getRelativePose(time, cursor_pose, animations.binding, cursors, bones_count);
+				clip->getRelativePose(time, search_pose, animations.binding, nullptr, bones_count);
+				LUMIX_EXPECT(
+					memcmp(cursor_pose.positions, search_pose.positions, sizeof(Lumix::Vec3) * BONES_COUNT) == 0);
+				LUMIX_EXPECT(
+					memcmp(cursor_pose.rotations, search_pose.rotations, sizeof(Lumix::Quat) * BONES_COUNT) == 0);
+				// bones after bones_count are not sampled
+				bool is_last_sampled = cursor_pose.rotations[BONES_COUNT - 1].w != 0;
+				LUMIX_EXPECT(is_last_sampled == (bones_count == BONES_COUNT));
+			}
+		}
+	}
+
+
+	void UT_animation_update_benchmark(const char* params)
+	{
+		static const int ANIMABLES_COUNT = 1500;
+		static const int UPDATES_COUNT = 20;
+
+		Lumix::DefaultAllocator allocator;
+		Lumix::PathManager path_manager(allocator);
+		TestAnimations animations(allocator);
+		if (!animations.isReady()) return;
+
+		Lumix::MTJD::Manager* manager = Lumix::MTJD::Manager::create(allocator);
+		TestScene scene(animations);
+		createScene(scene, ANIMABLES_COUNT);
+
+		float serial_time;
+		{
+			Lumix::ScopedTimer timer("serial", allocator);
+			for (int i = 0; i < UPDATES_COUNT; ++i) updateSerial(scene, 1 / 60.0f);
+			serial_time = timer.getTimeSinceStart() * 1000;
+		}
+
+		float parallel_time;
+		{
+			Lumix::ScopedTimer timer("parallel", allocator);
+			for (int i = 0; i < UPDATES_COUNT; ++i) updateParallel(scene, *manager, 1 / 60.0f);
+			parallel_time = timer.getTimeSinceStart() * 1000;
+		}
+
+		int updated_count = ANIMABLES_COUNT * UPDATES_COUNT;
+		Lumix::g_log_info.log("unit") << ANIMABLES_COUNT << " animables, " << BONES_COUNT << " bones: serial "
+									  << updated_count / serial_time << " animables/ms, "
+									  << manager->getCpuThreadsCount() + 1 << " threads "
+									  << updated_count / parallel_time << " animables/ms";
+
+		Lumix::MTJD::Manager::destroy(*manager);
+	}
+}
+
+REGISTER_TEST("unit_tests/graphics/animation_update_determinism", UT_animation_update_determinism, "");
+REGISTER_TEST("unit_tests/graphics/animation_cursor_sampling", UT_animation_cursor_sampling, "");
+REGISTER_TEST("unit_tests/graphics/animation_update_benchmark", UT_animation_update_benchmark, "");
@@ -3,6 +3,7 @@
 #include "engine/geometry.h"
 #include "engine/timer.h"
 #include "engine/log.h"
+#include "engine/math_utils.h"
 
 #include "engine/mtjd/manager.h"
 
@@ -133,7 +134,536 @@ namespace
 
 		Lumix::CullingSystem::destroy(*culling_system);
 	}
+
+	Lumix::Frustum createTestFrustum()
+	{
+		Lumix::Frustum frustum;
+		frustum.computePerspective(
+			test_frustum.pos,
+			test_frustum.dir,
+			test_frustum.up,
+			Lumix::Math::degreesToRadians(test_frustum.fov),
+			test_frustum.ratio,
+			test_frustum.near,
+			test_frustum.far);
+		return frustum;
+	}
+
+	Lumix::Sphere randomSphere(float area_size)
+	{
+		return Lumix::Sphere(Lumix::Math::randFloat(-area_size, area_size),
+			Lumix::Math::randFloat(-area_size, area_size),
+			Lumix::Math::randFloat(-area_size, area_size),
+			Lumix::Math::randFloat(0.1f, 5.f));
+	}
+
+	void markVisible(const Lumix::CullingSystem::Results& results, Lumix::Array<int>& visible)
+	{
+		for (int i = 0; i < visible.size(); ++i) visible[i] = 0;
+		for (const Lumix::CullingSystem::Subresults& subresults : results)
+		{
+			for (Lumix::ComponentHandle cmp : subresults) ++visible[cmp.index];
+		}
+	}
+
+	void expectSameResults(Lumix::CullingSystem& flat, Lumix::CullingSystem& tree, bool async, Lumix::IAllocator& allocator)
+	{
+		Lumix::Frustum frustum = createTestFrustum();
+		Lumix::Array<int> flat_visible(allocator);
+		Lumix::Array<int> tree_visible(allocator);
+		flat_visible.resize(10000);
+		tree_visible.resize(10000);
+
+		for (Lumix::uint64 layer_mask = 1; layer_mask <= 2; ++layer_mask)
+		{
+			if (async)
+			{
+				flat.cullToFrustumAsync(frustum, layer_mask);
+				tree.cullToFrustumAsync(frustum, layer_mask);
+			}
+			else
+			{
+				flat.cullToFrustum(frustum, layer_mask);
+				tree.cullToFrustum(frustum, layer_mask);
+			}
+			markVisible(flat.getResult(), flat_visible);
+			markVisible(tree.getResult(), tree_visible);
+			int visible_count = 0;
+			for (int i = 0; i < flat_visible.size(); ++i)
+			{
+				LUMIX_EXPECT(flat_visible[i] == tree_visible[i]);
+				LUMIX_EXPECT(tree_visible[i] <= 1);
+				visible_count += flat_visible[i];
+			}
+			LUMIX_EXPECT(visible_count > 0);
+		}
+	}
+
+	void UT_culling_system_hierarchical(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::MTJD::Manager* mtjd_manager = Lumix::MTJD::Manager::create(allocator);
+		Lumix::CullingSystem* flat = Lumix::CullingSystem::create(*mtjd_manager, allocator);
+		Lumix::CullingSystem* tree = Lumix::CullingSystem::create(
+			*mtjd_manager, allocator, (Lumix::uint32)Lumix::CullingSystem::Flags::HIERARCHICAL);
+
+		for (int i = 0; i < 10000; ++i)
+		{
+			Lumix::Sphere sphere = randomSphere(100);
+			Lumix::uint64 layer_mask = i % 3 == 0 ? 2 : 1;
+			flat->addStatic({i}, sphere, layer_mask);
+			tree->addStatic({i}, sphere, layer_mask);
+		}
+		expectSameResults(*flat, *tree, false, allocator);
+		expectSameResults(*flat, *tree, true, allocator);
+
+		for (int frame = 0; frame < 200; ++frame)
+		{
+			for (int i = 0; i < 50; ++i)
+			{
+				Lumix::ComponentHandle cmp = {(int)Lumix::Math::rand(0, 9999)};
+				if (!flat->isAdded(cmp)) continue;
+				Lumix::Sphere sphere = frame & 1 ? tree->getSphere(cmp) : randomSphere(100);
+				sphere.position.x += 0.5f;
+				flat->updateBoundingSphere(sphere, cmp);
+				tree->updateBoundingSphere(sphere, cmp);
+			}
+			Lumix::ComponentHandle removed = {(int)Lumix::Math::rand(0, 9999)};
+			if (flat->isAdded(removed))
+			{
+				flat->removeStatic(removed);
+				tree->removeStatic(removed);
+			}
+			if (frame % 20 == 0)
+			{
+				Lumix::ComponentHandle layer_changed = {(int)Lumix::Math::rand(0, 9999)};
+				if (flat->isAdded(layer_changed))
+				{
+					flat->setLayerMask(layer_changed, 2);
+					tree->setLayerMask(layer_changed, 2);
+				}
+			}
+			expectSameResults(*flat, *tree, (frame & 2) != 0, allocator);
+		}
+
+		Lumix::CullingSystem::destroy(*tree);
+		Lumix::CullingSystem::destroy(*flat);
+		Lumix::MTJD::Manager::destroy(*mtjd_manager);
+	}
+
+	float getRayDistance(const Lumix::Vec3& point, const Lumix::Vec3& origin, const Lumix::Vec3& dir)
+	{
+		float t = Lumix::Math::maximum(0.0f, Lumix::dotProduct(point - origin, dir) / dir.squaredLength());
+		return (origin + dir * t - point).length();
+	}
+
+	void expectSameRayHits(Lumix::CullingSystem& culling_system,
+		const Lumix::Array<Lumix::Sphere>& spheres,
+		const Lumix::Array<bool>& is_added,
+		Lumix::IAllocator& allocator)
+	{
+		Lumix::CullingSystem::RayHits hits(allocator);
+		Lumix::Array<int> hit_counts(allocator);
+		hit_counts.resize(spheres.size());
+		int total_hits = 0;
+		for (int ray = 0; ray < 200; ++ray)
+		{
+			Lumix::Vec3 origin = randomSphere(120).position;
+			Lumix::Vec3 dir = randomSphere(1).position;
+			if (ray % 10 == 0) dir.set(0, 0, 1); // axis aligned rays hit the zero division in box tests
+			hits.clear();
+			culling_system.castRay(origin, dir, hits);
+
+			for (int& count : hit_counts) count = 0;
+			for (int i = 0; i < hits.size(); ++i)
+			{
+				++hit_counts[hits[i].model_instance.index];
+				if (i > 0) LUMIX_EXPECT(hits[i - 1].t <= hits[i].t);
+			}
+			for (int i = 0; i < spheres.size(); ++i)
+			{
+				// spheres only touched by the ray are skipped, so rounding errors do not fail the test
+				float distance = getRayDistance(spheres[i].position, origin, dir);
+				if (Lumix::Math::abs(distance - spheres[i].radius) < 0.01f) continue;
+				bool expected = is_added[i] && distance < spheres[i].radius;
+				LUMIX_EXPECT(hit_counts[i] == (expected ? 1 : 0));
+			}
+			total_hits += hits.size();
+		}
+		LUMIX_EXPECT(total_hits > 0);
+	}
+
+	void UT_culling_system_ray(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::MTJD::Manager* mtjd_manager = Lumix::MTJD::Manager::create(allocator);
+		Lumix::CullingSystem* flat = Lumix::CullingSystem::create(*mtjd_manager, allocator);
+		Lumix::CullingSystem* tree = Lumix::CullingSystem::create(
+			*mtjd_manager, allocator, (Lumix::uint32)Lumix::CullingSystem::Flags::HIERARCHICAL);
+
+		Lumix::Array<Lumix::Sphere> spheres(allocator);
+		Lumix::Array<bool> is_added(allocator);
+		for (int i = 0; i < 5000; ++i)
+		{
+			spheres.push(randomSphere(100));
+			is_added.push(true);
+			flat->addStatic({i}, spheres.back(), 1);
+			tree->addStatic({i}, spheres.back(), 1);
+		}
+		expectSameRayHits(*flat, spheres, is_added, allocator);
+
+		// culling builds the tree, then some spheres are moved out of their leaves and some removed
+		tree->cullToFrustum(createTestFrustum(), 1);
+		for (int i = 0; i < 500; ++i)
+		{
+			int idx = Lumix::Math::rand(0, 4999);
+			if (!is_added[idx]) continue;
+			if (i % 5 == 0)
+			{
+				is_added[idx] = false;
+				flat->removeStatic({idx});
+				tree->removeStatic({idx});
+				continue;
+			}
+			spheres[idx] = randomSphere(100);
+			flat->updateBoundingSphere(spheres[idx], {idx});
+			tree->updateBoundingSphere(spheres[idx], {idx});
+		}
+		expectSameRayHits(*flat, spheres, is_added, allocator);
+		expectSameRayHits(*tree, spheres, is_added, allocator);
+
+		Lumix::CullingSystem::destroy(*tree);
+		Lumix::CullingSystem::destroy(*flat);
+		Lumix::MTJD::Manager::destroy(*mtjd_manager);
+	}
+
+	void createTestFrustums(Lumix::Frustum* frustums, int count)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			Lumix::Vec3 dir(Lumix::Math::randFloat(-1, 1), Lumix::Math::randFloat(-1, 1), 1);
+			dir.normalize();
+			frustums[i].computePerspective(test_frustum.pos,
+				dir,
+				test_frustum.up,
+				Lumix::Math::degreesToRadians(test_frustum.fov),
+				test_frustum.ratio,
+				test_frustum.near * (i + 1) * 0.5f,
+				test_frustum.far * (i + 1) * 0.5f);
+		}
+	}
+
+	void expectSameMultiResults(Lumix::CullingSystem& culling_system, Lumix::IAllocator& allocator)
+	{
+		static const int FRUSTUMS_COUNT = 5;
+		Lumix::Frustum frustums[FRUSTUMS_COUNT];
+		Lumix::uint64 layer_masks[FRUSTUMS_COUNT] = {1, 1, 2, 3, 1};
+		createTestFrustums(frustums, FRUSTUMS_COUNT);
+
+		Lumix::Array<int> single_visible(allocator);
+		Lumix::Array<Lumix::uint32> multi_visible(allocator);
+		single_visible.resize(10000);
+		multi_visible.resize(10000);
+		for (auto& i : multi_visible) i = 0;
+
+		culling_system.cullToFrustums(frustums, FRUSTUMS_COUNT, layer_masks);
+		const Lumix::CullingSystem::Results& results = culling_system.getResult();
+		const Lumix::Array<Lumix::CullingSystem::VisibilityMasks>& masks = culling_system.getVisibilityMasks();
+		LUMIX_EXPECT(masks.size() >= results.size());
+		for (int i = 0; i < results.size(); ++i)
+		{
+			LUMIX_EXPECT(masks[i].size() == results[i].size());
+			for (int j = 0; j < results[i].size(); ++j)
+			{
+				LUMIX_EXPECT(multi_visible[results[i][j].index] == 0);
+				LUMIX_EXPECT(masks[i][j] != 0);
+				multi_visible[results[i][j].index] = masks[i][j];
+			}
+		}
+
+		for (int frustum_idx = 0; frustum_idx < FRUSTUMS_COUNT; ++frustum_idx)
+		{
+			culling_system.cullToFrustum(frustums[frustum_idx], layer_masks[frustum_idx]);
+			markVisible(culling_system.getResult(), single_visible);
+			for (int i = 0; i < single_visible.size(); ++i)
+			{
+				bool is_multi_visible = (multi_visible[i] & (1 << frustum_idx)) != 0;
+				LUMIX_EXPECT(is_multi_visible == (single_visible[i] != 0));
+			}
+		}
+	}
+
+	void UT_culling_system_multi_frustum(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::MTJD::Manager* mtjd_manager = Lumix::MTJD::Manager::create(allocator);
+		Lumix::CullingSystem* flat = Lumix::CullingSystem::create(*mtjd_manager, allocator);
+		Lumix::CullingSystem* tree = Lumix::CullingSystem::create(
+			*mtjd_manager, allocator, (Lumix::uint32)Lumix::CullingSystem::Flags::HIERARCHICAL);
+
+		for (int i = 0; i < 10000; ++i)
+		{
+			Lumix::Sphere sphere = randomSphere(100);
+			Lumix::uint64 layer_mask = i % 3 == 0 ? 2 : 1;
+			flat->addStatic({i}, sphere, layer_mask);
+			tree->addStatic({i}, sphere, layer_mask);
+		}
+
+		for (int i = 0; i < 10; ++i)
+		{
+			expectSameMultiResults(*flat, allocator);
+			expectSameMultiResults(*tree, allocator);
+		}
+
+		Lumix::CullingSystem::destroy(*tree);
+		Lumix::CullingSystem::destroy(*flat);
+		Lumix::MTJD::Manager::destroy(*mtjd_manager);
+	}
+
+	void markVisibilityMasks(Lumix::CullingSystem& culling_system, Lumix::Array<Lumix::uint32>& visible)
+	{
+		const Lumix::CullingSystem::Results& results = culling_system.getResult();
+		const Lumix::Array<Lumix::CullingSystem::VisibilityMasks>& masks = culling_system.getVisibilityMasks();
+		for (auto& i : visible) i = 0;
+		for (int i = 0; i < results.size(); ++i)
+		{
+			LUMIX_EXPECT(masks[i].size() == results[i].size());
+			for (int j = 0; j < results[i].size(); ++j)
+			{
+				LUMIX_EXPECT(visible[results[i][j].index] == 0);
+				visible[results[i][j].index] = masks[i][j];
+			}
+		}
+	}
+
+	void UT_culling_system_temporal_cache(const char* params)
+	{
+		static const int FRUSTUMS_COUNT = 3;
+		Lumix::DefaultAllocator allocator;
+		Lumix::MTJD::Manager* mtjd_manager = Lumix::MTJD::Manager::create(allocator);
+		Lumix::CullingSystem* flat = Lumix::CullingSystem::create(*mtjd_manager, allocator);
+		Lumix::CullingSystem* cached = Lumix::CullingSystem::create(*mtjd_manager, allocator);
+		cached->enableTemporalCache(true);
+		Lumix::CullingSystem* cached_tree = Lumix::CullingSystem::create(*mtjd_manager,
+			allocator,
+			(Lumix::uint32)Lumix::CullingSystem::Flags::TEMPORAL_CACHE |
+				(Lumix::uint32)Lumix::CullingSystem::Flags::HIERARCHICAL);
+		Lumix::CullingSystem* systems[] = {flat, cached, cached_tree};
+
+		for (int i = 0; i < 10000; ++i)
+		{
+			Lumix::Sphere sphere = randomSphere(100);
+			Lumix::uint64 layer_mask = i % 3 == 0 ? 2 : 1;
+			for (auto* system : systems) system->addStatic({i}, sphere, layer_mask);
+		}
+
+		Lumix::Frustum frustums[FRUSTUMS_COUNT];
+		Lumix::uint64 layer_masks[FRUSTUMS_COUNT] = {1, 2, 3};
+		createTestFrustums(frustums, FRUSTUMS_COUNT);
+		Lumix::Array<Lumix::uint32> flat_visible(allocator);
+		Lumix::Array<Lumix::uint32> cached_visible(allocator);
+		flat_visible.resize(10000);
+		cached_visible.resize(10000);
+
+		for (int frame = 0; frame < 200; ++frame)
+		{
+			// several frames without any change must be served from cache
+			int changes_count = frame % 4 == 0 ? 0 : frame % 5;
+			for (int i = 0; i < changes_count; ++i)
+			{
+				Lumix::ComponentHandle cmp = {(int)Lumix::Math::rand(0, 9999)};
+				if (!flat->isAdded(cmp))
+				{
+					Lumix::Sphere sphere = randomSphere(100);
+					for (auto* system : systems) system->addStatic(cmp, sphere, 3);
+					continue;
+				}
+				switch (i % 3)
+				{
+					case 0:
+						for (auto* system : systems) system->removeStatic(cmp);
+						break;
+					case 1:
+					{
+						Lumix::uint64 layer_mask = flat->getLayerMask(cmp) ^ 3;
+						for (auto* system : systems) system->setLayerMask(cmp, layer_mask);
+						break;
+					}
+					default:
+					{
+						Lumix::Sphere sphere = randomSphere(100);
+						for (auto* system : systems) system->updateBoundingSphere(sphere, cmp);
+						break;
+					}
+				}
+			}
+
+			expectSameResults(*flat, *cached, (frame & 1) != 0, allocator);
+			expectSameResults(*flat, *cached_tree, (frame & 2) != 0, allocator);
+
+			flat->cullToFrustums(frustums, FRUSTUMS_COUNT, layer_masks);
+			markVisibilityMasks(*flat, flat_visible);
+			for (int system_idx = 1; system_idx < Lumix::lengthOf(systems); ++system_idx)
+			{
+				systems[system_idx]->cullToFrustums(frustums, FRUSTUMS_COUNT, layer_masks);
+				markVisibilityMasks(*systems[system_idx], cached_visible);
+				int visible_count = 0;
+				for (int i = 0; i < flat_visible.size(); ++i)
+				{
+					LUMIX_EXPECT(flat_visible[i] == cached_visible[i]);
+					if (cached_visible[i]) ++visible_count;
+				}
+				// cache hits are split into chunks, so they can be processed in parallel
+				if (visible_count > 100) LUMIX_EXPECT(systems[system_idx]->getResult().size() > 1);
+			}
+		}
+
+		for (auto* system : systems) Lumix::CullingSystem::destroy(*system);
+		Lumix::MTJD::Manager::destroy(*mtjd_manager);
+	}
+
+	float measureCulling(Lumix::CullingSystem& culling_system, const Lumix::Frustum& frustum, Lumix::IAllocator& allocator)
+	{
+		static const int RUNS = 10;
+		culling_system.cullToFrustumAsync(frustum, 1); // warm up, builds the tree
+		culling_system.getResult();
+
+		Lumix::ScopedTimer timer("culling", allocator);
+		for (int i = 0; i < RUNS; ++i)
+		{
+			culling_system.cullToFrustumAsync(frustum, 1);
+			culling_system.getResult();
+		}
+		return timer.getTimeSinceStart() * 1000 / RUNS;
+	}
+
+	static const int MULTI_FRUSTUMS_COUNT = 5;
+
+	float measureMultiCulling(Lumix::CullingSystem& culling_system, Lumix::IAllocator& allocator)
+	{
+		static const int RUNS = 10;
+		Lumix::Frustum frustums[MULTI_FRUSTUMS_COUNT];
+		Lumix::uint64 layer_masks[MULTI_FRUSTUMS_COUNT];
+		for (int i = 0; i < MULTI_FRUSTUMS_COUNT; ++i)
+		{
+			frustums[i] = createTestFrustum();
+			layer_masks[i] = 1;
+		}
+
+		Lumix::ScopedTimer timer("multi frustum culling", allocator);
+		for (int i = 0; i < RUNS; ++i)
+		{
+			culling_system.cullToFrustums(frustums, MULTI_FRUSTUMS_COUNT, layer_masks);
+			culling_system.getResult();
+		}
+		return timer.getTimeSinceStart() * 1000 / RUNS;
+	}
+
+	// the same work as measureMultiCulling, one frustum per pass
+	float measureSeparateCulling(Lumix::CullingSystem& culling_system, Lumix::IAllocator& allocator)
+	{
+		static const int RUNS = 10;
+		Lumix::Frustum frustum = createTestFrustum();
+
+		Lumix::ScopedTimer timer("separate frustum culling", allocator);
+		for (int i = 0; i < RUNS; ++i)
+		{
+			for (int j = 0; j < MULTI_FRUSTUMS_COUNT; ++j)
+			{
+				culling_system.cullToFrustumAsync(frustum, 1);
+				culling_system.getResult();
+			}
+		}
+		return timer.getTimeSinceStart() * 1000 / RUNS;
+	}
+
+	float measureRays(Lumix::CullingSystem& culling_system,
+		const Lumix::Vec3* origins,
+		const Lumix::Vec3* dirs,
+		int count,
+		Lumix::IAllocator& allocator)
+	{
+		Lumix::CullingSystem::RayHits hits(allocator);
+		Lumix::ScopedTimer timer("rays", allocator);
+		for (int i = 0; i < count; ++i)
+		{
+			hits.clear();
+			culling_system.castRay(origins[i], dirs[i], hits);
+		}
+		return timer.getTimeSinceStart() * 1000;
+	}
+
+	void UT_culling_system_benchmark(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::MTJD::Manager* mtjd_manager = Lumix::MTJD::Manager::create(allocator);
+		Lumix::Frustum frustum = createTestFrustum();
+
+		for (int count = 10000; count <= 1000000; count *= 10)
+		{
+			Lumix::Array<Lumix::Sphere> spheres(allocator);
+			Lumix::Array<Lumix::ComponentHandle> model_instances(allocator);
+			spheres.reserve(count);
+			model_instances.reserve(count);
+			float area_size = 10 * Lumix::Math::pow((float)count, 1 / 3.0f);
+			for (int i = 0; i < count; ++i)
+			{
+				spheres.push(randomSphere(area_size));
+				model_instances.push({i});
+			}
+
+			Lumix::CullingSystem* flat = Lumix::CullingSystem::create(*mtjd_manager, allocator);
+			Lumix::CullingSystem* tree = Lumix::CullingSystem::create(
+				*mtjd_manager, allocator, (Lumix::uint32)Lumix::CullingSystem::Flags::HIERARCHICAL);
+			Lumix::CullingSystem* cached = Lumix::CullingSystem::create(
+				*mtjd_manager, allocator, (Lumix::uint32)Lumix::CullingSystem::Flags::TEMPORAL_CACHE);
+			flat->insert(spheres, model_instances);
+			tree->insert(spheres, model_instances);
+			cached->insert(spheres, model_instances);
+
+			float flat_time = measureCulling(*flat, frustum, allocator);
+			float tree_time = measureCulling(*tree, frustum, allocator);
+			float cached_time = measureCulling(*cached, frustum, allocator);
+			Lumix::g_log_info.log("unit") << count << " spheres: flat " << flat_time << " ms, hierarchical "
+										  << tree_time << " ms, static camera with cache " << cached_time << " ms";
+
+			float flat_multi_time = measureMultiCulling(*flat, allocator);
+			float tree_multi_time = measureMultiCulling(*tree, allocator);
+			Lumix::g_log_info.log("unit") << count << " spheres, " << MULTI_FRUSTUMS_COUNT << " frustums in one pass: flat "
+										  << flat_multi_time << " ms, hierarchical " << tree_multi_time << " ms";
+			float flat_separate_time = measureSeparateCulling(*flat, allocator);
+			float tree_separate_time = measureSeparateCulling(*tree, allocator);
+			Lumix::g_log_info.log("unit") << count << " spheres, " << MULTI_FRUSTUMS_COUNT
+										  << " frustums in separate passes: flat " << flat_separate_time
+										  << " ms, hierarchical " << tree_separate_time << " ms";
+
+			static const int RAYS_COUNT = 100;
+			Lumix::Vec3 origins[RAYS_COUNT];
+			Lumix::Vec3 dirs[RAYS_COUNT];
+			for (int i = 0; i < RAYS_COUNT; ++i)
+			{
+				origins[i] = randomSphere(area_size).position;
+				dirs[i] = randomSphere(1).position;
+				dirs[i].normalize();
+			}
+			float flat_rays_time = measureRays(*flat, origins, dirs, RAYS_COUNT, allocator);
+			float tree_rays_time = measureRays(*tree, origins, dirs, RAYS_COUNT, allocator);
+			Lumix::g_log_info.log("unit") << count << " spheres, " << RAYS_COUNT << " rays: flat " << flat_rays_time
+										  << " ms, hierarchical " << tree_rays_time << " ms";
+
+			Lumix::CullingSystem::destroy(*cached);
+			Lumix::CullingSystem::destroy(*tree);
+			Lumix::CullingSystem::destroy(*flat);
+		}
+
+		Lumix::MTJD::Manager::destroy(*mtjd_manager);
+	}
 }
 
 REGISTER_TEST("unit_tests/graphics/culling_system", UT_culling_system, "");
 REGISTER_TEST("unit_tests/graphics/culling_system_async", UT_culling_system_async, "");
+REGISTER_TEST("unit_tests/graphics/culling_system_hierarchical", UT_culling_system_hierarchical, "");
+REGISTER_TEST("unit_tests/graphics/culling_system_ray", UT_culling_system_ray, "");
+REGISTER_TEST("unit_tests/graphics/culling_system_multi_frustum", UT_culling_system_multi_frustum, "");
+REGISTER_TEST("unit_tests/graphics/culling_system_temporal_cache", UT_culling_system_temporal_cache, "");
+REGISTER_TEST("unit_tests/graphics/culling_system_benchmark", UT_culling_system_benchmark, "");
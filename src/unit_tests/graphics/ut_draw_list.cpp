@@ -0,0 +1,275 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "engine/log.h"
+#include "engine/math_utils.h"
+#include "engine/matrix.h"
+#include "engine/mtjd/manager.h"
+#include "engine/mtjd/parallel_for.h"
+#include "engine/timer.h"
+#include "renderer/draw_list.h"
+
+namespace
+{
+	static const int INSTANCES_COUNT = 50000;
+	static const int MESHES_COUNT = 300;
+	// the same grain PipelineImpl uses for instance data
+	static const int INSTANCE_DATA_GRAIN = 1024;
+	// instance data which fillInstances did not write
+	static const float UNTOUCHED_X = 1000;
+
+
+	// a draw list of a render scene; PipelineImpl can not be created without bgfx, so the commands
+	// are created here and transient instance data buffers are faked
+	struct TestDrawList
+	{
+		explicit TestDrawList(Lumix::IAllocator& allocator)
+			: list(allocator)
+			, model_instances(allocator)
+			, meshes(allocator)
+			, is_allocated(allocator)
+			, buffers(allocator)
+			, instance_data(allocator)
+		{
+		}
+
+		Lumix::DrawList list;
+		Lumix::Array<Lumix::ModelInstance> model_instances;
+		Lumix::Array<Lumix::ModelInstanceMesh> meshes;
+		// per command, whether it gets instance data
+		Lumix::Array<bool> is_allocated;
+		Lumix::Array<bgfx::InstanceDataBuffer> buffers;
+		// indexed by draw list items, so it is clear which items were written
+		Lumix::Array<Lumix::Matrix> instance_data;
+	};
+
+
+	// model instances are shuffled in the draw list, like after sorting by the sort key
+	void createInstances(TestDrawList& test, int count)
+	{
+		Lumix::Math::seedRandom(15);
+		test.model_instances.resize(count);
+		test.meshes.resize(count);
+		test.list.meshes.resize(count);
+		for (int i = 0; i < count; ++i)
+		{
+			Lumix::ModelInstance& model_instance = test.model_instances[i];
+			model_instance.type = Lumix::ModelInstance::RIGID;
+			model_instance.matrix.setIdentity();
+			model_instance.matrix.setTranslation(
+				{Lumix::Math::randFloat(-100, 100), 0, Lumix::Math::randFloat(-100, 100)});
+			test.meshes[i].model_instance = {i};
+			test.meshes[i].mesh = nullptr;
+			test.list.meshes[i] = &test.meshes[i];
+			test.list.order.push(i);
+		}
+		for (int i = count - 1; i > 0; --i)
+		{
+			int j = Lumix::Math::rand() % (i + 1);
+			int tmp = test.list.order[i];
+			test.list.order[i] = test.list.order[j];
+			test.list.order[j] = tmp;
+		}
+	}
+
+
+	void addCommand(TestDrawList& test, int count, bool is_rigid, bool is_allocated)
+	{
+		Lumix::Array<Lumix::DrawCommand>& commands = test.list.commands;
+		int first = commands.empty() ? 0 : commands.back().first + commands.back().count;
+		Lumix::DrawCommand& cmd = commands.emplace();
+		cmd.first = first;
+		cmd.count = count;
+		cmd.instances = nullptr;
+		cmd.is_rigid = is_rigid;
+		test.is_allocated.push(is_rigid && is_allocated);
+	}
+
+
+	// regions are handed out in draw list order, like bgfx allocates transient buffers
+	void allocInstances(TestDrawList& test)
+	{
+		Lumix::Matrix untouched;
+		untouched.setIdentity();
+		untouched.setTranslation({UNTOUCHED_X, 0, 0});
+		test.instance_data.clear();
+		for (int i = 0; i < test.list.meshes.size(); ++i) test.instance_data.push(untouched);
+
+		test.buffers.resize(test.list.commands.size());
+		for (int i = 0; i < test.list.commands.size(); ++i)
+		{
+			Lumix::DrawCommand& cmd = test.list.commands[i];
+			bgfx::InstanceDataBuffer& buffer = test.buffers[i];
+			buffer.data = (Lumix::uint8*)&test.instance_data[cmd.first];
+			buffer.size = cmd.count * sizeof(Lumix::Matrix);
+			buffer.offset = 0;
+			buffer.num = cmd.count;
+			buffer.stride = sizeof(Lumix::Matrix);
+			cmd.instances = test.is_allocated[i] ? &buffer : nullptr;
+		}
+	}
+
+
+	bool isWritten(const TestDrawList& test, int item)
+	{
+		return test.instance_data[item].getTranslation().x != UNTOUCHED_X;
+	}
+
+
+	bool isFilled(const TestDrawList& test, int item)
+	{
+		const Lumix::Matrix& mtx = test.model_instances[test.list.order[item]].matrix;
+		return test.instance_data[item].getTranslation().x == mtx.getTranslation().x &&
+			   test.instance_data[item].getTranslation().z == mtx.getTranslation().z;
+	}
+
+
+	// all instances of commands with instance data are filled, nothing else is written
+	bool isFilled(const TestDrawList& test)
+	{
+		for (int i = 0; i < test.list.commands.size(); ++i)
+		{
+			const Lumix::DrawCommand& cmd = test.list.commands[i];
+			for (int j = cmd.first; j < cmd.first + cmd.count; ++j)
+			{
+				if (cmd.instances ? !isFilled(test, j) : isWritten(test, j)) return false;
+			}
+		}
+		return true;
+	}
+
+
+	void fillInJobs(const TestDrawList& test, int grain)
+	{
+		int count = test.list.meshes.size();
+		for (int from = 0; from < count; from += grain)
+		{
+			Lumix::fillInstances(test.list, &test.model_instances[0], from, Lumix::Math::minimum(from + grain, count));
+		}
+	}
+
+
+	void UT_draw_list_fill_range(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		TestDrawList test(allocator);
+		createInstances(test, 30);
+		addCommand(test, 10, true, true);
+		addCommand(test, 10, true, true);
+		addCommand(test, 10, true, true);
+		allocInstances(test);
+
+		// starts in the middle of the first command and ends in the middle of the second one
+		Lumix::fillInstances(test.list, &test.model_instances[0], 5, 12);
+		for (int i = 0; i < 30; ++i)
+		{
+			LUMIX_EXPECT((i >= 5 && i < 12 ? isFilled(test, i) : !isWritten(test, i)));
+		}
+
+		// starts in the middle of the last command
+		Lumix::fillInstances(test.list, &test.model_instances[0], 25, 30);
+		for (int i = 25; i < 30; ++i) LUMIX_EXPECT(isFilled(test, i));
+		LUMIX_EXPECT(!isWritten(test, 24));
+
+		Lumix::fillInstances(test.list, &test.model_instances[0], 12, 25);
+		Lumix::fillInstances(test.list, &test.model_instances[0], 0, 5);
+		LUMIX_EXPECT(isFilled(test));
+	}
+
+
+	void UT_draw_list_fill_mixed(const char* params)
+	{
+		static const int COMMANDS_COUNT = 500;
+
+		Lumix::DefaultAllocator allocator;
+		TestDrawList test(allocator);
+		int count = 0;
+		Lumix::Math::seedRandom(16);
+		for (int i = 0; i < COMMANDS_COUNT; ++i)
+		{
+			int type = Lumix::Math::rand() % 4;
+			// skinned and multilayer meshes have a command per mesh and no instance data
+			if (type == 0)
+			{
+				addCommand(test, 1, false, false);
+				++count;
+				continue;
+			}
+			// runs which do not fit in the instance data buffer, including single instances
+			int run = i % 7 == 0 ? 1 : 1 + Lumix::Math::rand() % 50;
+			addCommand(test, run, true, type != 1);
+			count += run;
+		}
+		createInstances(test, count);
+
+		int grains[] = {1, 3, 7, 64, INSTANCE_DATA_GRAIN, count};
+		for (int grain : grains)
+		{
+			allocInstances(test);
+			fillInJobs(test, grain);
+			LUMIX_EXPECT(isFilled(test));
+		}
+
+		// a list which starts and ends with commands without instance data
+		TestDrawList edges(allocator);
+		addCommand(edges, 1, false, false);
+		addCommand(edges, 5, true, false);
+		addCommand(edges, 5, true, true);
+		addCommand(edges, 1, false, false);
+		createInstances(edges, 12);
+		allocInstances(edges);
+		fillInJobs(edges, 2);
+		LUMIX_EXPECT(isFilled(edges));
+	}
+
+
+	void UT_draw_list_benchmark(const char* params)
+	{
+		static const int FRAMES_COUNT = 10;
+
+		Lumix::DefaultAllocator allocator;
+		Lumix::MTJD::Manager* manager = Lumix::MTJD::Manager::create(allocator);
+		TestDrawList test(allocator);
+		for (int i = 0; i < MESHES_COUNT; ++i)
+		{
+			int count = i == MESHES_COUNT - 1 ? INSTANCES_COUNT - i * (INSTANCES_COUNT / MESHES_COUNT)
+											  : INSTANCES_COUNT / MESHES_COUNT;
+			addCommand(test, count, true, true);
+		}
+		createInstances(test, INSTANCES_COUNT);
+
+		float serial_time = 0;
+		float parallel_time = 0;
+		for (int frame = 0; frame < FRAMES_COUNT; ++frame)
+		{
+			allocInstances(test);
+			{
+				Lumix::ScopedTimer timer("serial", allocator);
+				Lumix::fillInstances(test.list, &test.model_instances[0], 0, INSTANCES_COUNT);
+				serial_time += timer.getTimeSinceStart() * 1000;
+			}
+			LUMIX_EXPECT(isFilled(test));
+
+			allocInstances(test);
+			{
+				Lumix::ScopedTimer timer("parallel", allocator);
+				auto fill = [&test](int from, int to) {
+					Lumix::fillInstances(test.list, &test.model_instances[0], from, to);
+				};
+				Lumix::MTJD::parallelFor(*manager, allocator, 0, INSTANCES_COUNT, INSTANCE_DATA_GRAIN, fill).join();
+				parallel_time += timer.getTimeSinceStart() * 1000;
+			}
+			LUMIX_EXPECT(isFilled(test));
+		}
+
+		Lumix::g_log_info.log("unit") << INSTANCES_COUNT << " instances in " << MESHES_COUNT
+									  << " batches: serial " << serial_time / FRAMES_COUNT << " ms, "
+									  << manager->getCpuThreadsCount() + 1 << " threads "
+									  << parallel_time / FRAMES_COUNT << " ms per frame";
+
+		Lumix::MTJD::Manager::destroy(*manager);
+	}
+}
+
+REGISTER_TEST("unit_tests/graphics/draw_list_fill_range", UT_draw_list_fill_range, "");
+REGISTER_TEST("unit_tests/graphics/draw_list_fill_mixed", UT_draw_list_fill_mixed, "");
+REGISTER_TEST("unit_tests/graphics/draw_list_benchmark", UT_draw_list_benchmark, "");
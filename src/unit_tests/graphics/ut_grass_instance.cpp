@@ -0,0 +1,150 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "engine/log.h"
+#include "engine/math_utils.h"
+#include "engine/matrix.h"
+#include "engine/mtjd/manager.h"
+#include "engine/mtjd/parallel_for.h"
+#include "engine/quat.h"
+#include "engine/timer.h"
+
+#include "renderer/grass_instance.h"
+
+namespace
+{
+	// how terrains built the instance matrix before instances were compact
+	Lumix::Matrix getExpectedMatrix(const Lumix::Matrix& terrain_matrix, const Lumix::Vec3& pos, float yaw, float scale)
+	{
+		Lumix::Matrix tmp = Lumix::Matrix::IDENTITY;
+		tmp.setTranslation(pos);
+		Lumix::Quat q(Lumix::Vec3(0, 1, 0), yaw);
+		tmp = terrain_matrix * tmp * q.toMatrix();
+		tmp.multiply3x3(scale);
+		return tmp;
+	}
+
+
+	void UT_grass_instance(const char* params)
+	{
+		static const int COUNT = 500;
+
+		Lumix::Math::seedRandom(14);
+		Lumix::Matrix terrain_matrix = Lumix::Quat(Lumix::Vec3(0, 1, 0), 0.7f).toMatrix();
+		terrain_matrix.setTranslation(Lumix::Vec3(100, -20, 35));
+
+		Lumix::Vec3 pos_min(40, 3, 70);
+		Lumix::Vec3 pos_max(51, 18, 81);
+		Lumix::Vec3 pos_step = (pos_max - pos_min) * (1 / Lumix::GRASS_QUANTIZED_POSITION_MAX);
+
+		Lumix::Vec3 positions[COUNT];
+		float yaws[COUNT];
+		float scales[COUNT];
+		Lumix::Vec3 normals[COUNT];
+		Lumix::GrassInstance instances[COUNT];
+		for (int i = 0; i < COUNT; ++i)
+		{
+			positions[i].set(Lumix::Math::randFloat(pos_min.x, pos_max.x),
+				Lumix::Math::randFloat(pos_min.y, pos_max.y),
+				Lumix::Math::randFloat(pos_min.z, pos_max.z));
+			yaws[i] = Lumix::Math::randFloat(0, Lumix::Math::PI * 2);
+			scales[i] = Lumix::Math::randFloat(0.15f, 1.1f);
+			normals[i].set(Lumix::Math::randFloat(-1, 1), Lumix::Math::randFloat(0.5f, 1), Lumix::Math::randFloat(-1, 1));
+			normals[i].normalize();
+			Lumix::packGrassInstance(
+				positions[i], yaws[i], scales[i], normals[i], pos_min, pos_step, &instances[i]);
+		}
+		LUMIX_EXPECT(sizeof(Lumix::GrassInstance) == 10);
+
+		Lumix::GrassInfo::InstanceData expanded[COUNT];
+		Lumix::expandGrassInstances(instances, COUNT, terrain_matrix, pos_min, pos_step, expanded);
+		for (int i = 0; i < COUNT; ++i)
+		{
+			Lumix::Matrix expected = getExpectedMatrix(terrain_matrix, positions[i], yaws[i], scales[i]);
+			const Lumix::Matrix& result = expanded[i].matrix;
+			// half a step of yaw and scale
+			const float axis_tolerance = scales[i] * Lumix::Math::PI / 256 + Lumix::GRASS_MAX_SCALE / 510 + 0.0001f;
+			const float* e = &expected.m11;
+			const float* r = &result.m11;
+			for (int j = 0; j < 12; ++j)
+			{
+				LUMIX_EXPECT_CLOSE_EQ(r[j], e[j], axis_tolerance);
+			}
+			for (int j = 12; j < 16; ++j)
+			{
+				LUMIX_EXPECT_CLOSE_EQ(r[j], e[j], 0.001f);
+			}
+
+			const Lumix::Vec4& normal = expanded[i].normal;
+			LUMIX_EXPECT_CLOSE_EQ(normal.x, normals[i].x, 0.005f);
+			LUMIX_EXPECT_CLOSE_EQ(normal.y, normals[i].y, 0.02f);
+			LUMIX_EXPECT_CLOSE_EQ(normal.z, normals[i].z, 0.005f);
+			LUMIX_EXPECT(normal.w == 0);
+		}
+	}
+
+
+	// PipelineImpl::renderGrasses expands the instances of all visible patches each frame
+	void UT_grass_instance_benchmark(const char* params)
+	{
+		static const int PATCHES_COUNT = 200;
+		static const int PATCH_SIZE = 1000;
+		static const int FRAMES_COUNT = 10;
+
+		Lumix::DefaultAllocator allocator;
+		Lumix::MTJD::Manager* manager = Lumix::MTJD::Manager::create(allocator);
+		Lumix::Math::seedRandom(15);
+		Lumix::Array<Lumix::GrassInstance> instances(allocator);
+		instances.resize(PATCHES_COUNT * PATCH_SIZE);
+		for (Lumix::GrassInstance& instance : instances)
+		{
+			for (Lumix::uint16& pos : instance.pos) pos = (Lumix::uint16)(Lumix::Math::rand() & 0xffff);
+			instance.yaw = (Lumix::uint8)Lumix::Math::rand();
+			instance.scale = (Lumix::uint8)Lumix::Math::rand();
+			instance.normal[0] = (Lumix::int8)(Lumix::Math::rand() % 64);
+			instance.normal[1] = (Lumix::int8)(Lumix::Math::rand() % 64);
+		}
+		Lumix::Array<Lumix::GrassInfo::InstanceData> expanded(allocator);
+		expanded.resize(instances.size());
+		Lumix::Matrix terrain_matrix = Lumix::Matrix::IDENTITY;
+		Lumix::Vec3 pos_min(0, 0, 0);
+		Lumix::Vec3 pos_step(0.001f, 0.001f, 0.001f);
+
+		auto expand = [&](int from, int to) {
+			for (int i = from; i < to; ++i)
+			{
+				Lumix::expandGrassInstances(&instances[i * PATCH_SIZE],
+					PATCH_SIZE,
+					terrain_matrix,
+					pos_min,
+					pos_step,
+					&expanded[i * PATCH_SIZE]);
+			}
+		};
+
+		float serial_time = 0;
+		float parallel_time = 0;
+		for (int frame = 0; frame < FRAMES_COUNT; ++frame)
+		{
+			{
+				Lumix::ScopedTimer timer("serial", allocator);
+				expand(0, PATCHES_COUNT);
+				serial_time += timer.getTimeSinceStart() * 1000;
+			}
+			{
+				Lumix::ScopedTimer timer("parallel", allocator);
+				Lumix::MTJD::parallelFor(*manager, allocator, 0, PATCHES_COUNT, 1, expand).join();
+				parallel_time += timer.getTimeSinceStart() * 1000;
+			}
+		}
+
+		Lumix::g_log_info.log("unit") << PATCHES_COUNT * PATCH_SIZE << " grass instances: serial "
+									  << serial_time / FRAMES_COUNT << " ms, "
+									  << manager->getCpuThreadsCount() + 1 << " threads "
+									  << parallel_time / FRAMES_COUNT << " ms per frame";
+
+		Lumix::MTJD::Manager::destroy(*manager);
+	}
+}
+
+REGISTER_TEST("unit_tests/graphics/grass_instance", UT_grass_instance, "");
+REGISTER_TEST("unit_tests/graphics/grass_instance_benchmark", UT_grass_instance_benchmark, "");
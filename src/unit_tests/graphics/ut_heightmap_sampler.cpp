@@ -0,0 +1,122 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "engine/math_utils.h"
+
+#include "renderer/heightmap_sampler.h"
+
+namespace
+{
+	// not square and not a power of two, so width and height can not be mixed up
+	static const int WIDTH = 37;
+	static const int HEIGHT = 29;
+
+
+	void createHeights(Lumix::Array<Lumix::uint16>& heights)
+	{
+		heights.resize(WIDTH * HEIGHT);
+		for (Lumix::uint16& h : heights) h = (Lumix::uint16)(Lumix::Math::rand() & 0xffff);
+	}
+
+
+	void expectSameAsSingle(const Lumix::HeightmapSampler& sampler, const Lumix::Vec2* positions, int count)
+	{
+		float heights[64];
+		float batch_heights[64];
+		Lumix::Vec3 normals[64];
+		ASSERT(count <= Lumix::lengthOf(heights));
+		sampler.getHeightsAndNormals(positions, count, heights, normals);
+		sampler.getHeights(positions, count, batch_heights);
+		float tolerance = sampler.scale.y * 0.0001f;
+		for (int i = 0; i < count; ++i)
+		{
+			float height = sampler.getHeight(positions[i].x, positions[i].y);
+			Lumix::Vec3 normal = sampler.getNormal(positions[i].x, positions[i].y);
+			LUMIX_EXPECT_CLOSE_EQ(heights[i], height, tolerance);
+			LUMIX_EXPECT_CLOSE_EQ(batch_heights[i], height, tolerance);
+			LUMIX_EXPECT_CLOSE_EQ(normals[i].x, normal.x, 0.001f);
+			LUMIX_EXPECT_CLOSE_EQ(normals[i].y, normal.y, 0.001f);
+			LUMIX_EXPECT_CLOSE_EQ(normals[i].z, normal.z, 0.001f);
+		}
+	}
+
+
+	void UT_heightmap_sampler_batch(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::Math::seedRandom(23);
+		Lumix::Array<Lumix::uint16> heights(allocator);
+		createHeights(heights);
+		Lumix::Vec3 scales[] = {{1, 1, 1}, {2, 100, 2}, {0.5f, 300, 0.5f}};
+		for (const Lumix::Vec3& scale : scales)
+		{
+			Lumix::HeightmapSampler sampler(&heights[0], WIDTH, HEIGHT, scale);
+
+			// every count up to a few full lanes, so the tail lanes are covered
+			Lumix::Vec2 positions[64];
+			for (int count = 1; count <= 13; ++count)
+			{
+				for (int i = 0; i < count; ++i)
+				{
+					positions[i].set(Lumix::Math::randFloat(0, (WIDTH - 1) * scale.x),
+						Lumix::Math::randFloat(0, (HEIGHT - 1) * scale.z));
+				}
+				expectSameAsSingle(sampler, positions, count);
+			}
+
+			for (int k = 0; k < 50; ++k)
+			{
+				for (Lumix::Vec2& pos : positions)
+				{
+					pos.set(Lumix::Math::randFloat(0, (WIDTH - 1) * scale.x),
+						Lumix::Math::randFloat(0, (HEIGHT - 1) * scale.z));
+				}
+				expectSameAsSingle(sampler, positions, Lumix::lengthOf(positions) - 3);
+			}
+
+			// at samples and on the diagonals of quads
+			Lumix::Vec2 exact[] = {{0, 0},
+				{scale.x, 0},
+				{3 * scale.x, 2 * scale.z},
+				{2.5f * scale.x, 4.5f * scale.z},
+				{(WIDTH - 1) * scale.x, (HEIGHT - 1) * scale.z}};
+			expectSameAsSingle(sampler, exact, Lumix::lengthOf(exact));
+
+			// the last row and column, neighbours out of the heightmap are clamped
+			Lumix::Vec2 edges[] = {{(WIDTH - 1.5f) * scale.x, 3.3f * scale.z},
+				{(WIDTH - 0.5f) * scale.x, 3.3f * scale.z},
+				{5.2f * scale.x, (HEIGHT - 0.5f) * scale.z},
+				{(WIDTH - 0.25f) * scale.x, (HEIGHT - 0.75f) * scale.z},
+				{(WIDTH + 3.0f) * scale.x, (HEIGHT + 3.0f) * scale.z}};
+			expectSameAsSingle(sampler, edges, Lumix::lengthOf(edges));
+		}
+	}
+
+
+	void UT_heightmap_sampler_clamp(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::Array<Lumix::uint16> heights(allocator);
+		// every sample is different, so a sample from another row is detected
+		heights.resize(WIDTH * HEIGHT);
+		for (int i = 0; i < heights.size(); ++i) heights[i] = (Lumix::uint16)(i * 7);
+		Lumix::HeightmapSampler sampler(&heights[0], WIDTH, HEIGHT, {1, 65535, 1});
+
+		LUMIX_EXPECT(sampler.getSample(-1, -1) == heights[0]);
+		LUMIX_EXPECT(sampler.getSample(WIDTH, 0) == heights[WIDTH - 1]);
+		LUMIX_EXPECT(sampler.getSample(WIDTH + 10, 2) == heights[WIDTH - 1 + 2 * WIDTH]);
+		LUMIX_EXPECT(sampler.getSample(3, HEIGHT) == heights[3 + (HEIGHT - 1) * WIDTH]);
+		LUMIX_EXPECT(sampler.getSample(WIDTH, HEIGHT) == heights[WIDTH * HEIGHT - 1]);
+
+		// the quad beyond the last column is flat at the height of the last column
+		float edge = heights[WIDTH - 1 + 4 * WIDTH];
+		LUMIX_EXPECT_CLOSE_EQ(sampler.getHeight(WIDTH - 0.5f, 4.0f), edge, 0.01f);
+		Lumix::Vec2 pos(WIDTH - 0.5f, 4.0f);
+		float batch_height;
+		Lumix::Vec3 normal;
+		sampler.getHeightsAndNormals(&pos, 1, &batch_height, &normal);
+		LUMIX_EXPECT_CLOSE_EQ(batch_height, edge, 0.01f);
+	}
+}
+
+REGISTER_TEST("unit_tests/graphics/heightmap_sampler_batch", UT_heightmap_sampler_batch, "");
+REGISTER_TEST("unit_tests/graphics/heightmap_sampler_clamp", UT_heightmap_sampler_clamp, "");
@@ -0,0 +1,225 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "engine/geometry.h"
+#include "engine/log.h"
+#include "engine/math_utils.h"
+#include "engine/timer.h"
+
+#include "renderer/light_influence_grid.h"
+
+namespace
+{
+	struct TestLight
+	{
+		Lumix::Vec3 position;
+		float range;
+		bool is_valid;
+	};
+
+
+	bool overlaps(const TestLight& light, const Lumix::Sphere& sphere)
+	{
+		float dist = light.range + sphere.radius;
+		return (light.position - sphere.position).squaredLength() < dist * dist;
+	}
+
+
+	Lumix::Vec3 randomPosition(float area_size)
+	{
+		return {Lumix::Math::randFloat(-area_size, area_size),
+			Lumix::Math::randFloat(-area_size, area_size),
+			Lumix::Math::randFloat(-area_size, area_size)};
+	}
+
+
+	float randomRange() { return Lumix::Math::rand() % 20 == 0 ? 150.0f : Lumix::Math::randFloat(2, 20); }
+
+
+	void checkInfluence(Lumix::IAllocator& allocator,
+		const Lumix::LightInfluenceGrid& grid,
+		const Lumix::Array<TestLight>& lights,
+		const Lumix::Array<Lumix::Sphere>& spheres,
+		const Lumix::Array<bool>& valid_spheres)
+	{
+		Lumix::Array<int> instance_lights(allocator);
+		instance_lights.resize(spheres.size());
+		for (int& count : instance_lights) count = 0;
+
+		for (int i = 0; i < lights.size(); ++i)
+		{
+			const auto& influenced = grid.getInfluencedInstances({i});
+			if (!lights[i].is_valid)
+			{
+				LUMIX_EXPECT(influenced.empty());
+				continue;
+			}
+
+			int expected_count = 0;
+			for (int j = 0; j < spheres.size(); ++j)
+			{
+				if (!valid_spheres[j] || !overlaps(lights[i], spheres[j])) continue;
+				++expected_count;
+				++instance_lights[j];
+			}
+			LUMIX_EXPECT(influenced.size() == expected_count);
+			for (Lumix::ComponentHandle instance : influenced)
+			{
+				LUMIX_EXPECT(valid_spheres[instance.index]);
+				LUMIX_EXPECT(overlaps(lights[i], spheres[instance.index]));
+			}
+		}
+
+		for (int j = 0; j < spheres.size(); ++j)
+		{
+			LUMIX_EXPECT(grid.getInstanceLightsCount({j}) == instance_lights[j]);
+		}
+	}
+
+
+	void UT_light_influence_grid(const char* params)
+	{
+		static const int LIGHTS_COUNT = 100;
+		static const int INSTANCES_COUNT = 1000;
+		static const float AREA_SIZE = 150;
+
+		Lumix::DefaultAllocator allocator;
+		Lumix::LightInfluenceGrid grid(allocator, 16);
+		Lumix::Math::seedRandom(1);
+
+		Lumix::Array<TestLight> lights(allocator);
+		Lumix::Array<Lumix::Sphere> spheres(allocator);
+		Lumix::Array<bool> valid_spheres(allocator);
+		for (int i = 0; i < LIGHTS_COUNT; ++i)
+		{
+			TestLight& light = lights.emplace();
+			light.position = randomPosition(AREA_SIZE);
+			light.range = randomRange();
+			light.is_valid = true;
+			grid.setLight({i}, light.position, light.range);
+		}
+		for (int i = 0; i < INSTANCES_COUNT; ++i)
+		{
+			float radius = i % 50 == 0 ? 100.0f : Lumix::Math::randFloat(0.1f, 5);
+			spheres.emplace(randomPosition(AREA_SIZE), radius);
+			valid_spheres.push(true);
+			grid.setInstance({i}, spheres.back());
+		}
+		checkInfluence(allocator, grid, lights, spheres, valid_spheres);
+
+		for (int step = 0; step < 5; ++step)
+		{
+			for (int i = 0; i < 300; ++i)
+			{
+				int idx = Lumix::Math::rand() % INSTANCES_COUNT;
+				switch (Lumix::Math::rand() % 3)
+				{
+					case 0:
+						spheres[idx].position = randomPosition(AREA_SIZE);
+						valid_spheres[idx] = true;
+						grid.setInstance({idx}, spheres[idx]);
+						break;
+					case 1:
+						spheres[idx].position += randomPosition(3);
+						if (valid_spheres[idx]) grid.setInstance({idx}, spheres[idx]);
+						break;
+					case 2:
+						valid_spheres[idx] = false;
+						grid.removeInstance({idx});
+						break;
+				}
+			}
+			for (int i = 0; i < 30; ++i)
+			{
+				int idx = Lumix::Math::rand() % LIGHTS_COUNT;
+				TestLight& light = lights[idx];
+				if (Lumix::Math::rand() % 4 == 0)
+				{
+					light.is_valid = false;
+					grid.removeLight({idx});
+					continue;
+				}
+				light.position = randomPosition(AREA_SIZE);
+				light.range = randomRange();
+				light.is_valid = true;
+				grid.setLight({idx}, light.position, light.range);
+			}
+			checkInfluence(allocator, grid, lights, spheres, valid_spheres);
+		}
+
+		grid.clear();
+		LUMIX_EXPECT(grid.getInfluencedInstances({0}).empty());
+		LUMIX_EXPECT(grid.getInstanceLightsCount({0}) == 0);
+	}
+
+
+	void UT_light_influence_grid_benchmark(const char* params)
+	{
+		static const int LIGHTS_COUNT = 2000;
+		static const int INSTANCES_COUNT = 10000;
+		static const int MOVING_COUNT = 5000;
+		static const float AREA_SIZE = 500;
+
+		Lumix::DefaultAllocator allocator;
+		Lumix::LightInfluenceGrid grid(allocator);
+		Lumix::Math::seedRandom(2);
+
+		Lumix::Array<TestLight> lights(allocator);
+		for (int i = 0; i < LIGHTS_COUNT; ++i)
+		{
+			TestLight& light = lights.emplace();
+			light.position = randomPosition(AREA_SIZE);
+			light.range = Lumix::Math::randFloat(2, 20);
+			light.is_valid = true;
+			grid.setLight({i}, light.position, light.range);
+		}
+		Lumix::Array<Lumix::Sphere> spheres(allocator);
+		for (int i = 0; i < INSTANCES_COUNT; ++i)
+		{
+			spheres.emplace(randomPosition(AREA_SIZE), Lumix::Math::randFloat(0.1f, 5));
+			grid.setInstance({i}, spheres.back());
+		}
+		for (int i = 0; i < MOVING_COUNT; ++i)
+		{
+			spheres[i].position += randomPosition(1);
+		}
+
+		// what each moved instance used to cost, every light is tested
+		int brute_force_links = 0;
+		float brute_force_time;
+		{
+			Lumix::ScopedTimer timer("brute force", allocator);
+			for (int i = 0; i < MOVING_COUNT; ++i)
+			{
+				for (const TestLight& light : lights)
+				{
+					if (overlaps(light, spheres[i])) ++brute_force_links;
+				}
+			}
+			brute_force_time = timer.getTimeSinceStart() * 1000;
+		}
+
+		int tests_count = grid.getPairTestsCount();
+		float grid_time;
+		{
+			Lumix::ScopedTimer timer("grid", allocator);
+			for (int i = 0; i < MOVING_COUNT; ++i)
+			{
+				grid.setInstance({i}, spheres[i]);
+			}
+			grid_time = timer.getTimeSinceStart() * 1000;
+		}
+		tests_count = grid.getPairTestsCount() - tests_count;
+
+		int grid_links = 0;
+		for (int i = 0; i < MOVING_COUNT; ++i) grid_links += grid.getInstanceLightsCount({i});
+		LUMIX_EXPECT(grid_links == brute_force_links);
+
+		Lumix::g_log_info.log("unit") << MOVING_COUNT << " moving instances, " << LIGHTS_COUNT
+									  << " lights: brute force " << brute_force_time << " ms, grid " << grid_time
+									  << " ms, " << tests_count << " light tests instead of "
+									  << MOVING_COUNT * LIGHTS_COUNT;
+	}
+}
+
+REGISTER_TEST("unit_tests/graphics/light_influence_grid", UT_light_influence_grid, "");
+REGISTER_TEST("unit_tests/graphics/light_influence_grid_benchmark", UT_light_influence_grid_benchmark, "");
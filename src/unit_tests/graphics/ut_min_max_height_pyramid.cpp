@@ -0,0 +1,233 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "engine/log.h"
+#include "engine/math_utils.h"
+#include "engine/timer.h"
+
+#include "renderer/min_max_height_pyramid.h"
+
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+	bool intersectQuad(const Lumix::Array<Lumix::uint16>& heights,
+		int width,
+		int x,
+		int z,
+		const Lumix::Vec3& origin,
+		const Lumix::Vec3& dir,
+		float* t)
+	{
+		auto getPoint = [&](int px, int pz) {
+			return Lumix::Vec3((float)px, heights[px + pz * width], (float)pz);
+		};
+		Lumix::Vec3 p0 = getPoint(x, z);
+		Lumix::Vec3 p1 = getPoint(x + 1, z);
+		Lumix::Vec3 p2 = getPoint(x + 1, z + 1);
+		Lumix::Vec3 p3 = getPoint(x, z + 1);
+		float t0, t1;
+		bool is_hit0 = Lumix::Math::getRayTriangleIntersection(origin, dir, p0, p1, p2, &t0);
+		bool is_hit1 = Lumix::Math::getRayTriangleIntersection(origin, dir, p0, p2, p3, &t1);
+		if (!is_hit0 && !is_hit1) return false;
+		*t = is_hit0 && is_hit1 ? Lumix::Math::minimum(t0, t1) : (is_hit0 ? t0 : t1);
+		return true;
+	}
+
+
+	bool castRayBruteForce(const Lumix::Array<Lumix::uint16>& heights,
+		int width,
+		int height,
+		const Lumix::Vec3& origin,
+		const Lumix::Vec3& dir,
+		float* t)
+	{
+		bool is_hit = false;
+		for (int z = 0; z < height - 1; ++z)
+		{
+			for (int x = 0; x < width - 1; ++x)
+			{
+				float quad_t;
+				if (!intersectQuad(heights, width, x, z, origin, dir, &quad_t)) continue;
+				if (!is_hit || quad_t < *t) *t = quad_t;
+				is_hit = true;
+			}
+		}
+		return is_hit;
+	}
+
+
+	// walks the heightmap cell by cell like Terrain::castRay used to do
+	bool castRayCells(const Lumix::Array<Lumix::uint16>& heights,
+		int width,
+		int height,
+		const Lumix::Vec3& origin,
+		const Lumix::Vec3& dir,
+		float* t)
+	{
+		int x = (int)origin.x;
+		int z = (int)origin.z;
+		int step_x = dir.x < 0 ? -1 : 1;
+		int step_z = dir.z < 0 ? -1 : 1;
+		float delta_x = fabsf(1 / dir.x);
+		float delta_z = fabsf(1 / dir.z);
+		float next_x = ((x + (step_x > 0 ? 1 : 0)) - origin.x) / dir.x;
+		float next_z = ((z + (step_z > 0 ? 1 : 0)) - origin.z) / dir.z;
+		while (x >= 0 && z >= 0 && x < width - 1 && z < height - 1)
+		{
+			if (intersectQuad(heights, width, x, z, origin, dir, t)) return true;
+			if (next_x < next_z)
+			{
+				next_x += delta_x;
+				x += step_x;
+			}
+			else
+			{
+				next_z += delta_z;
+				z += step_z;
+			}
+		}
+		return false;
+	}
+
+
+	void createHeightmap(int width, int height, Lumix::Array<Lumix::uint16>& heights)
+	{
+		heights.resize(width * height);
+		for (int z = 0; z < height; ++z)
+		{
+			for (int x = 0; x < width; ++x)
+			{
+				float h = sinf(x * 0.05f) * cosf(z * 0.07f) * 10000 + 20000 + Lumix::Math::randFloat(0, 500);
+				heights[x + z * width] = (Lumix::uint16)h;
+			}
+		}
+	}
+
+
+	void expectSameHits(const Lumix::MinMaxHeightPyramid& pyramid,
+		const Lumix::Array<Lumix::uint16>& heights,
+		int width,
+		int height)
+	{
+		int hits_count = 0;
+		for (int i = 0; i < 300; ++i)
+		{
+			Lumix::Vec3 origin(Lumix::Math::randFloat(-10, width + 10.0f),
+				Lumix::Math::randFloat(0, 40000),
+				Lumix::Math::randFloat(-10, height + 10.0f));
+			Lumix::Vec3 target(Lumix::Math::randFloat(0, (float)width), 20000, Lumix::Math::randFloat(0, (float)height));
+			Lumix::Vec3 dir = target - origin;
+			if (i % 10 == 0) dir.set(0, -1, 0); // zero division in box tests
+
+			float expected_t = 0;
+			bool expected_hit = castRayBruteForce(heights, width, height, origin, dir, &expected_t);
+			float t = 0;
+			bool is_hit = pyramid.castRay(&heights[0], origin, dir, &t);
+			LUMIX_EXPECT(is_hit == expected_hit);
+			if (!is_hit || !expected_hit) continue;
+			LUMIX_EXPECT_CLOSE_EQ(t, expected_t, 0.0001f + expected_t * 0.0001f);
+			++hits_count;
+		}
+		LUMIX_EXPECT(hits_count > 50);
+	}
+
+
+	void UT_min_max_height_pyramid(const char* params)
+	{
+		static const int WIDTH = 67;
+		static const int HEIGHT = 45;
+
+		Lumix::DefaultAllocator allocator;
+		Lumix::Math::seedRandom(5);
+		Lumix::Array<Lumix::uint16> heights(allocator);
+		createHeightmap(WIDTH, HEIGHT, heights);
+
+		Lumix::MinMaxHeightPyramid pyramid(allocator);
+		LUMIX_EXPECT(pyramid.empty());
+		pyramid.build(&heights[0], WIDTH, HEIGHT);
+		LUMIX_EXPECT(!pyramid.empty());
+		LUMIX_EXPECT(pyramid.getLevelsCount() == 8);
+		expectSameHits(pyramid, heights, WIDTH, HEIGHT);
+
+		// terrain editor changes a part of the heightmap
+		for (int z = 10; z < 30; ++z)
+		{
+			for (int x = 40; x < 67; ++x)
+			{
+				heights[x + z * WIDTH] = x % 4 == 0 ? 65535 : 0;
+			}
+		}
+		pyramid.update(&heights[0], 40, 10, 27, 20);
+		heights[0] = 65535;
+		pyramid.update(&heights[0], 0, 0, 1, 1);
+		expectSameHits(pyramid, heights, WIDTH, HEIGHT);
+
+		float t;
+		LUMIX_EXPECT(!pyramid.castRay(&heights[0], {10, 0, 10}, {0, -1, 0}, &t));
+		pyramid.clear();
+		LUMIX_EXPECT(pyramid.empty());
+		LUMIX_EXPECT(!pyramid.castRay(&heights[0], {10, 65535, 10}, {0, -1, 0}, &t));
+	}
+
+
+	void UT_min_max_height_pyramid_benchmark(const char* params)
+	{
+		static const int SIZE = 2049;
+		static const int RAYS_COUNT = 1000;
+
+		Lumix::DefaultAllocator allocator;
+		Lumix::Math::seedRandom(6);
+		Lumix::Array<Lumix::uint16> heights(allocator);
+		createHeightmap(SIZE, SIZE, heights);
+
+		Lumix::MinMaxHeightPyramid pyramid(allocator);
+		float build_time;
+		{
+			Lumix::ScopedTimer timer("build", allocator);
+			pyramid.build(&heights[0], SIZE, SIZE);
+			build_time = timer.getTimeSinceStart() * 1000;
+		}
+
+		// rays crossing hundreds of cells before they hit, like looking at the horizon
+		Lumix::Vec3 origins[RAYS_COUNT];
+		Lumix::Vec3 dirs[RAYS_COUNT];
+		for (int i = 0; i < RAYS_COUNT; ++i)
+		{
+			origins[i].set(Lumix::Math::randFloat(1, SIZE - 2.0f), 32000, Lumix::Math::randFloat(1, SIZE - 2.0f));
+			dirs[i].set(Lumix::Math::randFloat(-1, 1), Lumix::Math::randFloat(-20, -2), Lumix::Math::randFloat(-1, 1));
+		}
+
+		int cells_hits = 0;
+		float cells_time;
+		{
+			Lumix::ScopedTimer timer("cells", allocator);
+			for (int i = 0; i < RAYS_COUNT; ++i)
+			{
+				float t;
+				if (castRayCells(heights, SIZE, SIZE, origins[i], dirs[i], &t)) ++cells_hits;
+			}
+			cells_time = timer.getTimeSinceStart() * 1000;
+		}
+
+		int pyramid_hits = 0;
+		float pyramid_time;
+		{
+			Lumix::ScopedTimer timer("pyramid", allocator);
+			for (int i = 0; i < RAYS_COUNT; ++i)
+			{
+				float t;
+				if (pyramid.castRay(&heights[0], origins[i], dirs[i], &t)) ++pyramid_hits;
+			}
+			pyramid_time = timer.getTimeSinceStart() * 1000;
+		}
+		LUMIX_EXPECT(pyramid_hits == cells_hits);
+
+		Lumix::g_log_info.log("unit") << RAYS_COUNT << " rays, " << SIZE << "x" << SIZE << " heightmap: cell by cell "
+									  << cells_time << " ms, min/max pyramid " << pyramid_time << " ms, build "
+									  << build_time << " ms";
+	}
+}
+
+REGISTER_TEST("unit_tests/graphics/min_max_height_pyramid", UT_min_max_height_pyramid, "");
+REGISTER_TEST("unit_tests/graphics/min_max_height_pyramid_benchmark", UT_min_max_height_pyramid_benchmark, "");
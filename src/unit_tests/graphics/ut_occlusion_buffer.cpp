@@ -0,0 +1,86 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "engine/geometry.h"
+#include "engine/math_utils.h"
+#include "engine/matrix.h"
+
+#include "engine/mtjd/manager.h"
+
+#include "renderer/occlusion_buffer.h"
+
+namespace
+{
+	Lumix::Matrix translation(float x, float y, float z)
+	{
+		Lumix::Matrix mtx = Lumix::Matrix::IDENTITY;
+		mtx.setTranslation({x, y, z});
+		return mtx;
+	}
+
+	bool isBoxVisible(const Lumix::OcclusionBuffer& buffer, const Lumix::Vec3& center, float half_size)
+	{
+		Lumix::AABB aabb({-half_size, -half_size, -half_size}, {half_size, half_size, half_size});
+		return buffer.isVisible(translation(center.x, center.y, center.z), aabb);
+	}
+
+	void UT_occlusion_buffer(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::MTJD::Manager* mtjd_manager = Lumix::MTJD::Manager::create(allocator);
+		Lumix::OcclusionBuffer buffer(*mtjd_manager, allocator);
+
+		Lumix::Frustum frustum;
+		frustum.computePerspective(
+			{0, 0, 0}, {0, 0, 1}, {0, 1, 0}, Lumix::Math::degreesToRadians(60), 2.0f, 0.1f, 100.0f);
+
+		// 10x10 quad facing the camera
+		Lumix::Vec3 vertices[] = {{-5, -5, 0}, {5, -5, 0}, {5, 5, 0}, {-5, 5, 0}};
+		Lumix::uint16 indices[] = {0, 1, 2, 0, 2, 3};
+
+		buffer.clear(frustum, Lumix::OcclusionBuffer::DEFAULT_WIDTH, Lumix::OcclusionBuffer::DEFAULT_HEIGHT);
+		LUMIX_EXPECT(isBoxVisible(buffer, {0, 0, 30}, 1));
+
+		buffer.addTriangles(translation(0, 0, 10), vertices, indices, Lumix::lengthOf(indices));
+		LUMIX_EXPECT(buffer.getTrianglesCount() == 2);
+		buffer.rasterize(allocator);
+
+		const float* depths = buffer.getDepths();
+		int center = buffer.getHeight() / 2 * buffer.getWidth() + buffer.getWidth() / 2;
+		LUMIX_EXPECT_CLOSE_EQ(depths[center], 10, 0.001f);
+		LUMIX_EXPECT(depths[0] > 100);
+
+		LUMIX_EXPECT(!isBoxVisible(buffer, {0, 0, 30}, 1));
+		LUMIX_EXPECT(!isBoxVisible(buffer, {3, -3, 50}, 2));
+		LUMIX_EXPECT(isBoxVisible(buffer, {0, 0, 5}, 1)); // in front of the occluder
+		LUMIX_EXPECT(isBoxVisible(buffer, {0, 0, 10}, 1)); // intersects the occluder
+		LUMIX_EXPECT(isBoxVisible(buffer, {40, 0, 50}, 2)); // next to the occluder
+		LUMIX_EXPECT(isBoxVisible(buffer, {14, 0, 30}, 3)); // partially hidden
+		LUMIX_EXPECT(isBoxVisible(buffer, {0, 0, -5}, 1)); // behind the camera
+
+		// triangles crossing the near plane are ignored
+		buffer.clear(frustum, Lumix::OcclusionBuffer::DEFAULT_WIDTH, Lumix::OcclusionBuffer::DEFAULT_HEIGHT);
+		Lumix::Matrix rotated = Lumix::Matrix::IDENTITY;
+		rotated.setYVector({0, 0, 1});
+		rotated.setZVector({0, -1, 0});
+		buffer.addTriangles(rotated, vertices, indices, Lumix::lengthOf(indices));
+		LUMIX_EXPECT(buffer.getTrianglesCount() == 0);
+
+		// many small occluders give the same result as one big
+		buffer.clear(frustum, Lumix::OcclusionBuffer::DEFAULT_WIDTH, Lumix::OcclusionBuffer::DEFAULT_HEIGHT);
+		for (int y = 0; y < 10; ++y)
+		{
+			for (int x = 0; x < 10; ++x)
+			{
+				Lumix::Vec3 tile[] = {{0, 0, 0}, {1.01f, 0, 0}, {1.01f, 1.01f, 0}, {0, 1.01f, 0}};
+				buffer.addTriangles(translation(x - 5.0f, y - 5.0f, 10), tile, indices, Lumix::lengthOf(indices));
+			}
+		}
+		buffer.rasterize(allocator);
+		LUMIX_EXPECT(!isBoxVisible(buffer, {0, 0, 30}, 1));
+		LUMIX_EXPECT(isBoxVisible(buffer, {40, 0, 50}, 2));
+
+		Lumix::MTJD::Manager::destroy(*mtjd_manager);
+	}
+}
+
+REGISTER_TEST("unit_tests/graphics/occlusion_buffer", UT_occlusion_buffer, "");
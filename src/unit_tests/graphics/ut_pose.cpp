@@ -0,0 +1,239 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "engine/log.h"
+#include "engine/math_utils.h"
+#include "engine/quat.h"
+#include "engine/timer.h"
+#include "engine/vec.h"
+
+#include "renderer/pose.h"
+
+#include <cmath>
+
+namespace
+{
+	static const int BONES_COUNT = 61;
+
+
+	// a spine with limbs, so there are both chains and siblings
+	void createSkeleton(int* parents)
+	{
+		parents[0] = -1;
+		for (int i = 1; i < BONES_COUNT; ++i)
+		{
+			parents[i] = i < 8 ? i - 1 : i - 1 - (i % 4);
+		}
+	}
+
+
+	void createPose(Lumix::Pose& pose)
+	{
+		pose.resize(BONES_COUNT);
+		for (int i = 0; i < BONES_COUNT; ++i)
+		{
+			pose.positions[i].set(
+				Lumix::Math::randFloat(-1, 1), Lumix::Math::randFloat(0, 1), Lumix::Math::randFloat(-1, 1));
+			Lumix::Vec3 axis(Lumix::Math::randFloat(-1, 1), Lumix::Math::randFloat(-1, 1), 1.0f);
+			axis.normalize();
+			pose.rotations[i] = Lumix::Quat(axis, Lumix::Math::randFloat(-3, 3));
+		}
+	}
+
+
+	void copyPose(const Lumix::Pose& src, Lumix::Pose& dst)
+	{
+		dst.resize(src.count);
+		for (int i = 0; i < src.count; ++i)
+		{
+			dst.positions[i] = src.positions[i];
+			dst.rotations[i] = src.rotations[i];
+		}
+		dst.is_absolute = src.is_absolute;
+	}
+
+
+	// the scalar code Pose used before it had SIMD kernels
+	void computeAbsoluteScalar(Lumix::Pose& pose, const int* parents)
+	{
+		for (int i = 1; i < pose.count; ++i)
+		{
+			int parent = parents[i];
+			pose.positions[i] = pose.rotations[parent].rotate(pose.positions[i]) + pose.positions[parent];
+			pose.rotations[i] = pose.rotations[parent] * pose.rotations[i];
+		}
+		pose.is_absolute = true;
+	}
+
+
+	void blendScalar(Lumix::Pose& pose, const Lumix::Pose& rhs, float weight)
+	{
+		float inv = 1.0f - weight;
+		for (int i = 0; i < pose.count; ++i)
+		{
+			pose.positions[i] = pose.positions[i] * inv + rhs.positions[i] * weight;
+			Lumix::nlerp(pose.rotations[i], rhs.rotations[i], &pose.rotations[i], weight);
+		}
+	}
+
+
+	void expectSamePose(const Lumix::Pose& a, const Lumix::Pose& b, float tolerance)
+	{
+		LUMIX_EXPECT(a.count == b.count);
+		for (int i = 0; i < a.count; ++i)
+		{
+			LUMIX_EXPECT_CLOSE_EQ(a.positions[i].x, b.positions[i].x, tolerance);
+			LUMIX_EXPECT_CLOSE_EQ(a.positions[i].y, b.positions[i].y, tolerance);
+			LUMIX_EXPECT_CLOSE_EQ(a.positions[i].z, b.positions[i].z, tolerance);
+			LUMIX_EXPECT_CLOSE_EQ(a.rotations[i].x, b.rotations[i].x, tolerance);
+			LUMIX_EXPECT_CLOSE_EQ(a.rotations[i].y, b.rotations[i].y, tolerance);
+			LUMIX_EXPECT_CLOSE_EQ(a.rotations[i].z, b.rotations[i].z, tolerance);
+			LUMIX_EXPECT_CLOSE_EQ(a.rotations[i].w, b.rotations[i].w, tolerance);
+		}
+	}
+
+
+	void UT_pose_compute_absolute(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::Math::seedRandom(10);
+		int parents[BONES_COUNT];
+		createSkeleton(parents);
+
+		Lumix::Pose pose(allocator);
+		Lumix::Pose expected(allocator);
+		createPose(pose);
+		copyPose(pose, expected);
+
+		pose.computeAbsolute(parents, 1);
+		computeAbsoluteScalar(expected, parents);
+		LUMIX_EXPECT(pose.is_absolute);
+		expectSamePose(pose, expected, 0.00001f);
+	}
+
+
+	void UT_pose_blend(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::Math::seedRandom(11);
+
+		Lumix::Pose pose(allocator);
+		Lumix::Pose rhs(allocator);
+		Lumix::Pose expected(allocator);
+		createPose(pose);
+		createPose(rhs);
+		// opposite hemispheres must be flipped
+		for (int i = 0; i < BONES_COUNT; i += 3)
+		{
+			const Lumix::Quat& q = pose.rotations[i];
+			rhs.rotations[i].set(-q.x, -q.y, -q.z, -q.w);
+		}
+		copyPose(pose, expected);
+
+		pose.blend(rhs, 0.3f);
+		blendScalar(expected, rhs, 0.3f);
+		expectSamePose(pose, expected, 0.00001f);
+	}
+
+
+	void UT_pose_blend_n(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::Math::seedRandom(12);
+
+		Lumix::Pose a(allocator);
+		Lumix::Pose b(allocator);
+		Lumix::Pose c(allocator);
+		createPose(a);
+		createPose(b);
+		createPose(c);
+		for (int i = 0; i < BONES_COUNT; i += 3)
+		{
+			const Lumix::Quat& q = a.rotations[i];
+			b.rotations[i].set(-q.x, -q.y, -q.z, -q.w);
+		}
+
+		// two poses are the same as nlerp
+		Lumix::Pose pose(allocator);
+		Lumix::Pose expected(allocator);
+		pose.resize(BONES_COUNT);
+		copyPose(a, expected);
+		Lumix::Pose* poses[] = {&a, &b, &c};
+		float weights[] = {0.75f, 0.25f, 0};
+		pose.blend(poses, weights, 2);
+		blendScalar(expected, b, 0.25f);
+		expectSamePose(pose, expected, 0.00001f);
+
+		// normalized weighted sum in the hemisphere of the first pose, the output can be an input
+		copyPose(a, expected);
+		weights[0] = 0.5f;
+		weights[1] = 0.2f;
+		weights[2] = 0.3f;
+		for (int i = 0; i < BONES_COUNT; ++i)
+		{
+			Lumix::Vec3 pos(0, 0, 0);
+			Lumix::Quat rot(0, 0, 0, 0);
+			const Lumix::Quat& first = a.rotations[i];
+			for (int j = 0; j < 3; ++j)
+			{
+				pos += poses[j]->positions[i] * weights[j];
+				const Lumix::Quat& q = poses[j]->rotations[i];
+				float dot = first.x * q.x + first.y * q.y + first.z * q.z + first.w * q.w;
+				float weight = dot < 0 ? -weights[j] : weights[j];
+				rot.set(rot.x + q.x * weight, rot.y + q.y * weight, rot.z + q.z * weight, rot.w + q.w * weight);
+			}
+			rot.normalize();
+			expected.positions[i] = pos;
+			expected.rotations[i] = rot;
+		}
+		a.blend(poses, weights, 3);
+		expectSamePose(a, expected, 0.00001f);
+	}
+
+
+	void UT_pose_benchmark(const char* params)
+	{
+		static const int POSES_COUNT = 2000;
+
+		Lumix::DefaultAllocator allocator;
+		Lumix::Math::seedRandom(13);
+		int parents[BONES_COUNT];
+		createSkeleton(parents);
+		Lumix::Pose src(allocator);
+		Lumix::Pose rhs(allocator);
+		Lumix::Pose pose(allocator);
+		createPose(src);
+		createPose(rhs);
+
+		float scalar_time;
+		{
+			Lumix::ScopedTimer timer("scalar", allocator);
+			for (int i = 0; i < POSES_COUNT; ++i)
+			{
+				copyPose(src, pose);
+				blendScalar(pose, rhs, 0.4f);
+				computeAbsoluteScalar(pose, parents);
+			}
+			scalar_time = timer.getTimeSinceStart() * 1000;
+		}
+
+		float simd_time;
+		{
+			Lumix::ScopedTimer timer("simd", allocator);
+			for (int i = 0; i < POSES_COUNT; ++i)
+			{
+				copyPose(src, pose);
+				pose.blend(rhs, 0.4f);
+				pose.computeAbsolute(parents, 1);
+			}
+			simd_time = timer.getTimeSinceStart() * 1000;
+		}
+
+		Lumix::g_log_info.log("unit") << POSES_COUNT << " poses, " << BONES_COUNT << " bones, blend and absolute: scalar "
+									  << scalar_time << " ms, SIMD " << simd_time << " ms";
+	}
+}
+
+REGISTER_TEST("unit_tests/graphics/pose_compute_absolute", UT_pose_compute_absolute, "");
+REGISTER_TEST("unit_tests/graphics/pose_blend", UT_pose_blend, "");
+REGISTER_TEST("unit_tests/graphics/pose_blend_n", UT_pose_blend_n, "");
+REGISTER_TEST("unit_tests/graphics/pose_benchmark", UT_pose_benchmark, "");
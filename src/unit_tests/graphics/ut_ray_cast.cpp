@@ -0,0 +1,136 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "engine/geometry.h"
+#include "engine/math_utils.h"
+#include "engine/mtjd/manager.h"
+#include "renderer/culling_system.h"
+#include "renderer/ray_cast.h"
+#include <cmath>
+
+
+namespace
+{
+	// RenderScene can not be created without bgfx, so instances are spheres half the size of their
+	// bounding spheres instead of models, the rest is what RenderScene::castRay(s) run
+	struct InstanceHit
+	{
+		Lumix::RayCastModelHit operator()(Lumix::ComponentHandle model_instance,
+			const Lumix::Vec3& origin,
+			const Lumix::Vec3& dir) const
+		{
+			const Lumix::Sphere& sphere = (*spheres)[model_instance.index];
+			Lumix::RayCastModelHit hit;
+			hit.m_is_hit = false;
+			hit.m_component = model_instance;
+
+			float radius = sphere.radius * 0.5f;
+			Lumix::Vec3 rel_origin = origin - sphere.position;
+			float c = Lumix::dotProduct(rel_origin, rel_origin) - radius * radius;
+			float b = Lumix::dotProduct(rel_origin, dir);
+			float discriminant = b * b - c;
+			if (c > 0 && (b >= 0 || discriminant < 0)) return hit;
+
+			hit.m_is_hit = true;
+			hit.m_t = c <= 0 ? 0 : -b - sqrtf(discriminant);
+			return hit;
+		}
+
+		const Lumix::Array<Lumix::Sphere>* spheres;
+	};
+
+
+	Lumix::Vec3 randomPoint(float area_size)
+	{
+		return Lumix::Vec3(Lumix::Math::randFloat(-area_size, area_size),
+			Lumix::Math::randFloat(-area_size, area_size),
+			Lumix::Math::randFloat(-area_size, area_size));
+	}
+
+
+	Lumix::RayCastModelHit castRayBruteForce(const InstanceHit& hit_instance,
+		const Lumix::Ray& ray,
+		Lumix::ComponentHandle ignored_model_instance)
+	{
+		Lumix::RayCastModelHit hit;
+		hit.m_is_hit = false;
+		for (int i = 0; i < hit_instance.spheres->size(); ++i)
+		{
+			if (i == ignored_model_instance.index) continue;
+			Lumix::RayCastModelHit new_hit = hit_instance({i}, ray.origin, ray.dir);
+			if (new_hit.m_is_hit && (!hit.m_is_hit || new_hit.m_t < hit.m_t)) hit = new_hit;
+		}
+		return hit;
+	}
+
+
+	void expectSameHit(const Lumix::RayCastModelHit& a, const Lumix::RayCastModelHit& b)
+	{
+		LUMIX_EXPECT(a.m_is_hit == b.m_is_hit);
+		if (!a.m_is_hit || !b.m_is_hit) return;
+		LUMIX_EXPECT_CLOSE_EQ(a.m_t, b.m_t, 0.001f);
+	}
+
+
+	void UT_ray_cast(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::MTJD::Manager* mtjd_manager = Lumix::MTJD::Manager::create(allocator);
+		Lumix::CullingSystem* culling_system = Lumix::CullingSystem::create(
+			*mtjd_manager, allocator, (Lumix::uint32)Lumix::CullingSystem::Flags::HIERARCHICAL);
+
+		Lumix::Math::seedRandom(7);
+		Lumix::Array<Lumix::Sphere> spheres(allocator);
+		for (int i = 0; i < 3000; ++i)
+		{
+			spheres.push(Lumix::Sphere(randomPoint(100), Lumix::Math::randFloat(0.5f, 8.0f)));
+			culling_system->addStatic({i}, spheres.back(), 1);
+		}
+		InstanceHit hit_instance;
+		hit_instance.spheres = &spheres;
+
+		// not a multiple of RAYS_PER_JOB, so the last job is partial
+		static const int RAYS_COUNT = 1000;
+		Lumix::Array<Lumix::Ray> rays(allocator);
+		for (int i = 0; i < RAYS_COUNT; ++i)
+		{
+			Lumix::Ray& ray = rays.emplace();
+			ray.origin = randomPoint(120);
+			ray.dir = i % 10 == 0 ? Lumix::Vec3(0, 0, 1) : randomPoint(1);
+			ray.dir.normalize();
+		}
+
+		auto cast = [culling_system, &hit_instance](const Lumix::Ray& ray,
+			Lumix::CullingSystem::RayHits& candidates) {
+			return Lumix::castRayOnInstances(
+				*culling_system, ray.origin, ray.dir, Lumix::INVALID_COMPONENT, candidates, hit_instance);
+		};
+		Lumix::Array<Lumix::RayCastModelHit> batch_hits(allocator);
+		batch_hits.resize(RAYS_COUNT);
+		Lumix::castRaysInJobs(*mtjd_manager, allocator, &rays[0], RAYS_COUNT, &batch_hits[0], cast);
+
+		Lumix::CullingSystem::RayHits candidates(allocator);
+		int hits_count = 0;
+		for (int i = 0; i < RAYS_COUNT; ++i)
+		{
+			Lumix::RayCastModelHit hit = Lumix::castRayOnInstances(
+				*culling_system, rays[i].origin, rays[i].dir, Lumix::INVALID_COMPONENT, candidates, hit_instance);
+			expectSameHit(batch_hits[i], hit);
+			LUMIX_EXPECT((!hit.m_is_hit || batch_hits[i].m_component == hit.m_component));
+			expectSameHit(hit, castRayBruteForce(hit_instance, rays[i], Lumix::INVALID_COMPONENT));
+			if (!hit.m_is_hit) continue;
+
+			++hits_count;
+			Lumix::RayCastModelHit next_hit = Lumix::castRayOnInstances(
+				*culling_system, rays[i].origin, rays[i].dir, hit.m_component, candidates, hit_instance);
+			LUMIX_EXPECT((!next_hit.m_is_hit || next_hit.m_component != hit.m_component));
+			expectSameHit(next_hit, castRayBruteForce(hit_instance, rays[i], hit.m_component));
+		}
+		LUMIX_EXPECT(hits_count > 0);
+		LUMIX_EXPECT(hits_count < RAYS_COUNT);
+
+		Lumix::CullingSystem::destroy(*culling_system);
+		Lumix::MTJD::Manager::destroy(*mtjd_manager);
+	}
+} // anonymous namespace
+
+REGISTER_TEST("unit_tests/graphics/ray_cast", UT_ray_cast, "");
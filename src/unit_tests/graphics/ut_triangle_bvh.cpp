@@ -0,0 +1,197 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "engine/log.h"
+#include "engine/math_utils.h"
+#include "engine/timer.h"
+
+#include "renderer/triangle_bvh.h"
+
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+	// the same test Model::castRay used to do for every triangle
+	bool castRayBruteForce(const Lumix::Array<Lumix::Vec3>& vertices,
+		const Lumix::Array<Lumix::uint32>& indices,
+		const Lumix::Vec3& origin,
+		const Lumix::Vec3& dir,
+		float* hit_t)
+	{
+		bool is_hit = false;
+		for (int i = 0, c = indices.size(); i < c; i += 3)
+		{
+			Lumix::Vec3 p0 = vertices[indices[i]];
+			Lumix::Vec3 p1 = vertices[indices[i + 1]];
+			Lumix::Vec3 p2 = vertices[indices[i + 2]];
+			Lumix::Vec3 normal = Lumix::crossProduct(p1 - p0, p2 - p0);
+			float q = Lumix::dotProduct(normal, dir);
+			if (q == 0) continue;
+
+			float d = -Lumix::dotProduct(normal, p0);
+			float t = -(Lumix::dotProduct(normal, origin) + d) / q;
+			if (t < 0) continue;
+
+			Lumix::Vec3 hit_point = origin + dir * t;
+			if (Lumix::dotProduct(normal, Lumix::crossProduct(p1 - p0, hit_point - p0)) < 0) continue;
+			if (Lumix::dotProduct(normal, Lumix::crossProduct(p2 - p1, hit_point - p1)) < 0) continue;
+			if (Lumix::dotProduct(normal, Lumix::crossProduct(p0 - p2, hit_point - p2)) < 0) continue;
+
+			if (!is_hit || *hit_t > t)
+			{
+				is_hit = true;
+				*hit_t = t;
+			}
+		}
+		return is_hit;
+	}
+
+
+	Lumix::Vec3 randomPoint(float size)
+	{
+		return {Lumix::Math::randFloat(-size, size),
+			Lumix::Math::randFloat(-size, size),
+			Lumix::Math::randFloat(-size, size)};
+	}
+
+
+	// bumpy terrain-like grid, similar to what a big static mesh looks like
+	void createGrid(int size, Lumix::Array<Lumix::Vec3>& vertices, Lumix::Array<Lumix::uint32>& indices)
+	{
+		for (int z = 0; z <= size; ++z)
+		{
+			for (int x = 0; x <= size; ++x)
+			{
+				float height = sinf(x * 0.1f) * cosf(z * 0.13f) * 5 + Lumix::Math::randFloat(0, 0.3f);
+				vertices.emplace(x - size * 0.5f, height, z - size * 0.5f);
+			}
+		}
+		for (int z = 0; z < size; ++z)
+		{
+			for (int x = 0; x < size; ++x)
+			{
+				Lumix::uint32 i = z * (size + 1) + x;
+				indices.push(i);
+				indices.push(i + 1);
+				indices.push(i + size + 1);
+				indices.push(i + 1);
+				indices.push(i + size + 2);
+				indices.push(i + size + 1);
+			}
+		}
+	}
+
+
+	void UT_triangle_bvh(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::Math::seedRandom(3);
+
+		Lumix::Array<Lumix::Vec3> vertices(allocator);
+		Lumix::Array<Lumix::uint32> indices(allocator);
+		for (int i = 0; i < 2000; ++i)
+		{
+			Lumix::Vec3 center = randomPoint(50);
+			for (int j = 0; j < 3; ++j)
+			{
+				indices.push(vertices.size());
+				vertices.push(center + randomPoint(3));
+			}
+		}
+		createGrid(20, vertices, indices);
+
+		Lumix::TriangleBVH bvh(allocator);
+		LUMIX_EXPECT(bvh.empty());
+		bvh.build(&vertices[0], &indices[0], indices.size() / 3);
+		LUMIX_EXPECT(!bvh.empty());
+
+		int hits_count = 0;
+		for (int i = 0; i < 1000; ++i)
+		{
+			Lumix::Vec3 origin = randomPoint(80);
+			Lumix::Vec3 dir = randomPoint(1) - origin * 0.01f;
+
+			float expected_t = FLT_MAX;
+			bool expected_hit = castRayBruteForce(vertices, indices, origin, dir, &expected_t);
+			Lumix::TriangleBVH::Hit hit;
+			bool is_hit = bvh.castRay(origin, dir, &hit);
+			LUMIX_EXPECT(is_hit == expected_hit);
+			if (!is_hit || !expected_hit) continue;
+
+			++hits_count;
+			LUMIX_EXPECT_CLOSE_EQ(hit.t, expected_t, 0.001f * expected_t);
+			LUMIX_EXPECT(hit.triangle >= 0);
+			LUMIX_EXPECT(hit.triangle < indices.size() / 3);
+		}
+		LUMIX_EXPECT(hits_count > 100);
+
+		// ray pointing away from everything
+		Lumix::TriangleBVH::Hit hit;
+		LUMIX_EXPECT(!bvh.castRay({0, 1000, 0}, {0, 1, 0}, &hit));
+
+		bvh.clear();
+		LUMIX_EXPECT(bvh.empty());
+		LUMIX_EXPECT(!bvh.castRay({0, 0, 0}, {0, 1, 0}, &hit));
+	}
+
+
+	void UT_triangle_bvh_benchmark(const char* params)
+	{
+		static const int GRID_SIZE = 300;
+		static const int RAYS_COUNT = 200;
+
+		Lumix::DefaultAllocator allocator;
+		Lumix::Math::seedRandom(4);
+		Lumix::Array<Lumix::Vec3> vertices(allocator);
+		Lumix::Array<Lumix::uint32> indices(allocator);
+		createGrid(GRID_SIZE, vertices, indices);
+
+		Lumix::Vec3 origins[RAYS_COUNT];
+		Lumix::Vec3 dirs[RAYS_COUNT];
+		for (int i = 0; i < RAYS_COUNT; ++i)
+		{
+			origins[i].set(Lumix::Math::randFloat(-100, 100), 50, Lumix::Math::randFloat(-100, 100));
+			dirs[i].set(Lumix::Math::randFloat(-1, 1), -1, Lumix::Math::randFloat(-1, 1));
+		}
+
+		float brute_force_time;
+		int brute_force_hits = 0;
+		{
+			Lumix::ScopedTimer timer("brute force", allocator);
+			for (int i = 0; i < RAYS_COUNT; ++i)
+			{
+				float t;
+				if (castRayBruteForce(vertices, indices, origins[i], dirs[i], &t)) ++brute_force_hits;
+			}
+			brute_force_time = timer.getTimeSinceStart() * 1000;
+		}
+
+		Lumix::TriangleBVH bvh(allocator);
+		float build_time;
+		{
+			Lumix::ScopedTimer timer("build", allocator);
+			bvh.build(&vertices[0], &indices[0], indices.size() / 3);
+			build_time = timer.getTimeSinceStart() * 1000;
+		}
+
+		float bvh_time;
+		int bvh_hits = 0;
+		{
+			Lumix::ScopedTimer timer("bvh", allocator);
+			for (int i = 0; i < RAYS_COUNT; ++i)
+			{
+				Lumix::TriangleBVH::Hit hit;
+				if (bvh.castRay(origins[i], dirs[i], &hit)) ++bvh_hits;
+			}
+			bvh_time = timer.getTimeSinceStart() * 1000;
+		}
+		LUMIX_EXPECT(bvh_hits == brute_force_hits);
+
+		Lumix::g_log_info.log("unit") << RAYS_COUNT << " rays, " << indices.size() / 3 << " triangles: brute force "
+									  << brute_force_time << " ms, bvh " << bvh_time << " ms, bvh build "
+									  << build_time << " ms, " << bvh.getNodesCount() << " nodes";
+	}
+}
+
+REGISTER_TEST("unit_tests/graphics/triangle_bvh", UT_triangle_bvh, "");
+REGISTER_TEST("unit_tests/graphics/triangle_bvh_benchmark", UT_triangle_bvh_benchmark, "");